@@ -0,0 +1,337 @@
+/*
+ * Request hot path benchmark against an in-process mock daemon.
+ *
+ * The daemon serves canned /_ping, /containers/json, /containers/{id}/json
+ * and a multiplexed log stream of configurable size on a unix socket, so
+ * numbers only reflect the library, curl and json-c. For every operation
+ * and thread count it reports requests/s, p50/p99 latency and heap
+ * allocations per call (counted on the calling threads only).
+ */
+
+#include "../docker-excess.c"
+#include "../tests/mock_daemon.h"
+
+#include <getopt.h>
+
+/* ----------------- Allocation Counting ----------------- */
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static atomic_ullong alloc_count;
+static _Thread_local bool counting;
+
+void *malloc(size_t size) {
+    if (counting) atomic_fetch_add_explicit(&alloc_count, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    if (counting) atomic_fetch_add_explicit(&alloc_count, 1, memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (counting) atomic_fetch_add_explicit(&alloc_count, 1, memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+/* ----------------- Mock Daemon ----------------- */
+
+typedef struct {
+    char *list_body;
+    char *inspect_body;
+    size_t stream_bytes;
+} canned_t;
+
+#define STREAM_FRAME 16384
+
+static void write_log_stream(int fd, size_t total) {
+    static char payload[STREAM_FRAME];
+    if (!payload[0]) memset(payload, 'x', sizeof(payload));
+    
+    size_t frames = (total + STREAM_FRAME - 1) / STREAM_FRAME;
+    char head[160];
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: application/vnd.docker.raw-stream\r\n"
+                     "Content-Length: %zu\r\n\r\n", total + frames * 8);
+    mock_write(fd, head, (size_t)n);
+    
+    for (size_t sent = 0; sent < total;) {
+        size_t len = total - sent < STREAM_FRAME ? total - sent : STREAM_FRAME;
+        unsigned char header[8] = { DOCKER_EXCESS_STREAM_STDOUT, 0, 0, 0, (unsigned char)(len >> 24),
+                                    (unsigned char)(len >> 16), (unsigned char)(len >> 8), (unsigned char)len };
+        mock_write(fd, header, sizeof(header));
+        mock_write(fd, payload, len);
+        sent += len;
+    }
+}
+
+static bool handle(int fd, const mock_request_t *req, void *userdata) {
+    const canned_t *canned = userdata;
+    
+    if (strstr(req->path, "/_ping")) {
+        mock_reply(fd, 200, "text/plain", "OK");
+    } else if (strstr(req->path, "/containers/json")) {
+        mock_reply(fd, 200, NULL, canned->list_body);
+    } else if (strstr(req->path, "/logs?")) {
+        write_log_stream(fd, canned->stream_bytes);
+    } else if (strstr(req->path, "/containers/")) {
+        mock_reply(fd, 200, NULL, canned->inspect_body);
+    } else {
+        mock_reply(fd, 404, NULL, "{\"message\":\"page not found\"}");
+    }
+    return true;
+}
+
+static char* container_json(size_t i, bool inspect) {
+    char *json = NULL;
+    int n;
+    if (inspect) {
+        n = asprintf(&json, "{\"Id\":\"%064zx\",\"Name\":\"/bench-%zu\",\"Image\":\"sha256:%064zx\","
+                     "\"Created\":\"2024-05-06T07:08:09.123456789Z\",\"State\":{\"Status\":\"running\","
+                     "\"Running\":true,\"ExitCode\":0,\"StartedAt\":\"2024-05-06T07:08:10Z\"},"
+                     "\"Config\":{\"Image\":\"nginx:alpine\",\"Labels\":{\"app\":\"bench\",\"tier\":\"web\"}},"
+                     "\"Mounts\":[{\"Type\":\"volume\",\"Source\":\"/var/lib/docker/volumes/data\","
+                     "\"Destination\":\"/data\",\"RW\":true}]}", i, i, i);
+    } else {
+        n = asprintf(&json, "{\"Id\":\"%064zx\",\"Names\":[\"/bench-%zu\"],\"Image\":\"nginx:alpine\","
+                     "\"ImageID\":\"sha256:%064zx\",\"Command\":\"nginx -g 'daemon off;'\",\"Created\":1714979289,"
+                     "\"State\":\"running\",\"Status\":\"Up 2 hours\",\"Ports\":[{\"IP\":\"0.0.0.0\","
+                     "\"PrivatePort\":80,\"PublicPort\":8080,\"Type\":\"tcp\"}],"
+                     "\"Labels\":{\"app\":\"bench\",\"tier\":\"web\"}}", i, i, i);
+    }
+    return n < 0 ? NULL : json;
+}
+
+static void list_append(response_buffer_t *buffer, const char *data, size_t len) {
+    write_response_callback((void*)data, 1, len, buffer);
+}
+
+static char* list_json(size_t count) {
+    response_buffer_t buffer = {0};
+    list_append(&buffer, "[", 1);
+    for (size_t i = 0; i < count; i++) {
+        char *item = container_json(i, false);
+        if (i > 0) list_append(&buffer, ",", 1);
+        if (item) list_append(&buffer, item, strlen(item));
+        free(item);
+    }
+    list_append(&buffer, "]", 1);
+    return buffer.data;
+}
+
+/* ----------------- Operations ----------------- */
+
+typedef bool (*bench_op_fn)(docker_excess_t *client);
+
+static bool op_ping(docker_excess_t *client) {
+    char *response = NULL;
+    docker_excess_error_t err = make_request(client, "GET", "/_ping", NULL, &response, NULL);
+    free(response);
+    return err == DOCKER_EXCESS_OK;
+}
+
+static bool op_list(docker_excess_t *client) {
+    docker_excess_container_t **containers = NULL;
+    size_t count = 0;
+    docker_excess_error_t err = docker_excess_list_containers(client, true, NULL, &containers, &count);
+    docker_excess_free_containers(containers, count);
+    return err == DOCKER_EXCESS_OK;
+}
+
+static bool op_inspect(docker_excess_t *client) {
+    docker_excess_container_t *container = NULL;
+    docker_excess_error_t err = docker_excess_inspect_container(client, "bench-0", &container);
+    if (container) {
+        container_clear(container);
+        free(container);
+    }
+    return err == DOCKER_EXCESS_OK;
+}
+
+static bool count_bytes(const void *data, size_t len, int stream_id, void *userdata) {
+    (void)data;
+    (void)stream_id;
+    *(size_t*)userdata += len;
+    return true;
+}
+
+static bool op_stream(docker_excess_t *client) {
+    size_t received = 0;
+    return docker_excess_get_logs_raw(client, "bench-0", NULL, count_bytes, &received) == DOCKER_EXCESS_OK;
+}
+
+static const struct {
+    const char *name;
+    bench_op_fn fn;
+} bench_ops[] = {
+    { "ping", op_ping },            /* make_request() with the smallest body */
+    { "list", op_list },
+    { "inspect", op_inspect },
+    { "stream", op_stream },
+};
+
+/* ----------------- Runner ----------------- */
+
+static int64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+typedef struct {
+    docker_excess_t *client;
+    bench_op_fn fn;
+    int64_t end_us;
+    uint32_t *samples;              /* Latency of each call in microseconds */
+    size_t count;
+    size_t capacity;
+    size_t failures;
+    pthread_barrier_t *start;
+} worker_t;
+
+static void* worker_run(void *arg) {
+    worker_t *worker = arg;
+    pthread_barrier_wait(worker->start);
+    
+    counting = true;
+    while (now_us() < worker->end_us) {
+        int64_t t0 = now_us();
+        bool ok = worker->fn(worker->client);
+        int64_t elapsed = now_us() - t0;
+    
+        if (!ok) worker->failures++;
+        if (worker->count == worker->capacity) {
+            counting = false;       /* The sample array is the bench's, not the library's */
+            worker->capacity = worker->capacity ? worker->capacity * 2 : 4096;
+            worker->samples = realloc(worker->samples, worker->capacity * sizeof(uint32_t));
+            counting = true;
+        }
+        worker->samples[worker->count++] = (uint32_t)(elapsed > UINT32_MAX ? UINT32_MAX : elapsed);
+    }
+    counting = false;
+    return NULL;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void run_case(docker_excess_t *client, const char *name, bench_op_fn fn, int threads, double seconds) {
+    /* Warm the pool so connection setup is not part of the numbers */
+    for (int i = 0; i < threads; i++) fn(client);
+    
+    worker_t *workers = calloc((size_t)threads, sizeof(worker_t));
+    pthread_t *ids = calloc((size_t)threads, sizeof(pthread_t));
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, (unsigned)threads + 1);
+    
+    for (int i = 0; i < threads; i++) {
+        workers[i] = (worker_t){ .client = client, .fn = fn, .start = &start };
+        pthread_create(&ids[i], NULL, worker_run, &workers[i]);
+    }
+    
+    unsigned long long allocs_before = atomic_load(&alloc_count);
+    int64_t begin = now_us();
+    int64_t end = begin + (int64_t)(seconds * 1e6);
+    for (int i = 0; i < threads; i++) workers[i].end_us = end;
+    pthread_barrier_wait(&start);
+    for (int i = 0; i < threads; i++) pthread_join(ids[i], NULL);
+    int64_t wall = now_us() - begin;
+    unsigned long long allocs = atomic_load(&alloc_count) - allocs_before;
+    
+    size_t total = 0, failures = 0;
+    for (int i = 0; i < threads; i++) {
+        total += workers[i].count;
+        failures += workers[i].failures;
+    }
+    uint32_t *all = malloc((total ? total : 1) * sizeof(uint32_t));
+    size_t at = 0;
+    for (int i = 0; i < threads; i++) {
+        memcpy(all + at, workers[i].samples, workers[i].count * sizeof(uint32_t));
+        at += workers[i].count;
+        free(workers[i].samples);
+    }
+    qsort(all, total, sizeof(uint32_t), compare_u32);
+    
+    printf("%-8s %7d %12.0f %9u %9u %12.1f %8zu\n", name, threads, total * 1e6 / (double)wall,
+           total ? all[total / 2] : 0, total ? all[(size_t)(total * 0.99)] : 0,
+           total ? (double)allocs / (double)total : 0.0, failures);
+    
+    free(all);
+    pthread_barrier_destroy(&start);
+    free(ids);
+    free(workers);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-d seconds] [-t max_threads] [-c containers] [-s stream_bytes] [op...]\n"
+            "ops: ping list inspect stream (default: all)\n", argv0);
+}
+
+int main(int argc, char **argv) {
+    double seconds = 1.0;
+    int max_threads = 64;
+    size_t containers = 50;
+    size_t stream_bytes = 1 << 20;
+    
+    int opt;
+    while ((opt = getopt(argc, argv, "d:t:c:s:h")) != -1) {
+        switch (opt) {
+            case 'd': seconds = atof(optarg); break;
+            case 't': max_threads = atoi(optarg); break;
+            case 'c': containers = strtoul(optarg, NULL, 10); break;
+            case 's': stream_bytes = strtoul(optarg, NULL, 10); break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (seconds <= 0 || max_threads < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    
+    canned_t canned = {
+        .list_body = list_json(containers),
+        .inspect_body = container_json(0, true),
+        .stream_bytes = stream_bytes,
+    };
+    mock_daemon_t daemon;
+    if (!canned.list_body || !canned.inspect_body || !mock_daemon_start(&daemon, handle, &canned)) {
+        perror("mock daemon");
+        return 1;
+    }
+    
+    docker_excess_config_t config = {0};
+    config.socket_path = daemon.socket_path;
+    config.timeout_s = 30;
+    config.max_connections = max_threads;
+    docker_excess_t *client = NULL;
+    if (docker_excess_new_with_config(&config, &client) != DOCKER_EXCESS_OK) {
+        fprintf(stderr, "client: %s\n", docker_excess_get_error(NULL));
+        return 1;
+    }
+    
+    printf("%zu containers per list, %zu bytes per stream, %.1f s per case\n\n", containers, stream_bytes, seconds);
+    printf("%-8s %7s %12s %9s %9s %12s %8s\n", "op", "threads", "req/s", "p50_us", "p99_us", "allocs/call",
+           "failed");
+    
+    for (size_t i = 0; i < sizeof(bench_ops) / sizeof(bench_ops[0]); i++) {
+        bool selected = optind == argc;
+        for (int a = optind; a < argc; a++) {
+            if (strcmp(argv[a], bench_ops[i].name) == 0) selected = true;
+        }
+        if (!selected) continue;
+    
+        for (int threads = 1; threads <= max_threads; threads *= 2) {
+            run_case(client, bench_ops[i].name, bench_ops[i].fn, threads, seconds);
+        }
+    }
+    
+    docker_excess_free(client);
+    mock_daemon_stop(&daemon);
+    free(canned.list_body);
+    free(canned.inspect_body);
+    return 0;
+}
@@ -4,16 +4,26 @@
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <sys/stat.h>
+#include <limits.h>
+#include <libgen.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <dirent.h>
 #include <stdarg.h>
 #include <ctype.h>
+#include <strings.h>
 #include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/mman.h>
 #include <curl/curl.h>
 #include <json-c/json.h>
+#include <zlib.h>
 
 /* ----------------- Internal Structures ----------------- */
 
@@ -23,25 +33,113 @@ typedef struct {
     size_t capacity;
 } response_buffer_t;
 
+typedef struct async_engine async_engine_t;
+
+/* curl share handle (DNS and TLS session cache) with its locks; owned by a client or its group */
+typedef struct {
+    CURLSH *handle;
+    pthread_mutex_t locks[CURL_LOCK_DATA_LAST];
+    bool locks_initialized;
+} share_t;
+
+typedef struct metrics metrics_t;
+typedef struct list_snapshot list_snapshot_t;
+
+typedef enum {
+    RESOLVE_CONTAINER,
+    RESOLVE_IMAGE,
+    RESOLVE_NETWORK
+} resolve_kind_t;
+
+typedef struct resolve_entry resolve_entry_t;
+
+/* Bounded name -> ID cache: chained hash table plus an LRU list */
+typedef struct {
+    resolve_entry_t **buckets;
+    size_t bucket_mask;
+    size_t count;
+    size_t capacity;                /* 0 = disabled */
+    int64_t ttl_ms;
+    resolve_entry_t *lru_head;      /* Most recently used */
+    resolve_entry_t *lru_tail;
+    pthread_mutex_t mutex;
+} resolve_cache_t;
+
+/* Pool of easy handles; each handle keeps its own keep-alive connection */
+typedef struct {
+    CURL **idle;                    /* Stack of handles ready for checkout */
+    size_t idle_count;
+    size_t created;                 /* Handles created so far (<= max) */
+    size_t max;
+    pthread_mutex_t mutex;
+    pthread_cond_t available;
+} connection_pool_t;
+
+/* Multi handles for hedged requests; each keeps its own connection cache between uses */
+typedef struct {
+    CURLM **idle;
+    size_t idle_count;
+    size_t max;
+    pthread_mutex_t mutex;
+} multi_pool_t;
+
+/* Retry budget and circuit breaker of one daemon */
+typedef struct {
+    int retry_tokens;               /* Tenths of a retry; requests earn 1, a retry costs 10 */
+    int failures;                   /* Consecutive unhealthy responses */
+    int64_t open_until;             /* monotonic_ms() the breaker stays open until, 0 = closed */
+    bool probing;                   /* Half-open: one request is testing the daemon */
+    pthread_mutex_t mutex;
+} transport_policy_t;
+
 struct docker_excess_t {
     docker_excess_config_t config;
-    CURL *curl;
-    char error_msg[DOCKER_EXCESS_MAX_ERROR_MSG];
-    pthread_mutex_t mutex;
+    connection_pool_t pool;
+    transport_policy_t policy;
+    multi_pool_t hedge_multis;      /* Only set up with config.hedge_reads */
+    share_t *share;                 /* &own_share, or the group's */
+    share_t own_share;
+    docker_excess_group_t *group;   /* NULL unless created by docker_excess_group_add() */
+    struct curl_slist *headers;     /* Default request headers, built once */
+    struct curl_slist *tar_headers; /* Same, for tar request bodies */
+    char url_prefix[512];           /* "scheme://host:port/vX.YY", built once */
+    size_t url_prefix_len;
+    async_engine_t *engine;         /* Created on first async use; the group's for group members */
+    pthread_mutex_t async_mutex;
+    resolve_cache_t resolver;
+    metrics_t *metrics;             /* NULL unless config.metrics */
+    list_snapshot_t *list_snapshots; /* Last listing per query, see list_containers_delta */
+    pthread_mutex_t list_mutex;     /* Protects the list_snapshots chain */
     bool curl_initialized;
     bool is_connected;
     time_t last_ping;
 };
 
+/* Clients for several daemons sharing one DNS/TLS cache and one async engine */
+struct docker_excess_group {
+    share_t share;
+    async_engine_t *engine;
+    docker_excess_t **clients;
+    size_t count;
+    size_t capacity;
+    pthread_mutex_t mutex;          /* Protects clients, count and capacity */
+};
+
 /* Global initialization counter for libcurl */
 static int g_curl_init_count = 0;
 static pthread_mutex_t g_curl_init_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /* ----------------- Static Helper Functions ----------------- */
 
-static void docker_excess_log(docker_excess_t *client, docker_excess_log_level_t level, const char *format, ...) {
-    if (!client || !client->config.log_callback) return;
-    
+/* The level is checked before the arguments are evaluated or formatted */
+#define docker_excess_log(client, level, ...) \
+    do { \
+        if ((client) && (client)->config.log_callback && (level) <= (client)->config.log_level) { \
+            docker_excess_log_write((client), (level), __VA_ARGS__); \
+        } \
+    } while (0)
+
+static void docker_excess_log_write(docker_excess_t *client, docker_excess_log_level_t level, const char *format, ...) {
     char message[1024];
     va_list args;
     va_start(args, format);
@@ -51,6 +149,18 @@ static void docker_excess_log(docker_excess_t *client, docker_excess_log_level_t
     client->config.log_callback(level, message, client->config.log_userdata);
 }
 
+static int64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 static size_t write_response_callback(void *contents, size_t size, size_t nmemb, response_buffer_t *buffer) {
     size_t total_size = size * nmemb;
     
@@ -76,17 +186,162 @@ static size_t write_response_callback(void *contents, size_t size, size_t nmemb,
     return total_size;
 }
 
+/* Incremental JSON parse state: chunks are tokenized as they arrive */
+typedef struct {
+    json_tokener *tok;
+    json_object *result;
+    enum json_tokener_error error;
+    bool timed;                     /* Accumulate parse_us (metrics or tracing on) */
+    int64_t parse_us;
+} json_sink_t;
+
+static bool json_sink_init(json_sink_t *sink) {
+    sink->tok = json_tokener_new();
+    sink->result = NULL;
+    sink->error = json_tokener_continue;
+    sink->timed = false;
+    sink->parse_us = 0;
+    return sink->tok != NULL;
+}
+
+static void json_sink_cleanup(json_sink_t *sink) {
+    if (sink->tok) json_tokener_free(sink->tok);
+    if (sink->result) json_object_put(sink->result);
+    sink->tok = NULL;
+    sink->result = NULL;
+}
+
+static size_t write_json_callback(char *contents, size_t size, size_t nmemb, void *userdata) {
+    json_sink_t *sink = userdata;
+    size_t total_size = size * nmemb;
+    
+    /* Once a value is complete (or broken) the rest of the body is ignored */
+    if (sink->error != json_tokener_continue || total_size == 0) return total_size;
+    
+    int64_t start_us = sink->timed ? monotonic_us() : 0;
+    json_object *obj = json_tokener_parse_ex(sink->tok, contents, (int)total_size);
+    sink->error = json_tokener_get_error(sink->tok);
+    if (obj) {
+        sink->result = obj;
+        sink->error = json_tokener_success;
+    }
+    if (sink->timed) sink->parse_us += monotonic_us() - start_us;
+    
+    return total_size;
+}
+
+/* Signal end of input and take ownership of the parsed value (NULL if invalid) */
+static json_object* json_sink_finish(json_sink_t *sink) {
+    if (sink->error == json_tokener_continue) {
+        /* Bare scalars at end of input need the terminating NUL to complete */
+        json_object *obj = json_tokener_parse_ex(sink->tok, "", 1);
+        if (obj) sink->result = obj;
+    }
+    
+    json_object *result = sink->result;
+    sink->result = NULL;
+    return result;
+}
+
+/* Splits a body carrying back-to-back JSON values and hands each one over */
+typedef bool (*json_stream_value_fn)(json_object *value, void *ctx);
+
+typedef struct {
+    json_tokener *tok;              /* Reused for every value of the stream */
+    json_stream_value_fn on_value;  /* Return false to stop the transfer */
+    void *ctx;
+    bool stopped;
+} json_stream_t;
+
+static bool json_stream_init(json_stream_t *stream, json_stream_value_fn on_value, void *ctx) {
+    stream->tok = json_tokener_new();
+    stream->on_value = on_value;
+    stream->ctx = ctx;
+    stream->stopped = false;
+    return stream->tok != NULL;
+}
+
+static void json_stream_cleanup(json_stream_t *stream) {
+    if (stream->tok) json_tokener_free(stream->tok);
+    stream->tok = NULL;
+}
+
+static size_t write_json_stream_callback(char *contents, size_t size, size_t nmemb, void *userdata) {
+    json_stream_t *stream = userdata;
+    size_t total_size = size * nmemb;
+    size_t offset = 0;
+    
+    while (offset < total_size && !stream->stopped) {
+        json_object *value = json_tokener_parse_ex(stream->tok, contents + offset, (int)(total_size - offset));
+        enum json_tokener_error jerr = json_tokener_get_error(stream->tok);
+        
+        if (!value) {
+            if (jerr != json_tokener_continue) {
+                /* Drop the damaged value and resync on the next chunk */
+                json_tokener_reset(stream->tok);
+            }
+            break;
+        }
+        
+        size_t consumed = json_tokener_get_parse_end(stream->tok);
+        offset += consumed > 0 ? consumed : total_size - offset;
+        json_tokener_reset(stream->tok);
+        
+        if (!stream->on_value(value, stream->ctx)) stream->stopped = true;
+        json_object_put(value);
+    }
+    
+    return stream->stopped ? 0 : total_size;
+}
+
+/*
+ * Errors are kept per thread: a thread sees the failures of the calls it made
+ * (and of the async completions it ran), and recording one never takes a lock
+ * that in-flight requests use. One client at a time, the last one that failed.
+ */
+typedef struct {
+    const docker_excess_t *client;  /* Owner of `result`, NULL = none */
+    docker_excess_result_t result;
+} error_context_t;
+
+static _Thread_local error_context_t g_error;
+
+static docker_excess_result_t* error_context(const docker_excess_t *client) {
+    if (g_error.client != client) {
+        g_error.client = client;
+        g_error.result.code = DOCKER_EXCESS_OK;
+        g_error.result.http_code = 0;
+        g_error.result.message[0] = '\0';
+    }
+    return &g_error.result;
+}
+
+/* An error that is not the status of a request: code and http_code are reset */
 static void set_error(docker_excess_t *client, const char *format, ...) {
     if (!client) return;
     
-    pthread_mutex_lock(&client->mutex);
+    docker_excess_result_t *result = error_context(client);
     va_list args;
     va_start(args, format);
-    vsnprintf(client->error_msg, sizeof(client->error_msg), format, args);
+    vsnprintf(result->message, sizeof(result->message), format, args);
     va_end(args);
-    pthread_mutex_unlock(&client->mutex);
+    result->code = DOCKER_EXCESS_OK;
+    result->http_code = 0;
+    
+    docker_excess_log(client, DOCKER_EXCESS_LOG_ERROR, "%s", result->message);
+}
+
+/* A failed request; only transport errors are logged, error statuses are often expected (404 on lookups) */
+static void set_request_error(docker_excess_t *client, docker_excess_error_t code, int http_code, CURLcode res,
+                              const char *method, const char *endpoint) {
+    if (res != CURLE_OK) set_error(client, "cURL error: %s", curl_easy_strerror(res));
     
-    docker_excess_log(client, DOCKER_EXCESS_LOG_ERROR, "%s", client->error_msg);
+    docker_excess_result_t *result = error_context(client);
+    if (res == CURLE_OK) {
+        snprintf(result->message, sizeof(result->message), "%s %s: HTTP %d", method, endpoint, http_code);
+    }
+    result->code = code;
+    result->http_code = http_code;
 }
 
 static char* safe_strdup(const char *str) {
@@ -97,18 +352,173 @@ static void safe_free(void *ptr) {
     if (ptr) free(ptr);
 }
 
-static char* url_encode(const char *str) {
+/* ----------------- Arena Allocator ----------------- */
+
+/*
+ * Bump allocator backing list results: every string and struct of a list
+ * lives in a chain of large blocks and is released with one call.
+ */
+
+#define ARENA_MIN_BLOCK 16384
+#define ARENA_ALIGN 16
+
+/* data starts on an ARENA_ALIGN boundary, as does every allocation carved from it */
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t used;
+    size_t capacity;
+    _Alignas(ARENA_ALIGN) char data[];
+} arena_block_t;
+
+struct docker_excess_arena_t {
+    arena_block_t *head;            /* Current block, older blocks chained behind it */
+    size_t block_size;              /* Size of the next block to allocate */
+};
+
+static arena_block_t* arena_block_new(size_t capacity) {
+    capacity = (capacity + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    arena_block_t *block = aligned_alloc(ARENA_ALIGN, sizeof(arena_block_t) + capacity);
+    if (!block) return NULL;
+    block->next = NULL;
+    block->used = 0;
+    block->capacity = capacity;
+    return block;
+}
+
+static docker_excess_arena_t* arena_create(size_t size_hint) {
+    docker_excess_arena_t *arena = calloc(1, sizeof(docker_excess_arena_t));
+    if (!arena) return NULL;
+    
+    arena->block_size = size_hint > ARENA_MIN_BLOCK ? size_hint : ARENA_MIN_BLOCK;
+    arena->head = arena_block_new(arena->block_size);
+    if (!arena->head) {
+        free(arena);
+        return NULL;
+    }
+    return arena;
+}
+
+static void* arena_alloc(docker_excess_arena_t *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    
+    arena_block_t *block = arena->head;
+    if (block->capacity - block->used < size) {
+        /* Grow geometrically; oversized requests get a block of their own */
+        arena->block_size *= 2;
+        size_t capacity = size > arena->block_size ? size : arena->block_size;
+        block = arena_block_new(capacity);
+        if (!block) return NULL;
+        block->next = arena->head;
+        arena->head = block;
+    }
+    
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+static void* arena_calloc(docker_excess_arena_t *arena, size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) return NULL;
+    void *ptr = arena_alloc(arena, count * size);
+    if (ptr) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+static char* arena_strndup(docker_excess_arena_t *arena, const char *str, size_t max_len) {
     if (!str) return NULL;
+    size_t len = strnlen(str, max_len);
+    char *copy = arena_alloc(arena, len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+/* strdup into the arena when one is given, otherwise onto the heap */
+static char* dx_strdup(docker_excess_arena_t *arena, const char *str) {
+    if (!arena) return safe_strdup(str);
+    return str ? arena_strndup(arena, str, SIZE_MAX) : NULL;
+}
+
+static void* dx_calloc(docker_excess_arena_t *arena, size_t count, size_t size) {
+    return arena ? arena_calloc(arena, count, size) : calloc(count, size);
+}
+
+void docker_excess_arena_free(docker_excess_arena_t *arena) {
+    if (!arena) return;
     
-    CURL *curl = curl_easy_init();
-    if (!curl) return NULL;
+    arena_block_t *block = arena->head;
+    while (block) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
+/* RFC 3986 unreserved characters, passed through unencoded */
+static const char url_unreserved[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-._~";
+
+/*
+ * Percent-encode str into buf without allocating. Returns the encoded length,
+ * or (size_t)-1 if it does not fit. Strings that are already safe (container
+ * IDs, most names) are a single strspn() and memcpy().
+ */
+static size_t url_encode_into(const char *str, char *buf, size_t size) {
+    static const char hex[] = "0123456789ABCDEF";
+    size_t out = 0;
+    
+    while (*str) {
+        size_t safe = strspn(str, url_unreserved);
+        if (safe > 0) {
+            if (out + safe >= size) return (size_t)-1;
+            memcpy(buf + out, str, safe);
+            out += safe;
+            str += safe;
+            continue;
+        }
+        
+        if (out + 3 >= size) return (size_t)-1;
+        unsigned char c = (unsigned char)*str++;
+        buf[out++] = '%';
+        buf[out++] = hex[c >> 4];
+        buf[out++] = hex[c & 0x0F];
+    }
     
-    char *encoded = curl_easy_escape(curl, str, 0);
-    char *result = encoded ? strdup(encoded) : NULL;
+    if (out >= size) return (size_t)-1;
+    buf[out] = '\0';
+    return out;
+}
+
+/* Append "?key=value" or "&key=value" with the value percent-encoded */
+static bool query_append(char *endpoint, size_t size, size_t *len, const char *key, const char *value) {
+    int n = snprintf(endpoint + *len, size - *len, "%c%s=", strchr(endpoint, '?') ? '&' : '?', key);
+    if (n < 0 || (size_t)n >= size - *len) return false;
+    *len += (size_t)n;
     
-    curl_free(encoded);
-    curl_easy_cleanup(curl);
-    return result;
+    size_t encoded = url_encode_into(value, endpoint + *len, size - *len);
+    if (encoded == (size_t)-1) return false;
+    *len += encoded;
+    return true;
+}
+
+/* Build prefix + encoded(id) + suffix into endpoint, e.g. "/containers/" id "/json" */
+static bool build_resource_endpoint(char *endpoint, size_t size, const char *prefix,
+                                    const char *id, const char *suffix) {
+    size_t prefix_len = strlen(prefix);
+    if (!id || !id[0] || prefix_len >= size) return false;
+    
+    memcpy(endpoint, prefix, prefix_len);
+    size_t id_len = url_encode_into(id, endpoint + prefix_len, size - prefix_len);
+    if (id_len == (size_t)-1) return false;
+    
+    size_t used = prefix_len + id_len;
+    size_t suffix_len = suffix ? strlen(suffix) : 0;
+    if (used + suffix_len >= size) return false;
+    if (suffix_len) memcpy(endpoint + used, suffix, suffix_len);
+    endpoint[used + suffix_len] = '\0';
+    return true;
 }
 
 static bool is_success_status(int http_code) {
@@ -126,148 +536,2123 @@ static docker_excess_error_t map_http_error(int http_code) {
     }
 }
 
-static docker_excess_error_t make_request(docker_excess_t *client, const char *method, 
-                                         const char *endpoint, const char *body,
-                                         char **response, int *http_code) {
-    if (!client || !method || !endpoint) return DOCKER_EXCESS_ERR_INVALID_PARAM;
-    
-    pthread_mutex_lock(&client->mutex);
-    
-    response_buffer_t buffer = {0};
-    char url[DOCKER_EXCESS_MAX_URL_LEN];
-    
-    /* Build URL */
+/* ----------------- Request Setup ----------------- */
+
+static docker_excess_error_t map_curl_error(CURLcode res) {
+    switch (res) {
+        case CURLE_OPERATION_TIMEDOUT:
+            return DOCKER_EXCESS_ERR_TIMEOUT;
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_COULDNT_RESOLVE_HOST:
+            return DOCKER_EXCESS_ERR_NETWORK;
+        default:
+            return DOCKER_EXCESS_ERR_INTERNAL;
+    }
+}
+
+static docker_excess_error_t map_errno(int err) {
+    switch (err) {
+        case ENOENT:
+        case ENOTDIR:
+            return DOCKER_EXCESS_ERR_NOT_FOUND;
+        case EACCES:
+        case EPERM:
+            return DOCKER_EXCESS_ERR_PERMISSION;
+        case EEXIST:
+            return DOCKER_EXCESS_ERR_ALREADY_EXISTS;
+        case ENOMEM:
+            return DOCKER_EXCESS_ERR_MEMORY;
+        default:
+            return DOCKER_EXCESS_ERR_INTERNAL;
+    }
+}
+
+/* Scheme, host, port and API version never change for a client: format them once */
+static bool build_url_prefix(docker_excess_t *client) {
+    int len;
     if (client->config.host) {
-        snprintf(url, sizeof(url), "%s://%s:%d/v%s%s",
-                client->config.use_tls ? "https" : "http",
-                client->config.host, client->config.port, 
-                DOCKER_EXCESS_API_VERSION, endpoint);
+        len = snprintf(client->url_prefix, sizeof(client->url_prefix), "%s://%s:%d/v%s",
+                       client->config.use_tls ? "https" : "http",
+                       client->config.host, client->config.port, DOCKER_EXCESS_API_VERSION);
     } else {
-        snprintf(url, sizeof(url), "http://localhost/v%s%s", 
-                DOCKER_EXCESS_API_VERSION, endpoint);
+        len = snprintf(client->url_prefix, sizeof(client->url_prefix), "http://localhost/v%s",
+                       DOCKER_EXCESS_API_VERSION);
+    }
+    if (len <= 0 || (size_t)len >= sizeof(client->url_prefix)) return false;
+    
+    client->url_prefix_len = (size_t)len;
+    return true;
+}
+
+static void build_url(docker_excess_t *client, const char *endpoint, char *url, size_t url_size) {
+    size_t endpoint_len = strlen(endpoint);
+    size_t prefix_len = client->url_prefix_len;
+    
+    if (prefix_len + endpoint_len >= url_size) {
+        endpoint_len = url_size > prefix_len + 1 ? url_size - prefix_len - 1 : 0;
     }
+    memcpy(url, client->url_prefix, prefix_len);
+    memcpy(url + prefix_len, endpoint, endpoint_len);
+    url[prefix_len + endpoint_len] = '\0';
+}
+
+static struct curl_slist* build_headers(const char *content_type) {
+    char header[128];
+    snprintf(header, sizeof(header), "Content-Type: %s", content_type);
     
-    docker_excess_log(client, DOCKER_EXCESS_LOG_DEBUG, "Making %s request to %s", method, url);
+    struct curl_slist *headers = curl_slist_append(NULL, header);
+    struct curl_slist *last = headers;
+    if (last) last = curl_slist_append(headers, "User-Agent: docker-excess/2.0");
+    if (last) last = curl_slist_append(headers, "Expect:"); /* No 100-continue round trip on uploads */
+    if (!last) {
+        curl_slist_free_all(headers);
+        return NULL;
+    }
+    return headers;
+}
+
+/* Options that are the same for every request of a client, set once per handle */
+static void configure_handle(docker_excess_t *client, CURL *curl) {
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, (long)client->config.connect_timeout_s);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L); /* Thread safety */
+    curl_easy_setopt(curl, CURLOPT_SHARE, client->share->handle);
     
-    /* Configure cURL */
-    curl_easy_reset(client->curl);
-    curl_easy_setopt(client->curl, CURLOPT_URL, url);
-    curl_easy_setopt(client->curl, CURLOPT_CUSTOMREQUEST, method);
-    curl_easy_setopt(client->curl, CURLOPT_WRITEFUNCTION, write_response_callback);
-    curl_easy_setopt(client->curl, CURLOPT_WRITEDATA, &buffer);
-    curl_easy_setopt(client->curl, CURLOPT_TIMEOUT, (long)client->config.timeout_s);
-    curl_easy_setopt(client->curl, CURLOPT_CONNECTTIMEOUT, 10L);
-    curl_easy_setopt(client->curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(client->curl, CURLOPT_MAXREDIRS, 5L);
-    curl_easy_setopt(client->curl, CURLOPT_NOSIGNAL, 1L); /* Thread safety */
+    /* "" offers every encoding this libcurl can decode (gzip, deflate, br, zstd) */
+    if (client->config.compression) {
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    }
     
     if (client->config.debug) {
-        curl_easy_setopt(client->curl, CURLOPT_VERBOSE, 1L);
+        curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
     }
     
     /* Unix socket configuration */
     if (!client->config.host) {
-        curl_easy_setopt(client->curl, CURLOPT_UNIX_SOCKET_PATH, client->config.socket_path);
+        curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, client->config.socket_path);
     }
     
     /* TLS configuration */
     if (client->config.use_tls) {
-        curl_easy_setopt(client->curl, CURLOPT_SSL_VERIFYPEER, 1L);
-        curl_easy_setopt(client->curl, CURLOPT_SSL_VERIFYHOST, 2L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
         
         if (client->config.ca_path) {
-            curl_easy_setopt(client->curl, CURLOPT_CAINFO, client->config.ca_path);
+            curl_easy_setopt(curl, CURLOPT_CAINFO, client->config.ca_path);
         }
         if (client->config.cert_path) {
-            curl_easy_setopt(client->curl, CURLOPT_SSLCERT, client->config.cert_path);
+            curl_easy_setopt(curl, CURLOPT_SSLCERT, client->config.cert_path);
         }
         if (client->config.key_path) {
-            curl_easy_setopt(client->curl, CURLOPT_SSLKEY, client->config.key_path);
+            curl_easy_setopt(curl, CURLOPT_SSLKEY, client->config.key_path);
         }
     }
+}
+
+static CURL* create_handle(docker_excess_t *client) {
+    CURL *curl = curl_easy_init();
+    if (curl) configure_handle(client, curl);
+    return curl;
+}
+
+/* Everything that varies between two requests on the same handle */
+typedef struct {
+    const char *method;
+    const char *endpoint;
+    const char *body;
+    size_t body_len;                /* 0 = strlen(body); lets `body` carry binary data */
+    curl_read_callback read_fn;     /* Streamed request body, replaces `body` */
+    void *read_data;
+    curl_off_t upload_size;         /* Size of the streamed body, -1 = chunked */
+    const struct curl_slist *headers; /* NULL = client->headers */
+    curl_write_callback write_fn;
+    void *write_data;
+    long timeout_ms;                /* 0 = config.timeout_s, < 0 = none (streams) */
+    const bool *stopped;            /* Set by write_fn when it aborts on purpose */
+    bool fail_on_error;             /* Keep HTTP error bodies away from write_fn */
+    const int64_t *parse_us;        /* JSON parse time of write_data, for tracing */
+    bool health_check;              /* Ping: bypasses the circuit breaker and reports to it */
+} request_opts_t;
+
+/*
+ * Per-request options on an already configured handle. Everything a previous
+ * request may have changed is set explicitly, so no curl_easy_reset() is needed.
+ */
+static void setup_request(docker_excess_t *client, CURL *curl, const char *url, const request_opts_t *opts) {
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, opts->write_fn);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, opts->write_data);
     
-    /* Headers */
-    struct curl_slist *headers = NULL;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    headers = curl_slist_append(headers, "User-Agent: docker-excess/2.0");
-    curl_easy_setopt(client->curl, CURLOPT_HTTPHEADER, headers);
+    long timeout_ms = opts->timeout_ms;
+    if (timeout_ms == 0) timeout_ms = (long)client->config.timeout_s * 1000L;
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout_ms > 0 ? timeout_ms : 0L);
+    
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, opts->headers ? opts->headers : client->headers);
     
     /* Request body */
-    if (body && strlen(body) > 0) {
-        curl_easy_setopt(client->curl, CURLOPT_POSTFIELDS, body);
-        curl_easy_setopt(client->curl, CURLOPT_POSTFIELDSIZE, (long)strlen(body));
+    size_t body_len = opts->body_len ? opts->body_len : (opts->body ? strlen(opts->body) : 0);
+    if (opts->read_fn) {
+        curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+        curl_easy_setopt(curl, CURLOPT_READFUNCTION, opts->read_fn);
+        curl_easy_setopt(curl, CURLOPT_READDATA, opts->read_data);
+        curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE, opts->upload_size);
+    } else if (body_len > 0) {
+        curl_easy_setopt(curl, CURLOPT_UPLOAD, 0L);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)body_len);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, opts->body);
+    } else {
+        curl_easy_setopt(curl, CURLOPT_UPLOAD, 0L);
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L); /* Drops any previous body */
     }
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, opts->method);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, opts->fail_on_error ? 1L : 0L);
+}
+
+/*
+ * A write callback that returned short on purpose is a clean end of stream,
+ * and a refused fail_on_error body is reported through the status code.
+ */
+static CURLcode normalize_result(CURLcode res, const bool *stopped) {
+    if (res == CURLE_WRITE_ERROR && stopped && *stopped) return CURLE_OK;
+    if (res == CURLE_HTTP_RETURNED_ERROR) return CURLE_OK;
+    return res;
+}
+
+/* ----------------- Metrics and Tracing ----------------- */
+
+/*
+ * Requests are counted per method and route: the endpoint without its query
+ * and with resource IDs and names replaced, so "/containers/3f2a/json?size=1"
+ * and "/containers/web/json" land together. The table is fixed; routes past
+ * it share the last "*" slot. Nothing here runs unless config.metrics or
+ * config.span_end is set.
+ */
+
+#define METRICS_MAX_ROUTES 128
+
+struct metrics {
+    pthread_mutex_t mutex;
+    docker_excess_route_metrics_t routes[METRICS_MAX_ROUTES];
+    uint32_t hashes[METRICS_MAX_ROUTES];
+    size_t routes_count;
+    docker_excess_histogram_t pool_wait;
+    docker_excess_histogram_t json_parse;
+    uint64_t retries;
+};
+
+/* Instrumentation state of one request */
+typedef struct {
+    void *span;                     /* Token from config.span_begin */
+    int64_t start_us;
+    int64_t pool_wait_us;
+    bool open;                      /* trace_end() still due */
+} request_trace_t;
+
+/* Collections whose next path segment names a resource */
+static const char *const route_collections[] = {
+    "containers", "images", "networks", "volumes", "exec", "plugins", "services",
+    "tasks", "nodes", "secrets", "configs", "distribution", NULL
+};
+
+/* Segments right after a collection that are actions, not names */
+static const char *const route_actions[] = {
+    "json", "create", "prune", "search", "load", "get", NULL
+};
+
+/* Actions that end an image or plugin reference, which may contain '/' itself */
+static const char *const route_ref_actions[] = {
+    "json", "history", "push", "tag", "get", "enable", "disable", "upgrade", "set", NULL
+};
+
+static bool tracing_enabled(const docker_excess_t *client) {
+    return client->metrics || client->config.span_end;
+}
+
+static bool route_word_in(const char *seg, size_t len, const char *const *words) {
+    for (; *words; words++) {
+        if (strlen(*words) == len && memcmp(*words, seg, len) == 0) return true;
+    }
+    return false;
+}
+
+static void build_route(const char *endpoint, char *route, size_t route_size) {
+    const char *p = endpoint;
+    const char *end = endpoint + strcspn(endpoint, "?");
+    const char *collection = NULL;
+    size_t collection_len = 0;
+    size_t len = 0;
     
-    /* Perform request */
-    CURLcode res = curl_easy_perform(client->curl);
-    long response_code = 0;
-    curl_easy_getinfo(client->curl, CURLINFO_RESPONSE_CODE, &response_code);
-    
-    curl_slist_free_all(headers);
-    pthread_mutex_unlock(&client->mutex);
+    while (p < end) {
+        if (*p == '/') {
+            p++;
+            continue;
+        }
+        const char *seg = p;
+        while (p < end && *p != '/') p++;
+        size_t seg_len = (size_t)(p - seg);
+        
+        if (collection && !route_word_in(seg, seg_len, route_actions)) {
+            bool ref = (collection_len == 6 && memcmp(collection, "images", 6) == 0) ||
+                       (collection_len == 7 && memcmp(collection, "plugins", 7) == 0) ||
+                       (collection_len == 12 && memcmp(collection, "distribution", 12) == 0);
+            /* A repository path runs up to the next known action */
+            while (ref && p < end) {
+                const char *next = p + 1;
+                const char *next_end = next;
+                while (next_end < end && *next_end != '/') next_end++;
+                if (route_word_in(next, (size_t)(next_end - next), route_ref_actions)) break;
+                p = next_end;
+            }
+            seg = "{id}";
+            seg_len = 4;
+            collection = NULL;
+        } else {
+            bool is_collection = !collection && route_word_in(seg, seg_len, route_collections);
+            collection = is_collection ? seg : NULL;
+            collection_len = is_collection ? seg_len : 0;
+        }
+        
+        if (len + 1 + seg_len >= route_size) break;
+        route[len++] = '/';
+        memcpy(route + len, seg, seg_len);
+        len += seg_len;
+    }
     
-    if (http_code) *http_code = (int)response_code;
+    if (len == 0 && route_size > 1) route[len++] = '/';
+    if (route_size > 0) route[len] = '\0';
+}
+
+static uint32_t route_hash(const char *method, const char *route) {
+    uint32_t hash = 2166136261u;
+    for (const char *p = method; *p; p++) hash = (hash ^ (uint8_t)*p) * 16777619u;
+    hash = (hash ^ ' ') * 16777619u;
+    for (const char *p = route; *p; p++) hash = (hash ^ (uint8_t)*p) * 16777619u;
+    return hash;
+}
+
+static void histogram_add(docker_excess_histogram_t *hist, int64_t value_us) {
+    uint64_t value = value_us > 0 ? (uint64_t)value_us : 0;
+    size_t bucket = 0;
+    while (bucket < DOCKER_EXCESS_HIST_BUCKETS - 1 && (value >> bucket) != 0) bucket++;
     
-    docker_excess_log(client, DOCKER_EXCESS_LOG_DEBUG, "Request completed with HTTP %ld", response_code);
+    hist->buckets[bucket]++;
+    hist->count++;
+    hist->sum_us += value;
+    if (value > hist->max_us) hist->max_us = value;
+}
+
+static metrics_t* metrics_new(void) {
+    metrics_t *metrics = calloc(1, sizeof(metrics_t));
+    if (!metrics) return NULL;
     
-    if (res != CURLE_OK) {
-        set_error(client, "cURL error: %s", curl_easy_strerror(res));
-        safe_free(buffer.data);
-        
-        switch (res) {
-            case CURLE_OPERATION_TIMEDOUT:
-                return DOCKER_EXCESS_ERR_TIMEOUT;
-            case CURLE_COULDNT_CONNECT:
-            case CURLE_COULDNT_RESOLVE_HOST:
-                return DOCKER_EXCESS_ERR_NETWORK;
-            default:
-                return DOCKER_EXCESS_ERR_INTERNAL;
+    if (pthread_mutex_init(&metrics->mutex, NULL) != 0) {
+        free(metrics);
+        return NULL;
+    }
+    return metrics;
+}
+
+static void metrics_free(metrics_t *metrics) {
+    if (!metrics) return;
+    pthread_mutex_destroy(&metrics->mutex);
+    free(metrics);
+}
+
+/* Caller holds metrics->mutex */
+static docker_excess_route_metrics_t* metrics_route(metrics_t *metrics, const char *method, const char *route) {
+    uint32_t hash = route_hash(method, route);
+    for (size_t i = 0; i < metrics->routes_count; i++) {
+        docker_excess_route_metrics_t *entry = &metrics->routes[i];
+        if (metrics->hashes[i] == hash && strcmp(entry->route, route) == 0 && strcmp(entry->method, method) == 0) {
+            return entry;
         }
     }
     
-    if (response) {
-        *response = buffer.data;
-    } else {
-        safe_free(buffer.data);
+    if (metrics->routes_count == METRICS_MAX_ROUTES) return &metrics->routes[METRICS_MAX_ROUTES - 1];
+    
+    /* The last free slot becomes the catch-all */
+    bool overflow = metrics->routes_count == METRICS_MAX_ROUTES - 1;
+    docker_excess_route_metrics_t *entry = &metrics->routes[metrics->routes_count];
+    snprintf(entry->method, sizeof(entry->method), "%s", overflow ? "*" : method);
+    snprintf(entry->route, sizeof(entry->route), "%s", overflow ? "*" : route);
+    metrics->hashes[metrics->routes_count++] = route_hash(entry->method, entry->route);
+    return entry;
+}
+
+/* `timed` is false for requests that never ran to completion */
+static void metrics_record(metrics_t *metrics, const docker_excess_span_t *span, bool timed) {
+    pthread_mutex_lock(&metrics->mutex);
+    docker_excess_route_metrics_t *entry = metrics_route(metrics, span->method, span->route);
+    entry->requests++;
+    if (span->error != DOCKER_EXCESS_OK) entry->errors++;
+    entry->bytes_in += span->bytes_in;
+    entry->bytes_out += span->bytes_out;
+    
+    if (timed) {
+        /* Connection phases only count when a connection was actually set up */
+        if (span->new_connection) {
+            histogram_add(&entry->dns, span->dns_us);
+            histogram_add(&entry->connect, span->connect_us);
+            if (span->tls_us > 0) histogram_add(&entry->tls, span->tls_us);
+        }
+        histogram_add(&entry->first_byte, span->first_byte_us);
+        histogram_add(&entry->total, span->total_us);
     }
+    histogram_add(&metrics->pool_wait, span->pool_wait_us);
+    if (span->json_parse_us > 0) histogram_add(&metrics->json_parse, span->json_parse_us);
+    pthread_mutex_unlock(&metrics->mutex);
+}
+
+static void trace_begin(docker_excess_t *client, request_trace_t *trace, const char *method, const char *endpoint) {
+    trace->start_us = monotonic_us();
+    trace->pool_wait_us = 0;
+    trace->span = client->config.span_begin ?
+                  client->config.span_begin(method, endpoint, client->config.span_userdata) : NULL;
+    trace->open = true;
+}
+
+/* Record a finished request; `curl` is NULL when it never got a response (cancelled, no handle) */
+static void trace_end(docker_excess_t *client, request_trace_t *trace, CURL *curl, const char *method,
+                      const char *endpoint, int http_code, docker_excess_error_t err,
+                      const int64_t *parse_us, bool async) {
+    if (!trace->open) return;
+    trace->open = false;
+    
+    char route[96];
+    build_route(endpoint, route, sizeof(route));
+    
+    docker_excess_span_t span = {
+        .method = method,
+        .endpoint = endpoint,
+        .route = route,
+        .http_code = http_code,
+        .error = err,
+        .async = async,
+        .pool_wait_us = trace->pool_wait_us,
+        .json_parse_us = parse_us ? *parse_us : 0,
+    };
     
-    if (!is_success_status(response_code)) {
-        return map_http_error(response_code);
+    if (curl) {
+        /* curl reports each phase as the time elapsed since the transfer started */
+        curl_off_t dns = 0, connect = 0, tls = 0, pretransfer = 0, first_byte = 0, total = 0;
+        curl_off_t bytes_in = 0, bytes_out = 0;
+        curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+        curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+        curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &tls);
+        curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+        curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &first_byte);
+        curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+        curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &bytes_in);
+        curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &bytes_out);
+        long connects = 0;
+        curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+        
+        span.dns_us = dns;
+        span.connect_us = connect > dns ? connect - dns : 0;
+        span.tls_us = tls > connect ? tls - connect : 0;
+        span.first_byte_us = first_byte > pretransfer ? first_byte - pretransfer : 0;
+        span.total_us = total;
+        span.bytes_in = bytes_in;
+        span.bytes_out = bytes_out;
+        span.new_connection = connects > 0;
     }
     
-    return DOCKER_EXCESS_OK;
+    if (client->metrics) metrics_record(client->metrics, &span, curl != NULL);
+    if (client->config.span_end) client->config.span_end(trace->span, &span, client->config.span_userdata);
 }
 
-/* ----------------- JSON Helper Functions ----------------- */
+/* ----------------- Connection Pool ----------------- */
 
-static json_object* get_json_object(json_object *obj, const char *key) {
-    if (!obj || !key) return NULL;
-    json_object *result;
-    return json_object_object_get_ex(obj, key, &result) ? result : NULL;
+static void share_lock_callback(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr) {
+    (void)handle;
+    (void)access;
+    share_t *share = userptr;
+    pthread_mutex_lock(&share->locks[data]);
 }
 
-static const char* get_json_string(json_object *obj, const char *key) {
-    json_object *field = get_json_object(obj, key);
-    if (field && json_object_get_type(field) == json_type_string) {
-        return json_object_get_string(field);
-    }
-    return NULL;
+static void share_unlock_callback(CURL *handle, curl_lock_data data, void *userptr) {
+    (void)handle;
+    share_t *share = userptr;
+    pthread_mutex_unlock(&share->locks[data]);
 }
 
-static int64_t get_json_int(json_object *obj, const char *key) {
-    json_object *field = get_json_object(obj, key);
-    if (field && json_object_get_type(field) == json_type_int) {
-        return json_object_get_int64(field);
+static docker_excess_error_t share_init(share_t *share) {
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_init(&share->locks[i], NULL);
     }
-    return 0;
+    share->locks_initialized = true;
+    
+    share->handle = curl_share_init();
+    if (!share->handle) return DOCKER_EXCESS_ERR_INTERNAL;
+    
+    curl_share_setopt(share->handle, CURLSHOPT_LOCKFUNC, share_lock_callback);
+    curl_share_setopt(share->handle, CURLSHOPT_UNLOCKFUNC, share_unlock_callback);
+    curl_share_setopt(share->handle, CURLSHOPT_USERDATA, share);
+    curl_share_setopt(share->handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share->handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    return DOCKER_EXCESS_OK;
 }
 
-static bool get_json_bool(json_object *obj, const char *key) {
-    json_object *field = get_json_object(obj, key);
-    if (field && json_object_get_type(field) == json_type_boolean) {
-        return json_object_get_boolean(field);
+/* Every easy handle using the share must be gone by now */
+static void share_cleanup(share_t *share) {
+    if (share->handle) {
+        curl_share_cleanup(share->handle);
+        share->handle = NULL;
+    }
+    if (share->locks_initialized) {
+        for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+            pthread_mutex_destroy(&share->locks[i]);
+        }
+        share->locks_initialized = false;
     }
-    return false;
+}
+
+static docker_excess_error_t pool_init(connection_pool_t *pool, size_t max) {
+    pool->idle = calloc(max, sizeof(CURL*));
+    if (!pool->idle) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    pool->idle_count = 0;
+    pool->created = 0;
+    pool->max = max;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->available, NULL);
+    return DOCKER_EXCESS_OK;
+}
+
+static void pool_cleanup(connection_pool_t *pool) {
+    if (!pool->idle) return;
+    
+    /* All handles must have been checked in by now */
+    for (size_t i = 0; i < pool->idle_count; i++) {
+        curl_easy_cleanup(pool->idle[i]);
+    }
+    free(pool->idle);
+    pool->idle = NULL;
+    pool->idle_count = 0;
+    pool->created = 0;
+    
+    pthread_cond_destroy(&pool->available);
+    pthread_mutex_destroy(&pool->mutex);
+}
+
+/* Take an idle handle, creating one while under the limit, otherwise wait */
+static CURL* pool_checkout(docker_excess_t *client) {
+    connection_pool_t *pool = &client->pool;
+    CURL *handle = NULL;
+    bool create = false;
+    
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->idle_count == 0 && pool->created >= pool->max) {
+        pthread_cond_wait(&pool->available, &pool->mutex);
+    }
+    
+    if (pool->idle_count > 0) {
+        handle = pool->idle[--pool->idle_count];
+    } else {
+        pool->created++;
+        create = true;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    
+    if (create) {
+        handle = create_handle(client);
+        if (!handle) {
+            pthread_mutex_lock(&pool->mutex);
+            pool->created--;
+            pthread_cond_signal(&pool->available);
+            pthread_mutex_unlock(&pool->mutex);
+        }
+    }
+    
+    return handle;
+}
+
+static void pool_checkin(connection_pool_t *pool, CURL *handle) {
+    if (!handle) return;
+    
+    pthread_mutex_lock(&pool->mutex);
+    pool->idle[pool->idle_count++] = handle;
+    pthread_cond_signal(&pool->available);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+/* ----------------- Transport Policy ----------------- */
+
+/*
+ * Blocking requests go through three policies, all per client and so per
+ * daemon. Idempotent requests are retried with full-jitter backoff while a
+ * retry budget lasts (about one retry per ten requests), so an overloaded
+ * daemon does not see every caller triple its load. GETs can be hedged: a
+ * second attempt starts when the first has not answered within the
+ * route's p95, and whichever answers first owns the caller's writer. A
+ * circuit breaker opens after consecutive unhealthy responses and fails
+ * requests fast until a probe, or docker_excess_ping(), gets through.
+ */
+
+#define POLICY_MAX_RETRY_TOKENS 100
+#define POLICY_RETRY_COST 10
+#define POLICY_MAX_BACKOFF_MS 2000
+#define HEDGE_MIN_SAMPLES 20        /* Before trusting a route's p95 */
+
+static docker_excess_error_t multi_pool_init(multi_pool_t *pool, size_t max) {
+    pool->idle = calloc(max, sizeof(CURLM*));
+    if (!pool->idle) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    pool->idle_count = 0;
+    pool->max = max;
+    pthread_mutex_init(&pool->mutex, NULL);
+    return DOCKER_EXCESS_OK;
+}
+
+static void multi_pool_cleanup(multi_pool_t *pool) {
+    if (!pool->idle) return;
+    
+    for (size_t i = 0; i < pool->idle_count; i++) {
+        curl_multi_cleanup(pool->idle[i]);
+    }
+    free(pool->idle);
+    pool->idle = NULL;
+    pool->idle_count = 0;
+    pthread_mutex_destroy(&pool->mutex);
+}
+
+static CURLM* multi_pool_checkout(multi_pool_t *pool) {
+    CURLM *multi = NULL;
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->idle_count > 0) multi = pool->idle[--pool->idle_count];
+    pthread_mutex_unlock(&pool->mutex);
+    return multi ? multi : curl_multi_init();
+}
+
+static void multi_pool_checkin(multi_pool_t *pool, CURLM *multi) {
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->idle_count < pool->max) {
+        pool->idle[pool->idle_count++] = multi;
+        multi = NULL;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    if (multi) curl_multi_cleanup(multi);
+}
+
+/* Like pool_checkout() but never waits: a hedge is not worth blocking for */
+static CURL* pool_try_checkout(docker_excess_t *client) {
+    connection_pool_t *pool = &client->pool;
+    CURL *handle = NULL;
+    bool create = false;
+    
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->idle_count > 0) {
+        handle = pool->idle[--pool->idle_count];
+    } else if (pool->created < pool->max) {
+        pool->created++;
+        create = true;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    
+    if (create) {
+        handle = create_handle(client);
+        if (!handle) {
+            pthread_mutex_lock(&pool->mutex);
+            pool->created--;
+            pthread_cond_signal(&pool->available);
+            pthread_mutex_unlock(&pool->mutex);
+        }
+    }
+    return handle;
+}
+
+static bool method_is(const char *method, const char *const *methods) {
+    for (size_t i = 0; methods[i]; i++) {
+        if (strcmp(method, methods[i]) == 0) return true;
+    }
+    return false;
+}
+
+/* Safe methods may be replayed even when the daemon might have seen them */
+static bool method_is_safe(const char *method) {
+    static const char *const safe[] = { "GET", "HEAD", "OPTIONS", NULL };
+    return method_is(method, safe);
+}
+
+static bool method_is_idempotent(const char *method) {
+    static const char *const idempotent[] = { "GET", "HEAD", "OPTIONS", "PUT", "DELETE", NULL };
+    return method_is(method, idempotent);
+}
+
+static bool status_is_retryable(long http_code) {
+    return http_code == 502 || http_code == 503;
+}
+
+/* The connection broke; a safe request can be sent again */
+static bool result_is_transport_failure(CURLcode res) {
+    switch (res) {
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_GOT_NOTHING:
+        case CURLE_SEND_ERROR:
+        case CURLE_RECV_ERROR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * The daemon could not be reached at all. 503s and timeouts are left out:
+ * the daemon answers 503 in normal operation (swarm calls on a worker) and
+ * slow calls against a short timeout_s say nothing about other requests.
+ */
+static bool result_is_unhealthy(CURLcode res) {
+    return res == CURLE_COULDNT_RESOLVE_HOST || res == CURLE_COULDNT_CONNECT || res == CURLE_GOT_NOTHING;
+}
+
+/* Retries left for this request: streamed bodies and aborting writers cannot be replayed */
+static int request_max_retries(const docker_excess_t *client, const request_opts_t *opts) {
+    if (client->config.max_retries <= 0 || opts->read_fn || opts->stopped || opts->timeout_ms < 0) return 0;
+    return method_is_idempotent(opts->method) ? client->config.max_retries : 0;
+}
+
+/* Only when nothing reached the caller's writer; timeouts are not retried, they already took the budget */
+static bool attempt_retryable(const request_opts_t *opts, CURLcode res, bool discarded, bool delivered) {
+    if (delivered) return false;                        /* A replay would repeat part of the body */
+    if (discarded) return true;
+    if (res == CURLE_COULDNT_CONNECT) return true;      /* Never reached the daemon */
+    return method_is_safe(opts->method) && result_is_transport_failure(res);
+}
+
+static bool retry_budget_take(docker_excess_t *client) {
+    transport_policy_t *policy = &client->policy;
+    pthread_mutex_lock(&policy->mutex);
+    bool ok = policy->retry_tokens >= POLICY_RETRY_COST;
+    if (ok) policy->retry_tokens -= POLICY_RETRY_COST;
+    pthread_mutex_unlock(&policy->mutex);
+    return ok;
+}
+
+static uint64_t jitter_random(void) {
+    static _Thread_local uint64_t state;
+    if (state == 0) state = (uint64_t)monotonic_us() ^ (uint64_t)(uintptr_t)&state ^ 0x9E3779B97F4A7C15ull;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+/* Full jitter: uniform in [0, min(cap, base * 2^attempt)] */
+static void retry_backoff(const docker_excess_t *client, int attempt) {
+    int64_t ceiling = client->config.retry_backoff_ms;
+    for (int i = 0; i < attempt && ceiling < POLICY_MAX_BACKOFF_MS; i++) ceiling *= 2;
+    if (ceiling > POLICY_MAX_BACKOFF_MS) ceiling = POLICY_MAX_BACKOFF_MS;
+    
+    int64_t delay_ms = (int64_t)(jitter_random() % (uint64_t)(ceiling + 1));
+    struct timespec ts = { .tv_sec = delay_ms / 1000, .tv_nsec = (delay_ms % 1000) * 1000000 };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+static void metrics_record_retry(docker_excess_t *client, const char *method, const char *endpoint) {
+    if (!client->metrics) return;
+    
+    char route[96];
+    build_route(endpoint, route, sizeof(route));
+    
+    metrics_t *metrics = client->metrics;
+    pthread_mutex_lock(&metrics->mutex);
+    metrics_route(metrics, method, route)->retries++;
+    metrics->retries++;
+    pthread_mutex_unlock(&metrics->mutex);
+}
+
+/* 0 = no hedge; the route's p95 needs metrics and enough samples */
+static long hedge_delay_ms(docker_excess_t *client, const request_opts_t *opts) {
+    if (!client->config.hedge_reads || strcmp(opts->method, "GET") != 0) return 0;
+    if (opts->read_fn || opts->stopped || opts->timeout_ms < 0) return 0;
+    if (client->config.hedge_delay_ms > 0) return client->config.hedge_delay_ms;
+    if (!client->metrics) return 0;
+    
+    char route[96];
+    build_route(opts->endpoint, route, sizeof(route));
+    
+    int64_t p95_us = 0;
+    metrics_t *metrics = client->metrics;
+    pthread_mutex_lock(&metrics->mutex);
+    const docker_excess_route_metrics_t *entry = metrics_route(metrics, opts->method, route);
+    if (entry->total.count >= HEDGE_MIN_SAMPLES) p95_us = docker_excess_histogram_quantile(&entry->total, 0.95);
+    pthread_mutex_unlock(&metrics->mutex);
+    
+    return p95_us > 0 ? (long)((p95_us + 999) / 1000) : 0;
+}
+
+/* false = fail fast; *probe is set for the one request let through after the cooldown */
+static bool breaker_admit(docker_excess_t *client, bool *probe, int64_t *wait_ms) {
+    *probe = false;
+    if (client->config.breaker_threshold <= 0) return true;
+    
+    transport_policy_t *policy = &client->policy;
+    pthread_mutex_lock(&policy->mutex);
+    bool admit = true;
+    if (policy->open_until) {
+        int64_t now = monotonic_ms();
+        if (now < policy->open_until || policy->probing) {
+            admit = false;
+            *wait_ms = policy->open_until > now ? policy->open_until - now : 0;
+        } else {
+            policy->probing = true;
+            *probe = true;
+        }
+    }
+    pthread_mutex_unlock(&policy->mutex);
+    return admit;
+}
+
+/* A probe or a ping decides on its own; other requests open the breaker after threshold failures */
+static void breaker_record(docker_excess_t *client, bool unhealthy, bool probe, bool health_check) {
+    transport_policy_t *policy = &client->policy;
+    bool opened = false;
+    
+    pthread_mutex_lock(&policy->mutex);
+    if (probe) policy->probing = false;
+    if (policy->retry_tokens < POLICY_MAX_RETRY_TOKENS) policy->retry_tokens++;
+    
+    if (!unhealthy) {
+        policy->failures = 0;
+        policy->open_until = 0;
+    } else if (client->config.breaker_threshold > 0 &&
+               (probe || health_check || ++policy->failures >= client->config.breaker_threshold)) {
+        opened = !policy->open_until || probe;
+        policy->open_until = monotonic_ms() + client->config.breaker_cooldown_ms;
+    }
+    pthread_mutex_unlock(&policy->mutex);
+    
+    if (opened) {
+        client->is_connected = false;
+        docker_excess_log(client, DOCKER_EXCESS_LOG_WARN, "Daemon unhealthy, failing requests for %d ms",
+                          client->config.breaker_cooldown_ms);
+    }
+}
+
+/* Between curl and opts->write_fn: holds back a retryable error body and, when hedging, lets one attempt write */
+typedef struct {
+    curl_write_callback write_fn;
+    void *write_data;
+    bool discard_retryable;         /* Retries left: a 502/503 body is held back, not delivered */
+    int owner;                      /* Attempt that delivered the first byte, -1 = none yet */
+} transport_writer_t;
+
+typedef struct {
+    transport_writer_t *writer;
+    CURL *curl;
+    int index;
+    bool discarded;
+    response_buffer_t held;         /* The held-back body, handed over if no retry follows */
+} transport_attempt_t;
+
+static size_t transport_write_callback(char *data, size_t size, size_t nmemb, void *userdata) {
+    transport_attempt_t *attempt = userdata;
+    transport_writer_t *writer = attempt->writer;
+    if (attempt->discarded) return write_response_callback(data, size, nmemb, &attempt->held);
+    
+    if (writer->owner < 0) {
+        long http_code = 0;
+        curl_easy_getinfo(attempt->curl, CURLINFO_RESPONSE_CODE, &http_code);
+        if (writer->discard_retryable && status_is_retryable(http_code)) {
+            attempt->discarded = true;
+            return write_response_callback(data, size, nmemb, &attempt->held);
+        }
+        writer->owner = attempt->index;
+    }
+    if (writer->owner != attempt->index) return 0;     /* The other attempt answered first */
+    return writer->write_fn(data, size, nmemb, writer->write_data);
+}
+
+static void transport_attempt_setup(docker_excess_t *client, transport_attempt_t *attempt, const char *url,
+                                    const request_opts_t *opts) {
+    request_opts_t attempt_opts = *opts;
+    attempt_opts.write_fn = transport_write_callback;
+    attempt_opts.write_data = attempt;
+    setup_request(client, attempt->curl, url, &attempt_opts);
+}
+
+/* Run *curl and, if it has not answered after delay_ms, a second handle; *curl becomes the winner */
+static CURLcode perform_hedged(docker_excess_t *client, CURL **curl, const char *url, const request_opts_t *opts,
+                               transport_writer_t *writer, long delay_ms, bool *discarded, response_buffer_t *held) {
+    transport_attempt_t attempts[2] = {
+        { .writer = writer, .curl = *curl, .index = 0 },
+        { .writer = writer, .curl = NULL, .index = 1 },
+    };
+    transport_attempt_setup(client, &attempts[0], url, opts);
+    
+    CURLM *multi = multi_pool_checkout(&client->hedge_multis);
+    if (!multi) {
+        CURLcode res = curl_easy_perform(*curl);
+        *discarded = attempts[0].discarded;
+        *held = attempts[0].held;
+        return res;
+    }
+    curl_multi_add_handle(multi, attempts[0].curl);
+    
+    CURLcode results[2] = { CURLE_OK, CURLE_OK };
+    bool finished[2] = { false, false };
+    bool hedge_tried = false;
+    int64_t hedge_at = monotonic_ms() + delay_ms;
+    int winner = -1;
+    
+    while (winner < 0) {
+        int timeout_ms = 1000;
+        if (!hedge_tried) {
+            int64_t left = hedge_at - monotonic_ms();
+            if (left <= 0) {
+                /* Only worth it while the first attempt has nothing to show */
+                hedge_tried = true;
+                attempts[1].curl = writer->owner < 0 && !attempts[0].discarded ? pool_try_checkout(client) : NULL;
+                if (attempts[1].curl) {
+                    transport_attempt_setup(client, &attempts[1], url, opts);
+                    curl_multi_add_handle(multi, attempts[1].curl);
+                    metrics_record_retry(client, opts->method, opts->endpoint);
+                    docker_excess_log(client, DOCKER_EXCESS_LOG_DEBUG, "Hedging %s %s after %ld ms",
+                                      opts->method, opts->endpoint, delay_ms);
+                }
+            } else if (left < timeout_ms) {
+                timeout_ms = (int)left;
+            }
+        }
+        
+        int running = 0;
+        curl_multi_perform(multi, &running);
+        CURLMsg *msg;
+        int queued;
+        while ((msg = curl_multi_info_read(multi, &queued))) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            int i = msg->easy_handle == attempts[0].curl ? 0 : 1;
+            finished[i] = true;
+            results[i] = msg->data.result;
+        }
+        
+        /* A success ends it, and so does a failure of the attempt that owns the writer */
+        for (int i = 0; i < 2 && winner < 0; i++) {
+            if (finished[i] && (results[i] == CURLE_OK || writer->owner == i)) winner = i;
+        }
+        if (winner < 0 && finished[0] && (!attempts[1].curl || finished[1])) winner = 0;
+        if (winner < 0 && running > 0) curl_multi_poll(multi, NULL, 0, timeout_ms, NULL);
+    }
+    
+    for (int i = 0; i < 2; i++) {
+        if (i != winner) safe_free(attempts[i].held.data);
+        if (!attempts[i].curl) continue;
+        curl_multi_remove_handle(multi, attempts[i].curl);
+        if (i != winner) pool_checkin(&client->pool, attempts[i].curl);
+    }
+    multi_pool_checkin(&client->hedge_multis, multi);
+    
+    *curl = attempts[winner].curl;
+    *discarded = attempts[winner].discarded;
+    *held = attempts[winner].held;
+    return results[winner];
+}
+
+static docker_excess_error_t perform_request(docker_excess_t *client, const request_opts_t *opts,
+                                            int *http_code, CURLcode *curl_result) {
+    request_trace_t trace = {0};
+    bool traced = tracing_enabled(client);
+    if (traced) trace_begin(client, &trace, opts->method, opts->endpoint);
+    
+    bool probe = false;
+    int64_t wait_ms = 0;
+    if (!opts->health_check && !breaker_admit(client, &probe, &wait_ms)) {
+        set_error(client, "%s %s: daemon unhealthy, circuit open for another %lld ms", opts->method,
+                  opts->endpoint, (long long)wait_ms);
+        error_context(client)->code = DOCKER_EXCESS_ERR_NETWORK;
+        if (http_code) *http_code = 0;
+        if (curl_result) *curl_result = CURLE_COULDNT_CONNECT;
+        if (traced) trace_end(client, &trace, NULL, opts->method, opts->endpoint, 0,
+                              DOCKER_EXCESS_ERR_NETWORK, NULL, false);
+        return DOCKER_EXCESS_ERR_NETWORK;
+    }
+    
+    CURL *curl = pool_checkout(client);
+    if (!curl) {
+        set_error(client, "Failed to allocate cURL handle");
+        if (probe) {
+            pthread_mutex_lock(&client->policy.mutex);
+            client->policy.probing = false;
+            pthread_mutex_unlock(&client->policy.mutex);
+        }
+        if (traced) trace_end(client, &trace, NULL, opts->method, opts->endpoint, 0,
+                              DOCKER_EXCESS_ERR_INTERNAL, NULL, false);
+        return DOCKER_EXCESS_ERR_INTERNAL;
+    }
+    if (traced) trace.pool_wait_us = monotonic_us() - trace.start_us;
+    
+    char url[DOCKER_EXCESS_MAX_URL_LEN];
+    build_url(client, opts->endpoint, url, sizeof(url));
+    
+    int max_retries = request_max_retries(client, opts);
+    long hedge_ms = hedge_delay_ms(client, opts);
+    CURLcode res;
+    long response_code = 0;
+    
+    for (int attempt = 0;; attempt++) {
+        docker_excess_log(client, DOCKER_EXCESS_LOG_DEBUG, "Making %s request to %s", opts->method, url);
+        
+        /* Plain requests go straight to the caller's writer; a probe gets no retry to hold a body back for */
+        transport_writer_t writer = {
+            .write_fn = opts->write_fn,
+            .write_data = opts->write_data,
+            .discard_retryable = attempt < max_retries && !probe,
+            .owner = -1,
+        };
+        bool discarded = false;
+        response_buffer_t held = {0};
+        if (hedge_ms > 0) {
+            res = perform_hedged(client, &curl, url, opts, &writer, hedge_ms, &discarded, &held);
+        } else if (max_retries > 0) {
+            transport_attempt_t single = { .writer = &writer, .curl = curl };
+            transport_attempt_setup(client, &single, url, opts);
+            res = curl_easy_perform(curl);
+            discarded = single.discarded;
+            held = single.held;
+        } else {
+            setup_request(client, curl, url, opts);
+            res = curl_easy_perform(curl);
+        }
+        
+        response_code = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+        res = normalize_result(res, opts->stopped);
+        
+        bool delivered = writer.owner >= 0;
+        bool retry = attempt < max_retries && attempt_retryable(opts, res, discarded, delivered) &&
+                     !probe && retry_budget_take(client);
+        if (!retry) {
+            /* No retry after all: the caller still gets the error body */
+            if (discarded && held.size > 0 && opts->write_fn) {
+                opts->write_fn(held.data, 1, held.size, opts->write_data);
+            }
+            safe_free(held.data);
+            break;
+        }
+        safe_free(held.data);
+        
+        metrics_record_retry(client, opts->method, opts->endpoint);
+        docker_excess_log(client, DOCKER_EXCESS_LOG_DEBUG, "Retrying %s %s (%s, HTTP %ld)", opts->method,
+                          opts->endpoint, curl_easy_strerror(res), response_code);
+        retry_backoff(client, attempt);
+    }
+    
+    if (http_code) *http_code = (int)response_code;
+    if (curl_result) *curl_result = res;
+    
+    docker_excess_log(client, DOCKER_EXCESS_LOG_DEBUG, "Request completed with HTTP %ld", response_code);
+    
+    breaker_record(client, result_is_unhealthy(res), probe, opts->health_check);
+    
+    docker_excess_error_t err = DOCKER_EXCESS_OK;
+    if (res != CURLE_OK) {
+        err = map_curl_error(res);
+    } else if (!is_success_status(response_code)) {
+        err = map_http_error(response_code);
+    }
+    if (err != DOCKER_EXCESS_OK) {
+        set_request_error(client, err, (int)response_code, res, opts->method, opts->endpoint);
+    }
+    
+    /* Timings are read off the handle, so before it goes back to the pool */
+    if (traced) trace_end(client, &trace, curl, opts->method, opts->endpoint, (int)response_code, err,
+                          opts->parse_us, false);
+    pool_checkin(&client->pool, curl);
+    
+    return err;
+}
+
+static docker_excess_error_t make_request(docker_excess_t *client, const char *method, 
+                                         const char *endpoint, const char *body,
+                                         char **response, int *http_code) {
+    if (!client || !method || !endpoint) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    response_buffer_t buffer = {0};
+    CURLcode res = CURLE_OK;
+    request_opts_t opts = {
+        .method = method,
+        .endpoint = endpoint,
+        .body = body,
+        .write_fn = (curl_write_callback)write_response_callback,
+        .write_data = &buffer,
+    };
+    docker_excess_error_t err = perform_request(client, &opts, http_code, &res);
+    
+    /* The body of an HTTP error is still handed back; transport errors have none */
+    if (response && res == CURLE_OK) {
+        *response = buffer.data;
+    } else {
+        safe_free(buffer.data);
+    }
+    
+    return err;
+}
+
+/* Like make_request(), but parses the body while it is being received */
+static docker_excess_error_t make_request_json(docker_excess_t *client, const char *method,
+                                              const char *endpoint, const char *body,
+                                              json_object **json, int *http_code) {
+    if (!client || !method || !endpoint || !json) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    json_sink_t sink;
+    if (!json_sink_init(&sink)) return DOCKER_EXCESS_ERR_MEMORY;
+    sink.timed = tracing_enabled(client);
+    
+    request_opts_t opts = {
+        .method = method,
+        .endpoint = endpoint,
+        .body = body,
+        .write_fn = write_json_callback,
+        .write_data = &sink,
+        .parse_us = &sink.parse_us,
+    };
+    docker_excess_error_t err = perform_request(client, &opts, http_code, NULL);
+    if (err == DOCKER_EXCESS_OK) {
+        *json = json_sink_finish(&sink);
+        if (!*json) {
+            set_error(client, "Invalid JSON response from %s", endpoint);
+            err = DOCKER_EXCESS_ERR_JSON;
+        }
+    }
+    
+    json_sink_cleanup(&sink);
+    return err;
+}
+
+/* Stream a response as a sequence of JSON values (stats, events, progress) */
+static docker_excess_error_t make_request_stream(docker_excess_t *client, const char *method,
+                                                const char *endpoint, const char *body,
+                                                json_stream_t *stream) {
+    request_opts_t opts = {
+        .method = method,
+        .endpoint = endpoint,
+        .body = body,
+        .write_fn = write_json_stream_callback,
+        .write_data = stream,
+        .timeout_ms = -1,
+        .stopped = &stream->stopped,
+        .fail_on_error = true,
+    };
+    return perform_request(client, &opts, NULL, NULL);
+}
+
+/* ----------------- Request Bodies ----------------- */
+
+/* Feeds a docker_excess_body_t to curl; memory bodies bypass it entirely */
+typedef struct {
+    const docker_excess_body_t *body;
+    uint64_t position;
+    struct curl_slist *headers;     /* Owned, for content types without a prebuilt list */
+    int error;
+} body_reader_t;
+
+static size_t body_read_callback(char *buffer, size_t size, size_t nitems, void *userdata) {
+    body_reader_t *reader = userdata;
+    const docker_excess_body_t *body = reader->body;
+    size_t capacity = size * nitems;
+    
+    if (body->length >= 0) {
+        uint64_t left = (uint64_t)body->length - reader->position;
+        if (capacity > left) capacity = (size_t)left;
+    }
+    if (capacity == 0) return 0;
+    
+    if (body->type == DOCKER_EXCESS_BODY_FD) {
+        ssize_t got;
+        do {
+            got = pread(body->fd, buffer, capacity, body->offset + (off_t)reader->position);
+        } while (got < 0 && errno == EINTR);
+        if (got < 0) {
+            reader->error = errno;
+            return CURL_READFUNC_ABORT;
+        }
+        /* A file shorter than the announced length would hang the upload */
+        if (got == 0 && body->length >= 0) {
+            reader->error = EIO;
+            return CURL_READFUNC_ABORT;
+        }
+        reader->position += (uint64_t)got;
+        return (size_t)got;
+    }
+    
+    size_t got = body->read(buffer, capacity, body->userdata);
+    if (got == DOCKER_EXCESS_BODY_ABORT) {
+        reader->error = ECANCELED;
+        return CURL_READFUNC_ABORT;
+    }
+    reader->position += got;
+    return got;
+}
+
+/* Point opts at the body: memory goes to POSTFIELDS as is, the rest is pulled on demand */
+static docker_excess_error_t body_prepare(docker_excess_t *client, const docker_excess_body_t *body,
+                                          body_reader_t *reader, request_opts_t *opts) {
+    memset(reader, 0, sizeof(*reader));
+    reader->body = body;
+    if (!body || body->type == DOCKER_EXCESS_BODY_NONE) return DOCKER_EXCESS_OK;
+    
+    const char *content_type = body->content_type;
+    if (!content_type || strcmp(content_type, "application/json") == 0) {
+        opts->headers = client->headers;
+    } else if (strcmp(content_type, "application/x-tar") == 0) {
+        opts->headers = client->tar_headers;
+    } else {
+        reader->headers = build_headers(content_type);
+        if (!reader->headers) return DOCKER_EXCESS_ERR_MEMORY;
+        opts->headers = reader->headers;
+    }
+    
+    switch (body->type) {
+        case DOCKER_EXCESS_BODY_MEMORY:
+            if (!body->data && body->size > 0) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+            if (body->size == 0) return DOCKER_EXCESS_OK;
+            opts->body = body->data;
+            opts->body_len = body->size;
+            return DOCKER_EXCESS_OK;
+        case DOCKER_EXCESS_BODY_FD:
+            if (body->fd < 0 || body->offset < 0) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+            break;
+        case DOCKER_EXCESS_BODY_CALLBACK:
+            if (!body->read) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+            break;
+        default:
+            return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    opts->read_fn = body_read_callback;
+    opts->read_data = reader;
+    opts->upload_size = body->length >= 0 ? (curl_off_t)body->length : -1;
+    return DOCKER_EXCESS_OK;
+}
+
+static void body_cleanup(body_reader_t *reader) {
+    curl_slist_free_all(reader->headers);
+    reader->headers = NULL;
+}
+
+/* Like make_request(), for any body; a streamed body's read failure wins over the transport error */
+static docker_excess_error_t make_request_body(docker_excess_t *client, const char *method, const char *endpoint,
+                                              const docker_excess_body_t *body, long timeout_ms,
+                                              curl_write_callback write_fn, void *write_data,
+                                              int *http_code, CURLcode *curl_result) {
+    request_opts_t opts = {
+        .method = method,
+        .endpoint = endpoint,
+        .write_fn = write_fn,
+        .write_data = write_data,
+        .timeout_ms = timeout_ms,
+    };
+    
+    body_reader_t reader;
+    docker_excess_error_t err = body_prepare(client, body, &reader, &opts);
+    if (err == DOCKER_EXCESS_OK) {
+        err = perform_request(client, &opts, http_code, curl_result);
+        if (reader.error) {
+            set_error(client, "Failed to read request body: %s", strerror(reader.error));
+            err = reader.error == ECANCELED ? DOCKER_EXCESS_ERR_INTERNAL : map_errno(reader.error);
+        }
+    }
+    body_cleanup(&reader);
+    return err;
+}
+
+/* Gzip-compresses another read callback on the fly (config.compression uploads) */
+typedef struct {
+    z_stream zs;
+    curl_read_callback source;
+    void *source_data;
+    bool source_done;
+    bool finished;
+    bool aborted;                   /* The source returned CURL_READFUNC_ABORT */
+    unsigned char in[CURL_MAX_READ_SIZE];
+} gzip_upload_t;
+
+static gzip_upload_t* gzip_upload_new(curl_read_callback source, void *source_data) {
+    gzip_upload_t *gz = calloc(1, sizeof(gzip_upload_t));
+    if (!gz) return NULL;
+    
+    /* Level 1: link bandwidth is the bottleneck, but the CPU still has to keep up */
+    if (deflateInit2(&gz->zs, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        free(gz);
+        return NULL;
+    }
+    gz->source = source;
+    gz->source_data = source_data;
+    return gz;
+}
+
+static void gzip_upload_free(gzip_upload_t *gz) {
+    if (!gz) return;
+    deflateEnd(&gz->zs);
+    free(gz);
+}
+
+static size_t gzip_upload_read(char *buffer, size_t size, size_t nitems, void *userdata) {
+    gzip_upload_t *gz = userdata;
+    size_t capacity = size * nitems;
+    if (gz->finished) return 0;
+    
+    gz->zs.next_out = (Bytef *)buffer;
+    gz->zs.avail_out = (uInt)capacity;
+    
+    /* Return as soon as there is output: deflate buffers internally */
+    while (gz->zs.avail_out == capacity) {
+        if (gz->zs.avail_in == 0 && !gz->source_done) {
+            size_t got = gz->source((char *)gz->in, 1, sizeof(gz->in), gz->source_data);
+            if (got == CURL_READFUNC_ABORT) {
+                gz->aborted = true;
+                return CURL_READFUNC_ABORT;
+            }
+            if (got == 0) gz->source_done = true;
+            gz->zs.next_in = gz->in;
+            gz->zs.avail_in = (uInt)got;
+        }
+        
+        int rc = deflate(&gz->zs, gz->source_done ? Z_FINISH : Z_NO_FLUSH);
+        if (rc == Z_STREAM_END) {
+            gz->finished = true;
+            break;
+        }
+        if (rc != Z_OK && rc != Z_BUF_ERROR) return CURL_READFUNC_ABORT;
+    }
+    
+    return capacity - gz->zs.avail_out;
+}
+
+/* ----------------- Response Sinks ----------------- */
+
+/*
+ * Where a raw response body goes: a growing heap buffer (the default), the
+ * caller's fixed buffer, an fd, or the heap until spill_threshold and an
+ * unlinked temp file after that, mapped once the transfer is complete.
+ */
+
+typedef struct {
+    docker_excess_sink_t *sink;
+    response_buffer_t buffer;       /* MEMORY, and SPILL below the threshold */
+    int spill_fd;                   /* SPILL once over the threshold */
+    int64_t received;
+    int error;                      /* errno of a failed write */
+    bool over_limit;
+} sink_writer_t;
+
+static int open_spill_file(const char *dir) {
+    if (!dir || !dir[0]) dir = getenv("TMPDIR");
+    if (!dir || !dir[0]) dir = "/tmp";
+    
+#ifdef O_TMPFILE
+    int fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd >= 0) return fd;
+#endif
+    
+    char path[PATH_MAX];
+    int len = snprintf(path, sizeof(path), "%s/docker-excess-XXXXXX", dir);
+    if (len < 0 || (size_t)len >= sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int tmp = mkstemp(path);
+    if (tmp >= 0) unlink(path);
+    return tmp;
+}
+
+static bool write_all(int fd, const char *data, size_t len, int *error) {
+    size_t written = 0;
+    while (written < len) {
+        ssize_t w = write(fd, data + written, len - written);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            *error = errno;
+            return false;
+        }
+        written += (size_t)w;
+    }
+    return true;
+}
+
+static size_t sink_spill_threshold(const docker_excess_sink_t *sink) {
+    return sink->spill_threshold ? sink->spill_threshold : DOCKER_EXCESS_DEFAULT_SPILL_THRESHOLD;
+}
+
+/* Most bytes the sink takes, -1 = no limit */
+static int64_t sink_limit(const docker_excess_sink_t *sink) {
+    int64_t limit = sink->limit > 0 ? sink->limit : -1;
+    if (sink->type == DOCKER_EXCESS_SINK_BUFFER && (limit < 0 || limit > (int64_t)sink->capacity)) {
+        limit = (int64_t)sink->capacity;
+    }
+    return limit;
+}
+
+static size_t write_sink_callback(char *contents, size_t size, size_t nmemb, void *userdata) {
+    sink_writer_t *writer = userdata;
+    docker_excess_sink_t *sink = writer->sink;
+    size_t total_size = size * nmemb;
+    
+    int64_t limit = sink_limit(sink);
+    if (limit >= 0 && writer->received + (int64_t)total_size > limit) {
+        writer->over_limit = true;
+        return 0;
+    }
+    
+    switch (sink->type) {
+        case DOCKER_EXCESS_SINK_BUFFER:
+            memcpy((char *)sink->buffer + writer->received, contents, total_size);
+            break;
+        case DOCKER_EXCESS_SINK_FD:
+            if (!write_all(sink->fd, contents, total_size, &writer->error)) return 0;
+            break;
+        case DOCKER_EXCESS_SINK_SPILL:
+            if (writer->spill_fd < 0 && writer->buffer.size + total_size > sink_spill_threshold(sink)) {
+                /* Move what is buffered so far to the file and stay there */
+                writer->spill_fd = open_spill_file(sink->spill_dir);
+                if (writer->spill_fd < 0) {
+                    writer->error = errno;
+                    return 0;
+                }
+                bool moved = write_all(writer->spill_fd, writer->buffer.data, writer->buffer.size, &writer->error);
+                safe_free(writer->buffer.data);
+                writer->buffer = (response_buffer_t){0};
+                if (!moved) return 0;
+            }
+            if (writer->spill_fd >= 0) {
+                if (!write_all(writer->spill_fd, contents, total_size, &writer->error)) return 0;
+                break;
+            }
+            /* fallthrough - below the threshold */
+        default:
+            if (write_response_callback(contents, size, nmemb, &writer->buffer) != total_size) {
+                writer->error = ENOMEM;
+                return 0;
+            }
+            break;
+    }
+    
+    writer->received += (int64_t)total_size;
+    return total_size;
+}
+
+/* Hand the body over to the sink once the transfer succeeded */
+static docker_excess_error_t sink_writer_finish(sink_writer_t *writer) {
+    docker_excess_sink_t *sink = writer->sink;
+    sink->size = (size_t)writer->received;
+    
+    switch (sink->type) {
+        case DOCKER_EXCESS_SINK_BUFFER:
+            sink->data = sink->buffer;
+            break;
+        case DOCKER_EXCESS_SINK_FD:
+            break;
+        default:
+            if (writer->spill_fd >= 0) {
+                void *map = mmap(NULL, sink->size, PROT_READ, MAP_PRIVATE, writer->spill_fd, 0);
+                if (map == MAP_FAILED) return map_errno(errno);
+                sink->data = map;
+                sink->mapped = true;
+                sink->spill_fd = writer->spill_fd;
+                writer->spill_fd = -1;
+            } else {
+                sink->data = writer->buffer.data;
+                writer->buffer.data = NULL;
+            }
+            break;
+    }
+    return DOCKER_EXCESS_OK;
+}
+
+static void sink_writer_cleanup(sink_writer_t *writer) {
+    safe_free(writer->buffer.data);
+    if (writer->spill_fd >= 0) close(writer->spill_fd);
+    writer->buffer.data = NULL;
+    writer->spill_fd = -1;
+}
+
+void docker_excess_sink_release(docker_excess_sink_t *sink) {
+    if (!sink) return;
+    
+    if (sink->mapped) {
+        munmap((void *)sink->data, sink->size);
+        close(sink->spill_fd);
+    } else if (sink->type == DOCKER_EXCESS_SINK_MEMORY || sink->type == DOCKER_EXCESS_SINK_SPILL) {
+        safe_free((void *)sink->data);
+    }
+    
+    sink->data = NULL;
+    sink->size = 0;
+    sink->mapped = false;
+}
+
+/* ----------------- Async Engine ----------------- */
+
+/*
+ * One curl_multi handle drives every in-flight async request of a client.
+ * Sockets and the multi timeout are mirrored into an epoll set (timerfd for
+ * the timeout, eventfd for wakeups on submit), so the epoll fd itself is the
+ * single pollable descriptor handed out by docker_excess_async_fd().
+ *
+ * Submitting only queues the request; handles are added to the multi handle
+ * by whichever thread runs docker_excess_async_run(), under run_mutex.
+ */
+
+#define ASYNC_MAX_EVENTS 64
+#define ASYNC_MAX_IDLE_HANDLES 64       /* Per client using the engine */
+
+typedef struct async_request async_request_t;
+typedef void (*async_done_fn)(async_request_t *req, docker_excess_error_t err, int http_code);
+
+struct async_request {
+    docker_excess_t *client;
+    CURL *curl;
+    char *body;
+    char url[DOCKER_EXCESS_MAX_URL_LEN];
+    char method[16];
+    response_buffer_t buffer;
+    json_sink_t json;               /* Used after async_request_parse_json() */
+    curl_write_callback write_fn;   /* Defaults to buffering into `buffer` */
+    void *write_data;
+    struct curl_slist *headers;     /* NULL = client defaults; not owned */
+    request_trace_t trace;          /* Opened on submit when tracing is on */
+    long timeout_ms;                /* As in request_opts_t */
+    const bool *stopped;
+    bool fail_on_error;
+    async_done_fn done;
+    void *done_data;
+    docker_excess_completion_callback_t callback;
+    void *userdata;
+    size_t tag;                     /* Free for use by the done callback */
+    CURLcode result;
+    async_request_t *next;          /* Queue or completion list link */
+    async_request_t *active_next;   /* Requests currently in the multi handle */
+    async_request_t **active_pprev;
+};
+
+struct async_engine {
+    CURLM *multi;
+    int epoll_fd;
+    int timer_fd;
+    int wake_fd;
+    pthread_mutex_t mutex;          /* Protects queue, idle handles and pending */
+    pthread_mutex_t run_mutex;      /* Serializes access to the multi handle */
+    async_request_t *queue;         /* Submitted, not yet added to multi */
+    async_request_t **queue_tail;
+    struct {
+        CURL *curl;
+        docker_excess_t *client;    /* Handles carry their client's options */
+    } *idle;
+    size_t idle_count;
+    size_t idle_max;
+    async_request_t *active;        /* Added to multi, protected by run_mutex */
+    size_t pending;                 /* Queued plus running requests */
+};
+
+static int async_socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, void *socketp) {
+    (void)easy;
+    async_engine_t *engine = userp;
+    
+    if (what == CURL_POLL_REMOVE) {
+        epoll_ctl(engine->epoll_fd, EPOLL_CTL_DEL, s, NULL);
+        curl_multi_assign(engine->multi, s, NULL);
+        return 0;
+    }
+    
+    struct epoll_event ev = {0};
+    ev.data.fd = s;
+    if (what & CURL_POLL_IN) ev.events |= EPOLLIN;
+    if (what & CURL_POLL_OUT) ev.events |= EPOLLOUT;
+    
+    if (socketp) {
+        epoll_ctl(engine->epoll_fd, EPOLL_CTL_MOD, s, &ev);
+    } else {
+        epoll_ctl(engine->epoll_fd, EPOLL_CTL_ADD, s, &ev);
+        curl_multi_assign(engine->multi, s, engine);
+    }
+    return 0;
+}
+
+static int async_timer_callback(CURLM *multi, long timeout_ms, void *userp) {
+    (void)multi;
+    async_engine_t *engine = userp;
+    struct itimerspec its = {0};
+    
+    if (timeout_ms == 0) {
+        its.it_value.tv_nsec = 1; /* Fire as soon as possible */
+    } else if (timeout_ms > 0) {
+        its.it_value.tv_sec = timeout_ms / 1000;
+        its.it_value.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    }
+    /* timeout_ms == -1 leaves its zeroed, which disarms the timer */
+    timerfd_settime(engine->timer_fd, 0, &its, NULL);
+    return 0;
+}
+
+static void async_engine_destroy(async_engine_t *engine) {
+    if (!engine) return;
+    
+    for (size_t i = 0; i < engine->idle_count; i++) {
+        curl_easy_cleanup(engine->idle[i].curl);
+    }
+    free(engine->idle);
+    if (engine->multi) curl_multi_cleanup(engine->multi);
+    if (engine->epoll_fd >= 0) close(engine->epoll_fd);
+    if (engine->timer_fd >= 0) close(engine->timer_fd);
+    if (engine->wake_fd >= 0) close(engine->wake_fd);
+    pthread_mutex_destroy(&engine->mutex);
+    pthread_mutex_destroy(&engine->run_mutex);
+    free(engine);
+}
+
+static async_engine_t* async_engine_create(size_t idle_max) {
+    async_engine_t *engine = calloc(1, sizeof(async_engine_t));
+    if (!engine) return NULL;
+    
+    engine->idle = calloc(idle_max, sizeof(*engine->idle));
+    engine->idle_max = idle_max;
+    engine->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    engine->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    engine->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    engine->queue_tail = &engine->queue;
+    pthread_mutex_init(&engine->mutex, NULL);
+    pthread_mutex_init(&engine->run_mutex, NULL);
+    engine->multi = curl_multi_init();
+    
+    if ((idle_max && !engine->idle) || engine->epoll_fd < 0 || engine->timer_fd < 0 || engine->wake_fd < 0 || !engine->multi) {
+        async_engine_destroy(engine);
+        return NULL;
+    }
+    
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    ev.data.fd = engine->timer_fd;
+    epoll_ctl(engine->epoll_fd, EPOLL_CTL_ADD, engine->timer_fd, &ev);
+    ev.data.fd = engine->wake_fd;
+    epoll_ctl(engine->epoll_fd, EPOLL_CTL_ADD, engine->wake_fd, &ev);
+    
+    curl_multi_setopt(engine->multi, CURLMOPT_SOCKETFUNCTION, async_socket_callback);
+    curl_multi_setopt(engine->multi, CURLMOPT_SOCKETDATA, engine);
+    curl_multi_setopt(engine->multi, CURLMOPT_TIMERFUNCTION, async_timer_callback);
+    curl_multi_setopt(engine->multi, CURLMOPT_TIMERDATA, engine);
+    
+    return engine;
+}
+
+static async_engine_t* async_engine_get(docker_excess_t *client) {
+    pthread_mutex_lock(&client->async_mutex);
+    if (!client->engine) {
+        client->engine = async_engine_create(ASYNC_MAX_IDLE_HANDLES);
+    }
+    async_engine_t *engine = client->engine;
+    pthread_mutex_unlock(&client->async_mutex);
+    
+    if (!engine) set_error(client, "Failed to initialize async engine");
+    return engine;
+}
+
+static void async_request_free(async_engine_t *engine, async_request_t *req) {
+    if (!req) return;
+    
+    /* Cancelled or never started: close the span without timings */
+    if (req->trace.open) {
+        trace_end(req->client, &req->trace, NULL, req->method, req->url + req->client->url_prefix_len, 0,
+                  DOCKER_EXCESS_ERR_INTERNAL, NULL, true);
+    }
+    
+    pthread_mutex_lock(&engine->mutex);
+    if (req->curl && engine->idle_count < engine->idle_max) {
+        engine->idle[engine->idle_count].curl = req->curl;
+        engine->idle[engine->idle_count++].client = req->client;
+        req->curl = NULL;
+    }
+    engine->pending--;
+    pthread_mutex_unlock(&engine->mutex);
+    
+    if (req->curl) curl_easy_cleanup(req->curl);
+    safe_free(req->body);
+    safe_free(req->buffer.data);
+    json_sink_cleanup(&req->json);
+    free(req);
+}
+
+static async_request_t* async_request_new(docker_excess_t *client, async_engine_t *engine,
+                                          const char *method, const char *endpoint, const char *body) {
+    async_request_t *req = calloc(1, sizeof(async_request_t));
+    if (!req) return NULL;
+    
+    req->client = client;
+    snprintf(req->method, sizeof(req->method), "%s", method);
+    build_url(client, endpoint, req->url, sizeof(req->url));
+    req->write_fn = (curl_write_callback)write_response_callback;
+    req->write_data = &req->buffer;
+    
+    if (body && body[0]) {
+        req->body = strdup(body);
+        if (!req->body) {
+            free(req);
+            return NULL;
+        }
+    }
+    
+    if (tracing_enabled(client)) trace_begin(client, &req->trace, req->method, endpoint);
+    
+    pthread_mutex_lock(&engine->mutex);
+    for (size_t i = engine->idle_count; i > 0; i--) {
+        if (engine->idle[i - 1].client != client) continue;
+        req->curl = engine->idle[i - 1].curl;
+        engine->idle[i - 1] = engine->idle[--engine->idle_count];
+        break;
+    }
+    engine->pending++;
+    pthread_mutex_unlock(&engine->mutex);
+    
+    if (!req->curl) req->curl = create_handle(client);
+    if (!req->curl) {
+        async_request_free(engine, req);
+        return NULL;
+    }
+    
+    return req;
+}
+
+/* Parse the response incrementally instead of buffering it */
+static bool async_request_parse_json(async_request_t *req) {
+    if (!json_sink_init(&req->json)) return false;
+    req->json.timed = req->trace.open;
+    req->write_fn = write_json_callback;
+    req->write_data = &req->json;
+    return true;
+}
+
+static void async_request_enqueue(async_engine_t *engine, async_request_t *req) {
+    req->next = NULL;
+    
+    pthread_mutex_lock(&engine->mutex);
+    *engine->queue_tail = req;
+    engine->queue_tail = &req->next;
+    pthread_mutex_unlock(&engine->mutex);
+    
+    uint64_t one = 1;
+    ssize_t written = write(engine->wake_fd, &one, sizeof(one));
+    (void)written; /* EAGAIN means a wakeup is already pending */
+}
+
+/* Add queued requests to the multi handle; caller holds run_mutex */
+static size_t async_engine_start_queued(async_engine_t *engine) {
+    size_t started = 0;
+
+    pthread_mutex_lock(&engine->mutex);
+    async_request_t *req = engine->queue;
+    engine->queue = NULL;
+    engine->queue_tail = &engine->queue;
+    pthread_mutex_unlock(&engine->mutex);
+    
+    while (req) {
+        async_request_t *next = req->next;
+        req->next = NULL;
+        
+        docker_excess_log(req->client, DOCKER_EXCESS_LOG_DEBUG, "Starting async %s request to %s",
+                          req->method, req->url);
+        
+        request_opts_t opts = {
+            .method = req->method,
+            .body = req->body,
+            .write_fn = req->write_fn,
+            .write_data = req->write_data,
+            .headers = req->headers,
+            .timeout_ms = req->timeout_ms,
+            .fail_on_error = req->fail_on_error,
+        };
+        setup_request(req->client, req->curl, req->url, &opts);
+        curl_easy_setopt(req->curl, CURLOPT_PRIVATE, req);
+        if (req->trace.open) req->trace.pool_wait_us = monotonic_us() - req->trace.start_us;
+        curl_multi_add_handle(engine->multi, req->curl);
+        
+        req->active_next = engine->active;
+        if (engine->active) engine->active->active_pprev = &req->active_next;
+        req->active_pprev = &engine->active;
+        engine->active = req;
+        
+        started++;
+        req = next;
+    }
+    return started;
+}
+
+static void async_engine_unlink_active(async_request_t *req) {
+    *req->active_pprev = req->active_next;
+    if (req->active_next) req->active_next->active_pprev = req->active_pprev;
+    req->active_next = NULL;
+    req->active_pprev = NULL;
+}
+
+static void async_request_complete(async_request_t *req, CURLcode res) {
+    res = normalize_result(res, req->stopped);
+    
+    long response_code = 0;
+    curl_easy_getinfo(req->curl, CURLINFO_RESPONSE_CODE, &response_code);
+    
+    docker_excess_log(req->client, DOCKER_EXCESS_LOG_DEBUG, "Async request completed with HTTP %ld",
+                      response_code);
+    
+    docker_excess_error_t err = DOCKER_EXCESS_OK;
+    if (res != CURLE_OK) {
+        err = map_curl_error(res);
+    } else if (!is_success_status(response_code)) {
+        err = map_http_error(response_code);
+    }
+    if (err != DOCKER_EXCESS_OK) {
+        set_request_error(req->client, err, (int)response_code, res, req->method,
+                          req->url + req->client->url_prefix_len);
+    }
+    
+    if (req->trace.open) {
+        trace_end(req->client, &req->trace, req->curl, req->method, req->url + req->client->url_prefix_len,
+                  (int)response_code, err, req->json.tok ? &req->json.parse_us : NULL, true);
+    }
+    
+    req->done(req, err, (int)response_code);
+}
+
+/* Completion for requests made via docker_excess_submit() */
+static void async_submit_done(async_request_t *req, docker_excess_error_t err, int http_code) {
+    if (req->callback) {
+        req->callback(err, http_code, req->buffer.data, req->buffer.size, req->userdata);
+    }
+}
+
+static docker_excess_error_t async_engine_run(async_engine_t *engine, int timeout_ms) {
+    struct epoll_event events[ASYNC_MAX_EVENTS];
+    int n = epoll_wait(engine->epoll_fd, events, ASYNC_MAX_EVENTS, timeout_ms);
+    if (n < 0) {
+        return errno == EINTR ? DOCKER_EXCESS_OK : DOCKER_EXCESS_ERR_INTERNAL;
+    }
+    
+    async_request_t *finished = NULL;
+    async_request_t **finished_tail = &finished;
+    int running = 0;
+    
+    pthread_mutex_lock(&engine->run_mutex);
+    
+    for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        if (fd == engine->wake_fd || fd == engine->timer_fd) {
+            uint64_t value;
+            ssize_t got = read(fd, &value, sizeof(value));
+            (void)got;
+            if (fd == engine->timer_fd) {
+                curl_multi_socket_action(engine->multi, CURL_SOCKET_TIMEOUT, 0, &running);
+            }
+            continue;
+        }
+        
+        int flags = 0;
+        if (events[i].events & EPOLLIN) flags |= CURL_CSELECT_IN;
+        if (events[i].events & EPOLLOUT) flags |= CURL_CSELECT_OUT;
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) flags |= CURL_CSELECT_ERR;
+        curl_multi_socket_action(engine->multi, fd, flags, &running);
+    }
+    
+    /* Newly queued requests are kicked off right away instead of waiting on the timer */
+    if (async_engine_start_queued(engine) > 0) {
+        curl_multi_socket_action(engine->multi, CURL_SOCKET_TIMEOUT, 0, &running);
+    }
+    
+    CURLMsg *msg;
+    int msgs_left;
+    while ((msg = curl_multi_info_read(engine->multi, &msgs_left))) {
+        if (msg->msg != CURLMSG_DONE) continue;
+        
+        async_request_t *req = NULL;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&req);
+        CURLcode res = msg->data.result;
+        curl_multi_remove_handle(engine->multi, msg->easy_handle);
+        
+        if (req) {
+            async_engine_unlink_active(req);
+            req->result = res;
+            *finished_tail = req;
+            finished_tail = &req->next;
+        }
+    }
+    
+    pthread_mutex_unlock(&engine->run_mutex);
+    
+    /* Completion callbacks run without engine locks so they may submit again */
+    while (finished) {
+        async_request_t *req = finished;
+        finished = req->next;
+        async_request_complete(req, req->result);
+        async_request_free(engine, req);
+    }
+    
+    return DOCKER_EXCESS_OK;
+}
+
+/*
+ * Take one request out of the engine before it completes. Returns false if
+ * it already finished; the caller runs ->done and frees it otherwise.
+ */
+static bool async_engine_detach(async_engine_t *engine, async_request_t *req) {
+    bool found = false;
+    
+    pthread_mutex_lock(&engine->run_mutex);
+    for (async_request_t *active = engine->active; active; active = active->active_next) {
+        if (active == req) {
+            async_engine_unlink_active(req);
+            curl_multi_remove_handle(engine->multi, req->curl);
+            found = true;
+            break;
+        }
+    }
+    
+    if (!found) {
+        pthread_mutex_lock(&engine->mutex);
+        for (async_request_t **link = &engine->queue; *link; link = &(*link)->next) {
+            if (*link == req) {
+                *link = req->next;
+                if (!*link) engine->queue_tail = link;
+                found = true;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&engine->mutex);
+    }
+    pthread_mutex_unlock(&engine->run_mutex);
+    
+    return found;
+}
+
+/*
+ * Detach every request whose done_data is `owner` and fail it with err,
+ * leaving other work on the engine alone. Returns how many it failed; a
+ * request another thread already completed is finished by that thread.
+ */
+static size_t async_engine_fail_owned(async_engine_t *engine, const void *owner, docker_excess_error_t err) {
+    async_request_t *cancelled = NULL;
+    size_t count = 0;
+    
+    pthread_mutex_lock(&engine->run_mutex);
+    for (async_request_t *req = engine->active, *next; req; req = next) {
+        next = req->active_next;
+        if (req->done_data != owner) continue;
+        async_engine_unlink_active(req);
+        curl_multi_remove_handle(engine->multi, req->curl);
+        req->next = cancelled;
+        cancelled = req;
+    }
+    
+    pthread_mutex_lock(&engine->mutex);
+    async_request_t **link = &engine->queue;
+    while (*link) {
+        async_request_t *req = *link;
+        if (req->done_data != owner) {
+            link = &req->next;
+            continue;
+        }
+        *link = req->next;
+        req->next = cancelled;
+        cancelled = req;
+    }
+    engine->queue_tail = link;
+    pthread_mutex_unlock(&engine->mutex);
+    pthread_mutex_unlock(&engine->run_mutex);
+    
+    while (cancelled) {
+        async_request_t *req = cancelled;
+        cancelled = req->next;
+        req->done(req, err, 0);
+        async_request_free(engine, req);
+        count++;
+    }
+    return count;
+}
+
+/* Fail every queued and running request; used when the client goes away */
+static void async_engine_shutdown(async_engine_t *engine) {
+    pthread_mutex_lock(&engine->run_mutex);
+    pthread_mutex_lock(&engine->mutex);
+    async_request_t *cancelled = engine->queue;
+    engine->queue = NULL;
+    engine->queue_tail = &engine->queue;
+    pthread_mutex_unlock(&engine->mutex);
+    
+    while (engine->active) {
+        async_request_t *req = engine->active;
+        async_engine_unlink_active(req);
+        curl_multi_remove_handle(engine->multi, req->curl);
+        req->next = cancelled;
+        cancelled = req;
+    }
+    pthread_mutex_unlock(&engine->run_mutex);
+    
+    while (cancelled) {
+        async_request_t *req = cancelled;
+        cancelled = req->next;
+        req->done(req, DOCKER_EXCESS_ERR_INTERNAL, 0);
+        async_request_free(engine, req);
+    }
+}
+
+/* ----------------- Async Batches ----------------- */
+
+/*
+ * Runs count independent items on an engine, at most max_parallel at a
+ * time. submit() returns DOCKER_EXCESS_OK once it enqueued a request whose
+ * completion ends with async_batch_done(); any other result finishes the
+ * item with that error. The waiter returns when every item has finished,
+ * submitted or not, so no callback can outlive the batch.
+ */
+typedef struct async_batch async_batch_t;
+typedef docker_excess_error_t (*async_batch_submit_fn)(async_batch_t *batch, size_t index);
+
+struct async_batch {
+    async_engine_t *engine;
+    size_t count;
+    size_t max_parallel;
+    async_batch_submit_fn submit;
+    void *data;                     /* The caller's batch state, done_data of its requests */
+    docker_excess_error_t *errors;  /* One per item */
+    size_t next;                    /* Next index to submit */
+    size_t in_flight;
+    size_t remaining;               /* Items not finished yet */
+    pthread_mutex_t mutex;
+};
+
+/*
+ * Retire `finished` items whose errors are already recorded, then submit
+ * what the free slots allow. Slots are claimed under the lock and a
+ * claimed item keeps the batch alive until it finishes, so nothing here
+ * touches the batch after the last item is handed over.
+ */
+static void async_batch_pump(async_batch_t *batch, size_t finished) {
+    for (;;) {
+        pthread_mutex_lock(&batch->mutex);
+        batch->in_flight -= finished;
+        batch->remaining -= finished;
+    
+        size_t first = batch->next;
+        size_t slots = batch->max_parallel > batch->in_flight ? batch->max_parallel - batch->in_flight : 0;
+        size_t claimed = batch->count - first < slots ? batch->count - first : slots;
+        batch->next += claimed;
+        batch->in_flight += claimed;
+    
+        async_batch_submit_fn submit = batch->submit;
+        pthread_mutex_unlock(&batch->mutex);
+    
+        if (claimed == 0) return;
+    
+        finished = 0;
+        for (size_t i = 0; i < claimed; i++) {
+            docker_excess_error_t err = submit(batch, first + i);
+            if (err != DOCKER_EXCESS_OK) {
+                batch->errors[first + i] = err;
+                finished++;
+            }
+        }
+        if (finished == 0) return;
+    }
+}
+
+/* Called last by an item's completion, on whichever thread runs the engine */
+static void async_batch_done(async_batch_t *batch, size_t index, docker_excess_error_t err) {
+    batch->errors[index] = err;
+    async_batch_pump(batch, 1);
+}
+
+/*
+ * Run the batch to completion. If the engine itself fails, the items not
+ * submitted yet get its error and the batch's own requests are detached
+ * and failed too, so the wait still ends once their callbacks have run.
+ * Other requests on a shared engine are left alone.
+ */
+static docker_excess_error_t async_batch_run(docker_excess_t *client, async_batch_t *batch) {
+    batch->next = 0;
+    batch->in_flight = 0;
+    batch->remaining = batch->count;
+    if (batch->max_parallel == 0) batch->max_parallel = 1;
+    pthread_mutex_init(&batch->mutex, NULL);
+    
+    async_batch_pump(batch, 0);
+    
+    docker_excess_error_t result = DOCKER_EXCESS_OK;
+    pthread_mutex_lock(&batch->mutex);
+    while (batch->remaining > 0) {
+        pthread_mutex_unlock(&batch->mutex);
+    
+        if (result != DOCKER_EXCESS_OK) {
+            if (async_engine_fail_owned(batch->engine, batch->data, result) == 0) sched_yield();
+            pthread_mutex_lock(&batch->mutex);
+            continue;
+        }
+    
+        /* Short waits: another thread may be running the same engine */
+        result = async_engine_run(batch->engine, 100);
+        if (result != DOCKER_EXCESS_OK) {
+            set_error(client, "Async engine failed: %s", strerror(errno));
+    
+            pthread_mutex_lock(&batch->mutex);
+            for (size_t i = batch->next; i < batch->count; i++) batch->errors[i] = result;
+            batch->remaining -= batch->count - batch->next;
+            batch->next = batch->count;
+            pthread_mutex_unlock(&batch->mutex);
+        }
+        pthread_mutex_lock(&batch->mutex);
+    }
+    pthread_mutex_unlock(&batch->mutex);
+    
+    pthread_mutex_destroy(&batch->mutex);
+    return result;
+}
+
+/* ----------------- JSON Helper Functions ----------------- */
+
+static json_object* get_json_object(json_object *obj, const char *key) {
+    if (!obj || !key) return NULL;
+    json_object *result;
+    return json_object_object_get_ex(obj, key, &result) ? result : NULL;
+}
+
+static const char* get_json_string(json_object *obj, const char *key) {
+    json_object *field = get_json_object(obj, key);
+    if (field && json_object_get_type(field) == json_type_string) {
+        return json_object_get_string(field);
+    }
+    return NULL;
+}
+
+static int64_t get_json_int(json_object *obj, const char *key) {
+    json_object *field = get_json_object(obj, key);
+    if (field && json_object_get_type(field) == json_type_int) {
+        return json_object_get_int64(field);
+    }
+    return 0;
+}
+
+static bool get_json_bool(json_object *obj, const char *key) {
+    json_object *field = get_json_object(obj, key);
+    if (field && json_object_get_type(field) == json_type_boolean) {
+        return json_object_get_boolean(field);
+    }
+    return false;
+}
+
+/*
+ * Times are Unix seconds in listings and RFC 3339 in inspect responses.
+ * The daemon reports unset times as Go's zero time, 0001-01-01T00:00:00Z,
+ * which maps to 0 like a missing key.
+ */
+static int64_t parse_json_time(json_object *obj, const char *key) {
+    json_object *value;
+    if (!json_object_object_get_ex(obj, key, &value)) return 0;
+    if (json_object_get_type(value) != json_type_string) return json_object_get_int64(value);
+    
+    struct tm tm = {0};
+    if (sscanf(json_object_get_string(value), "%d-%d-%dT%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+               &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6 || tm.tm_year <= 1) {
+        return 0;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    return (int64_t)timegm(&tm);
 }
 
 static char** parse_json_string_array(json_object *array, size_t *count) {
@@ -276,361 +2661,6856 @@ static char** parse_json_string_array(json_object *array, size_t *count) {
         return NULL;
     }
     
-    size_t len = json_object_array_length(array);
-    if (len == 0) {
-        *count = 0;
-        return NULL;
+    size_t len = json_object_array_length(array);
+    if (len == 0) {
+        *count = 0;
+        return NULL;
+    }
+    
+    char **result = calloc(len, sizeof(char*));
+    if (!result) {
+        *count = 0;
+        return NULL;
+    }
+    
+    for (size_t i = 0; i < len; i++) {
+        json_object *item = json_object_array_get_idx(array, i);
+        const char *str = json_object_get_string(item);
+        result[i] = safe_strdup(str);
+    }
+    
+    *count = len;
+    return result;
+}
+
+static char* make_label(docker_excess_arena_t *arena, const char *key, json_object *value) {
+    const char *val = json_object_get_string(value);
+    size_t key_len = strlen(key);
+    size_t val_len = val ? strlen(val) : 0;
+    
+    char *label = arena ? arena_alloc(arena, key_len + val_len + 2) : malloc(key_len + val_len + 2);
+    if (!label) return NULL;
+    
+    memcpy(label, key, key_len);
+    label[key_len] = '=';
+    if (val_len) memcpy(label + key_len + 1, val, val_len);
+    label[key_len + val_len + 1] = '\0';
+    return label;
+}
+
+/* Build "key=value" strings straight from a Labels object; keys limits which are kept */
+static void parse_json_labels(json_object *labels_obj, docker_excess_arena_t *arena,
+                              const char **keys, size_t keys_count,
+                              char ***labels, size_t *count) {
+    *labels = NULL;
+    *count = 0;
+    if (!labels_obj || json_object_get_type(labels_obj) != json_type_object) return;
+    
+    size_t len = keys ? keys_count : (size_t)json_object_object_length(labels_obj);
+    if (len == 0) return;
+    
+    char **result = dx_calloc(arena, len, sizeof(char*));
+    if (!result) return;
+    
+    size_t n = 0;
+    if (keys) {
+        for (size_t i = 0; i < keys_count; i++) {
+            json_object *value;
+            if (!keys[i] || !json_object_object_get_ex(labels_obj, keys[i], &value)) continue;
+            char *label = make_label(arena, keys[i], value);
+            if (label) result[n++] = label;
+        }
+    } else {
+        json_object_object_foreach(labels_obj, key, value) {
+            char *label = make_label(arena, key, value);
+            if (label) result[n++] = label;
+        }
+    }
+    
+    if (n == 0 && !arena) {
+        free(result);
+        result = NULL;
+    }
+    
+    *labels = result;
+    *count = n;
+}
+
+/* ----------------- Label Index ----------------- */
+
+/*
+ * Open-addressing table over a container's "key=value" strings. Slots hold
+ * label position + 1 (0 = empty); keys are hashed up to the '='. Built only
+ * for containers with enough labels that a linear scan starts to cost.
+ */
+
+#define LABEL_INDEX_MIN_LABELS 8
+
+struct docker_excess_label_index {
+    uint32_t mask;
+    uint32_t slots[];
+};
+
+static uint32_t label_key_hash(const char *key, size_t len) {
+    uint32_t hash = 2166136261u; /* FNV-1a */
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static size_t label_key_length(const char *label) {
+    const char *eq = strchr(label, '=');
+    return eq ? (size_t)(eq - label) : strlen(label);
+}
+
+static struct docker_excess_label_index* build_label_index(docker_excess_arena_t *arena,
+                                                           char **labels, size_t count) {
+    if (count < LABEL_INDEX_MIN_LABELS || count > UINT32_MAX / 4) return NULL;
+    
+    uint32_t capacity = 16;
+    while (capacity < count * 2) capacity <<= 1;
+    
+    size_t size = sizeof(struct docker_excess_label_index) + capacity * sizeof(uint32_t);
+    struct docker_excess_label_index *index = dx_calloc(arena, 1, size);
+    if (!index) return NULL;
+    
+    index->mask = capacity - 1;
+    for (size_t i = 0; i < count; i++) {
+        if (!labels[i]) continue;
+        uint32_t slot = label_key_hash(labels[i], label_key_length(labels[i])) & index->mask;
+        while (index->slots[slot]) slot = (slot + 1) & index->mask;
+        index->slots[slot] = (uint32_t)i + 1;
+    }
+    return index;
+}
+
+static bool label_has_key(const char *label, const char *key, size_t key_len) {
+    return label && strncmp(label, key, key_len) == 0 && label[key_len] == '=';
+}
+
+const char* docker_excess_get_label(const docker_excess_container_t *container, const char *key) {
+    if (!container || !key) return NULL;
+    
+    size_t key_len = strlen(key);
+    const struct docker_excess_label_index *index = container->label_index;
+    
+    if (index) {
+        uint32_t slot = label_key_hash(key, key_len) & index->mask;
+        while (index->slots[slot]) {
+            const char *label = container->labels[index->slots[slot] - 1];
+            if (label_has_key(label, key, key_len)) return label + key_len + 1;
+            slot = (slot + 1) & index->mask;
+        }
+        return NULL;
+    }
+    
+    for (size_t i = 0; i < container->labels_count; i++) {
+        if (label_has_key(container->labels[i], key, key_len)) {
+            return container->labels[i] + key_len + 1;
+        }
+    }
+    return NULL;
+}
+
+static docker_excess_container_state_t parse_container_state(const char *state_str) {
+    if (!state_str) return DOCKER_EXCESS_STATE_CREATED;
+    
+    static const struct {
+        const char *name;
+        docker_excess_container_state_t state;
+    } state_map[] = {
+        {"created", DOCKER_EXCESS_STATE_CREATED},
+        {"restarting", DOCKER_EXCESS_STATE_RESTARTING},
+        {"running", DOCKER_EXCESS_STATE_RUNNING},
+        {"removing", DOCKER_EXCESS_STATE_REMOVING},
+        {"paused", DOCKER_EXCESS_STATE_PAUSED},
+        {"exited", DOCKER_EXCESS_STATE_EXITED},
+        {"dead", DOCKER_EXCESS_STATE_DEAD}
+    };
+    
+    for (size_t i = 0; i < sizeof(state_map) / sizeof(state_map[0]); i++) {
+        if (strcmp(state_str, state_map[i].name) == 0) {
+            return state_map[i].state;
+        }
+    }
+    
+    return DOCKER_EXCESS_STATE_CREATED;
+}
+
+/* ----------------- Resolver Cache ----------------- */
+
+struct resolve_entry {
+    resolve_entry_t *hash_next;
+    resolve_entry_t *lru_prev;
+    resolve_entry_t *lru_next;
+    uint32_t hash;
+    resolve_kind_t kind;
+    int64_t expires_ms;
+    char *id;
+    char name[];
+};
+
+static uint32_t resolve_hash(resolve_kind_t kind, const char *name) {
+    return label_key_hash(name, strlen(name)) ^ ((uint32_t)kind * 0x9e3779b9u);
+}
+
+static docker_excess_error_t resolve_cache_init(resolve_cache_t *cache, int capacity, int ttl_s) {
+    memset(cache, 0, sizeof(*cache));
+    if (capacity <= 0) return DOCKER_EXCESS_OK;
+    
+    size_t buckets = 16;
+    while (buckets < (size_t)capacity) buckets <<= 1;
+    
+    cache->buckets = calloc(buckets, sizeof(resolve_entry_t*));
+    if (!cache->buckets) return DOCKER_EXCESS_ERR_MEMORY;
+    if (pthread_mutex_init(&cache->mutex, NULL) != 0) {
+        safe_free(cache->buckets);
+        return DOCKER_EXCESS_ERR_INTERNAL;
+    }
+    
+    cache->bucket_mask = buckets - 1;
+    cache->capacity = (size_t)capacity;
+    cache->ttl_ms = (int64_t)ttl_s * 1000;
+    return DOCKER_EXCESS_OK;
+}
+
+/* Caller holds the mutex */
+static void resolve_cache_unlink(resolve_cache_t *cache, resolve_entry_t *entry) {
+    resolve_entry_t **link = &cache->buckets[entry->hash & cache->bucket_mask];
+    while (*link != entry) link = &(*link)->hash_next;
+    *link = entry->hash_next;
+    
+    if (entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+    else cache->lru_head = entry->lru_next;
+    if (entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+    else cache->lru_tail = entry->lru_prev;
+    
+    cache->count--;
+    free(entry->id);
+    free(entry);
+}
+
+static void resolve_cache_clear(resolve_cache_t *cache) {
+    if (!cache->buckets) return;
+    
+    pthread_mutex_lock(&cache->mutex);
+    while (cache->lru_head) {
+        resolve_cache_unlink(cache, cache->lru_head);
+    }
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+static void resolve_cache_cleanup(resolve_cache_t *cache) {
+    if (!cache->buckets) return;
+    
+    resolve_cache_clear(cache);
+    pthread_mutex_destroy(&cache->mutex);
+    safe_free(cache->buckets);
+}
+
+/* Returns a copy of the cached ID, or NULL on a miss */
+static char* resolve_cache_get(resolve_cache_t *cache, resolve_kind_t kind, const char *name) {
+    if (!cache->buckets) return NULL;
+    
+    uint32_t hash = resolve_hash(kind, name);
+    char *id = NULL;
+    
+    pthread_mutex_lock(&cache->mutex);
+    resolve_entry_t *entry = cache->buckets[hash & cache->bucket_mask];
+    while (entry && !(entry->hash == hash && entry->kind == kind && strcmp(entry->name, name) == 0)) {
+        entry = entry->hash_next;
+    }
+    
+    if (entry && cache->ttl_ms > 0 && monotonic_ms() >= entry->expires_ms) {
+        resolve_cache_unlink(cache, entry);
+        entry = NULL;
+    }
+    
+    if (entry) {
+        /* Move to the front of the LRU list */
+        if (entry != cache->lru_head) {
+            entry->lru_prev->lru_next = entry->lru_next;
+            if (entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+            else cache->lru_tail = entry->lru_prev;
+            entry->lru_prev = NULL;
+            entry->lru_next = cache->lru_head;
+            cache->lru_head->lru_prev = entry;
+            cache->lru_head = entry;
+        }
+        id = strdup(entry->id);
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    
+    return id;
+}
+
+static void resolve_cache_put(resolve_cache_t *cache, resolve_kind_t kind, const char *name, const char *id) {
+    if (!cache->buckets) return;
+    
+    size_t name_len = strlen(name);
+    resolve_entry_t *entry = calloc(1, sizeof(resolve_entry_t) + name_len + 1);
+    if (!entry) return;
+    entry->id = strdup(id);
+    if (!entry->id) {
+        free(entry);
+        return;
+    }
+    memcpy(entry->name, name, name_len + 1);
+    entry->kind = kind;
+    entry->hash = resolve_hash(kind, name);
+    entry->expires_ms = monotonic_ms() + cache->ttl_ms;
+    
+    pthread_mutex_lock(&cache->mutex);
+    
+    /* Replace an existing mapping for the same name */
+    for (resolve_entry_t *old = cache->buckets[entry->hash & cache->bucket_mask]; old; old = old->hash_next) {
+        if (old->hash == entry->hash && old->kind == kind && strcmp(old->name, name) == 0) {
+            resolve_cache_unlink(cache, old);
+            break;
+        }
+    }
+    if (cache->count >= cache->capacity) {
+        resolve_cache_unlink(cache, cache->lru_tail);
+    }
+    
+    resolve_entry_t **bucket = &cache->buckets[entry->hash & cache->bucket_mask];
+    entry->hash_next = *bucket;
+    *bucket = entry;
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head) cache->lru_head->lru_prev = entry;
+    cache->lru_head = entry;
+    if (!cache->lru_tail) cache->lru_tail = entry;
+    cache->count++;
+    
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+/* Caller holds the mutex; prefix also matches IDs that start with id */
+static void resolve_cache_drop_id(resolve_cache_t *cache, const char *id, bool prefix) {
+    size_t len = strlen(id);
+    resolve_entry_t *entry = cache->lru_head;
+    while (entry) {
+        resolve_entry_t *next = entry->lru_next;
+        if (prefix ? strncmp(entry->id, id, len) == 0 : strcmp(entry->id, id) == 0) {
+            resolve_cache_unlink(cache, entry);
+        }
+        entry = next;
+    }
+}
+
+/*
+ * Drop every entry whose name or ID equals key, or whose ID starts with a
+ * short hex ID. A name also takes every other name cached for the ID it
+ * pointed to, since those may be just as stale.
+ */
+static void resolve_cache_invalidate(resolve_cache_t *cache, const char *key) {
+    if (!cache->buckets || !key || !key[0]) return;
+    
+    size_t key_len = strlen(key);
+    bool short_id = key_len >= 12 && strspn(key, "0123456789abcdef") == key_len;
+    
+    pthread_mutex_lock(&cache->mutex);
+    for (;;) {
+        resolve_entry_t *entry = cache->lru_head;
+        while (entry && strcmp(entry->name, key) != 0) entry = entry->lru_next;
+        if (!entry) break;
+        
+        char id[128];
+        snprintf(id, sizeof(id), "%s", entry->id);
+        resolve_cache_unlink(cache, entry);
+        resolve_cache_drop_id(cache, id, false);
+    }
+    resolve_cache_drop_id(cache, key, short_id);
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+/* Images: an untag can leave any cached reference pointing at the wrong image, so all of them go */
+static void resolve_cache_invalidate_kind(resolve_cache_t *cache, resolve_kind_t kind) {
+    if (!cache->buckets) return;
+    
+    pthread_mutex_lock(&cache->mutex);
+    resolve_entry_t *entry = cache->lru_head;
+    while (entry) {
+        resolve_entry_t *next = entry->lru_next;
+        if (entry->kind == kind) resolve_cache_unlink(cache, entry);
+        entry = next;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+/* ----------------- Core API Implementation ----------------- */
+
+const char* docker_excess_get_version(void) {
+    return DOCKER_EXCESS_VERSION;
+}
+
+docker_excess_config_t docker_excess_default_config(void) {
+    docker_excess_config_t config = {0};
+    config.socket_path = safe_strdup(DOCKER_EXCESS_DEFAULT_SOCKET);
+    config.port = 2376;
+    config.timeout_s = DOCKER_EXCESS_DEFAULT_TIMEOUT_S;
+    config.log_level = DOCKER_EXCESS_LOG_INFO;
+    return config;
+}
+
+void docker_excess_free_config(docker_excess_config_t *config) {
+    if (!config) return;
+    
+    safe_free(config->socket_path);
+    safe_free(config->host);
+    safe_free(config->cert_path);
+    safe_free(config->key_path);
+    safe_free(config->ca_path);
+    config->socket_path = config->host = config->cert_path = config->key_path = config->ca_path = NULL;
+}
+
+docker_excess_error_t docker_excess_new(docker_excess_t **client) {
+    docker_excess_config_t config = docker_excess_default_config();
+    docker_excess_error_t err = docker_excess_new_with_config(&config, client);
+    docker_excess_free_config(&config);
+    return err;
+}
+
+static void client_destroy(docker_excess_t *client);
+
+/* Group members reuse the group's share and engine instead of creating their own */
+static docker_excess_error_t client_create(const docker_excess_config_t *config, docker_excess_group_t *group,
+                                           docker_excess_t **client) {
+    docker_excess_t *c = calloc(1, sizeof(docker_excess_t));
+    if (!c) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    /* Initialize config with deep copy */
+    memset(&c->config, 0, sizeof(docker_excess_config_t));
+    c->config.socket_path = safe_strdup(config->socket_path);
+    c->config.host = safe_strdup(config->host);
+    c->config.port = config->port;
+    c->config.use_tls = config->use_tls;
+    c->config.cert_path = safe_strdup(config->cert_path);
+    c->config.key_path = safe_strdup(config->key_path);
+    c->config.ca_path = safe_strdup(config->ca_path);
+    c->config.timeout_s = config->timeout_s;
+    c->config.connect_timeout_s = config->connect_timeout_s > 0 ?
+                                  config->connect_timeout_s : DOCKER_EXCESS_DEFAULT_CONNECT_TIMEOUT;
+    c->config.max_retries = config->max_retries;
+    c->config.retry_backoff_ms = config->retry_backoff_ms > 0 ?
+                                 config->retry_backoff_ms : DOCKER_EXCESS_DEFAULT_RETRY_BACKOFF_MS;
+    c->config.hedge_reads = config->hedge_reads;
+    c->config.hedge_delay_ms = config->hedge_delay_ms;
+    c->config.breaker_threshold = config->breaker_threshold;
+    c->config.breaker_cooldown_ms = config->breaker_cooldown_ms > 0 ?
+                                    config->breaker_cooldown_ms : DOCKER_EXCESS_DEFAULT_BREAKER_COOLDOWN_MS;
+    c->config.debug = config->debug;
+    c->config.compression = config->compression;
+    c->config.log_callback = config->log_callback;
+    c->config.log_userdata = config->log_userdata;
+    c->config.log_level = config->debug ? DOCKER_EXCESS_LOG_DEBUG :
+                          config->log_level != DOCKER_EXCESS_LOG_DEFAULT ? config->log_level : DOCKER_EXCESS_LOG_INFO;
+    c->config.metrics = config->metrics;
+    c->config.span_begin = config->span_begin;
+    c->config.span_end = config->span_end;
+    c->config.span_userdata = config->span_userdata;
+    c->config.max_connections = config->max_connections > 0 ?
+                                config->max_connections : DOCKER_EXCESS_DEFAULT_MAX_CONNECTIONS;
+    c->config.resolve_cache_size = config->resolve_cache_size != 0 ?
+                                   config->resolve_cache_size : DOCKER_EXCESS_DEFAULT_RESOLVE_CACHE_SIZE;
+    c->config.resolve_cache_ttl_s = config->resolve_cache_ttl_s > 0 ?
+                                    config->resolve_cache_ttl_s : DOCKER_EXCESS_DEFAULT_RESOLVE_CACHE_TTL;
+    
+    if (pthread_mutex_init(&c->async_mutex, NULL) != 0 || pthread_mutex_init(&c->list_mutex, NULL) != 0 ||
+        pthread_mutex_init(&c->policy.mutex, NULL) != 0) {
+        client_destroy(c);
+        return DOCKER_EXCESS_ERR_INTERNAL;
+    }
+    
+    /* Initialize cURL (thread-safe) */
+    pthread_mutex_lock(&g_curl_init_mutex);
+    if (g_curl_init_count == 0) {
+        if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+            pthread_mutex_unlock(&g_curl_init_mutex);
+            client_destroy(c);
+            return DOCKER_EXCESS_ERR_INTERNAL;
+        }
+    }
+    g_curl_init_count++;
+    pthread_mutex_unlock(&g_curl_init_mutex);
+    
+    c->curl_initialized = true;
+    
+    if (!build_url_prefix(c)) {
+        client_destroy(c);
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    c->headers = build_headers("application/json");
+    c->tar_headers = build_headers("application/x-tar");
+    docker_excess_error_t err = c->headers && c->tar_headers ? DOCKER_EXCESS_OK : DOCKER_EXCESS_ERR_MEMORY;
+    if (err == DOCKER_EXCESS_OK && group) {
+        c->group = group;
+        c->share = &group->share;
+        c->engine = group->engine;
+    } else if (err == DOCKER_EXCESS_OK) {
+        c->share = &c->own_share;
+        err = share_init(c->share);
+    }
+    if (err == DOCKER_EXCESS_OK) {
+        err = pool_init(&c->pool, (size_t)c->config.max_connections);
+    }
+    if (err == DOCKER_EXCESS_OK && c->config.hedge_reads) {
+        err = multi_pool_init(&c->hedge_multis, (size_t)c->config.max_connections);
+    }
+    c->policy.retry_tokens = POLICY_MAX_RETRY_TOKENS;
+    if (err == DOCKER_EXCESS_OK) {
+        err = resolve_cache_init(&c->resolver, c->config.resolve_cache_size, c->config.resolve_cache_ttl_s);
+    }
+    if (err == DOCKER_EXCESS_OK && c->config.metrics) {
+        c->metrics = metrics_new();
+        if (!c->metrics) err = DOCKER_EXCESS_ERR_MEMORY;
+    }
+    if (err != DOCKER_EXCESS_OK) {
+        client_destroy(c);
+        return err;
+    }
+    
+    c->is_connected = false;
+    c->last_ping = 0;
+    
+    docker_excess_log(c, DOCKER_EXCESS_LOG_INFO, "Docker client created successfully");
+    
+    *client = c;
+    return DOCKER_EXCESS_OK;
+}
+
+docker_excess_error_t docker_excess_new_with_config(const docker_excess_config_t *config, docker_excess_t **client) {
+    if (!config || !client) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    return client_create(config, NULL, client);
+}
+
+static void list_snapshots_free(docker_excess_t *client);
+
+static void client_destroy(docker_excess_t *client) {
+    docker_excess_log(client, DOCKER_EXCESS_LOG_DEBUG, "Freeing Docker client");
+    
+    /* Free configuration */
+    safe_free(client->config.socket_path);
+    safe_free(client->config.host);
+    safe_free(client->config.cert_path);
+    safe_free(client->config.key_path);
+    safe_free(client->config.ca_path);
+    
+    /* Cleanup cURL; a group tears down its shared engine and share itself */
+    if (client->engine && !client->group) {
+        async_engine_shutdown(client->engine);
+        async_engine_destroy(client->engine);
+    }
+    pool_cleanup(&client->pool);
+    multi_pool_cleanup(&client->hedge_multis);
+    share_cleanup(&client->own_share);
+    resolve_cache_cleanup(&client->resolver);
+    metrics_free(client->metrics);       /* After the engine: cancelled requests still record */
+    curl_slist_free_all(client->headers);
+    curl_slist_free_all(client->tar_headers);
+    
+    if (client->curl_initialized) {
+        pthread_mutex_lock(&g_curl_init_mutex);
+        g_curl_init_count--;
+        if (g_curl_init_count == 0) {
+            curl_global_cleanup();
+        }
+        pthread_mutex_unlock(&g_curl_init_mutex);
+    }
+    
+    list_snapshots_free(client);
+    pthread_mutex_destroy(&client->list_mutex);
+    pthread_mutex_destroy(&client->async_mutex);
+    pthread_mutex_destroy(&client->policy.mutex);
+    if (g_error.client == client) g_error.client = NULL;
+    free(client);
+}
+
+void docker_excess_free(docker_excess_t *client) {
+    if (!client || client->group) return;   /* Group members are freed with their group */
+    client_destroy(client);
+}
+
+const char* docker_excess_get_error(docker_excess_t *client) {
+    if (!client) return "Invalid client";
+    if (g_error.client != client || !g_error.result.message[0]) return "No error";
+    return g_error.result.message;
+}
+
+docker_excess_error_t docker_excess_last_result(docker_excess_t *client, docker_excess_result_t *result) {
+    if (!client || !result) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    if (g_error.client == client) {
+        *result = g_error.result;
+    } else {
+        memset(result, 0, sizeof(*result));
+    }
+    return result->code;
+}
+
+void docker_excess_clear_error(docker_excess_t *client) {
+    if (!client || g_error.client != client) return;
+    g_error.client = NULL;
+}
+
+docker_excess_error_t docker_excess_ping(docker_excess_t *client) {
+    if (!client) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    response_buffer_t response = {0};
+    request_opts_t opts = {
+        .method = "GET",
+        .endpoint = "/_ping",
+        .write_fn = (curl_write_callback)write_response_callback,
+        .write_data = &response,
+        .health_check = true,
+    };
+    int http_code = 0;
+    docker_excess_error_t err = perform_request(client, &opts, &http_code, NULL);
+    
+    if (err == DOCKER_EXCESS_OK) {
+        client->is_connected = true;
+        client->last_ping = time(NULL);
+        docker_excess_log(client, DOCKER_EXCESS_LOG_DEBUG, "Ping successful");
+    } else {
+        client->is_connected = false;
+        docker_excess_log(client, DOCKER_EXCESS_LOG_WARN, "Ping failed");
+    }
+    
+    safe_free(response.data);
+    return err;
+}
+
+bool docker_excess_circuit_open(docker_excess_t *client) {
+    if (!client) return false;
+    
+    pthread_mutex_lock(&client->policy.mutex);
+    bool open = client->policy.open_until != 0;
+    pthread_mutex_unlock(&client->policy.mutex);
+    return open;
+}
+
+docker_excess_error_t docker_excess_version(docker_excess_t *client, char **version_json) {
+    return make_request(client, "GET", "/version", NULL, version_json, NULL);
+}
+
+docker_excess_error_t docker_excess_system_info(docker_excess_t *client, char **info_json) {
+    return make_request(client, "GET", "/info", NULL, info_json, NULL);
+}
+
+/* ----------------- Asynchronous Requests Implementation ----------------- */
+
+docker_excess_error_t docker_excess_submit(docker_excess_t *client, const char *method,
+                                          const char *endpoint, const char *body,
+                                          docker_excess_completion_callback_t callback, void *userdata) {
+    if (!client || !method || !endpoint) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    async_engine_t *engine = async_engine_get(client);
+    if (!engine) return DOCKER_EXCESS_ERR_INTERNAL;
+    
+    async_request_t *req = async_request_new(client, engine, method, endpoint, body);
+    if (!req) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    req->done = async_submit_done;
+    req->callback = callback;
+    req->userdata = userdata;
+    async_request_enqueue(engine, req);
+    return DOCKER_EXCESS_OK;
+}
+
+int docker_excess_async_fd(docker_excess_t *client) {
+    if (!client) return -1;
+    
+    async_engine_t *engine = async_engine_get(client);
+    return engine ? engine->epoll_fd : -1;
+}
+
+docker_excess_error_t docker_excess_async_run(docker_excess_t *client, int timeout_ms) {
+    if (!client) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    async_engine_t *engine = async_engine_get(client);
+    if (!engine) return DOCKER_EXCESS_ERR_INTERNAL;
+    
+    return async_engine_run(engine, timeout_ms);
+}
+
+size_t docker_excess_async_pending(docker_excess_t *client) {
+    if (!client) return 0;
+    
+    pthread_mutex_lock(&client->async_mutex);
+    async_engine_t *engine = client->engine;
+    pthread_mutex_unlock(&client->async_mutex);
+    if (!engine) return 0;
+    
+    pthread_mutex_lock(&engine->mutex);
+    size_t pending = engine->pending;
+    pthread_mutex_unlock(&engine->mutex);
+    return pending;
+}
+
+/* ----------------- Metrics Implementation ----------------- */
+
+docker_excess_error_t docker_excess_metrics_snapshot(docker_excess_t *client, docker_excess_metrics_t *metrics) {
+    if (!client || !metrics) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    memset(metrics, 0, sizeof(*metrics));
+    
+    if (!client->metrics) {
+        set_error(client, "Metrics are disabled for this client");
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    /* Copied out of the lock into a right-sized array, never more than the table */
+    docker_excess_route_metrics_t *routes = malloc(METRICS_MAX_ROUTES * sizeof(docker_excess_route_metrics_t));
+    if (!routes) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    metrics_t *m = client->metrics;
+    pthread_mutex_lock(&m->mutex);
+    metrics->routes_count = m->routes_count;
+    memcpy(routes, m->routes, m->routes_count * sizeof(docker_excess_route_metrics_t));
+    metrics->pool_wait = m->pool_wait;
+    metrics->json_parse = m->json_parse;
+    metrics->retries = m->retries;
+    pthread_mutex_unlock(&m->mutex);
+    
+    if (metrics->routes_count == 0) {
+        free(routes);
+        routes = NULL;
+    }
+    metrics->routes = routes;
+    return DOCKER_EXCESS_OK;
+}
+
+void docker_excess_metrics_free(docker_excess_metrics_t *metrics) {
+    if (!metrics) return;
+    safe_free(metrics->routes);
+    memset(metrics, 0, sizeof(*metrics));
+}
+
+void docker_excess_metrics_reset(docker_excess_t *client) {
+    if (!client || !client->metrics) return;
+    
+    metrics_t *m = client->metrics;
+    pthread_mutex_lock(&m->mutex);
+    memset(m->routes, 0, sizeof(m->routes));
+    memset(m->hashes, 0, sizeof(m->hashes));
+    m->routes_count = 0;
+    memset(&m->pool_wait, 0, sizeof(m->pool_wait));
+    memset(&m->json_parse, 0, sizeof(m->json_parse));
+    m->retries = 0;
+    pthread_mutex_unlock(&m->mutex);
+}
+
+int64_t docker_excess_histogram_quantile(const docker_excess_histogram_t *hist, double quantile) {
+    if (!hist || hist->count == 0) return 0;
+    if (quantile < 0.0) quantile = 0.0;
+    if (quantile > 1.0) quantile = 1.0;
+    
+    /* Rank of the sample, rounded up so 0.99 of 10 samples is the 10th */
+    double exact = quantile * (double)hist->count;
+    uint64_t rank = (uint64_t)exact;
+    if ((double)rank < exact) rank++;
+    if (rank == 0) rank = 1;
+    
+    uint64_t seen = 0;
+    for (size_t i = 0; i < DOCKER_EXCESS_HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen < rank) continue;
+        
+        if (i == DOCKER_EXCESS_HIST_BUCKETS - 1) return (int64_t)hist->max_us;
+        uint64_t bound = (uint64_t)1 << i;
+        return (int64_t)(bound < hist->max_us ? bound : hist->max_us);
+    }
+    return (int64_t)hist->max_us;
+}
+
+/* ----------------- Container Management Implementation ----------------- */
+
+static bool build_container_list_endpoint(docker_excess_t *client, bool all, const char *filters,
+                                          char *endpoint, size_t endpoint_size) {
+    int len = snprintf(endpoint, endpoint_size, "/containers/json?all=%s", all ? "true" : "false");
+    if (filters) {
+        if (!build_resource_endpoint(endpoint + len, endpoint_size - (size_t)len, "&filters=", filters, NULL)) {
+            set_error(client, "Container filters too long");
+            return false;
+        }
+    }
+    return true;
+}
+
+static docker_excess_error_t fetch_container_list(docker_excess_t *client, bool all, const char *filters,
+                                                 json_object **json) {
+    char endpoint[DOCKER_EXCESS_MAX_URL_LEN];
+    if (!build_container_list_endpoint(client, all, filters, endpoint, sizeof(endpoint))) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    docker_excess_error_t err = make_request_json(client, "GET", endpoint, NULL, json, NULL);
+    if (err != DOCKER_EXCESS_OK) return err;
+    
+    if (json_object_get_type(*json) != json_type_array) {
+        json_object_put(*json);
+        *json = NULL;
+        set_error(client, "Invalid JSON response for container list");
+        return DOCKER_EXCESS_ERR_JSON;
+    }
+    
+    return DOCKER_EXCESS_OK;
+}
+
+/* Which members of docker_excess_container_t a parse should fill in */
+typedef struct {
+    uint32_t fields;
+    const char **label_keys;        /* NULL = every label */
+    size_t label_keys_count;
+} container_projection_t;
+
+static const container_projection_t full_projection = { DOCKER_EXCESS_FIELD_ALL, NULL, 0 };
+
+static container_projection_t make_projection(const docker_excess_list_options_t *options) {
+    container_projection_t projection = full_projection;
+    if (options) {
+        if (options->fields) projection.fields = options->fields;
+        projection.label_keys = options->label_keys;
+        projection.label_keys_count = options->label_keys_count;
+    }
+    return projection;
+}
+
+static void parse_container_labels(json_object *labels_obj, docker_excess_container_t *container,
+                                   docker_excess_arena_t *arena, const container_projection_t *projection) {
+    if (!labels_obj || !(projection->fields & DOCKER_EXCESS_FIELD_LABELS)) return;
+    
+    parse_json_labels(labels_obj, arena, projection->label_keys, projection->label_keys_count,
+                      &container->labels, &container->labels_count);
+    container->label_index = build_label_index(arena, container->labels, container->labels_count);
+}
+
+/* Fill a container from one /containers/json entry; strings go to the arena if given */
+static void parse_container_summary(json_object *container_obj, docker_excess_container_t *container,
+                                    docker_excess_arena_t *arena, const container_projection_t *projection) {
+    uint32_t fields = projection->fields;
+    
+    const char *id = (fields & DOCKER_EXCESS_FIELD_ID) ? get_json_string(container_obj, "Id") : NULL;
+    if (id) {
+        container->id = dx_strdup(arena, id);
+        container->short_id = arena ? arena_strndup(arena, id, 12) : docker_excess_short_id(id);
+    }
+    
+    if (fields & DOCKER_EXCESS_FIELD_IMAGE) {
+        container->image = dx_strdup(arena, get_json_string(container_obj, "Image"));
+    }
+    if (fields & DOCKER_EXCESS_FIELD_IMAGE_ID) {
+        container->image_id = dx_strdup(arena, get_json_string(container_obj, "ImageID"));
+    }
+    if (fields & DOCKER_EXCESS_FIELD_STATUS) {
+        container->status = dx_strdup(arena, get_json_string(container_obj, "Status"));
+    }
+    if (fields & DOCKER_EXCESS_FIELD_STATE) {
+        container->state = parse_container_state(get_json_string(container_obj, "State"));
+    }
+    if (fields & DOCKER_EXCESS_FIELD_CREATED) {
+        container->created = get_json_int(container_obj, "Created");
+    }
+    
+    /* Parse names array */
+    json_object *names_obj = (fields & DOCKER_EXCESS_FIELD_NAME) ? get_json_object(container_obj, "Names") : NULL;
+    if (names_obj && json_object_get_type(names_obj) == json_type_array) {
+        if (json_object_array_length(names_obj) > 0) {
+            json_object *name_obj = json_object_array_get_idx(names_obj, 0);
+            const char *name = json_object_get_string(name_obj);
+            if (name && name[0] == '/') {
+                container->name = dx_strdup(arena, name + 1); /* Skip leading '/' */
+            }
+        }
+    }
+    
+    parse_container_labels(get_json_object(container_obj, "Labels"), container, arena, projection);
+}
+
+/* Build the container array of a /containers/json response; json stays owned by the caller */
+static docker_excess_error_t build_container_list(json_object *json, const container_projection_t *projection,
+                                                 docker_excess_arena_t **arena,
+                                                 docker_excess_container_t ***containers, size_t *count) {
+    size_t array_len = json_object_array_length(json);
+    
+    /* Rough per-container footprint so typical lists fit the first block */
+    docker_excess_arena_t *result_arena = NULL;
+    if (arena) {
+        result_arena = arena_create(array_len * 1024);
+        if (!result_arena) return DOCKER_EXCESS_ERR_MEMORY;
+    }
+    
+    docker_excess_container_t **result = NULL;
+    
+    if (array_len > 0) {
+        result = dx_calloc(result_arena, array_len, sizeof(docker_excess_container_t*));
+        docker_excess_container_t *items = result_arena ?
+            arena_calloc(result_arena, array_len, sizeof(docker_excess_container_t)) : NULL;
+        if (!result || (result_arena && !items)) {
+            if (result_arena) docker_excess_arena_free(result_arena);
+            else safe_free(result);
+            return DOCKER_EXCESS_ERR_MEMORY;
+        }
+        
+        for (size_t i = 0; i < array_len; i++) {
+            json_object *container_obj = json_object_array_get_idx(json, i);
+            
+            docker_excess_container_t *container = items ? &items[i] : calloc(1, sizeof(docker_excess_container_t));
+            if (!container) continue;
+            
+            if (container_obj) {
+                parse_container_summary(container_obj, container, result_arena, projection);
+            }
+            result[i] = container;
+        }
+    }
+    
+    if (arena) *arena = result_arena;
+    *containers = result;
+    *count = array_len;
+    return DOCKER_EXCESS_OK;
+}
+
+static docker_excess_error_t list_containers(docker_excess_t *client, bool all, const char *filters,
+                                            const container_projection_t *projection,
+                                            docker_excess_arena_t **arena,
+                                            docker_excess_container_t ***containers, size_t *count) {
+    json_object *json = NULL;
+    docker_excess_error_t err = fetch_container_list(client, all, filters, &json);
+    if (err != DOCKER_EXCESS_OK) return err;
+    
+    err = build_container_list(json, projection, arena, containers, count);
+    json_object_put(json);
+    return err;
+}
+
+docker_excess_error_t docker_excess_list_containers(docker_excess_t *client, bool all,
+                                                   const char *filters,
+                                                   docker_excess_container_t ***containers, size_t *count) {
+    if (!client || !containers || !count) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    return list_containers(client, all, filters, &full_projection, NULL, containers, count);
+}
+
+docker_excess_error_t docker_excess_list_containers_arena(docker_excess_t *client, bool all,
+                                                         const char *filters, docker_excess_arena_t **arena,
+                                                         docker_excess_container_t ***containers, size_t *count) {
+    if (!client || !arena || !containers || !count) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    return list_containers(client, all, filters, &full_projection, arena, containers, count);
+}
+
+docker_excess_error_t docker_excess_list_containers_ex(docker_excess_t *client,
+                                                      const docker_excess_list_options_t *options,
+                                                      docker_excess_container_t ***containers, size_t *count) {
+    if (!client || !containers || !count) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    container_projection_t projection = make_projection(options);
+    return list_containers(client, options ? options->all : false, options ? options->filters : NULL,
+                           &projection, options ? options->arena : NULL, containers, count);
+}
+
+/* Fill a container from a /containers/{id}/json response */
+static void parse_container_inspect(json_object *json, docker_excess_container_t *result,
+                                    const container_projection_t *projection) {
+    uint32_t fields = projection->fields;
+    
+    const char *id = (fields & DOCKER_EXCESS_FIELD_ID) ? get_json_string(json, "Id") : NULL;
+    if (id) {
+        result->id = safe_strdup(id);
+        result->short_id = docker_excess_short_id(id);
+    }
+    
+    const char *name = (fields & DOCKER_EXCESS_FIELD_NAME) ? get_json_string(json, "Name") : NULL;
+    if (name && name[0] == '/') {
+        result->name = safe_strdup(name + 1);
+    }
+    
+    /* Parse Config section */
+    json_object *config_obj = get_json_object(json, "Config");
+    if (config_obj) {
+        if (fields & DOCKER_EXCESS_FIELD_IMAGE) {
+            result->image = safe_strdup(get_json_string(config_obj, "Image"));
+        }
+        
+        parse_container_labels(get_json_object(config_obj, "Labels"), result, NULL, projection);
+    }
+    
+    /* Parse State section */
+    json_object *state_obj = get_json_object(json, "State");
+    if (state_obj) {
+        if (fields & DOCKER_EXCESS_FIELD_STATE) {
+            const char *status = get_json_string(state_obj, "Status");
+            result->state = parse_container_state(status);
+            result->started_at = parse_json_time(state_obj, "StartedAt");
+            result->finished_at = parse_json_time(state_obj, "FinishedAt");
+        }
+        
+        if (fields & DOCKER_EXCESS_FIELD_EXIT_CODE) {
+            result->exit_code = (int)get_json_int(state_obj, "ExitCode");
+        }
+    }
+    
+    if (fields & DOCKER_EXCESS_FIELD_CREATED) {
+        result->created = get_json_int(json, "Created");
+    }
+}
+
+/* Release everything a container owns, but not the struct itself */
+static void container_clear(docker_excess_container_t *container) {
+    safe_free(container->id);
+    safe_free(container->short_id);
+    safe_free(container->name);
+    safe_free(container->image);
+    safe_free(container->image_id);
+    safe_free(container->status);
+    
+    for (size_t i = 0; i < container->ports_count; i++) {
+        safe_free(container->ports[i].protocol);
+        safe_free(container->ports[i].host_ip);
+    }
+    safe_free(container->ports);
+    
+    for (size_t i = 0; i < container->mounts_count; i++) {
+        safe_free(container->mounts[i].source);
+        safe_free(container->mounts[i].target);
+        safe_free(container->mounts[i].type);
+    }
+    safe_free(container->mounts);
+    
+    for (size_t i = 0; i < container->labels_count; i++) {
+        safe_free(container->labels[i]);
+    }
+    safe_free(container->labels);
+    safe_free(container->label_index);
+    
+    memset(container, 0, sizeof(*container));
+}
+
+void docker_excess_free_containers(docker_excess_container_t **containers, size_t count) {
+    if (!containers) return;
+    
+    for (size_t i = 0; i < count; i++) {
+        if (!containers[i]) continue;
+        container_clear(containers[i]);
+        free(containers[i]);
+    }
+    free(containers);
+}
+
+static docker_excess_error_t inspect_container(docker_excess_t *client, const char *container_id,
+                                               const container_projection_t *projection,
+                                               docker_excess_container_t **container) {
+    char endpoint[512];
+    if (!build_resource_endpoint(endpoint, sizeof(endpoint), "/containers/", container_id, "/json")) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    json_object *json = NULL;
+    docker_excess_error_t err = make_request_json(client, "GET", endpoint, NULL, &json, NULL);
+    if (err != DOCKER_EXCESS_OK) return err;
+    
+    docker_excess_container_t *result = calloc(1, sizeof(docker_excess_container_t));
+    if (!result) {
+        json_object_put(json);
+        return DOCKER_EXCESS_ERR_MEMORY;
+    }
+    
+    /* Parse detailed container information */
+    parse_container_inspect(json, result, projection);
+    
+    json_object_put(json);
+    *container = result;
+    return DOCKER_EXCESS_OK;
+}
+
+docker_excess_error_t docker_excess_inspect_container(docker_excess_t *client, const char *container_id,
+                                                     docker_excess_container_t **container) {
+    if (!client || !container_id || !container) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    return inspect_container(client, container_id, &full_projection, container);
+}
+
+docker_excess_error_t docker_excess_inspect_container_ex(docker_excess_t *client, const char *container_id,
+                                                        uint32_t fields, docker_excess_container_t **container) {
+    if (!client || !container_id || !container) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    container_projection_t projection = full_projection;
+    if (fields) projection.fields = fields;
+    return inspect_container(client, container_id, &projection, container);
+}
+
+/* Shared state of one docker_excess_inspect_containers() call */
+typedef struct {
+    docker_excess_t *client;
+    const char **ids;
+    docker_excess_container_t *results;
+    async_batch_t run;
+} inspect_batch_t;
+
+static void inspect_batch_done(async_request_t *req, docker_excess_error_t err, int http_code) {
+    (void)http_code;
+    inspect_batch_t *batch = req->done_data;
+    size_t index = req->tag;
+    
+    if (err == DOCKER_EXCESS_OK) {
+        json_object *json = json_sink_finish(&req->json);
+        if (json) {
+            parse_container_inspect(json, &batch->results[index], &full_projection);
+            json_object_put(json);
+        } else {
+            err = DOCKER_EXCESS_ERR_JSON;
+        }
+    }
+    async_batch_done(&batch->run, index, err);
+}
+
+static docker_excess_error_t inspect_batch_submit(async_batch_t *run, size_t index) {
+    inspect_batch_t *batch = run->data;
+    char endpoint[512];
+    
+    if (!build_resource_endpoint(endpoint, sizeof(endpoint), "/containers/", batch->ids[index], "/json")) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    async_request_t *req = async_request_new(batch->client, run->engine, "GET", endpoint, NULL);
+    if (req && !async_request_parse_json(req)) {
+        async_request_free(run->engine, req);
+        req = NULL;
+    }
+    if (!req) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    req->done = inspect_batch_done;
+    req->done_data = batch;
+    req->tag = index;
+    async_request_enqueue(run->engine, req);
+    return DOCKER_EXCESS_OK;
+}
+
+docker_excess_error_t docker_excess_inspect_containers(docker_excess_t *client, const char **container_ids,
+                                                      size_t count, size_t max_parallel,
+                                                      docker_excess_container_t **containers,
+                                                      docker_excess_error_t *errors) {
+    if (!client || (!container_ids && count > 0) || !containers || !errors) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    *containers = NULL;
+    if (count == 0) return DOCKER_EXCESS_OK;
+    
+    async_engine_t *engine = async_engine_get(client);
+    if (!engine) return DOCKER_EXCESS_ERR_INTERNAL;
+    
+    docker_excess_container_t *results = calloc(count, sizeof(docker_excess_container_t));
+    if (!results) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    inspect_batch_t batch = {
+        .client = client,
+        .ids = container_ids,
+        .results = results,
+    };
+    batch.run = (async_batch_t){
+        .engine = engine,
+        .count = count,
+        .max_parallel = max_parallel > 0 ? max_parallel : (size_t)client->config.max_connections,
+        .submit = inspect_batch_submit,
+        .data = &batch,
+        .errors = errors,
+    };
+    
+    docker_excess_error_t err = async_batch_run(client, &batch.run);
+    if (err != DOCKER_EXCESS_OK) {
+        docker_excess_free_container_array(results, count);
+        return err;
+    }
+    
+    *containers = results;
+    return DOCKER_EXCESS_OK;
+}
+
+void docker_excess_free_container_array(docker_excess_container_t *containers, size_t count) {
+    if (!containers) return;
+    
+    for (size_t i = 0; i < count; i++) {
+        container_clear(&containers[i]);
+    }
+    free(containers);
+}
+
+/* ----------------- Incremental Container Listing ----------------- */
+
+/*
+ * The client keeps the last listing of every distinct query (endpoint and
+ * projection). A new listing is split into its raw array elements and each
+ * one is hashed; only elements whose hash changed since the previous call
+ * are parsed, unchanged ones hand out the record built last time. Records
+ * are refcounted and shared between the snapshot and every delta.
+ */
+
+typedef struct {
+    atomic_uint refs;
+    uint64_t hash;                  /* Of the raw JSON object it was parsed from */
+    docker_excess_container_t container;
+} list_record_t;
+
+struct list_snapshot {
+    list_snapshot_t *next;
+    pthread_mutex_t mutex;          /* Held for a whole delta listing */
+    uint64_t token;
+    size_t count;
+    list_record_t **records;        /* Sorted by container id */
+    char key[];                     /* Endpoint and projection of the query */
+};
+
+/* One element of a JSON array, located without being parsed */
+typedef struct {
+    const char *data;
+    size_t len;
+    const char *id;                 /* Raw bytes of its top-level "Id" string, NULL = none */
+    size_t id_len;
+    uint64_t hash;
+} raw_object_t;
+
+#define FNV64_OFFSET 14695981039346656037ULL
+#define FNV64_PRIME 1099511628211ULL
+
+/*
+ * Split a JSON array of objects in one pass, hashing every element and
+ * picking out its "Id" on the way. Only the structure is checked here; an
+ * element is validated when (and if) it is parsed.
+ */
+static bool split_object_array(const char *data, size_t len, raw_object_t **objects, size_t *count) {
+    raw_object_t *items = NULL;
+    size_t items_count = 0, capacity = 0;
+    raw_object_t *current = NULL;
+    uint64_t hash = 0;
+    int depth = 0;
+    bool in_string = false, escaped = false;
+    bool expect_key = false, is_key = false, id_key = false, id_value = false;
+    const char *string_start = NULL;
+    
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        if (current) hash = (hash ^ (uint8_t)c) * FNV64_PRIME;
+        
+        if (in_string) {
+            if (escaped) {
+                escaped = false;
+            } else if (c == '\\') {
+                escaped = true;
+            } else if (c == '"') {
+                in_string = false;
+                size_t string_len = (size_t)(data + i - string_start);
+                if (is_key) {
+                    id_key = string_len == 2 && memcmp(string_start, "Id", 2) == 0;
+                } else if (id_value) {
+                    current->id = string_start;
+                    current->id_len = string_len;
+                }
+            }
+            continue;
+        }
+        
+        switch (c) {
+            case '"':
+                in_string = true;
+                string_start = data + i + 1;
+                is_key = depth == 2 && expect_key;
+                id_value = depth == 2 && !expect_key && id_key;
+                break;
+            case ':':
+                if (depth == 2) expect_key = false;
+                break;
+            case ',':
+                if (depth == 2) {
+                    expect_key = true;
+                    id_key = false;
+                }
+                break;
+            case '[':
+            case '{':
+                depth++;
+                if (depth == 1 && c != '[') goto fail;
+                if (depth == 2) {
+                    if (c != '{') goto fail;
+                    if (items_count == capacity) {
+                        size_t new_capacity = capacity ? capacity * 2 : 64;
+                        raw_object_t *grown = realloc(items, new_capacity * sizeof(raw_object_t));
+                        if (!grown) goto fail;
+                        items = grown;
+                        capacity = new_capacity;
+                    }
+                    current = &items[items_count++];
+                    memset(current, 0, sizeof(*current));
+                    current->data = data + i;
+                    hash = (FNV64_OFFSET ^ (uint8_t)c) * FNV64_PRIME;
+                    expect_key = true;
+                    id_key = false;
+                }
+                break;
+            case ']':
+            case '}':
+                if (depth == 2 && current) {
+                    current->len = (size_t)(data + i + 1 - current->data);
+                    current->hash = hash;
+                    current = NULL;
+                }
+                if (--depth < 0) goto fail;
+                break;
+            default:
+                break;
+        }
+    }
+    if (depth != 0 || in_string) goto fail;
+    
+    *objects = items;
+    *count = items_count;
+    return true;
+    
+fail:
+    free(items);
+    return false;
+}
+
+static list_record_t* list_record_of(docker_excess_container_t *container) {
+    return (list_record_t*)((char*)container - offsetof(list_record_t, container));
+}
+
+static void list_record_release(list_record_t *record) {
+    if (record && atomic_fetch_sub(&record->refs, 1) == 1) {
+        container_clear(&record->container);
+        free(record);
+    }
+}
+
+static list_record_t* list_record_parse(const raw_object_t *raw, const container_projection_t *projection) {
+    json_tokener *tok = json_tokener_new();
+    if (!tok) return NULL;
+    json_object *obj = json_tokener_parse_ex(tok, raw->data, (int)raw->len);
+    json_tokener_free(tok);
+    if (!obj) return NULL;
+    
+    list_record_t *record = calloc(1, sizeof(list_record_t));
+    if (record) {
+        atomic_init(&record->refs, 1);
+        record->hash = raw->hash;
+        parse_container_summary(obj, &record->container, NULL, projection);
+    }
+    json_object_put(obj);
+    return record;
+}
+
+static int list_record_compare(const void *a, const void *b) {
+    const list_record_t *ra = *(list_record_t *const *)a;
+    const list_record_t *rb = *(list_record_t *const *)b;
+    return strcmp(ra->container.id, rb->container.id);
+}
+
+/* Index of the record with this id, or snapshot->count */
+static size_t list_snapshot_find(const list_snapshot_t *snapshot, const char *id, size_t id_len) {
+    size_t lo = 0, hi = snapshot->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const char *key = snapshot->records[mid]->container.id;
+        int cmp = strncmp(key, id, id_len);
+        if (cmp == 0 && key[id_len] != '\0') cmp = 1;
+        if (cmp == 0) return mid;
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return snapshot->count;
+}
+
+/* The snapshot for a query, created empty on first use */
+static list_snapshot_t* list_snapshot_get(docker_excess_t *client, const char *key) {
+    pthread_mutex_lock(&client->list_mutex);
+    list_snapshot_t *snapshot = client->list_snapshots;
+    while (snapshot && strcmp(snapshot->key, key) != 0) snapshot = snapshot->next;
+    
+    if (!snapshot) {
+        size_t key_len = strlen(key);
+        snapshot = calloc(1, sizeof(list_snapshot_t) + key_len + 1);
+        if (snapshot) {
+            pthread_mutex_init(&snapshot->mutex, NULL);
+            memcpy(snapshot->key, key, key_len + 1);
+            snapshot->next = client->list_snapshots;
+            client->list_snapshots = snapshot;
+        }
+    }
+    pthread_mutex_unlock(&client->list_mutex);
+    return snapshot;
+}
+
+static void list_snapshots_free(docker_excess_t *client) {
+    list_snapshot_t *snapshot = client->list_snapshots;
+    while (snapshot) {
+        list_snapshot_t *next = snapshot->next;
+        for (size_t i = 0; i < snapshot->count; i++) {
+            list_record_release(snapshot->records[i]);
+        }
+        free(snapshot->records);
+        pthread_mutex_destroy(&snapshot->mutex);
+        free(snapshot);
+        snapshot = next;
+    }
+    client->list_snapshots = NULL;
+}
+
+/* Endpoint plus projection: deltas are only meaningful against the same query */
+static bool build_list_key(char *key, size_t key_size, const char *endpoint, const container_projection_t *projection) {
+    int len = snprintf(key, key_size, "%s#%x", endpoint, projection->fields);
+    if (len < 0 || (size_t)len >= key_size) return false;
+    
+    for (size_t i = 0; projection->label_keys && i < projection->label_keys_count; i++) {
+        int written = snprintf(key + len, key_size - (size_t)len, "#%s", projection->label_keys[i]);
+        if (written < 0 || (size_t)written >= key_size - (size_t)len) return false;
+        len += written;
+    }
+    return true;
+}
+
+static docker_excess_error_t list_delta_build(docker_excess_t *client, list_snapshot_t *snapshot,
+                                              const char *body, size_t body_len,
+                                              const container_projection_t *projection, uint64_t token,
+                                              docker_excess_container_delta_t *delta) {
+    raw_object_t *objects = NULL;
+    size_t count = 0;
+    if (!split_object_array(body, body_len, &objects, &count)) {
+        set_error(client, "Invalid JSON response for container list");
+        return DOCKER_EXCESS_ERR_JSON;
+    }
+    
+    /* A token from another consumer or an older snapshot cannot be diffed against */
+    bool full = token == 0 || token != snapshot->token;
+    
+    list_record_t **records = calloc(count ? count : 1, sizeof(list_record_t*));
+    bool *seen = calloc(snapshot->count ? snapshot->count : 1, sizeof(bool));
+    delta->containers = calloc(count ? count : 1, sizeof(docker_excess_container_t*));
+    delta->added = calloc(count ? count : 1, sizeof(docker_excess_container_t*));
+    delta->changed = full ? NULL : calloc(count ? count : 1, sizeof(docker_excess_container_t*));
+    
+    docker_excess_error_t err = DOCKER_EXCESS_OK;
+    if (!records || !seen || !delta->containers || !delta->added || (!full && !delta->changed)) {
+        err = DOCKER_EXCESS_ERR_MEMORY;
+    }
+    
+    size_t kept = 0;
+    for (size_t i = 0; err == DOCKER_EXCESS_OK && i < count; i++) {
+        const raw_object_t *raw = &objects[i];
+        if (!raw->id || raw->id_len == 0) continue;
+        
+        size_t index = list_snapshot_find(snapshot, raw->id, raw->id_len);
+        list_record_t *old = index < snapshot->count ? snapshot->records[index] : NULL;
+        if (old) seen[index] = true;
+        
+        list_record_t *record;
+        if (old && old->hash == raw->hash) {
+            record = old;
+            atomic_fetch_add(&record->refs, 1);
+        } else {
+            record = list_record_parse(raw, projection);
+            if (!record || !record->container.id) {
+                list_record_release(record);
+                continue;
+            }
+        }
+        
+        records[kept] = record;
+        docker_excess_container_t *container = &record->container;
+        delta->containers[kept++] = container;
+        atomic_fetch_add(&record->refs, 1);   /* The delta's reference */
+        
+        if (full || !old) {
+            delta->added[delta->added_count++] = container;
+        } else if (record != old) {
+            delta->changed[delta->changed_count++] = container;
+        }
+    }
+    delta->count = kept;
+    
+    if (err == DOCKER_EXCESS_OK && !full) {
+        for (size_t i = 0; i < snapshot->count; i++) {
+            if (!seen[i]) delta->removed_count++;
+        }
+        if (delta->removed_count > 0) {
+            delta->removed = calloc(delta->removed_count, sizeof(char*));
+            if (!delta->removed) err = DOCKER_EXCESS_ERR_MEMORY;
+        }
+        size_t removed = 0;
+        for (size_t i = 0; err == DOCKER_EXCESS_OK && i < snapshot->count; i++) {
+            if (seen[i]) continue;
+            delta->removed[removed] = strdup(snapshot->records[i]->container.id);
+            if (!delta->removed[removed++]) err = DOCKER_EXCESS_ERR_MEMORY;
+        }
+    }
+    
+    if (err == DOCKER_EXCESS_OK) {
+        /* The new listing replaces the snapshot; records reused above keep their reference */
+        for (size_t i = 0; i < snapshot->count; i++) {
+            list_record_release(snapshot->records[i]);
+        }
+        free(snapshot->records);
+        qsort(records, kept, sizeof(list_record_t*), list_record_compare);
+        snapshot->records = records;
+        snapshot->count = kept;
+        snapshot->token++;
+        delta->token = snapshot->token;
+        delta->full = full;
+        records = NULL;
+    } else {
+        for (size_t i = 0; i < kept; i++) {
+            list_record_release(records[i]);
+        }
+        free(records);
+        docker_excess_container_delta_free(delta);
+    }
+    
+    free(seen);
+    free(objects);
+    return err;
+}
+
+docker_excess_error_t docker_excess_list_containers_delta(docker_excess_t *client,
+                                                         const docker_excess_list_options_t *options,
+                                                         uint64_t token, docker_excess_container_delta_t *delta) {
+    if (!client || !delta) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    memset(delta, 0, sizeof(*delta));
+    
+    char endpoint[DOCKER_EXCESS_MAX_URL_LEN];
+    if (!build_container_list_endpoint(client, options ? options->all : false, options ? options->filters : NULL,
+                                       endpoint, sizeof(endpoint))) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    /* Records are keyed by id, so it is parsed whatever the projection */
+    container_projection_t projection = make_projection(options);
+    projection.fields |= DOCKER_EXCESS_FIELD_ID;
+    char key[DOCKER_EXCESS_MAX_URL_LEN + 256];
+    if (!build_list_key(key, sizeof(key), endpoint, &projection)) {
+        set_error(client, "Container list query too long");
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    list_snapshot_t *snapshot = list_snapshot_get(client, key);
+    if (!snapshot) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    pthread_mutex_lock(&snapshot->mutex);
+    response_buffer_t buffer = {0};
+    request_opts_t opts = {
+        .method = "GET",
+        .endpoint = endpoint,
+        .write_fn = (curl_write_callback)write_response_callback,
+        .write_data = &buffer,
+        .fail_on_error = true,
+    };
+    docker_excess_error_t err = perform_request(client, &opts, NULL, NULL);
+    if (err == DOCKER_EXCESS_OK) {
+        err = list_delta_build(client, snapshot, buffer.data ? buffer.data : "", buffer.size,
+                               &projection, token, delta);
+    }
+    pthread_mutex_unlock(&snapshot->mutex);
+    
+    safe_free(buffer.data);
+    return err;
+}
+
+void docker_excess_container_delta_free(docker_excess_container_delta_t *delta) {
+    if (!delta) return;
+    
+    if (delta->containers) {
+        for (size_t i = 0; i < delta->count; i++) {
+            list_record_release(list_record_of(delta->containers[i]));
+        }
+    }
+    if (delta->removed) {
+        for (size_t i = 0; i < delta->removed_count; i++) {
+            safe_free(delta->removed[i]);
+        }
+    }
+    safe_free(delta->containers);
+    safe_free(delta->added);
+    safe_free(delta->changed);
+    safe_free(delta->removed);
+    memset(delta, 0, sizeof(*delta));
+}
+
+/* ----------------- Container Lifecycle ----------------- */
+
+typedef struct {
+    int timeout_s;                  /* stop/restart grace period, < 0 = daemon default */
+    const char *signal;             /* kill, NULL = SIGKILL */
+    bool force;                     /* remove */
+    bool remove_volumes;
+} lifecycle_args_t;
+
+static bool build_lifecycle_endpoint(char *endpoint, size_t size, docker_excess_bulk_op_t op,
+                                     const char *container_id, const lifecycle_args_t *args,
+                                     const char **method) {
+    static const char *const suffixes[] = {
+        [DOCKER_EXCESS_OP_START] = "/start",
+        [DOCKER_EXCESS_OP_STOP] = "/stop",
+        [DOCKER_EXCESS_OP_KILL] = "/kill",
+        [DOCKER_EXCESS_OP_RESTART] = "/restart",
+        [DOCKER_EXCESS_OP_REMOVE] = "",
+        [DOCKER_EXCESS_OP_PAUSE] = "/pause",
+        [DOCKER_EXCESS_OP_UNPAUSE] = "/unpause",
+    };
+    if ((unsigned)op > DOCKER_EXCESS_OP_UNPAUSE) return false;
+    
+    *method = op == DOCKER_EXCESS_OP_REMOVE ? "DELETE" : "POST";
+    if (!build_resource_endpoint(endpoint, size, "/containers/", container_id, suffixes[op])) return false;
+    
+    size_t len = strlen(endpoint);
+    int n = 0;
+    if ((op == DOCKER_EXCESS_OP_STOP || op == DOCKER_EXCESS_OP_RESTART) && args->timeout_s >= 0) {
+        n = snprintf(endpoint + len, size - len, "?t=%d", args->timeout_s);
+    } else if (op == DOCKER_EXCESS_OP_REMOVE) {
+        n = snprintf(endpoint + len, size - len, "?force=%d&v=%d", args->force ? 1 : 0, args->remove_volumes ? 1 : 0);
+    } else if (op == DOCKER_EXCESS_OP_KILL && args->signal) {
+        return query_append(endpoint, size, &len, "signal", args->signal);
+    }
+    return n >= 0 && (size_t)n < size - len;
+}
+
+/* Stop and restart legitimately take the grace period: do not time out before the daemon does */
+static long lifecycle_timeout_ms(const docker_excess_t *client, docker_excess_bulk_op_t op, const lifecycle_args_t *args) {
+    if (op != DOCKER_EXCESS_OP_STOP && op != DOCKER_EXCESS_OP_RESTART) return 0;
+    int grace = args->timeout_s >= 0 ? args->timeout_s : 10;
+    return ((long)grace + (client->config.timeout_s > 0 ? client->config.timeout_s : 30)) * 1000;
+}
+
+/* 304: already started/stopped, which is what the caller asked for */
+static docker_excess_error_t lifecycle_result(docker_excess_error_t err, int http_code) {
+    return http_code == 304 ? DOCKER_EXCESS_OK : err;
+}
+
+static docker_excess_error_t lifecycle_request(docker_excess_t *client, docker_excess_bulk_op_t op,
+                                               const char *container_id, const lifecycle_args_t *args) {
+    if (!client || !container_id) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char endpoint[512];
+    const char *method;
+    if (!build_lifecycle_endpoint(endpoint, sizeof(endpoint), op, container_id, args, &method)) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    response_buffer_t response = {0};
+    request_opts_t opts = {
+        .method = method,
+        .endpoint = endpoint,
+        .write_fn = (curl_write_callback)write_response_callback,
+        .write_data = &response,
+        .timeout_ms = lifecycle_timeout_ms(client, op, args),
+    };
+    int http_code = 0;
+    docker_excess_error_t err = lifecycle_result(perform_request(client, &opts, &http_code, NULL), http_code);
+    safe_free(response.data);
+    
+    /* The name may be taken by a new container right away */
+    if (err == DOCKER_EXCESS_OK && op == DOCKER_EXCESS_OP_REMOVE) {
+        resolve_cache_invalidate(&client->resolver, container_id);
+    }
+    return err;
+}
+
+docker_excess_error_t docker_excess_start_container(docker_excess_t *client, const char *container_id) {
+    lifecycle_args_t args = { .timeout_s = -1 };
+    return lifecycle_request(client, DOCKER_EXCESS_OP_START, container_id, &args);
+}
+
+docker_excess_error_t docker_excess_stop_container(docker_excess_t *client, const char *container_id, int timeout_s) {
+    lifecycle_args_t args = { .timeout_s = timeout_s };
+    return lifecycle_request(client, DOCKER_EXCESS_OP_STOP, container_id, &args);
+}
+
+docker_excess_error_t docker_excess_kill_container(docker_excess_t *client, const char *container_id, const char *signal) {
+    lifecycle_args_t args = { .timeout_s = -1, .signal = signal };
+    return lifecycle_request(client, DOCKER_EXCESS_OP_KILL, container_id, &args);
+}
+
+docker_excess_error_t docker_excess_restart_container(docker_excess_t *client, const char *container_id) {
+    lifecycle_args_t args = { .timeout_s = -1 };
+    return lifecycle_request(client, DOCKER_EXCESS_OP_RESTART, container_id, &args);
+}
+
+docker_excess_error_t docker_excess_remove_container(docker_excess_t *client, const char *container_id, bool force,
+                                                    bool remove_volumes) {
+    lifecycle_args_t args = { .timeout_s = -1, .force = force, .remove_volumes = remove_volumes };
+    return lifecycle_request(client, DOCKER_EXCESS_OP_REMOVE, container_id, &args);
+}
+
+docker_excess_error_t docker_excess_pause_container(docker_excess_t *client, const char *container_id) {
+    lifecycle_args_t args = { .timeout_s = -1 };
+    return lifecycle_request(client, DOCKER_EXCESS_OP_PAUSE, container_id, &args);
+}
+
+docker_excess_error_t docker_excess_unpause_container(docker_excess_t *client, const char *container_id) {
+    lifecycle_args_t args = { .timeout_s = -1 };
+    return lifecycle_request(client, DOCKER_EXCESS_OP_UNPAUSE, container_id, &args);
+}
+
+docker_excess_error_t docker_excess_rename_container(docker_excess_t *client, const char *container_id,
+                                                    const char *new_name) {
+    if (!client || !container_id || !new_name || !new_name[0]) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char endpoint[512];
+    if (!build_resource_endpoint(endpoint, sizeof(endpoint), "/containers/", container_id, "/rename")) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    size_t len = strlen(endpoint);
+    if (!query_append(endpoint, sizeof(endpoint), &len, "name", new_name)) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char *response = NULL;
+    docker_excess_error_t err = make_request(client, "POST", endpoint, NULL, &response, NULL);
+    safe_free(response);
+    
+    /* The old name is free now, and a cached new name belonged to some earlier container */
+    if (err == DOCKER_EXCESS_OK) {
+        resolve_cache_invalidate(&client->resolver, container_id);
+        resolve_cache_invalidate(&client->resolver, new_name);
+    }
+    return err;
+}
+
+typedef struct {
+    docker_excess_t *client;
+    docker_excess_bulk_op_t op;
+    lifecycle_args_t args;
+    const char **ids;
+    int64_t deadline;               /* monotonic_ms(), 0 = none */
+    async_batch_t run;
+} bulk_batch_t;
+
+static void bulk_batch_done(async_request_t *req, docker_excess_error_t err, int http_code) {
+    bulk_batch_t *batch = req->done_data;
+    err = lifecycle_result(err, http_code);
+    if (err == DOCKER_EXCESS_OK && batch->op == DOCKER_EXCESS_OP_REMOVE) {
+        resolve_cache_invalidate(&batch->client->resolver, batch->ids[req->tag]);
+    }
+    async_batch_done(&batch->run, req->tag, err);
+}
+
+/* Past the deadline the rest time out without being sent */
+static docker_excess_error_t bulk_batch_submit(async_batch_t *run, size_t index) {
+    bulk_batch_t *batch = run->data;
+    long timeout_ms = lifecycle_timeout_ms(batch->client, batch->op, &batch->args);
+    if (batch->deadline) {
+        int64_t left = batch->deadline - monotonic_ms();
+        if (left <= 0) return DOCKER_EXCESS_ERR_TIMEOUT;
+        if (timeout_ms == 0 || left < timeout_ms) timeout_ms = (long)left;
+    }
+    
+    char endpoint[512];
+    const char *method;
+    if (!batch->ids[index] ||
+        !build_lifecycle_endpoint(endpoint, sizeof(endpoint), batch->op, batch->ids[index], &batch->args, &method)) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    async_request_t *req = async_request_new(batch->client, run->engine, method, endpoint, NULL);
+    if (!req) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    req->timeout_ms = timeout_ms;
+    req->done = bulk_batch_done;
+    req->done_data = batch;
+    req->tag = index;
+    async_request_enqueue(run->engine, req);
+    return DOCKER_EXCESS_OK;
+}
+
+docker_excess_error_t docker_excess_bulk_op(docker_excess_t *client, docker_excess_bulk_op_t op,
+                                           const char **container_ids, size_t count,
+                                           const docker_excess_bulk_options_t *options,
+                                           docker_excess_error_t *errors) {
+    if (!client || (!container_ids && count > 0) || !errors || (unsigned)op > DOCKER_EXCESS_OP_UNPAUSE) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    if (count == 0) return DOCKER_EXCESS_OK;
+    
+    async_engine_t *engine = async_engine_get(client);
+    if (!engine) return DOCKER_EXCESS_ERR_INTERNAL;
+    
+    bulk_batch_t batch = {
+        .client = client,
+        .op = op,
+        .args = {
+            .timeout_s = options && options->timeout_s > 0 ? options->timeout_s : -1,
+            .signal = options ? options->signal : NULL,
+            .force = options && options->force,
+            .remove_volumes = options && options->remove_volumes,
+        },
+        .ids = container_ids,
+        .deadline = options && options->deadline_ms > 0 ? monotonic_ms() + options->deadline_ms : 0,
+    };
+    batch.run = (async_batch_t){
+        .engine = engine,
+        .count = count,
+        .max_parallel = options && options->max_parallel > 0 ? options->max_parallel :
+                        DOCKER_EXCESS_DEFAULT_BULK_PARALLEL,
+        .submit = bulk_batch_submit,
+        .data = &batch,
+        .errors = errors,
+    };
+    
+    return async_batch_run(client, &batch.run);
+}
+
+/* ----------------- Container Create Templates ----------------- */
+
+/*
+ * A template is the create body serialized once, with Env and Labels held
+ * back as pre-escaped entries. Rendering an instance is memcpy of the
+ * base plus escaping only the per-instance values, into a buffer sized
+ * up front; an instance value replaces the template entry with the same
+ * key instead of duplicating it.
+ */
+
+typedef struct {
+    char *key;                      /* Env name / label key, for overrides */
+    char *json;                     /* "\"NAME=value\"" or "\"key\":\"value\"" */
+    size_t json_len;
+} template_entry_t;
+
+struct docker_excess_create_template {
+    char *head;                     /* Body without Env, Labels and the closing brace */
+    size_t head_len;
+    template_entry_t *env;
+    size_t env_count;
+    template_entry_t *labels;
+    size_t labels_count;
+    size_t body_size;               /* Rendered size without instance values */
+};
+
+static bool buffer_append(response_buffer_t *buffer, const char *data, size_t len) {
+    return write_response_callback((void*)data, 1, len, buffer) == len;
+}
+
+/* Append the JSON string escape of data, without quotes */
+static bool buffer_append_escaped(response_buffer_t *buffer, const char *data, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    size_t start = 0;
+    
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)data[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        
+        if (!buffer_append(buffer, data + start, i - start)) return false;
+        char esc[6] = { '\\', (char)c, 0 };
+        size_t esc_len = 2;
+        if (c == '\n') esc[1] = 'n';
+        else if (c == '\r') esc[1] = 'r';
+        else if (c == '\t') esc[1] = 't';
+        else if (c < 0x20) {
+            memcpy(esc, "\\u00", 4);
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 0x0F];
+            esc_len = 6;
+        }
+        if (!buffer_append(buffer, esc, esc_len)) return false;
+        start = i + 1;
+    }
+    return buffer_append(buffer, data + start, len - start);
+}
+
+/* "\"NAME=value\"" for Env, "\"key\":\"value\"" for Labels */
+static bool append_template_entry(response_buffer_t *buffer, const char *key, size_t key_len,
+                                  const char *value, bool is_label) {
+    const char *sep = is_label ? "\":\"" : "=";
+    return buffer_append(buffer, "\"", 1) &&
+           buffer_append_escaped(buffer, key, key_len) &&
+           buffer_append(buffer, sep, strlen(sep)) &&
+           buffer_append_escaped(buffer, value ? value : "", value ? strlen(value) : 0) &&
+           buffer_append(buffer, "\"", 1);
+}
+
+static bool template_entry_init(template_entry_t *entry, const char *key, size_t key_len,
+                                const char *value, bool is_label) {
+    response_buffer_t json = {0};
+    entry->key = strndup(key, key_len);
+    if (!entry->key || !append_template_entry(&json, key, key_len, value, is_label)) {
+        safe_free(entry->key);
+        safe_free(json.data);
+        return false;
+    }
+    entry->json = json.data;
+    entry->json_len = json.size;
+    return true;
+}
+
+static json_object* json_string_array(char **items, size_t count) {
+    json_object *array = json_object_new_array();
+    for (size_t i = 0; array && i < count; i++) {
+        json_object_array_add(array, json_object_new_string(items[i] ? items[i] : ""));
+    }
+    return array;
+}
+
+static int64_t seconds_to_ns(int seconds) {
+    return (int64_t)seconds * 1000000000;
+}
+
+/* Every create field except Name (a query parameter) and Env/Labels (template entries) */
+static json_object* container_create_body(const docker_excess_container_create_t *params) {
+    json_object *obj = json_object_new_object();
+    json_object *host = json_object_new_object();
+    if (!obj || !host) {
+        json_object_put(obj);
+        json_object_put(host);
+        return NULL;
+    }
+    
+    json_object_object_add(obj, "Image", json_object_new_string(params->image));
+    if (params->cmd_count > 0) {
+        json_object_object_add(obj, "Cmd", json_string_array(params->cmd, params->cmd_count));
+    }
+    if (params->entrypoint_count > 0) {
+        json_object_object_add(obj, "Entrypoint", json_string_array(params->entrypoint, params->entrypoint_count));
+    }
+    if (params->working_dir) json_object_object_add(obj, "WorkingDir", json_object_new_string(params->working_dir));
+    if (params->user) json_object_object_add(obj, "User", json_object_new_string(params->user));
+    if (params->hostname) json_object_object_add(obj, "Hostname", json_object_new_string(params->hostname));
+    if (params->domain_name) json_object_object_add(obj, "Domainname", json_object_new_string(params->domain_name));
+    json_object_object_add(obj, "Tty", json_object_new_boolean(params->tty));
+    json_object_object_add(obj, "OpenStdin", json_object_new_boolean(params->interactive));
+    json_object_object_add(obj, "AttachStdout", json_object_new_boolean(!params->detach));
+    json_object_object_add(obj, "AttachStderr", json_object_new_boolean(!params->detach));
+    
+    if (params->ports_count > 0) {
+        json_object *exposed = json_object_new_object();
+        json_object *bindings = json_object_new_object();
+        for (size_t i = 0; i < params->ports_count; i++) {
+            const docker_excess_port_mapping_t *port = &params->ports[i];
+            char key[32];
+            snprintf(key, sizeof(key), "%u/%s", port->container_port, port->protocol ? port->protocol : "tcp");
+            json_object_object_add(exposed, key, json_object_new_object());
+            if (port->host_port == 0) continue;
+            
+            json_object *list = get_json_object(bindings, key);
+            if (!list) {
+                list = json_object_new_array();
+                json_object_object_add(bindings, key, list);
+            }
+            char host_port[8];
+            snprintf(host_port, sizeof(host_port), "%u", port->host_port);
+            json_object *binding = json_object_new_object();
+            json_object_object_add(binding, "HostIp", json_object_new_string(port->host_ip ? port->host_ip : ""));
+            json_object_object_add(binding, "HostPort", json_object_new_string(host_port));
+            json_object_array_add(list, binding);
+        }
+        json_object_object_add(obj, "ExposedPorts", exposed);
+        json_object_object_add(host, "PortBindings", bindings);
+    }
+    
+    if (params->mounts_count > 0) {
+        json_object *mounts = json_object_new_array();
+        for (size_t i = 0; i < params->mounts_count; i++) {
+            const docker_excess_mount_t *mount = &params->mounts[i];
+            json_object *m = json_object_new_object();
+            json_object_object_add(m, "Type", json_object_new_string(mount->type ? mount->type : "bind"));
+            json_object_object_add(m, "Source", json_object_new_string(mount->source ? mount->source : ""));
+            json_object_object_add(m, "Target", json_object_new_string(mount->target ? mount->target : ""));
+            json_object_object_add(m, "ReadOnly", json_object_new_boolean(mount->read_only));
+            json_object_array_add(mounts, m);
+        }
+        json_object_object_add(host, "Mounts", mounts);
+    }
+    if (params->volumes_from_count > 0) {
+        json_object_object_add(host, "VolumesFrom", json_string_array(params->volumes_from, params->volumes_from_count));
+    }
+    
+    if (params->memory_limit > 0) json_object_object_add(host, "Memory", json_object_new_int64(params->memory_limit));
+    if (params->memory_swap != 0) json_object_object_add(host, "MemorySwap", json_object_new_int64(params->memory_swap));
+    if (params->cpu_shares > 0) json_object_object_add(host, "CpuShares", json_object_new_int64((int64_t)params->cpu_shares));
+    if (params->cpu_set) json_object_object_add(host, "CpusetCpus", json_object_new_string(params->cpu_set));
+    json_object_object_add(host, "Privileged", json_object_new_boolean(params->privileged));
+    if (params->cap_add_count > 0) {
+        json_object_object_add(host, "CapAdd", json_string_array(params->cap_add, params->cap_add_count));
+    }
+    if (params->cap_drop_count > 0) {
+        json_object_object_add(host, "CapDrop", json_string_array(params->cap_drop, params->cap_drop_count));
+    }
+    json_object_object_add(host, "AutoRemove", json_object_new_boolean(params->auto_remove));
+    if (params->restart_policy) {
+        json_object *policy = json_object_new_object();
+        json_object_object_add(policy, "Name", json_object_new_string(params->restart_policy));
+        json_object_object_add(policy, "MaximumRetryCount", json_object_new_int64(params->restart_max_retries));
+        json_object_object_add(host, "RestartPolicy", policy);
+    }
+    
+    /* API 1.41 attaches a single network at create time */
+    if (params->networks_count > 0 && params->networks[0]) {
+        json_object_object_add(host, "NetworkMode", json_object_new_string(params->networks[0]));
+        json_object *endpoints = json_object_new_object();
+        json_object_object_add(endpoints, params->networks[0], json_object_new_object());
+        json_object *networking = json_object_new_object();
+        json_object_object_add(networking, "EndpointsConfig", endpoints);
+        json_object_object_add(obj, "NetworkingConfig", networking);
+    }
+    json_object_object_add(obj, "HostConfig", host);
+    
+    if (params->health_cmd_count > 0) {
+        json_object *health = json_object_new_object();
+        json_object *test = json_object_new_array();
+        const char *first = params->health_cmd[0] ? params->health_cmd[0] : "";
+        if (strcmp(first, "CMD") != 0 && strcmp(first, "CMD-SHELL") != 0 && strcmp(first, "NONE") != 0) {
+            json_object_array_add(test, json_object_new_string("CMD"));
+        }
+        for (size_t i = 0; i < params->health_cmd_count; i++) {
+            json_object_array_add(test, json_object_new_string(params->health_cmd[i] ? params->health_cmd[i] : ""));
+        }
+        json_object_object_add(health, "Test", test);
+        if (params->health_interval_s > 0) {
+            json_object_object_add(health, "Interval", json_object_new_int64(seconds_to_ns(params->health_interval_s)));
+        }
+        if (params->health_timeout_s > 0) {
+            json_object_object_add(health, "Timeout", json_object_new_int64(seconds_to_ns(params->health_timeout_s)));
+        }
+        if (params->health_retries > 0) {
+            json_object_object_add(health, "Retries", json_object_new_int64(params->health_retries));
+        }
+        if (params->health_start_period_s > 0) {
+            json_object_object_add(health, "StartPeriod",
+                                   json_object_new_int64(seconds_to_ns(params->health_start_period_s)));
+        }
+        json_object_object_add(obj, "Healthcheck", health);
+    }
+    
+    return obj;
+}
+
+docker_excess_error_t docker_excess_create_template_compile(const docker_excess_container_create_t *params,
+                                                           docker_excess_create_template_t **template_out) {
+    if (!params || !params->image || !template_out) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    docker_excess_create_template_t *tmpl = calloc(1, sizeof(docker_excess_create_template_t));
+    if (!tmpl) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    json_object *body = container_create_body(params);
+    const char *text = body ? json_object_to_json_string_ext(body, JSON_C_TO_STRING_PLAIN) : NULL;
+    size_t text_len = text ? strlen(text) : 0;
+    if (text_len >= 2) tmpl->head = strndup(text, text_len - 1);     /* Drop the closing brace */
+    json_object_put(body);
+    
+    tmpl->head_len = tmpl->head ? text_len - 1 : 0;
+    tmpl->env = params->env_count ? calloc(params->env_count, sizeof(template_entry_t)) : NULL;
+    tmpl->labels = params->labels_count ? calloc(params->labels_count, sizeof(template_entry_t)) : NULL;
+    bool ok = tmpl->head && (!params->env_count || tmpl->env) && (!params->labels_count || tmpl->labels);
+    
+    for (size_t i = 0; ok && i < params->env_count; i++) {
+        const docker_excess_env_var_t *var = &params->env[i];
+        if (!var->name) continue;
+        ok = template_entry_init(&tmpl->env[tmpl->env_count], var->name, strlen(var->name), var->value, false);
+        if (ok) tmpl->body_size += tmpl->env[tmpl->env_count++].json_len + 1;
+    }
+    for (size_t i = 0; ok && i < params->labels_count; i++) {
+        const char *eq = params->labels[i] ? strchr(params->labels[i], '=') : NULL;
+        if (!eq) continue;
+        template_entry_t *entry = &tmpl->labels[tmpl->labels_count];
+        ok = template_entry_init(entry, params->labels[i], (size_t)(eq - params->labels[i]), eq + 1, true);
+        if (ok) tmpl->body_size += tmpl->labels[tmpl->labels_count++].json_len + 1;
+    }
+    
+    if (!ok) {
+        docker_excess_create_template_free(tmpl);
+        return DOCKER_EXCESS_ERR_MEMORY;
+    }
+    
+    tmpl->body_size += tmpl->head_len + sizeof(",\"Env\":[],\"Labels\":{}}");
+    *template_out = tmpl;
+    return DOCKER_EXCESS_OK;
+}
+
+void docker_excess_create_template_free(docker_excess_create_template_t *tmpl) {
+    if (!tmpl) return;
+    
+    for (size_t i = 0; i < tmpl->env_count; i++) {
+        free(tmpl->env[i].key);
+        free(tmpl->env[i].json);
+    }
+    for (size_t i = 0; i < tmpl->labels_count; i++) {
+        free(tmpl->labels[i].key);
+        free(tmpl->labels[i].json);
+    }
+    free(tmpl->env);
+    free(tmpl->labels);
+    free(tmpl->head);
+    free(tmpl);
+}
+
+static bool instance_env_overrides(const docker_excess_create_instance_t *instance, const char *key) {
+    for (size_t i = 0; i < instance->env_count; i++) {
+        if (instance->env[i].name && strcmp(instance->env[i].name, key) == 0) return true;
+    }
+    return false;
+}
+
+static bool instance_label_overrides(const docker_excess_create_instance_t *instance, const char *key) {
+    size_t key_len = strlen(key);
+    for (size_t i = 0; i < instance->labels_count; i++) {
+        const char *label = instance->labels[i];
+        if (label && strncmp(label, key, key_len) == 0 && label[key_len] == '=') return true;
+    }
+    return false;
+}
+
+/* Render the body of one instance; the one allocation is sized before anything is written */
+static char* template_render(const docker_excess_create_template_t *tmpl,
+                             const docker_excess_create_instance_t *instance) {
+    static const docker_excess_create_instance_t no_instance = {0};
+    if (!instance) instance = &no_instance;
+    
+    size_t estimate = tmpl->body_size;
+    for (size_t i = 0; i < instance->env_count; i++) {
+        const docker_excess_env_var_t *var = &instance->env[i];
+        estimate += (var->name ? strlen(var->name) : 0) + (var->value ? strlen(var->value) : 0) + 4;
+    }
+    for (size_t i = 0; i < instance->labels_count; i++) {
+        estimate += (instance->labels[i] ? strlen(instance->labels[i]) : 0) + 6;
+    }
+    
+    response_buffer_t body = { .data = malloc(estimate + 1), .capacity = estimate + 1 };
+    if (!body.data) return NULL;
+    
+    bool ok = buffer_append(&body, tmpl->head, tmpl->head_len) && buffer_append(&body, ",\"Env\":[", 8);
+    bool first = true;
+    for (size_t i = 0; ok && i < tmpl->env_count; i++) {
+        if (instance_env_overrides(instance, tmpl->env[i].key)) continue;
+        ok = (first || buffer_append(&body, ",", 1)) && buffer_append(&body, tmpl->env[i].json, tmpl->env[i].json_len);
+        first = false;
+    }
+    for (size_t i = 0; ok && i < instance->env_count; i++) {
+        const docker_excess_env_var_t *var = &instance->env[i];
+        if (!var->name) continue;
+        ok = (first || buffer_append(&body, ",", 1)) &&
+             append_template_entry(&body, var->name, strlen(var->name), var->value, false);
+        first = false;
+    }
+    
+    ok = ok && buffer_append(&body, "],\"Labels\":{", 12);
+    first = true;
+    for (size_t i = 0; ok && i < tmpl->labels_count; i++) {
+        if (instance_label_overrides(instance, tmpl->labels[i].key)) continue;
+        ok = (first || buffer_append(&body, ",", 1)) &&
+             buffer_append(&body, tmpl->labels[i].json, tmpl->labels[i].json_len);
+        first = false;
+    }
+    for (size_t i = 0; ok && i < instance->labels_count; i++) {
+        const char *eq = instance->labels[i] ? strchr(instance->labels[i], '=') : NULL;
+        if (!eq) continue;
+        ok = (first || buffer_append(&body, ",", 1)) &&
+             append_template_entry(&body, instance->labels[i], (size_t)(eq - instance->labels[i]), eq + 1, true);
+        first = false;
+    }
+    
+    ok = ok && buffer_append(&body, "}}", 2);
+    if (!ok) {
+        free(body.data);
+        return NULL;
+    }
+    return body.data;
+}
+
+static bool build_create_endpoint(char *endpoint, size_t size, const docker_excess_create_instance_t *instance) {
+    size_t len = (size_t)snprintf(endpoint, size, "/containers/create");
+    if (!instance || !instance->name) return true;
+    return query_append(endpoint, size, &len, "name", instance->name);
+}
+
+docker_excess_error_t docker_excess_create_from_template(docker_excess_t *client,
+                                                        const docker_excess_create_template_t *tmpl,
+                                                        const docker_excess_create_instance_t *instance,
+                                                        char **container_id) {
+    if (!client || !tmpl || !container_id) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    *container_id = NULL;
+    
+    char endpoint[512];
+    if (!build_create_endpoint(endpoint, sizeof(endpoint), instance)) {
+        set_error(client, "Container name too long");
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    char *body = template_render(tmpl, instance);
+    if (!body) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    json_object *json = NULL;
+    docker_excess_error_t err = make_request_json(client, "POST", endpoint, body, &json, NULL);
+    free(body);
+    if (err != DOCKER_EXCESS_OK) return err;
+    
+    const char *id = get_json_string(json, "Id");
+    *container_id = safe_strdup(id);
+    json_object_put(json);
+    
+    if (!*container_id) {
+        set_error(client, "Create response has no container Id");
+        return id ? DOCKER_EXCESS_ERR_MEMORY : DOCKER_EXCESS_ERR_JSON;
+    }
+    return DOCKER_EXCESS_OK;
+}
+
+/* One-off create: a template compiled for this call alone */
+docker_excess_error_t docker_excess_create_container(docker_excess_t *client,
+                                                    const docker_excess_container_create_t *params,
+                                                    char **container_id) {
+    if (!client || !params || !params->image || !container_id) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    *container_id = NULL;
+    
+    docker_excess_create_template_t *tmpl = NULL;
+    docker_excess_error_t err = docker_excess_create_template_compile(params, &tmpl);
+    if (err != DOCKER_EXCESS_OK) {
+        set_error(client, "Failed to serialize create parameters");
+        return err;
+    }
+    
+    docker_excess_create_instance_t instance = { .name = params->name };
+    err = docker_excess_create_from_template(client, tmpl, &instance, container_id);
+    docker_excess_create_template_free(tmpl);
+    return err;
+}
+
+/* Shared state of one docker_excess_create_start_containers() call */
+typedef struct {
+    docker_excess_t *client;
+    const docker_excess_create_template_t *tmpl;
+    const docker_excess_create_instance_t *instances;
+    int64_t deadline;               /* monotonic_ms(), 0 = none */
+    char **ids;
+    async_batch_t run;              /* An item runs from its create until its start completes */
+} create_batch_t;
+
+/* Request timeout left before the deadline; false once it has passed */
+static bool create_batch_timeout(const create_batch_t *batch, long *timeout_ms) {
+    *timeout_ms = 0;
+    if (!batch->deadline) return true;
+    
+    int64_t left = batch->deadline - monotonic_ms();
+    if (left <= 0) return false;
+    *timeout_ms = (long)left;
+    return true;
+}
+
+static void create_batch_started(async_request_t *req, docker_excess_error_t err, int http_code) {
+    create_batch_t *batch = req->done_data;
+    async_batch_done(&batch->run, req->tag, lifecycle_result(err, http_code));
+}
+
+/* Created: pipeline the start right away instead of waiting for the rest of the batch */
+static void create_batch_created(async_request_t *req, docker_excess_error_t err, int http_code) {
+    (void)http_code;
+    create_batch_t *batch = req->done_data;
+    size_t index = req->tag;
+    
+    if (err == DOCKER_EXCESS_OK) {
+        json_object *json = json_sink_finish(&req->json);
+        const char *id = json ? get_json_string(json, "Id") : NULL;
+        batch->ids[index] = safe_strdup(id);
+        json_object_put(json);
+        if (!batch->ids[index]) err = id ? DOCKER_EXCESS_ERR_MEMORY : DOCKER_EXCESS_ERR_JSON;
+    }
+    
+    long timeout_ms = 0;
+    if (err == DOCKER_EXCESS_OK && !create_batch_timeout(batch, &timeout_ms)) err = DOCKER_EXCESS_ERR_TIMEOUT;
+    
+    char endpoint[512];
+    const char *method;
+    lifecycle_args_t args = { .timeout_s = -1 };
+    if (err == DOCKER_EXCESS_OK) {
+        err = DOCKER_EXCESS_ERR_MEMORY;
+        if (build_lifecycle_endpoint(endpoint, sizeof(endpoint), DOCKER_EXCESS_OP_START, batch->ids[index],
+                                     &args, &method)) {
+            async_request_t *start = async_request_new(batch->client, batch->run.engine, method, endpoint, NULL);
+            if (start) {
+                start->timeout_ms = timeout_ms;
+                start->done = create_batch_started;
+                start->done_data = batch;
+                start->tag = index;
+                async_request_enqueue(batch->run.engine, start);
+                return;
+            }
+        }
+    }
+    
+    async_batch_done(&batch->run, index, err);
+}
+
+static docker_excess_error_t create_batch_submit(async_batch_t *run, size_t index) {
+    create_batch_t *batch = run->data;
+    const docker_excess_create_instance_t *instance = batch->instances ? &batch->instances[index] : NULL;
+    long timeout_ms = 0;
+    char endpoint[512];
+    
+    if (!create_batch_timeout(batch, &timeout_ms)) return DOCKER_EXCESS_ERR_TIMEOUT;
+    if (!build_create_endpoint(endpoint, sizeof(endpoint), instance)) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char *body = template_render(batch->tmpl, instance);
+    async_request_t *req = body ? async_request_new(batch->client, run->engine, "POST", endpoint, NULL) : NULL;
+    if (req && !async_request_parse_json(req)) {
+        async_request_free(run->engine, req);
+        req = NULL;
+    }
+    if (!req) {
+        free(body);
+        return DOCKER_EXCESS_ERR_MEMORY;
+    }
+    
+    req->body = body;               /* Rendered once, owned by the request */
+    req->timeout_ms = timeout_ms;
+    req->done = create_batch_created;
+    req->done_data = batch;
+    req->tag = index;
+    async_request_enqueue(run->engine, req);
+    return DOCKER_EXCESS_OK;
+}
+
+docker_excess_error_t docker_excess_create_start_containers(docker_excess_t *client,
+                                                           const docker_excess_create_template_t *tmpl,
+                                                           const docker_excess_create_instance_t *instances,
+                                                           size_t count, const docker_excess_bulk_options_t *options,
+                                                           char **container_ids, docker_excess_error_t *errors) {
+    if (!client || !tmpl || !container_ids || !errors) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    memset(container_ids, 0, count * sizeof(char*));
+    if (count == 0) return DOCKER_EXCESS_OK;
+    
+    async_engine_t *engine = async_engine_get(client);
+    if (!engine) return DOCKER_EXCESS_ERR_INTERNAL;
+    
+    create_batch_t batch = {
+        .client = client,
+        .tmpl = tmpl,
+        .instances = instances,
+        .deadline = options && options->deadline_ms > 0 ? monotonic_ms() + options->deadline_ms : 0,
+        .ids = container_ids,
+    };
+    batch.run = (async_batch_t){
+        .engine = engine,
+        .count = count,
+        .max_parallel = options && options->max_parallel > 0 ? options->max_parallel :
+                        DOCKER_EXCESS_DEFAULT_BULK_PARALLEL,
+        .submit = create_batch_submit,
+        .data = &batch,
+        .errors = errors,
+    };
+    
+    return async_batch_run(client, &batch.run);
+}
+
+/* ----------------- Container State Cache ----------------- */
+
+/*
+ * Readers never lock: they pin the current snapshot by bumping its
+ * refcount while the cache's reader counter is held. A writer publishes a
+ * new snapshot with one atomic exchange, waits for that counter to drain
+ * (a reader can only be between the load and the bump for a few
+ * instructions) and then drops its own reference to the old one.
+ *
+ * Snapshots are sorted arrays of refcounted records, so an update copies
+ * pointers, not containers. Updates come from the /events stream: every
+ * relevant container event schedules a filtered list of that one
+ * container, with at most one refresh in flight per id.
+ */
+
+typedef struct {
+    atomic_uint refs;
+    docker_excess_container_t container;
+} cache_record_t;
+
+struct docker_excess_cache_snapshot {
+    atomic_uint refs;
+    uint64_t version;
+    size_t count;
+    cache_record_t *records[];      /* Sorted by container id */
+};
+
+typedef struct cache_refresh {
+    struct cache_refresh *next;
+    bool dirty;                     /* Another event arrived while in flight */
+    char id[];
+} cache_refresh_t;
+
+struct docker_excess_cache {
+    docker_excess_t *client;
+    async_engine_t *engine;
+    _Atomic(docker_excess_cache_snapshot_t *) current;
+    atomic_uint readers;
+    atomic_bool stopping;
+    pthread_mutex_t write_mutex;    /* Serializes snapshot publishers */
+    pthread_mutex_t mutex;          /* Protects refreshes */
+    cache_refresh_t *refreshes;
+    pthread_mutex_t events_mutex;   /* Protects events_req; never taken inside curl callbacks */
+    async_request_t *events_req;
+    json_stream_t events;
+    atomic_bool live;
+};
+
+static void cache_record_release(cache_record_t *record) {
+    if (record && atomic_fetch_sub(&record->refs, 1) == 1) {
+        container_clear(&record->container);
+        free(record);
+    }
+}
+
+static docker_excess_cache_snapshot_t* cache_snapshot_new(size_t capacity) {
+    docker_excess_cache_snapshot_t *snapshot =
+        calloc(1, sizeof(docker_excess_cache_snapshot_t) + capacity * sizeof(cache_record_t*));
+    if (snapshot) atomic_init(&snapshot->refs, 1);
+    return snapshot;
+}
+
+static void cache_snapshot_release(docker_excess_cache_snapshot_t *snapshot) {
+    if (snapshot && atomic_fetch_sub(&snapshot->refs, 1) == 1) {
+        for (size_t i = 0; i < snapshot->count; i++) {
+            cache_record_release(snapshot->records[i]);
+        }
+        free(snapshot);
+    }
+}
+
+static int cache_record_compare(const void *a, const void *b) {
+    const cache_record_t *ra = *(cache_record_t *const *)a;
+    const cache_record_t *rb = *(cache_record_t *const *)b;
+    return strcmp(ra->container.id, rb->container.id);
+}
+
+/* Index of the first record whose id is >= key */
+static size_t cache_lower_bound(const docker_excess_cache_snapshot_t *snapshot, const char *key) {
+    size_t lo = 0, hi = snapshot->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(snapshot->records[mid]->container.id, key) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static cache_record_t* cache_record_from_json(json_object *obj) {
+    cache_record_t *record = calloc(1, sizeof(cache_record_t));
+    if (!record) return NULL;
+    
+    atomic_init(&record->refs, 1);
+    parse_container_summary(obj, &record->container, NULL, &full_projection);
+    if (!record->container.id) {
+        cache_record_release(record);
+        return NULL;
+    }
+    return record;
+}
+
+/* Caller holds write_mutex; consumes the reference of `snapshot` */
+static void cache_publish(docker_excess_cache_t *cache, docker_excess_cache_snapshot_t *snapshot) {
+    docker_excess_cache_snapshot_t *old = atomic_exchange(&cache->current, snapshot);
+    while (atomic_load(&cache->readers) > 0) {
+        sched_yield();
+    }
+    cache_snapshot_release(old);
+}
+
+/* Replace, insert or (record == NULL) remove the container with this id */
+static void cache_apply(docker_excess_cache_t *cache, const char *id, cache_record_t *record) {
+    pthread_mutex_lock(&cache->write_mutex);
+    
+    docker_excess_cache_snapshot_t *old = atomic_load(&cache->current);
+    size_t pos = cache_lower_bound(old, id);
+    bool exists = pos < old->count && strcmp(old->records[pos]->container.id, id) == 0;
+    
+    if (!exists && !record) {
+        pthread_mutex_unlock(&cache->write_mutex);
+        return;
+    }
+    
+    size_t count = old->count + (exists ? 0 : 1) - (record ? 0 : 1);
+    docker_excess_cache_snapshot_t *snapshot = cache_snapshot_new(count);
+    if (!snapshot) {
+        pthread_mutex_unlock(&cache->write_mutex);
+        cache_record_release(record);
+        return;
+    }
+    
+    size_t out = 0;
+    for (size_t i = 0; i < pos; i++) {
+        atomic_fetch_add(&old->records[i]->refs, 1);
+        snapshot->records[out++] = old->records[i];
+    }
+    if (record) snapshot->records[out++] = record;
+    for (size_t i = exists ? pos + 1 : pos; i < old->count; i++) {
+        atomic_fetch_add(&old->records[i]->refs, 1);
+        snapshot->records[out++] = old->records[i];
+    }
+    snapshot->count = out;
+    snapshot->version = old->version + 1;
+    
+    cache_publish(cache, snapshot);
+    pthread_mutex_unlock(&cache->write_mutex);
+}
+
+static void cache_submit_refresh(docker_excess_cache_t *cache, cache_refresh_t *refresh);
+
+static void cache_refresh_done(async_request_t *req, docker_excess_error_t err, int http_code) {
+    (void)http_code;
+    docker_excess_cache_t *cache = req->done_data;
+    cache_refresh_t *refresh = (cache_refresh_t *)req->tag;
+    
+    if (err == DOCKER_EXCESS_OK) {
+        json_object *json = json_sink_finish(&req->json);
+        cache_record_t *record = NULL;
+        bool parsed = json && json_object_get_type(json) == json_type_array;
+        
+        /* The id filter matches prefixes, so pick the exact entry */
+        size_t len = parsed ? json_object_array_length(json) : 0;
+        for (size_t i = 0; i < len && !record; i++) {
+            json_object *obj = json_object_array_get_idx(json, i);
+            const char *id = get_json_string(obj, "Id");
+            if (id && strcmp(id, refresh->id) == 0) record = cache_record_from_json(obj);
+        }
+        if (json) json_object_put(json);
+        
+        /* An empty result means the container is gone */
+        if (parsed) cache_apply(cache, refresh->id, record);
+    }
+    
+    pthread_mutex_lock(&cache->mutex);
+    bool again = refresh->dirty && !atomic_load(&cache->stopping);
+    refresh->dirty = false;
+    if (!again) {
+        for (cache_refresh_t **link = &cache->refreshes; *link; link = &(*link)->next) {
+            if (*link == refresh) {
+                *link = refresh->next;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    
+    if (again) cache_submit_refresh(cache, refresh);
+    else free(refresh);
+}
+
+static void cache_submit_refresh(docker_excess_cache_t *cache, cache_refresh_t *refresh) {
+    char filters[160];
+    char endpoint[512];
+    async_request_t *req = NULL;
+    
+    snprintf(filters, sizeof(filters), "{\"id\":[\"%s\"]}", refresh->id);
+    if (build_resource_endpoint(endpoint, sizeof(endpoint), "/containers/json?all=true&filters=", filters, NULL)) {
+        req = async_request_new(cache->client, cache->engine, "GET", endpoint, NULL);
+    }
+    if (req && !async_request_parse_json(req)) {
+        async_request_free(cache->engine, req);
+        req = NULL;
+    }
+    
+    if (!req) {
+        pthread_mutex_lock(&cache->mutex);
+        for (cache_refresh_t **link = &cache->refreshes; *link; link = &(*link)->next) {
+            if (*link == refresh) {
+                *link = refresh->next;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&cache->mutex);
+        free(refresh);
+        return;
+    }
+    
+    req->done = cache_refresh_done;
+    req->done_data = cache;
+    req->tag = (size_t)refresh;
+    async_request_enqueue(cache->engine, req);
+}
+
+static void cache_request_refresh(docker_excess_cache_t *cache, const char *id) {
+    if (atomic_load(&cache->stopping)) return;
+    
+    pthread_mutex_lock(&cache->mutex);
+    for (cache_refresh_t *refresh = cache->refreshes; refresh; refresh = refresh->next) {
+        if (strcmp(refresh->id, id) == 0) {
+            refresh->dirty = true;
+            pthread_mutex_unlock(&cache->mutex);
+            return;
+        }
+    }
+    
+    size_t id_len = strlen(id);
+    cache_refresh_t *refresh = calloc(1, sizeof(cache_refresh_t) + id_len + 1);
+    if (refresh) {
+        memcpy(refresh->id, id, id_len + 1);
+        refresh->next = cache->refreshes;
+        cache->refreshes = refresh;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    
+    if (refresh) cache_submit_refresh(cache, refresh);
+}
+
+/* Events that do not change anything docker_excess_container_t holds */
+static bool cache_event_ignored(const char *action) {
+    static const char *const ignored[] = {
+        "attach", "detach", "resize", "top", "copy", "archive-path", "extract-to-dir", "export", "commit"
+    };
+    
+    if (strncmp(action, "exec_", 5) == 0) return true;
+    for (size_t i = 0; i < sizeof(ignored) / sizeof(ignored[0]); i++) {
+        if (strcmp(action, ignored[i]) == 0) return true;
+    }
+    return false;
+}
+
+static bool cache_on_event(json_object *event, void *ctx) {
+    docker_excess_cache_t *cache = ctx;
+    
+    const char *type = get_json_string(event, "Type");
+    const char *action = get_json_string(event, "Action");
+    const char *id = get_json_string(get_json_object(event, "Actor"), "ID");
+    if (!type || !action || !id) return true;
+    
+    /* Names that may now point elsewhere, or nowhere */
+    if (strcmp(action, "rename") == 0 || strcmp(action, "destroy") == 0 || strcmp(action, "untag") == 0 ||
+        strcmp(action, "delete") == 0 || strcmp(action, "tag") == 0) {
+        resolve_cache_invalidate(&cache->client->resolver, id);
+        resolve_cache_invalidate(&cache->client->resolver,
+                                 get_json_string(get_json_object(get_json_object(event, "Actor"), "Attributes"), "name"));
+    }
+    if (strcmp(type, "container") != 0) return !atomic_load(&cache->stopping);
+    
+    if (strcmp(action, "destroy") == 0) {
+        cache_apply(cache, id, NULL);
+    } else if (!cache_event_ignored(action)) {
+        cache_request_refresh(cache, id);
+    }
+    return !atomic_load(&cache->stopping);
+}
+
+static void cache_events_done(async_request_t *req, docker_excess_error_t err, int http_code) {
+    (void)http_code;
+    docker_excess_cache_t *cache = req->done_data;
+    
+    if (err != DOCKER_EXCESS_OK && !atomic_load(&cache->stopping)) {
+        docker_excess_log(cache->client, DOCKER_EXCESS_LOG_WARN, "Container cache lost the events stream");
+    }
+    atomic_store(&cache->live, false);
+    
+    pthread_mutex_lock(&cache->events_mutex);
+    cache->events_req = NULL;
+    pthread_mutex_unlock(&cache->events_mutex);
+}
+
+static void cache_destroy(docker_excess_cache_t *cache) {
+    cache_snapshot_release(atomic_load(&cache->current));
+    json_stream_cleanup(&cache->events);
+    pthread_mutex_destroy(&cache->write_mutex);
+    pthread_mutex_destroy(&cache->mutex);
+    pthread_mutex_destroy(&cache->events_mutex);
+    free(cache);
+}
+
+docker_excess_error_t docker_excess_cache_start(docker_excess_t *client, docker_excess_cache_t **cache) {
+    if (!client || !cache) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    *cache = NULL;
+    
+    async_engine_t *engine = async_engine_get(client);
+    if (!engine) return DOCKER_EXCESS_ERR_INTERNAL;
+    
+    docker_excess_cache_t *c = calloc(1, sizeof(docker_excess_cache_t));
+    if (!c) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    c->client = client;
+    c->engine = engine;
+    pthread_mutex_init(&c->write_mutex, NULL);
+    pthread_mutex_init(&c->mutex, NULL);
+    pthread_mutex_init(&c->events_mutex, NULL);
+    if (!json_stream_init(&c->events, cache_on_event, c)) {
+        cache_destroy(c);
+        return DOCKER_EXCESS_ERR_MEMORY;
+    }
+    
+    /* Events are replayed from before the seed, so nothing falls in between */
+    time_t since = time(NULL) - 1;
+    
+    json_object *json = NULL;
+    docker_excess_error_t err = fetch_container_list(client, true, NULL, &json);
+    if (err != DOCKER_EXCESS_OK) {
+        cache_destroy(c);
+        return err;
+    }
+    
+    size_t len = json_object_array_length(json);
+    docker_excess_cache_snapshot_t *snapshot = cache_snapshot_new(len);
+    if (!snapshot) {
+        json_object_put(json);
+        cache_destroy(c);
+        return DOCKER_EXCESS_ERR_MEMORY;
+    }
+    for (size_t i = 0; i < len; i++) {
+        cache_record_t *record = cache_record_from_json(json_object_array_get_idx(json, i));
+        if (record) snapshot->records[snapshot->count++] = record;
+    }
+    json_object_put(json);
+    qsort(snapshot->records, snapshot->count, sizeof(cache_record_t*), cache_record_compare);
+    atomic_store(&c->current, snapshot);
+    
+    char prefix[64];
+    char endpoint[512];
+    snprintf(prefix, sizeof(prefix), "/events?since=%lld&filters=", (long long)since);
+    async_request_t *req = NULL;
+    if (build_resource_endpoint(endpoint, sizeof(endpoint), prefix,
+                                "{\"type\":[\"container\",\"image\",\"network\"]}", NULL)) {
+        req = async_request_new(client, engine, "GET", endpoint, NULL);
+    }
+    if (!req) {
+        cache_destroy(c);
+        return DOCKER_EXCESS_ERR_MEMORY;
+    }
+    
+    req->write_fn = write_json_stream_callback;
+    req->write_data = &c->events;
+    req->stopped = &c->events.stopped;
+    req->fail_on_error = true;
+    req->timeout_ms = -1;
+    req->done = cache_events_done;
+    req->done_data = c;
+    c->events_req = req;
+    atomic_store(&c->live, true);
+    async_request_enqueue(engine, req);
+    
+    *cache = c;
+    return DOCKER_EXCESS_OK;
+}
+
+void docker_excess_cache_stop(docker_excess_cache_t *cache) {
+    if (!cache) return;
+    
+    atomic_store(&cache->stopping, true);
+    
+    pthread_mutex_lock(&cache->events_mutex);
+    async_request_t *req = cache->events_req;
+    if (req && !async_engine_detach(cache->engine, req)) req = NULL;
+    pthread_mutex_unlock(&cache->events_mutex);
+    
+    if (req) {
+        req->done(req, DOCKER_EXCESS_OK, 0);
+        async_request_free(cache->engine, req);
+    }
+    
+    /* Let the events request and outstanding refreshes drain */
+    for (;;) {
+        pthread_mutex_lock(&cache->events_mutex);
+        bool events_running = cache->events_req != NULL;
+        pthread_mutex_unlock(&cache->events_mutex);
+        pthread_mutex_lock(&cache->mutex);
+        bool refreshing = cache->refreshes != NULL;
+        pthread_mutex_unlock(&cache->mutex);
+        
+        if (!events_running && !refreshing) break;
+        if (async_engine_run(cache->engine, 100) != DOCKER_EXCESS_OK) break;
+    }
+    
+    cache_destroy(cache);
+}
+
+bool docker_excess_cache_live(const docker_excess_cache_t *cache) {
+    return cache && atomic_load(&((docker_excess_cache_t *)cache)->live);
+}
+
+const docker_excess_cache_snapshot_t* docker_excess_cache_acquire(docker_excess_cache_t *cache) {
+    if (!cache) return NULL;
+    
+    atomic_fetch_add(&cache->readers, 1);
+    docker_excess_cache_snapshot_t *snapshot = atomic_load(&cache->current);
+    atomic_fetch_add(&snapshot->refs, 1);
+    atomic_fetch_sub(&cache->readers, 1);
+    return snapshot;
+}
+
+void docker_excess_cache_release(const docker_excess_cache_snapshot_t *snapshot) {
+    cache_snapshot_release((docker_excess_cache_snapshot_t *)snapshot);
+}
+
+uint64_t docker_excess_cache_version(const docker_excess_cache_snapshot_t *snapshot) {
+    return snapshot ? snapshot->version : 0;
+}
+
+size_t docker_excess_cache_count(const docker_excess_cache_snapshot_t *snapshot) {
+    return snapshot ? snapshot->count : 0;
+}
+
+const docker_excess_container_t* docker_excess_cache_at(const docker_excess_cache_snapshot_t *snapshot,
+                                                        size_t index) {
+    if (!snapshot || index >= snapshot->count) return NULL;
+    return &snapshot->records[index]->container;
+}
+
+const docker_excess_container_t* docker_excess_cache_find(const docker_excess_cache_snapshot_t *snapshot,
+                                                          const char *id_or_name) {
+    if (!snapshot || !id_or_name || !id_or_name[0]) return NULL;
+    
+    /* Unique id prefix first, like the docker CLI */
+    size_t key_len = strlen(id_or_name);
+    size_t pos = cache_lower_bound(snapshot, id_or_name);
+    if (pos < snapshot->count && strncmp(snapshot->records[pos]->container.id, id_or_name, key_len) == 0) {
+        bool ambiguous = pos + 1 < snapshot->count &&
+                         strncmp(snapshot->records[pos + 1]->container.id, id_or_name, key_len) == 0;
+        if (!ambiguous) return &snapshot->records[pos]->container;
+    }
+    
+    const char *name = id_or_name[0] == '/' ? id_or_name + 1 : id_or_name;
+    for (size_t i = 0; i < snapshot->count; i++) {
+        const docker_excess_container_t *container = &snapshot->records[i]->container;
+        if (container->name && strcmp(container->name, name) == 0) return container;
+    }
+    return NULL;
+}
+
+size_t docker_excess_cache_select(const docker_excess_cache_snapshot_t *snapshot, int state,
+                                  const char *label_key, const char *label_value,
+                                  const docker_excess_container_t **out, size_t max) {
+    if (!snapshot) return 0;
+    
+    size_t matched = 0;
+    for (size_t i = 0; i < snapshot->count; i++) {
+        const docker_excess_container_t *container = &snapshot->records[i]->container;
+        
+        if (state >= 0 && (int)container->state != state) continue;
+        if (label_key) {
+            const char *value = docker_excess_get_label(container, label_key);
+            if (!value || (label_value && strcmp(value, label_value) != 0)) continue;
+        }
+        
+        if (out && matched < max) out[matched] = container;
+        matched++;
+    }
+    return matched;
+}
+
+/* ----------------- Container Stats Streaming ----------------- */
+
+static uint64_t get_json_uint(json_object *obj, const char *key) {
+    int64_t value = get_json_int(obj, key);
+    return value > 0 ? (uint64_t)value : 0;
+}
+
+/* Fill a fixed-layout sample from one /containers/{id}/stats frame */
+static void parse_stats_sample(json_object *json, docker_excess_stats_sample_t *sample) {
+    memset(sample, 0, sizeof(*sample));
+    sample->read_time = time(NULL);
+    
+    json_object *cpu = get_json_object(json, "cpu_stats");
+    json_object *precpu = get_json_object(json, "precpu_stats");
+    if (cpu) {
+        sample->cpu_total_ns = get_json_uint(get_json_object(cpu, "cpu_usage"), "total_usage");
+        sample->system_cpu_ns = get_json_uint(cpu, "system_cpu_usage");
+        sample->online_cpus = (uint32_t)get_json_uint(cpu, "online_cpus");
+        if (sample->online_cpus == 0) {
+            json_object *percpu = get_json_object(get_json_object(cpu, "cpu_usage"), "percpu_usage");
+            if (percpu && json_object_get_type(percpu) == json_type_array) {
+                sample->online_cpus = (uint32_t)json_object_array_length(percpu);
+            }
+        }
+    }
+    if (precpu) {
+        uint64_t pre_total = get_json_uint(get_json_object(precpu, "cpu_usage"), "total_usage");
+        uint64_t pre_system = get_json_uint(precpu, "system_cpu_usage");
+        if (sample->cpu_total_ns > pre_total) sample->cpu_delta_ns = sample->cpu_total_ns - pre_total;
+        if (sample->system_cpu_ns > pre_system) sample->system_cpu_delta_ns = sample->system_cpu_ns - pre_system;
+    }
+    if (sample->cpu_delta_ns > 0 && sample->system_cpu_delta_ns > 0) {
+        sample->cpu_percent = (double)sample->cpu_delta_ns / (double)sample->system_cpu_delta_ns *
+                              (double)(sample->online_cpus ? sample->online_cpus : 1) * 100.0;
+    }
+    
+    json_object *memory = get_json_object(json, "memory_stats");
+    if (memory) {
+        sample->memory_usage = get_json_uint(memory, "usage");
+        sample->memory_limit = get_json_uint(memory, "limit");
+        
+        /* cgroup v2 reports inactive_file, v1 total_inactive_file */
+        json_object *mem_stats = get_json_object(memory, "stats");
+        sample->memory_cache = get_json_uint(mem_stats, "inactive_file");
+        if (sample->memory_cache == 0) sample->memory_cache = get_json_uint(mem_stats, "total_inactive_file");
+        
+        if (sample->memory_limit > 0) {
+            uint64_t used = sample->memory_usage > sample->memory_cache ?
+                            sample->memory_usage - sample->memory_cache : 0;
+            sample->memory_percent = (double)used / (double)sample->memory_limit * 100.0;
+        }
+    }
+    
+    json_object *networks = get_json_object(json, "networks");
+    if (networks && json_object_get_type(networks) == json_type_object) {
+        json_object_object_foreach(networks, ifname, iface) {
+            (void)ifname;
+            sample->net_rx_bytes += get_json_uint(iface, "rx_bytes");
+            sample->net_tx_bytes += get_json_uint(iface, "tx_bytes");
+            sample->net_rx_packets += get_json_uint(iface, "rx_packets");
+            sample->net_tx_packets += get_json_uint(iface, "tx_packets");
+        }
+    }
+    
+    json_object *blkio = get_json_object(get_json_object(json, "blkio_stats"), "io_service_bytes_recursive");
+    if (blkio && json_object_get_type(blkio) == json_type_array) {
+        size_t len = json_object_array_length(blkio);
+        for (size_t i = 0; i < len; i++) {
+            json_object *entry = json_object_array_get_idx(blkio, i);
+            const char *op = get_json_string(entry, "op");
+            if (!op) continue;
+            if (strcasecmp(op, "read") == 0) sample->blk_read_bytes += get_json_uint(entry, "value");
+            else if (strcasecmp(op, "write") == 0) sample->blk_write_bytes += get_json_uint(entry, "value");
+        }
+    }
+    
+    sample->pids = get_json_uint(get_json_object(json, "pids_stats"), "current");
+}
+
+/* One stats stream; the tokenizer and the sample are reused for every frame */
+typedef struct {
+    json_stream_t stream;
+    docker_excess_stats_sample_t sample;
+    docker_excess_stats_callback_t callback;
+    void *userdata;
+    char container_id[];
+} stats_stream_t;
+
+static bool stats_stream_on_value(json_object *value, void *ctx) {
+    stats_stream_t *stats = ctx;
+    parse_stats_sample(value, &stats->sample);
+    return stats->callback(stats->container_id, &stats->sample, stats->userdata);
+}
+
+static stats_stream_t* stats_stream_new(const char *container_id, docker_excess_stats_callback_t callback,
+                                        void *userdata) {
+    size_t id_len = strlen(container_id);
+    stats_stream_t *stats = calloc(1, sizeof(stats_stream_t) + id_len + 1);
+    if (!stats) return NULL;
+    
+    memcpy(stats->container_id, container_id, id_len + 1);
+    stats->callback = callback;
+    stats->userdata = userdata;
+    if (!json_stream_init(&stats->stream, stats_stream_on_value, stats)) {
+        free(stats);
+        return NULL;
+    }
+    return stats;
+}
+
+static void stats_stream_free(stats_stream_t *stats) {
+    if (!stats) return;
+    json_stream_cleanup(&stats->stream);
+    free(stats);
+}
+
+docker_excess_error_t docker_excess_stats_stream(docker_excess_t *client, const char *container_id,
+                                                docker_excess_stats_callback_t callback, void *userdata) {
+    if (!client || !container_id || !callback) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char endpoint[512];
+    if (!build_resource_endpoint(endpoint, sizeof(endpoint), "/containers/", container_id, "/stats?stream=true")) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    stats_stream_t *stats = stats_stream_new(container_id, callback, userdata);
+    if (!stats) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    docker_excess_error_t err = make_request_stream(client, "GET", endpoint, NULL, &stats->stream);
+    stats_stream_free(stats);
+    return err;
+}
+
+static void async_stats_done(async_request_t *req, docker_excess_error_t err, int http_code) {
+    (void)err;
+    (void)http_code;
+    stats_stream_t *stats = req->done_data;
+    
+    if (!stats->stream.stopped) {
+        stats->callback(stats->container_id, NULL, stats->userdata);
+    }
+    stats_stream_free(stats);
+}
+
+docker_excess_error_t docker_excess_async_stats(docker_excess_t *client, const char *container_id,
+                                               docker_excess_stats_callback_t callback, void *userdata) {
+    if (!client || !container_id || !callback) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char endpoint[512];
+    if (!build_resource_endpoint(endpoint, sizeof(endpoint), "/containers/", container_id, "/stats?stream=true")) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    async_engine_t *engine = async_engine_get(client);
+    if (!engine) return DOCKER_EXCESS_ERR_INTERNAL;
+    
+    stats_stream_t *stats = stats_stream_new(container_id, callback, userdata);
+    if (!stats) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    async_request_t *req = async_request_new(client, engine, "GET", endpoint, NULL);
+    if (!req) {
+        stats_stream_free(stats);
+        return DOCKER_EXCESS_ERR_MEMORY;
+    }
+    
+    req->write_fn = write_json_stream_callback;
+    req->write_data = &stats->stream;
+    req->stopped = &stats->stream.stopped;
+    req->fail_on_error = true;
+    req->timeout_ms = -1;
+    req->done = async_stats_done;
+    req->done_data = stats;
+    async_request_enqueue(engine, req);
+    return DOCKER_EXCESS_OK;
+}
+
+/* ----------------- Container Logs ----------------- */
+
+/*
+ * Non-TTY log streams are multiplexed: every frame is an 8-byte header
+ * (stream id, three zero bytes, big-endian payload length) followed by the
+ * payload. Payload bytes go to the caller straight out of curl's receive
+ * buffer, so a frame split across reads arrives as several slices. TTY
+ * containers send the bare stream, which is recognized from its first bytes.
+ */
+typedef struct {
+    docker_excess_log_frame_callback_t callback;
+    void *userdata;
+    unsigned char header[8];
+    size_t header_len;
+    size_t remaining;               /* Payload bytes left in the current frame */
+    int stream_id;
+    bool raw;                       /* TTY stream, no framing */
+    bool framed;                    /* At least one valid header seen */
+    bool corrupt;
+    bool stopped;
+} log_demux_t;
+
+static bool log_header_plausible(const unsigned char *header, size_t len) {
+    if (len > 0 && header[0] > DOCKER_EXCESS_STREAM_STDERR) return false;
+    for (size_t i = 1; i < len && i < 4; i++) {
+        if (header[i] != 0) return false;
+    }
+    return true;
+}
+
+static size_t log_demux_callback(char *contents, size_t size, size_t nmemb, void *userp) {
+    log_demux_t *demux = userp;
+    const unsigned char *data = (const unsigned char *)contents;
+    size_t total_size = size * nmemb;
+    size_t offset = 0;
+    
+    while (offset < total_size && !demux->stopped) {
+        if (demux->raw) {
+            if (!demux->callback(data + offset, total_size - offset, DOCKER_EXCESS_STREAM_STDOUT,
+                                 demux->userdata)) {
+                demux->stopped = true;
+            }
+            break;
+        }
+        
+        if (demux->remaining > 0) {
+            size_t n = total_size - offset;
+            if (n > demux->remaining) n = demux->remaining;
+            if (!demux->callback(data + offset, n, demux->stream_id, demux->userdata)) demux->stopped = true;
+            demux->remaining -= n;
+            offset += n;
+            continue;
+        }
+        
+        /* Headers may themselves be split across reads */
+        size_t n = sizeof(demux->header) - demux->header_len;
+        if (n > total_size - offset) n = total_size - offset;
+        memcpy(demux->header + demux->header_len, data + offset, n);
+        demux->header_len += n;
+        offset += n;
+        
+        if (!log_header_plausible(demux->header, demux->header_len)) {
+            if (demux->framed) {
+                demux->corrupt = true;
+                return 0;
+            }
+            /* Not a frame: TTY output, replay what was held back as a header */
+            demux->raw = true;
+            if (!demux->callback(demux->header, demux->header_len, DOCKER_EXCESS_STREAM_STDOUT,
+                                 demux->userdata)) {
+                demux->stopped = true;
+            }
+            continue;
+        }
+        if (demux->header_len < sizeof(demux->header)) continue;
+        
+        demux->stream_id = demux->header[0];
+        demux->remaining = ((size_t)demux->header[4] << 24) | ((size_t)demux->header[5] << 16) |
+                           ((size_t)demux->header[6] << 8) | (size_t)demux->header[7];
+        demux->header_len = 0;
+        demux->framed = true;
+    }
+    
+    return demux->stopped ? 0 : total_size;
+}
+
+static bool build_logs_endpoint(char *endpoint, size_t size, const char *container_id,
+                                const docker_excess_log_params_t *params) {
+    if (!build_resource_endpoint(endpoint, size, "/containers/", container_id, "/logs?stdout=1&stderr=1")) {
+        return false;
+    }
+    if (!params) return true;
+    
+    size_t len = strlen(endpoint);
+    int n = snprintf(endpoint + len, size - len, "&follow=%d&timestamps=%d&details=%d",
+                     params->follow ? 1 : 0, params->timestamps ? 1 : 0, params->details ? 1 : 0);
+    if (n < 0 || (size_t)n >= size - len) return false;
+    len += (size_t)n;
+    
+    if (params->tail_lines > 0) {
+        n = snprintf(endpoint + len, size - len, "&tail=%d", params->tail_lines);
+        if (n < 0 || (size_t)n >= size - len) return false;
+        len += (size_t)n;
+    }
+    if (params->since > 0) {
+        n = snprintf(endpoint + len, size - len, "&since=%lld", (long long)params->since);
+        if (n < 0 || (size_t)n >= size - len) return false;
+        len += (size_t)n;
+    }
+    if (params->until > 0) {
+        n = snprintf(endpoint + len, size - len, "&until=%lld", (long long)params->until);
+        if (n < 0 || (size_t)n >= size - len) return false;
+    }
+    return true;
+}
+
+docker_excess_error_t docker_excess_get_logs_raw(docker_excess_t *client, const char *container_id,
+                                                const docker_excess_log_params_t *params,
+                                                docker_excess_log_frame_callback_t callback, void *userdata) {
+    if (!client || !container_id || !callback) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char endpoint[1024];
+    if (!build_logs_endpoint(endpoint, sizeof(endpoint), container_id, params)) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    log_demux_t demux = {
+        .callback = callback,
+        .userdata = userdata,
+    };
+    request_opts_t opts = {
+        .method = "GET",
+        .endpoint = endpoint,
+        .write_fn = log_demux_callback,
+        .write_data = &demux,
+        .timeout_ms = params && params->follow ? -1 : 0,
+        .stopped = &demux.stopped,
+        .fail_on_error = true,
+    };
+    docker_excess_error_t err = perform_request(client, &opts, NULL, NULL);
+    if (demux.corrupt) {
+        set_error(client, "Malformed log frame from container %s", container_id);
+        return DOCKER_EXCESS_ERR_INTERNAL;
+    }
+    return err;
+}
+
+/* Lines for docker_excess_get_logs(), assembled per stream on top of the raw slices */
+typedef struct {
+    docker_excess_log_callback_t callback;
+    void *userdata;
+    bool timestamps;                /* Lines start with an RFC 3339 time and a space */
+    bool failed;                    /* Out of memory */
+    response_buffer_t partial[2];   /* Unterminated stdout and stderr lines */
+} log_lines_t;
+
+/* Strip the timestamp docker puts in front of a line; UTC, fraction ignored */
+static const char* log_line_timestamp(const char *line, time_t *timestamp) {
+    struct tm tm = {0};
+    int consumed = 0;
+    if (sscanf(line, "%d-%d-%dT%d:%d:%d%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+               &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &consumed) != 6) {
+        return line;
+    }
+    const char *space = strchr(line + consumed, ' ');
+    if (!space) return line;
+
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    *timestamp = timegm(&tm);
+    return space + 1;
+}
+
+static void log_lines_emit(log_lines_t *lines, response_buffer_t *line, bool is_stderr) {
+    if (line->size > 0 && line->data[line->size - 1] == '\r') line->data[--line->size] = '\0';
+
+    time_t timestamp = 0;
+    const char *text = line->data ? line->data : "";
+    if (lines->timestamps) text = log_line_timestamp(text, &timestamp);
+    lines->callback(text, is_stderr, timestamp, lines->userdata);
+    line->size = 0;
+}
+
+static bool log_lines_callback(const void *data, size_t len, int stream_id, void *userdata) {
+    log_lines_t *lines = userdata;
+    bool is_stderr = stream_id == DOCKER_EXCESS_STREAM_STDERR;
+    response_buffer_t *line = &lines->partial[is_stderr ? 1 : 0];
+    const char *p = data;
+    const char *end = p + len;
+
+    while (p < end) {
+        const char *newline = memchr(p, '\n', (size_t)(end - p));
+        size_t n = newline ? (size_t)(newline - p) : (size_t)(end - p);
+        if (!buffer_append(line, p, n)) {
+            lines->failed = true;
+            return false;
+        }
+        if (!newline) break;
+    
+        log_lines_emit(lines, line, is_stderr);
+        p = newline + 1;
+    }
+    return true;
+}
+
+docker_excess_error_t docker_excess_get_logs(docker_excess_t *client, const char *container_id,
+                                            const docker_excess_log_params_t *params,
+                                            docker_excess_log_callback_t callback, void *userdata) {
+    if (!client || !container_id || !callback) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+
+    log_lines_t lines = {
+        .callback = callback,
+        .userdata = userdata,
+        .timestamps = params && params->timestamps,
+    };
+    docker_excess_error_t err = docker_excess_get_logs_raw(client, container_id, params, log_lines_callback, &lines);
+
+    /* A last line without a newline still counts */
+    for (int i = 0; i < 2; i++) {
+        if (!lines.failed && lines.partial[i].size > 0) log_lines_emit(&lines, &lines.partial[i], i == 1);
+        safe_free(lines.partial[i].data);
+    }
+    if (lines.failed) {
+        set_error(client, "Out of memory assembling log lines of container %s", container_id);
+        return DOCKER_EXCESS_ERR_MEMORY;
+    }
+    return err;
+}
+
+static void async_logs_done(async_request_t *req, docker_excess_error_t err, int http_code) {
+    (void)err;
+    (void)http_code;
+    log_demux_t *demux = req->done_data;
+    
+    if (!demux->stopped) {
+        demux->callback(NULL, 0, DOCKER_EXCESS_STREAM_STDOUT, demux->userdata);
+    }
+    free(demux);
+}
+
+docker_excess_error_t docker_excess_async_logs_raw(docker_excess_t *client, const char *container_id,
+                                                  const docker_excess_log_params_t *params,
+                                                  docker_excess_log_frame_callback_t callback, void *userdata) {
+    if (!client || !container_id || !callback) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char endpoint[1024];
+    if (!build_logs_endpoint(endpoint, sizeof(endpoint), container_id, params)) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    async_engine_t *engine = async_engine_get(client);
+    if (!engine) return DOCKER_EXCESS_ERR_INTERNAL;
+    
+    log_demux_t *demux = calloc(1, sizeof(log_demux_t));
+    if (!demux) return DOCKER_EXCESS_ERR_MEMORY;
+    demux->callback = callback;
+    demux->userdata = userdata;
+    
+    async_request_t *req = async_request_new(client, engine, "GET", endpoint, NULL);
+    if (!req) {
+        free(demux);
+        return DOCKER_EXCESS_ERR_MEMORY;
+    }
+    
+    req->write_fn = log_demux_callback;
+    req->write_data = demux;
+    req->stopped = &demux->stopped;
+    req->fail_on_error = true;
+    req->timeout_ms = params && params->follow ? -1 : 0;
+    req->done = async_logs_done;
+    req->done_data = demux;
+    async_request_enqueue(engine, req);
+    return DOCKER_EXCESS_OK;
+}
+
+/* ----------------- Exec Sessions ----------------- */
+
+/*
+ * An exec is three dependent requests: create, start (which streams the
+ * output until the process exits) and inspect for the exit code. The
+ * session chains them inside the async engine, so each step is sent from
+ * the completion of the previous one on a pooled keep-alive handle, and
+ * any number of sessions run side by side. Output is demultiplexed
+ * straight from curl's buffer into the caller's buffers.
+ */
+
+#define EXEC_INSPECT_RETRIES 20     /* The exit code can trail the end of the stream */
+
+typedef enum {
+    EXEC_STEP_CREATE,
+    EXEC_STEP_START,
+    EXEC_STEP_INSPECT
+} exec_step_t;
+
+typedef struct exec_session exec_session_t;
+
+struct exec_session {
+    docker_excess_t *client;
+    async_engine_t *engine;
+    char *create_body;
+    char start_body[64];
+    bool detach;
+    char exec_id[72];
+    int inspect_retries;
+    log_demux_t demux;
+    
+    docker_excess_exec_result_t *result;        /* Fixed caller buffers */
+    response_buffer_t grow[2];                  /* exec_simple: stdout, stderr */
+    bool growable;
+    docker_excess_exec_callback_t stream_cb;    /* docker_excess_exec() */
+    
+    docker_excess_exec_done_t done;
+    void *userdata;
+    docker_excess_error_t err;
+    atomic_bool finished;                       /* For the blocking wrappers */
+};
+
+static char* exec_create_body(const docker_excess_exec_params_t *params) {
+    json_object *obj = json_object_new_object();
+    if (!obj) return NULL;
+    
+    bool attach = !params->detach;
+    json_object_object_add(obj, "AttachStdout", json_object_new_boolean(attach));
+    json_object_object_add(obj, "AttachStderr", json_object_new_boolean(attach));
+    json_object_object_add(obj, "Tty", json_object_new_boolean(params->tty));
+    json_object_object_add(obj, "Privileged", json_object_new_boolean(params->privileged));
+    
+    json_object *cmd = json_object_new_array();
+    for (size_t i = 0; i < params->cmd_count; i++) {
+        json_object_array_add(cmd, json_object_new_string(params->cmd[i]));
+    }
+    json_object_object_add(obj, "Cmd", cmd);
+    
+    if (params->env_count > 0) {
+        json_object *env = json_object_new_array();
+        for (size_t i = 0; i < params->env_count; i++) {
+            char entry[4096];
+            snprintf(entry, sizeof(entry), "%s=%s", params->env[i].name,
+                     params->env[i].value ? params->env[i].value : "");
+            json_object_array_add(env, json_object_new_string(entry));
+        }
+        json_object_object_add(obj, "Env", env);
+    }
+    if (params->working_dir) json_object_object_add(obj, "WorkingDir", json_object_new_string(params->working_dir));
+    if (params->user) json_object_object_add(obj, "User", json_object_new_string(params->user));
+    
+    char *body = strdup(json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PLAIN));
+    json_object_put(obj);
+    return body;
+}
+
+/* Copy into a fixed buffer, keeping room for the terminator */
+static void exec_copy_out(char *buf, size_t size, size_t *len, bool *truncated, const void *data, size_t n) {
+    if (!buf || size == 0) return;
+    
+    size_t room = size - 1 - *len;
+    if (n > room) {
+        n = room;
+        *truncated = true;
+    }
+    memcpy(buf + *len, data, n);
+    *len += n;
+    buf[*len] = '\0';
+}
+
+static bool exec_on_frame(const void *data, size_t len, int stream_id, void *userdata) {
+    exec_session_t *session = userdata;
+    if (!data) return true;
+    bool is_stderr = stream_id == DOCKER_EXCESS_STREAM_STDERR;
+    
+    if (session->growable) {
+        return write_response_callback((void *)data, 1, len, &session->grow[is_stderr ? 1 : 0]) == len;
+    }
+    
+    if (session->stream_cb) {
+        /* The callback takes strings: hand the frame over in terminated slices */
+        const char *bytes = data;
+        char chunk[4096];
+        while (len > 0) {
+            size_t n = len < sizeof(chunk) - 1 ? len : sizeof(chunk) - 1;
+            memcpy(chunk, bytes, n);
+            chunk[n] = '\0';
+            session->stream_cb(is_stderr ? NULL : chunk, is_stderr ? chunk : NULL, session->userdata);
+            bytes += n;
+            len -= n;
+        }
+        return true;
+    }
+    
+    docker_excess_exec_result_t *result = session->result;
+    if (is_stderr) {
+        exec_copy_out(result->stderr_buf, result->stderr_size, &result->stderr_len, &result->stderr_truncated,
+                      data, len);
+    } else {
+        exec_copy_out(result->stdout_buf, result->stdout_size, &result->stdout_len, &result->stdout_truncated,
+                      data, len);
+    }
+    return true;
+}
+
+static void exec_session_free(exec_session_t *session) {
+    free(session->create_body);
+    free(session->grow[0].data);
+    free(session->grow[1].data);
+    free(session);
+}
+
+static void exec_session_finish(exec_session_t *session, docker_excess_error_t err) {
+    session->err = err;
+    if (session->done) {
+        session->done(err, session->result, session->userdata);
+        exec_session_free(session);
+        return;
+    }
+    /* A blocking wrapper owns the session from here */
+    atomic_store(&session->finished, true);
+}
+
+static void exec_session_done(async_request_t *req, docker_excess_error_t err, int http_code);
+
+static docker_excess_error_t exec_session_submit(exec_session_t *session, exec_step_t step,
+                                                 const char *container_id) {
+    char endpoint[512];
+    const char *method = "POST";
+    const char *body = NULL;
+    bool ok;
+    
+    switch (step) {
+        case EXEC_STEP_CREATE:
+            ok = build_resource_endpoint(endpoint, sizeof(endpoint), "/containers/", container_id, "/exec");
+            body = session->create_body;
+            break;
+        case EXEC_STEP_START:
+            ok = build_resource_endpoint(endpoint, sizeof(endpoint), "/exec/", session->exec_id, "/start");
+            body = session->start_body;
+            break;
+        default:
+            ok = build_resource_endpoint(endpoint, sizeof(endpoint), "/exec/", session->exec_id, "/json");
+            method = "GET";
+            break;
+    }
+    if (!ok) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    async_request_t *req = async_request_new(session->client, session->engine, method, endpoint, body);
+    if (!req) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    if (step == EXEC_STEP_START) {
+        req->write_fn = log_demux_callback;
+        req->write_data = &session->demux;
+        req->stopped = &session->demux.stopped;
+        req->fail_on_error = true;
+        req->timeout_ms = -1;
+    } else if (!async_request_parse_json(req)) {
+        async_request_free(session->engine, req);
+        return DOCKER_EXCESS_ERR_MEMORY;
+    }
+    
+    req->done = exec_session_done;
+    req->done_data = session;
+    req->tag = step;
+    async_request_enqueue(session->engine, req);
+    return DOCKER_EXCESS_OK;
+}
+
+/* Each completion submits the next step */
+static void exec_session_done(async_request_t *req, docker_excess_error_t err, int http_code) {
+    (void)http_code;
+    exec_session_t *session = req->done_data;
+    exec_step_t step = (exec_step_t)req->tag;
+    
+    if (err != DOCKER_EXCESS_OK) {
+        exec_session_finish(session, err);
+        return;
+    }
+    
+    if (step == EXEC_STEP_START) {
+        if (session->demux.corrupt) {
+            set_error(session->client, "Malformed exec output stream");
+            exec_session_finish(session, DOCKER_EXCESS_ERR_INTERNAL);
+            return;
+        }
+        if (session->detach) {
+            exec_session_finish(session, DOCKER_EXCESS_OK);
+            return;
+        }
+        err = exec_session_submit(session, EXEC_STEP_INSPECT, NULL);
+        if (err != DOCKER_EXCESS_OK) exec_session_finish(session, err);
+        return;
+    }
+    
+    json_object *json = json_sink_finish(&req->json);
+    if (!json) {
+        exec_session_finish(session, DOCKER_EXCESS_ERR_JSON);
+        return;
+    }
+    
+    if (step == EXEC_STEP_CREATE) {
+        const char *id = get_json_string(json, "Id");
+        if (id) snprintf(session->exec_id, sizeof(session->exec_id), "%s", id);
+        json_object_put(json);
+        
+        err = id ? exec_session_submit(session, EXEC_STEP_START, NULL) : DOCKER_EXCESS_ERR_JSON;
+        if (err != DOCKER_EXCESS_OK) exec_session_finish(session, err);
+        return;
+    }
+    
+    bool running = get_json_bool(json, "Running");
+    int exit_code = (int)get_json_int(json, "ExitCode");
+    json_object_put(json);
+    
+    if (running && session->inspect_retries++ < EXEC_INSPECT_RETRIES) {
+        err = exec_session_submit(session, EXEC_STEP_INSPECT, NULL);
+        if (err != DOCKER_EXCESS_OK) exec_session_finish(session, err);
+        return;
+    }
+    if (session->result) session->result->exit_code = running ? -1 : exit_code;
+    exec_session_finish(session, DOCKER_EXCESS_OK);
+}
+
+static exec_session_t* exec_session_new(docker_excess_t *client, const docker_excess_exec_params_t *params) {
+    exec_session_t *session = calloc(1, sizeof(exec_session_t));
+    if (!session) return NULL;
+    
+    session->client = client;
+    session->detach = params->detach;
+    session->create_body = exec_create_body(params);
+    snprintf(session->start_body, sizeof(session->start_body), "{\"Detach\":%s,\"Tty\":%s}",
+             params->detach ? "true" : "false", params->tty ? "true" : "false");
+    session->demux.callback = exec_on_frame;
+    session->demux.userdata = session;
+    session->demux.raw = params->tty;
+    atomic_init(&session->finished, false);
+    
+    if (!session->create_body) {
+        exec_session_free(session);
+        return NULL;
+    }
+    return session;
+}
+
+static docker_excess_error_t exec_session_start(exec_session_t *session, const char *container_id) {
+    session->engine = async_engine_get(session->client);
+    if (!session->engine) return DOCKER_EXCESS_ERR_INTERNAL;
+    
+    docker_excess_exec_result_t *result = session->result;
+    if (result) {
+        result->stdout_len = result->stderr_len = 0;
+        result->stdout_truncated = result->stderr_truncated = false;
+        result->exit_code = -1;
+        if (result->stdout_buf && result->stdout_size) result->stdout_buf[0] = '\0';
+        if (result->stderr_buf && result->stderr_size) result->stderr_buf[0] = '\0';
+    }
+    
+    return exec_session_submit(session, EXEC_STEP_CREATE, container_id);
+}
+
+/*
+ * Drive the engine until a session without a done callback has finished.
+ * If the engine fails, the session's request is failed with its error;
+ * one another thread is completing still finishes the session there.
+ */
+static docker_excess_error_t exec_session_wait(exec_session_t *session) {
+    docker_excess_error_t result = DOCKER_EXCESS_OK;
+    while (!atomic_load(&session->finished)) {
+        if (result != DOCKER_EXCESS_OK) {
+            if (async_engine_fail_owned(session->engine, session, result) == 0) sched_yield();
+            continue;
+        }
+    
+        /* Short waits: another thread may be running the same engine */
+        result = async_engine_run(session->engine, 100);
+        if (result != DOCKER_EXCESS_OK) set_error(session->client, "Async engine failed: %s", strerror(errno));
+    }
+    return session->err;
+}
+
+static bool exec_params_valid(const docker_excess_exec_params_t *params) {
+    return params && params->cmd && params->cmd_count > 0;
+}
+
+docker_excess_error_t docker_excess_async_exec(docker_excess_t *client, const char *container_id,
+                                              const docker_excess_exec_params_t *params,
+                                              docker_excess_exec_result_t *result,
+                                              docker_excess_exec_done_t done, void *userdata) {
+    if (!client || !container_id || !exec_params_valid(params) || !result || !done) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    exec_session_t *session = exec_session_new(client, params);
+    if (!session) return DOCKER_EXCESS_ERR_MEMORY;
+    session->result = result;
+    session->done = done;
+    session->userdata = userdata;
+    
+    docker_excess_error_t err = exec_session_start(session, container_id);
+    if (err != DOCKER_EXCESS_OK) exec_session_free(session);
+    return err;
+}
+
+docker_excess_error_t docker_excess_exec_run(docker_excess_t *client, const char *container_id,
+                                            const docker_excess_exec_params_t *params,
+                                            docker_excess_exec_result_t *result) {
+    if (!client || !container_id || !exec_params_valid(params) || !result) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    exec_session_t *session = exec_session_new(client, params);
+    if (!session) return DOCKER_EXCESS_ERR_MEMORY;
+    session->result = result;
+    
+    docker_excess_error_t err = exec_session_start(session, container_id);
+    if (err == DOCKER_EXCESS_OK) err = exec_session_wait(session);
+    exec_session_free(session);
+    return err;
+}
+
+docker_excess_error_t docker_excess_exec(docker_excess_t *client, const char *container_id,
+                                        const docker_excess_exec_params_t *params,
+                                        docker_excess_exec_callback_t callback, void *userdata) {
+    if (!client || !container_id || !exec_params_valid(params)) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    exec_session_t *session = exec_session_new(client, params);
+    if (!session) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    docker_excess_exec_result_t result = {0};
+    session->result = &result;
+    session->stream_cb = callback;
+    session->userdata = userdata;
+    
+    docker_excess_error_t err = exec_session_start(session, container_id);
+    if (err == DOCKER_EXCESS_OK) err = exec_session_wait(session);
+    exec_session_free(session);
+    return err;
+}
+
+docker_excess_error_t docker_excess_exec_simple(docker_excess_t *client, const char *container_id,
+                                               const char *command, char **stdout_out, char **stderr_out,
+                                               int *exit_code) {
+    if (!client || !container_id || !command) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char *argv[] = { "/bin/sh", "-c", (char *)command };
+    docker_excess_exec_params_t params = { .cmd = argv, .cmd_count = 3 };
+    
+    exec_session_t *session = exec_session_new(client, &params);
+    if (!session) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    docker_excess_exec_result_t result = {0};
+    session->result = &result;
+    session->growable = true;
+    
+    docker_excess_error_t err = exec_session_start(session, container_id);
+    if (err == DOCKER_EXCESS_OK) err = exec_session_wait(session);
+    
+    if (err == DOCKER_EXCESS_OK) {
+        /* Empty output is still a string */
+        for (int i = 0; i < 2; i++) {
+            if (!session->grow[i].data) session->grow[i].data = calloc(1, 1);
+        }
+        if (stdout_out) {
+            *stdout_out = session->grow[0].data;
+            session->grow[0].data = NULL;
+        }
+        if (stderr_out) {
+            *stderr_out = session->grow[1].data;
+            session->grow[1].data = NULL;
+        }
+        if (exit_code) *exit_code = result.exit_code;
+    }
+    
+    exec_session_free(session);
+    return err;
+}
+
+/* ----------------- ID Utilities ----------------- */
+
+static bool is_hex_string(const char *str, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (!isxdigit((unsigned char)str[i])) return false;
+    }
+    return true;
+}
+
+/* A complete ID needs no lookup; image IDs may carry their digest prefix */
+static bool is_full_id(const char *str) {
+    if (strncmp(str, "sha256:", 7) == 0) str += 7;
+    return strlen(str) == 64 && is_hex_string(str, 64);
+}
+
+bool docker_excess_is_container_id(const char *str) {
+    if (!str) return false;
+    size_t len = strlen(str);
+    return len >= 12 && len <= 64 && is_hex_string(str, len);
+}
+
+char* docker_excess_short_id(const char *full_id) {
+    if (!full_id) return NULL;
+    if (strncmp(full_id, "sha256:", 7) == 0) full_id += 7;
+    return strndup(full_id, 12);
+}
+
+static docker_excess_error_t resolve_id(docker_excess_t *client, resolve_kind_t kind, const char *name_or_id,
+                                        char **full_id) {
+    if (!client || !name_or_id || !name_or_id[0] || !full_id) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    if (is_full_id(name_or_id)) {
+        *full_id = strdup(name_or_id);
+        return *full_id ? DOCKER_EXCESS_OK : DOCKER_EXCESS_ERR_MEMORY;
+    }
+    
+    *full_id = resolve_cache_get(&client->resolver, kind, name_or_id);
+    if (*full_id) return DOCKER_EXCESS_OK;
+    
+    static const char *const prefixes[] = { "/containers/", "/images/", "/networks/" };
+    static const char *const suffixes[] = { "/json", "/json", NULL };
+    
+    char endpoint[512];
+    if (!build_resource_endpoint(endpoint, sizeof(endpoint), prefixes[kind], name_or_id, suffixes[kind])) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    json_object *json = NULL;
+    docker_excess_error_t err = make_request_json(client, "GET", endpoint, NULL, &json, NULL);
+    if (err != DOCKER_EXCESS_OK) return err;
+    
+    const char *id = get_json_string(json, "Id");
+    if (id) {
+        resolve_cache_put(&client->resolver, kind, name_or_id, id);
+        *full_id = strdup(id);
+        err = *full_id ? DOCKER_EXCESS_OK : DOCKER_EXCESS_ERR_MEMORY;
+    } else {
+        set_error(client, "No Id in response for %s", name_or_id);
+        err = DOCKER_EXCESS_ERR_JSON;
+    }
+    
+    json_object_put(json);
+    return err;
+}
+
+docker_excess_error_t docker_excess_resolve_container_id(docker_excess_t *client, const char *name_or_id,
+                                                        char **full_id) {
+    return resolve_id(client, RESOLVE_CONTAINER, name_or_id, full_id);
+}
+
+docker_excess_error_t docker_excess_resolve_image_id(docker_excess_t *client, const char *name_or_id,
+                                                    char **full_id) {
+    return resolve_id(client, RESOLVE_IMAGE, name_or_id, full_id);
+}
+
+docker_excess_error_t docker_excess_resolve_network_id(docker_excess_t *client, const char *name_or_id,
+                                                      char **full_id) {
+    return resolve_id(client, RESOLVE_NETWORK, name_or_id, full_id);
+}
+
+void docker_excess_resolve_invalidate(docker_excess_t *client, const char *name_or_id) {
+    if (!client) return;
+    if (name_or_id) resolve_cache_invalidate(&client->resolver, name_or_id);
+    else resolve_cache_clear(&client->resolver);
+}
+
+/* ----------------- Tar Archives ----------------- */
+
+/*
+ * Archives are produced and consumed in the chunks libcurl asks for: the
+ * writer fills curl's upload buffer straight from read(2) on the source
+ * files, the reader write(2)s payload straight out of curl's receive
+ * buffer. Only headers and padding are staged, so memory use does not
+ * depend on the size of what is copied.
+ */
+
+#define TAR_BLOCK 512
+#define TAR_MAX_META (1024 * 1024)  /* Cap on GNU long names and pax headers */
+
+static bool tar_put_number(unsigned char *field, size_t width, uint64_t value) {
+    /* Octal while it fits, GNU base-256 beyond (files of 8 GiB and more) */
+    if (value < (1ULL << (3 * (width - 1)))) {
+        snprintf((char *)field, width, "%0*llo", (int)(width - 1), (unsigned long long)value);
+        return true;
+    }
+    memset(field, 0, width);
+    for (size_t i = width - 1; i > 0; i--) {
+        field[i] = (unsigned char)(value & 0xff);
+        value >>= 8;
+    }
+    field[0] = 0x80;
+    return value == 0;
+}
+
+static bool tar_get_number(const unsigned char *field, size_t width, uint64_t *value) {
+    uint64_t result = 0;
+    
+    if (field[0] & 0x80) {
+        result = field[0] & 0x7f;
+        for (size_t i = 1; i < width; i++) {
+            if (result >> 56) return false;
+            result = (result << 8) | field[i];
+        }
+        *value = result;
+        return true;
+    }
+    
+    size_t i = 0;
+    while (i < width && (field[i] == ' ' || field[i] == '\0')) i++;
+    for (; i < width && field[i] >= '0' && field[i] <= '7'; i++) {
+        result = (result << 3) | (uint64_t)(field[i] - '0');
+    }
+    *value = result;
+    return true;
+}
+
+static unsigned int tar_checksum(const unsigned char *header) {
+    unsigned int sum = 0;
+    for (size_t i = 0; i < TAR_BLOCK; i++) {
+        sum += (i >= 148 && i < 156) ? ' ' : header[i];
+    }
+    return sum;
+}
+
+/* --- Writer --- */
+
+typedef struct {
+    DIR *dir;
+    size_t path_len;                /* Length of `path` for this directory */
+} tar_dir_t;
+
+typedef struct {
+    char path[PATH_MAX];            /* Host path of the current entry */
+    size_t root_len;                /* Host path prefix replaced by `name_root` */
+    char name_root[PATH_MAX];       /* Archive name of the source root */
+    tar_dir_t *dirs;                /* Directories being walked, innermost last */
+    size_t dirs_count;
+    size_t dirs_capacity;
+    bool started;
+    
+    unsigned char *stage;           /* Headers and trailer waiting to be sent */
+    size_t stage_len;
+    size_t stage_off;
+    size_t stage_capacity;
+    
+    int fd;                         /* Payload of the current regular file */
+    uint64_t file_remaining;
+    size_t pad;                     /* Zero bytes owed after the payload */
+    bool finished;
+    
+    int error;                      /* errno of the first failure */
+    char error_path[PATH_MAX];
+} tar_writer_t;
+
+static void tar_writer_fail(tar_writer_t *w, int err, const char *path) {
+    if (w->error) return;
+    w->error = err ? err : EIO;
+    snprintf(w->error_path, sizeof(w->error_path), "%s", path);
+}
+
+/* Reserve n more staged bytes, zeroed */
+static unsigned char* tar_stage(tar_writer_t *w, size_t n) {
+    if (w->stage_len + n > w->stage_capacity) {
+        size_t capacity = w->stage_capacity ? w->stage_capacity : 4 * TAR_BLOCK;
+        while (capacity < w->stage_len + n) capacity *= 2;
+        unsigned char *stage = realloc(w->stage, capacity);
+        if (!stage) return NULL;
+        w->stage = stage;
+        w->stage_capacity = capacity;
+    }
+    unsigned char *block = w->stage + w->stage_len;
+    memset(block, 0, n);
+    w->stage_len += n;
+    return block;
+}
+
+static size_t tar_padding(uint64_t size) {
+    return (size_t)((TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK);
+}
+
+static void tar_finish_header(unsigned char *header) {
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+    snprintf((char *)header + 148, 8, "%06o", tar_checksum(header));
+    header[155] = ' ';
+}
+
+/* GNU 'L'/'K' entry carrying a name that does not fit in 100 bytes */
+static bool tar_stage_long(tar_writer_t *w, char type, const char *value) {
+    size_t len = strlen(value) + 1;
+    unsigned char *header = tar_stage(w, TAR_BLOCK);
+    if (!header) return false;
+    
+    memcpy(header, "././@LongLink", 13);
+    tar_put_number(header + 100, 8, 0644);
+    tar_put_number(header + 108, 8, 0);
+    tar_put_number(header + 116, 8, 0);
+    tar_put_number(header + 124, 12, len);
+    tar_put_number(header + 136, 12, 0);
+    header[156] = (unsigned char)type;
+    tar_finish_header(header);
+    
+    unsigned char *data = tar_stage(w, len + tar_padding(len));
+    if (!data) return false;
+    memcpy(data, value, len);
+    return true;
+}
+
+static bool tar_stage_header(tar_writer_t *w, const char *name, const struct stat *st, char type,
+                             const char *link_target) {
+    size_t name_len = strlen(name);
+    if (name_len > 100 && !tar_stage_long(w, 'L', name)) return false;
+    if (link_target && strlen(link_target) > 100 && !tar_stage_long(w, 'K', link_target)) return false;
+    
+    unsigned char *header = tar_stage(w, TAR_BLOCK);
+    if (!header) return false;
+    
+    memcpy(header, name, name_len < 100 ? name_len : 100);
+    tar_put_number(header + 100, 8, (uint64_t)(st->st_mode & 07777));
+    tar_put_number(header + 108, 8, (uint64_t)st->st_uid);
+    tar_put_number(header + 116, 8, (uint64_t)st->st_gid);
+    tar_put_number(header + 124, 12, type == '0' ? (uint64_t)st->st_size : 0);
+    tar_put_number(header + 136, 12, st->st_mtime > 0 ? (uint64_t)st->st_mtime : 0);
+    header[156] = (unsigned char)type;
+    if (link_target) {
+        size_t link_len = strlen(link_target);
+        memcpy(header + 157, link_target, link_len < 100 ? link_len : 100);
+    }
+    tar_finish_header(header);
+    return true;
+}
+
+/* Stage the entry for w->path and open its payload */
+static bool tar_writer_add(tar_writer_t *w) {
+    struct stat st;
+    if (lstat(w->path, &st) != 0) {
+        tar_writer_fail(w, errno, w->path);
+        return false;
+    }
+    
+    char name[PATH_MAX + 2];
+    int len = snprintf(name, sizeof(name), "%s%s%s", w->name_root, w->path + w->root_len,
+                       S_ISDIR(st.st_mode) ? "/" : "");
+    if (len < 0 || (size_t)len >= sizeof(name)) {
+        tar_writer_fail(w, ENAMETOOLONG, w->path);
+        return false;
+    }
+    
+    if (S_ISREG(st.st_mode)) {
+        w->fd = open(w->path, O_RDONLY | O_CLOEXEC);
+        if (w->fd < 0) {
+            tar_writer_fail(w, errno, w->path);
+            return false;
+        }
+        w->file_remaining = (uint64_t)st.st_size;
+        w->pad = tar_padding((uint64_t)st.st_size);
+        if (!tar_stage_header(w, name, &st, '0', NULL)) {
+            tar_writer_fail(w, ENOMEM, w->path);
+            return false;
+        }
+        return true;
+    }
+    
+    if (S_ISLNK(st.st_mode)) {
+        char target[PATH_MAX];
+        ssize_t target_len = readlink(w->path, target, sizeof(target) - 1);
+        if (target_len < 0) {
+            tar_writer_fail(w, errno, w->path);
+            return false;
+        }
+        target[target_len] = '\0';
+        if (!tar_stage_header(w, name, &st, '2', target)) {
+            tar_writer_fail(w, ENOMEM, w->path);
+            return false;
+        }
+        return true;
+    }
+    
+    if (S_ISDIR(st.st_mode)) {
+        if (!tar_stage_header(w, name, &st, '5', NULL)) {
+            tar_writer_fail(w, ENOMEM, w->path);
+            return false;
+        }
+        if (w->dirs_count == w->dirs_capacity) {
+            size_t capacity = w->dirs_capacity ? w->dirs_capacity * 2 : 16;
+            tar_dir_t *dirs = realloc(w->dirs, capacity * sizeof(tar_dir_t));
+            if (!dirs) {
+                tar_writer_fail(w, ENOMEM, w->path);
+                return false;
+            }
+            w->dirs = dirs;
+            w->dirs_capacity = capacity;
+        }
+        DIR *dir = opendir(w->path);
+        if (!dir) {
+            tar_writer_fail(w, errno, w->path);
+            return false;
+        }
+        w->dirs[w->dirs_count].dir = dir;
+        w->dirs[w->dirs_count].path_len = strlen(w->path);
+        w->dirs_count++;
+    }
+    
+    /* Sockets, fifos and devices are skipped, like docker cp */
+    return true;
+}
+
+/* Advance the walk to the next entry; false once the archive is complete or failed */
+static bool tar_writer_next(tar_writer_t *w) {
+    if (!w->started) {
+        w->started = true;
+        return tar_writer_add(w);
+    }
+    
+    while (w->dirs_count > 0) {
+        tar_dir_t *top = &w->dirs[w->dirs_count - 1];
+        struct dirent *entry = readdir(top->dir);
+        if (!entry) {
+            closedir(top->dir);
+            w->dirs_count--;
+            continue;
+        }
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        
+        int len = snprintf(w->path + top->path_len, sizeof(w->path) - top->path_len, "/%s", entry->d_name);
+        if (len < 0 || (size_t)len >= sizeof(w->path) - top->path_len) {
+            tar_writer_fail(w, ENAMETOOLONG, entry->d_name);
+            return false;
+        }
+        return tar_writer_add(w);
+    }
+    
+    /* End of archive: two zero blocks */
+    if (!tar_stage(w, 2 * TAR_BLOCK)) {
+        tar_writer_fail(w, ENOMEM, w->path);
+        return false;
+    }
+    w->finished = true;
+    return true;
+}
+
+static bool tar_writer_init(tar_writer_t *w, const char *host_path, const char *archive_name) {
+    memset(w, 0, sizeof(*w));
+    w->fd = -1;
+    
+    size_t len = strlen(host_path);
+    while (len > 1 && host_path[len - 1] == '/') len--;
+    if (len == 0 || len >= sizeof(w->path) || strlen(archive_name) >= sizeof(w->name_root)) return false;
+    
+    memcpy(w->path, host_path, len);
+    w->path[len] = '\0';
+    w->root_len = len;
+    snprintf(w->name_root, sizeof(w->name_root), "%s", archive_name);
+    return true;
+}
+
+static void tar_writer_cleanup(tar_writer_t *w) {
+    if (w->fd >= 0) close(w->fd);
+    for (size_t i = 0; i < w->dirs_count; i++) {
+        closedir(w->dirs[i].dir);
+    }
+    safe_free(w->dirs);
+    safe_free(w->stage);
+}
+
+/* CURLOPT_READFUNCTION: fill curl's buffer with the next bytes of the archive */
+static size_t tar_read_callback(char *buffer, size_t size, size_t nitems, void *userdata) {
+    tar_writer_t *w = userdata;
+    size_t capacity = size * nitems;
+    size_t out = 0;
+    
+    while (out < capacity) {
+        if (w->stage_off < w->stage_len) {
+            size_t n = w->stage_len - w->stage_off;
+            if (n > capacity - out) n = capacity - out;
+            memcpy(buffer + out, w->stage + w->stage_off, n);
+            w->stage_off += n;
+            out += n;
+            continue;
+        }
+        w->stage_off = w->stage_len = 0;
+        
+        if (w->fd >= 0 && w->file_remaining > 0) {
+            size_t n = capacity - out;
+            if (n > w->file_remaining) n = (size_t)w->file_remaining;
+            ssize_t got = read(w->fd, buffer + out, n);
+            if (got < 0) {
+                if (errno == EINTR) continue;
+                tar_writer_fail(w, errno, w->path);
+                return CURL_READFUNC_ABORT;
+            }
+            if (got == 0) {
+                /* File shrank after its header went out: pad with zeros to the promised size */
+                memset(buffer + out, 0, n);
+                got = (ssize_t)n;
+            }
+            w->file_remaining -= (uint64_t)got;
+            out += (size_t)got;
+            continue;
+        }
+        if (w->fd >= 0) {
+            close(w->fd);
+            w->fd = -1;
+        }
+        
+        if (w->pad > 0) {
+            size_t n = w->pad < capacity - out ? w->pad : capacity - out;
+            memset(buffer + out, 0, n);
+            w->pad -= n;
+            out += n;
+            continue;
+        }
+        
+        if (w->finished) break;
+        if (!tar_writer_next(w) && w->error) return CURL_READFUNC_ABORT;
+    }
+    
+    return out;
+}
+
+/* --- Reader --- */
+
+typedef enum {
+    TAR_SINK_SKIP,
+    TAR_SINK_FILE,
+    TAR_SINK_META
+} tar_sink_t;
+
+typedef struct {
+    const char *dest;               /* Host path the archive root maps to */
+    bool into_dir;                  /* dest is an existing directory: extract inside it */
+    int root_fd;                    /* dest, or its parent outside into_dir mode */
+    char root[PATH_MAX];            /* Host path of root_fd, for messages */
+    char root_name[NAME_MAX + 1];   /* Name of dest inside root_fd outside into_dir mode */
+    
+    unsigned char header[TAR_BLOCK];
+    size_t header_len;
+    uint64_t remaining;             /* Payload bytes left in the current entry */
+    size_t pad;
+    tar_sink_t sink;
+    int fd;
+    char path[PATH_MAX];            /* Current entry, relative to root_fd */
+    time_t mtime;
+    
+    char meta_type;                 /* 'L', 'K' or 'x' while collecting metadata */
+    char *meta;
+    size_t meta_len;
+    char *long_name;                /* Overrides for the next entry */
+    char *long_link;
+    uint64_t pax_size;
+    bool has_pax_size;
+    
+    int zero_blocks;
+    bool done;
+    int error;
+    char error_path[PATH_MAX];
+} tar_reader_t;
+
+static void tar_reader_fail(tar_reader_t *r, int err, const char *path) {
+    if (r->error) return;
+    r->error = err ? err : EIO;
+    snprintf(r->error_path, sizeof(r->error_path), "%s", path ? path : "");
+}
+
+/* Failure on an entry: report it with its host path */
+static void tar_reader_fail_entry(tar_reader_t *r, int err, const char *rel) {
+    if (r->error) return;
+    tar_reader_fail(r, err, r->root);
+    
+    size_t len = strlen(r->error_path);
+    if (len + 1 < sizeof(r->error_path)) {
+        r->error_path[len++] = '/';
+        snprintf(r->error_path + len, sizeof(r->error_path) - len, "%s", rel);
+    }
+}
+
+static void tar_reader_init(tar_reader_t *r, const char *dest) {
+    memset(r, 0, sizeof(*r));
+    r->dest = dest;
+    r->fd = -1;
+    
+    struct stat st;
+    r->into_dir = stat(dest, &st) == 0 && S_ISDIR(st.st_mode);
+    
+    /* dest itself is the caller's and may be a symlink; nothing below it is followed */
+    char buf[PATH_MAX];
+    snprintf(buf, sizeof(buf), "%s", dest);
+    if (r->into_dir) {
+        snprintf(r->root, sizeof(r->root), "%s", dest);
+    } else {
+        snprintf(r->root_name, sizeof(r->root_name), "%s", basename(buf));
+        snprintf(buf, sizeof(buf), "%s", dest);
+        snprintf(r->root, sizeof(r->root), "%s", dirname(buf));
+    }
+    r->root_fd = open(r->root, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (r->root_fd < 0) tar_reader_fail(r, errno, r->root);
+}
+
+static void tar_reader_cleanup(tar_reader_t *r) {
+    if (r->fd >= 0) close(r->fd);
+    r->fd = -1;
+    if (r->root_fd >= 0) close(r->root_fd);
+    r->root_fd = -1;
+    safe_free(r->meta);
+    safe_free(r->long_name);
+    safe_free(r->long_link);
+}
+
+/*
+ * Map an archive name to a path relative to root_fd. Names are relative
+ * to the archive root; "..", absolute paths and empty names never leave
+ * `dest`. Symlinks are handled when the path is opened.
+ */
+static bool tar_map_path(const tar_reader_t *r, const char *name, char *out, size_t size) {
+    char clean[PATH_MAX];
+    size_t clean_len = 0;
+    bool first = true;
+    
+    if (!r->into_dir) {
+        clean_len = strlen(r->root_name);
+        memcpy(clean, r->root_name, clean_len);
+    }
+    
+    while (*name) {
+        while (*name == '/') name++;
+        const char *end = strchr(name, '/');
+        size_t len = end ? (size_t)(end - name) : strlen(name);
+        
+        if (len == 2 && name[0] == '.' && name[1] == '.') return false;
+        
+        bool skip = len == 0 || (len == 1 && name[0] == '.');
+        /* Outside into_dir mode the root component is replaced by dest itself */
+        if (!skip && first && !r->into_dir) {
+            first = false;
+            skip = true;
+        } else if (!skip) {
+            first = false;
+        }
+        
+        if (!skip) {
+            if (clean_len + len + 2 >= sizeof(clean)) return false;
+            if (clean_len > 0) clean[clean_len++] = '/';
+            memcpy(clean + clean_len, name, len);
+            clean_len += len;
+        }
+        name += len;
+    }
+    clean[clean_len] = '\0';
+    
+    int n = snprintf(out, size, "%s", clean);
+    return n >= 0 && (size_t)n < size;
+}
+
+/*
+ * Open the directory holding `rel` below root_fd, one component at a time
+ * and without following symlinks, so an entry can't be written through a
+ * link an earlier entry created. Returns the directory (root_fd itself
+ * for top-level names, do not close it then) and points *leaf at the last
+ * component, or returns -1 with errno set; EPERM when a parent is not a
+ * plain directory.
+ */
+static int tar_open_parent(const tar_reader_t *r, const char *rel, const char **leaf) {
+    int dir = r->root_fd;
+    const char *name = rel;
+    
+    for (;;) {
+        const char *slash = strchr(name, '/');
+        if (!slash) break;
+        
+        char component[NAME_MAX + 1];
+        size_t len = (size_t)(slash - name);
+        if (len > NAME_MAX) {
+            errno = ENAMETOOLONG;
+            goto fail;
+        }
+        memcpy(component, name, len);
+        component[len] = '\0';
+        
+        int next = openat(dir, component, O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        struct stat st;
+        if (next >= 0 && (fstat(next, &st) != 0 || !S_ISDIR(st.st_mode))) {
+            close(next);
+            next = -1;
+            errno = ELOOP;
+        }
+        if (next < 0) {
+            if (errno == ELOOP || errno == ENOTDIR) errno = EPERM;
+            goto fail;
+        }
+        if (dir != r->root_fd) close(dir);
+        dir = next;
+        name = slash + 1;
+    }
+    
+    *leaf = name;
+    return dir;
+    
+fail:
+    if (dir != r->root_fd) {
+        int saved = errno;
+        close(dir);
+        errno = saved;
+    }
+    return -1;
+}
+
+static void tar_close_parent(const tar_reader_t *r, int dir) {
+    if (dir >= 0 && dir != r->root_fd) close(dir);
+}
+
+static void tar_reader_parse_pax(tar_reader_t *r) {
+    const char *p = r->meta;
+    const char *end = r->meta + r->meta_len;
+    
+    /* Records are "<len> <key>=<value>\n" */
+    while (p < end) {
+        char *space = NULL;
+        unsigned long len = strtoul(p, &space, 10);
+        if (!space || *space != ' ' || len == 0 || len > (unsigned long)(end - p)) return;
+        
+        const char *key = space + 1;
+        const char *record_end = p + len;
+        const char *eq = memchr(key, '=', (size_t)(record_end - key));
+        if (eq && record_end[-1] == '\n') {
+            size_t key_len = (size_t)(eq - key);
+            const char *value = eq + 1;
+            size_t value_len = (size_t)(record_end - 1 - value);
+            
+            if (key_len == 4 && memcmp(key, "path", 4) == 0) {
+                free(r->long_name);
+                r->long_name = strndup(value, value_len);
+            } else if (key_len == 8 && memcmp(key, "linkpath", 8) == 0) {
+                free(r->long_link);
+                r->long_link = strndup(value, value_len);
+            } else if (key_len == 4 && memcmp(key, "size", 4) == 0) {
+                r->pax_size = strtoull(value, NULL, 10);
+                r->has_pax_size = true;
+            }
+        }
+        p = record_end;
+    }
+}
+
+/* End of an entry's payload */
+static void tar_reader_end_entry(tar_reader_t *r) {
+    if (r->sink == TAR_SINK_FILE && r->fd >= 0) {
+        struct timespec times[2] = { { 0, UTIME_OMIT }, { r->mtime, 0 } };
+        futimens(r->fd, times);
+        if (close(r->fd) != 0) tar_reader_fail_entry(r, errno, r->path);
+        r->fd = -1;
+    } else if (r->sink == TAR_SINK_META) {
+        if (r->meta_type == 'x') {
+            tar_reader_parse_pax(r);
+        } else {
+            char **target = r->meta_type == 'L' ? &r->long_name : &r->long_link;
+            free(*target);
+            *target = strndup(r->meta ? r->meta : "", r->meta_len);
+        }
+        r->meta_len = 0;
+    }
+    r->sink = TAR_SINK_SKIP;
+}
+
+static void tar_reader_header(tar_reader_t *r) {
+    const unsigned char *h = r->header;
+    
+    bool zero = true;
+    for (size_t i = 0; i < TAR_BLOCK && zero; i++) zero = h[i] == 0;
+    if (zero) {
+        if (++r->zero_blocks >= 2) r->done = true;
+        return;
+    }
+    r->zero_blocks = 0;
+    
+    uint64_t checksum = 0;
+    if (!tar_get_number(h + 148, 8, &checksum) || checksum != tar_checksum(h)) {
+        tar_reader_fail(r, EILSEQ, "tar header checksum");
+        return;
+    }
+    
+    char type = (char)h[156];
+    uint64_t size = 0;
+    tar_get_number(h + 124, 12, &size);
+    if (r->has_pax_size && type != 'x' && type != 'g') size = r->pax_size;
+    
+    r->remaining = size;
+    r->pad = tar_padding(size);
+    r->sink = TAR_SINK_SKIP;
+    
+    if (type == 'L' || type == 'K' || type == 'x') {
+        if (size > TAR_MAX_META) {
+            tar_reader_fail(r, E2BIG, "tar metadata");
+            return;
+        }
+        char *meta = realloc(r->meta, (size_t)size + 1);
+        if (!meta) {
+            tar_reader_fail(r, ENOMEM, "tar metadata");
+            return;
+        }
+        r->meta = meta;
+        r->meta_len = 0;
+        r->meta_type = type;
+        r->sink = TAR_SINK_META;
+        if (size == 0) tar_reader_end_entry(r);
+        return;
+    }
+    if (type == 'g') return;        /* Global pax headers carry nothing we use */
+    
+    /* Entry name: GNU/pax override, else ustar prefix + name */
+    char name[PATH_MAX];
+    if (r->long_name) {
+        snprintf(name, sizeof(name), "%s", r->long_name);
+    } else if (memcmp(h + 257, "ustar", 5) == 0 && h[345]) {
+        snprintf(name, sizeof(name), "%.155s/%.100s", (const char *)h + 345, (const char *)h);
+    } else {
+        snprintf(name, sizeof(name), "%.100s", (const char *)h);
+    }
+    char link_name[PATH_MAX];
+    snprintf(link_name, sizeof(link_name), "%.*s", r->long_link ? PATH_MAX - 1 : 100,
+             r->long_link ? r->long_link : (const char *)h + 157);
+    
+    safe_free(r->long_name);
+    safe_free(r->long_link);
+    r->has_pax_size = false;
+    
+    if (!tar_map_path(r, name, r->path, sizeof(r->path))) {
+        tar_reader_fail(r, EPERM, name);
+        return;
+    }
+    if (type != '0' && type != '\0' && type != '7' && type != '5' && type != '2' && type != '1') {
+        return;                     /* Devices and fifos are not recreated */
+    }
+    if (!r->path[0]) {
+        /* The archive root in into_dir mode is dest itself */
+        if (type != '5') tar_reader_fail(r, EPERM, r->dest);
+        return;
+    }
+    
+    const char *leaf = NULL;
+    int dir = tar_open_parent(r, r->path, &leaf);
+    if (dir < 0) {
+        tar_reader_fail_entry(r, errno, r->path);
+        return;
+    }
+    
+    uint64_t mode = 0, mtime = 0;
+    tar_get_number(h + 100, 8, &mode);
+    tar_get_number(h + 136, 12, &mtime);
+    r->mtime = (time_t)mtime;
+    
+    switch (type) {
+        case '0':
+        case '\0':
+        case '7':
+            unlinkat(dir, leaf, 0); /* Never write through an existing symlink */
+            r->fd = openat(dir, leaf, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC,
+                           (mode_t)(mode & 07777));
+            if (r->fd < 0) {
+                tar_reader_fail_entry(r, errno, r->path);
+                break;
+            }
+            r->sink = TAR_SINK_FILE;
+            if (size == 0) tar_reader_end_entry(r);
+            break;
+        case '5':
+            if (mkdirat(dir, leaf, (mode_t)(mode & 07777)) != 0 && errno != EEXIST) {
+                tar_reader_fail_entry(r, errno, r->path);
+            }
+            break;
+        case '2':
+            /* Created as is; later entries never resolve through it */
+            unlinkat(dir, leaf, 0);
+            if (symlinkat(link_name, dir, leaf) != 0) tar_reader_fail_entry(r, errno, r->path);
+            break;
+        case '1': {
+            char target[PATH_MAX];
+            if (!tar_map_path(r, link_name, target, sizeof(target)) || !target[0]) {
+                tar_reader_fail(r, EPERM, link_name);
+                break;
+            }
+            const char *target_leaf = NULL;
+            int target_dir = tar_open_parent(r, target, &target_leaf);
+            if (target_dir < 0) {
+                tar_reader_fail_entry(r, errno, target);
+                break;
+            }
+            /* Without AT_SYMLINK_FOLLOW a symlink target is linked, not what it points to */
+            unlinkat(dir, leaf, 0);
+            if (linkat(target_dir, target_leaf, dir, leaf, 0) != 0) tar_reader_fail_entry(r, errno, r->path);
+            tar_close_parent(r, target_dir);
+            break;
+        }
+    }
+    tar_close_parent(r, dir);
+}
+
+/* CURLOPT_WRITEFUNCTION: extract as the archive arrives */
+static size_t tar_write_callback(char *contents, size_t size, size_t nmemb, void *userdata) {
+    tar_reader_t *r = userdata;
+    size_t total_size = size * nmemb;
+    size_t offset = 0;
+    
+    while (offset < total_size && !r->done && !r->error) {
+        size_t avail = total_size - offset;
+        
+        if (r->remaining > 0) {
+            size_t n = avail < r->remaining ? avail : (size_t)r->remaining;
+            if (r->sink == TAR_SINK_FILE) {
+                size_t written = 0;
+                while (written < n) {
+                    ssize_t w = write(r->fd, contents + offset + written, n - written);
+                    if (w < 0) {
+                        if (errno == EINTR) continue;
+                        tar_reader_fail_entry(r, errno, r->path);
+                        return 0;
+                    }
+                    written += (size_t)w;
+                }
+            } else if (r->sink == TAR_SINK_META) {
+                memcpy(r->meta + r->meta_len, contents + offset, n);
+                r->meta_len += n;
+            }
+            r->remaining -= n;
+            offset += n;
+            if (r->remaining == 0) tar_reader_end_entry(r);
+            continue;
+        }
+        
+        if (r->pad > 0) {
+            size_t n = avail < r->pad ? avail : r->pad;
+            r->pad -= n;
+            offset += n;
+            continue;
+        }
+        
+        size_t n = TAR_BLOCK - r->header_len;
+        if (n > avail) n = avail;
+        memcpy(r->header + r->header_len, contents + offset, n);
+        r->header_len += n;
+        offset += n;
+        if (r->header_len == TAR_BLOCK) {
+            r->header_len = 0;
+            tar_reader_header(r);
+        }
+    }
+    
+    /* Anything after the end-of-archive marker is ignored */
+    return r->error ? 0 : total_size;
+}
+
+/* ----------------- File Operations Implementation ----------------- */
+
+static bool build_archive_endpoint(char *endpoint, size_t size, const char *container_id, const char *path) {
+    if (!build_resource_endpoint(endpoint, size, "/containers/", container_id, "/archive?path=")) return false;
+    size_t len = strlen(endpoint);
+    return build_resource_endpoint(endpoint + len, size - len, "", path, NULL);
+}
+
+docker_excess_error_t docker_excess_copy_to_container(docker_excess_t *client, const char *container_id,
+                                                     const char *host_path, const char *container_path) {
+    if (!client || !container_id || !host_path || !container_path) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char endpoint[DOCKER_EXCESS_MAX_URL_LEN];
+    if (!build_archive_endpoint(endpoint, sizeof(endpoint), container_id, container_path)) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    /* The archive root is named after the source, like docker cp */
+    char base_buf[PATH_MAX];
+    snprintf(base_buf, sizeof(base_buf), "%s", host_path);
+    const char *archive_name = basename(base_buf);
+    
+    tar_writer_t *writer = malloc(sizeof(tar_writer_t));
+    if (!writer) return DOCKER_EXCESS_ERR_MEMORY;
+    if (!tar_writer_init(writer, host_path, archive_name)) {
+        free(writer);
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    /* Fail before any bytes go out if the source is unreadable */
+    docker_excess_error_t err = DOCKER_EXCESS_OK;
+    if (access(host_path, R_OK) != 0) {
+        set_error(client, "Cannot read %s: %s", host_path, strerror(errno));
+        err = map_errno(errno);
+    }
+    
+    /* The daemon inflates gzip archives itself */
+    gzip_upload_t *gz = NULL;
+    if (err == DOCKER_EXCESS_OK && client->config.compression) {
+        gz = gzip_upload_new(tar_read_callback, writer);
+        if (!gz) err = DOCKER_EXCESS_ERR_MEMORY;
+    }
+    
+    if (err == DOCKER_EXCESS_OK) {
+        response_buffer_t response = {0};
+        request_opts_t opts = {
+            .method = "PUT",
+            .endpoint = endpoint,
+            .read_fn = gz ? gzip_upload_read : tar_read_callback,
+            .read_data = gz ? (void *)gz : (void *)writer,
+            .upload_size = -1,
+            .headers = client->tar_headers,
+            .write_fn = (curl_write_callback)write_response_callback,
+            .write_data = &response,
+            .timeout_ms = -1,
+        };
+        err = perform_request(client, &opts, NULL, NULL);
+        safe_free(response.data);
+        
+        if (writer->error) {
+            set_error(client, "Failed to archive %s: %s", writer->error_path, strerror(writer->error));
+            err = map_errno(writer->error);
+        }
+    }
+    
+    gzip_upload_free(gz);
+    tar_writer_cleanup(writer);
+    free(writer);
+    return err;
+}
+
+docker_excess_error_t docker_excess_copy_from_container(docker_excess_t *client, const char *container_id,
+                                                       const char *container_path, const char *host_path) {
+    if (!client || !container_id || !container_path || !host_path) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char endpoint[DOCKER_EXCESS_MAX_URL_LEN];
+    if (!build_archive_endpoint(endpoint, sizeof(endpoint), container_id, container_path)) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    tar_reader_t *reader = malloc(sizeof(tar_reader_t));
+    if (!reader) return DOCKER_EXCESS_ERR_MEMORY;
+    tar_reader_init(reader, host_path);
+    
+    request_opts_t opts = {
+        .method = "GET",
+        .endpoint = endpoint,
+        .write_fn = tar_write_callback,
+        .write_data = reader,
+        .timeout_ms = -1,
+        .fail_on_error = true,
+    };
+    docker_excess_error_t err = DOCKER_EXCESS_OK;
+    if (!reader->error) err = perform_request(client, &opts, NULL, NULL);
+    
+    if (reader->error) {
+        set_error(client, "Failed to extract %s: %s", reader->error_path, strerror(reader->error));
+        err = map_errno(reader->error);
+    } else if (err == DOCKER_EXCESS_OK && (reader->remaining > 0 || reader->header_len > 0)) {
+        set_error(client, "Truncated archive from %s", container_path);
+        err = DOCKER_EXCESS_ERR_INTERNAL;
+    }
+    
+    tar_reader_cleanup(reader);
+    free(reader);
+    return err;
+}
+
+/* Segments sent in order; a NULL base stands for zeros */
+typedef struct {
+    struct {
+        const void *base;
+        size_t len;
+    } parts[3];
+    size_t count;
+    size_t index;
+    size_t offset;
+} segment_body_t;
+
+static size_t segment_body_read(void *buffer, size_t size, void *userdata) {
+    segment_body_t *body = userdata;
+    size_t out = 0;
+    
+    while (out < size && body->index < body->count) {
+        size_t left = body->parts[body->index].len - body->offset;
+        size_t n = left < size - out ? left : size - out;
+        const unsigned char *base = body->parts[body->index].base;
+        
+        if (base) memcpy((char *)buffer + out, base + body->offset, n);
+        else memset((char *)buffer + out, 0, n);
+        out += n;
+        body->offset += n;
+        if (body->offset == body->parts[body->index].len) {
+            body->index++;
+            body->offset = 0;
+        }
+    }
+    return out;
+}
+
+docker_excess_error_t docker_excess_put_archive(docker_excess_t *client, const char *container_id,
+                                               const char *container_path, const docker_excess_body_t *archive) {
+    if (!client || !container_id || !container_path || !archive) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char endpoint[DOCKER_EXCESS_MAX_URL_LEN];
+    if (!build_archive_endpoint(endpoint, sizeof(endpoint), container_id, container_path)) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    docker_excess_body_t body = *archive;
+    if (!body.content_type) body.content_type = "application/x-tar";
+    
+    response_buffer_t response = {0};
+    docker_excess_error_t err = make_request_body(client, "PUT", endpoint, &body, -1,
+                                                  (curl_write_callback)write_response_callback, &response,
+                                                  NULL, NULL);
+    safe_free(response.data);
+    return err;
+}
+
+docker_excess_error_t docker_excess_write_file(docker_excess_t *client, const char *container_id,
+                                              const char *file_path, const char *content, size_t size,
+                                              uint32_t mode) {
+    if (!client || !container_id || !file_path || (!content && size > 0)) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char dir_buf[PATH_MAX];
+    char base_buf[PATH_MAX];
+    if (strlen(file_path) >= sizeof(dir_buf)) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    snprintf(dir_buf, sizeof(dir_buf), "%s", file_path);
+    snprintf(base_buf, sizeof(base_buf), "%s", file_path);
+    const char *dir = dirname(dir_buf);
+    const char *name = basename(base_buf);
+    if (!name[0] || strcmp(name, "/") == 0 || strcmp(name, ".") == 0) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    /* A one-entry tar: header, the caller's bytes as they are, padding and trailer */
+    tar_writer_t *header_writer = calloc(1, sizeof(tar_writer_t));
+    if (!header_writer) return DOCKER_EXCESS_ERR_MEMORY;
+    header_writer->fd = -1;
+    
+    struct stat st = {0};
+    st.st_mode = (mode_t)(mode ? mode : 0644);
+    st.st_size = (off_t)size;
+    st.st_mtime = time(NULL);
+    
+    docker_excess_error_t err = DOCKER_EXCESS_OK;
+    if (!tar_stage_header(header_writer, name, &st, '0', NULL)) err = DOCKER_EXCESS_ERR_MEMORY;
+    
+    if (err == DOCKER_EXCESS_OK) {
+        segment_body_t segments = {
+            .parts = {
+                { header_writer->stage, header_writer->stage_len },
+                { content, size },
+                { NULL, tar_padding(size) + 2 * TAR_BLOCK },
+            },
+            .count = 3,
+        };
+        docker_excess_body_t body = {
+            .type = DOCKER_EXCESS_BODY_CALLBACK,
+            .read = segment_body_read,
+            .userdata = &segments,
+            .length = (int64_t)(header_writer->stage_len + size + tar_padding(size) + 2 * TAR_BLOCK),
+            .content_type = "application/x-tar",
+        };
+        err = docker_excess_put_archive(client, container_id, dir, &body);
+    }
+    
+    tar_writer_cleanup(header_writer);
+    free(header_writer);
+    return err;
+}
+
+/* ----------------- Build Context ----------------- */
+
+/*
+ * The context is walked by a small thread pool, filtered through the
+ * compiled .dockerignore and sorted, so archives are deterministic. Every
+ * entry becomes its own gzip member (concatenated members are one valid
+ * gzip stream to the daemon): workers compress small entries ahead of the
+ * upload within a bounded window, large files are deflated by the
+ * uploader straight into curl's buffer. A docker_excess_build_context_t
+ * keeps the compressed members of unchanged files, keyed by size, inode,
+ * mtime and ctime, so the next build neither reads nor recompresses them.
+ */
+
+#define PACK_MAX_THREADS 8
+#define PACK_WINDOW 64              /* Entries compressed ahead of the upload */
+#define PACK_INLINE_MAX (1024 * 1024) /* Larger files are compressed while uploading */
+#define PACK_CHUNK (64 * 1024)
+
+/* --- .dockerignore --- */
+
+typedef struct {
+    char **segments;                /* Path components; "**" matches any number of them */
+    size_t count;
+    bool negate;
+} ignore_pattern_t;
+
+typedef struct {
+    ignore_pattern_t *patterns;
+    size_t count;
+    bool has_negation;
+} ignore_rules_t;
+
+/* filepath.Match for one path component: * ? [...] and \ escapes */
+static bool glob_match(const char *pattern, const char *str) {
+    while (*pattern) {
+        char c = *pattern++;
+        switch (c) {
+            case '*':
+                while (*pattern == '*') pattern++;
+                if (!*pattern) return true;
+                for (; *str; str++) {
+                    if (glob_match(pattern, str)) return true;
+                }
+                return glob_match(pattern, str);
+            case '?':
+                if (!*str) return false;
+                str++;
+                break;
+            case '[': {
+                if (!*str) return false;
+                bool negate = *pattern == '^' || *pattern == '!';
+                if (negate) pattern++;
+                bool matched = false;
+                bool first = true;
+                while (*pattern && (first || *pattern != ']')) {
+                    first = false;
+                    unsigned char lo = (unsigned char)*pattern++;
+                    if (lo == '\\' && *pattern) lo = (unsigned char)*pattern++;
+                    unsigned char hi = lo;
+                    if (pattern[0] == '-' && pattern[1] && pattern[1] != ']') {
+                        pattern++;
+                        hi = (unsigned char)*pattern++;
+                        if (hi == '\\' && *pattern) hi = (unsigned char)*pattern++;
+                    }
+                    if ((unsigned char)*str >= lo && (unsigned char)*str <= hi) matched = true;
+                }
+                if (*pattern != ']') return false;
+                pattern++;
+                if (matched == negate) return false;
+                str++;
+                break;
+            }
+            case '\\':
+                if (*pattern) c = *pattern++;
+                /* fallthrough */
+            default:
+                if (*str != c) return false;
+                str++;
+                break;
+        }
+    }
+    return *str == '\0';
+}
+
+static bool ignore_match_segments(char *const *segments, size_t count, char *const *components, size_t ncomponents) {
+    if (count == 0) return ncomponents == 0;
+    
+    if (strcmp(segments[0], "**") == 0) {
+        for (size_t skip = 0; skip <= ncomponents; skip++) {
+            if (ignore_match_segments(segments + 1, count - 1, components + skip, ncomponents - skip)) return true;
+        }
+        return false;
+    }
+    
+    return ncomponents > 0 && glob_match(segments[0], components[0]) &&
+           ignore_match_segments(segments + 1, count - 1, components + 1, ncomponents - 1);
+}
+
+static void ignore_rules_free(ignore_rules_t *rules) {
+    for (size_t i = 0; i < rules->count; i++) {
+        for (size_t j = 0; j < rules->patterns[i].count; j++) {
+            free(rules->patterns[i].segments[j]);
+        }
+        free(rules->patterns[i].segments);
+    }
+    safe_free(rules->patterns);
+    rules->count = 0;
+}
+
+/* Split a cleaned pattern into components, resolving "." and ".." like filepath.Clean */
+static bool ignore_compile_pattern(ignore_pattern_t *pattern, const char *text) {
+    size_t capacity = 4;
+    pattern->segments = malloc(capacity * sizeof(char*));
+    if (!pattern->segments) return false;
+    
+    while (*text) {
+        while (*text == '/') text++;
+        const char *end = strchr(text, '/');
+        size_t len = end ? (size_t)(end - text) : strlen(text);
+        
+        if (len == 2 && text[0] == '.' && text[1] == '.') {
+            if (pattern->count > 0) free(pattern->segments[--pattern->count]);
+        } else if (len > 0 && !(len == 1 && text[0] == '.')) {
+            if (pattern->count == capacity) {
+                capacity *= 2;
+                char **segments = realloc(pattern->segments, capacity * sizeof(char*));
+                if (!segments) return false;
+                pattern->segments = segments;
+            }
+            pattern->segments[pattern->count] = strndup(text, len);
+            if (!pattern->segments[pattern->count]) return false;
+            pattern->count++;
+        }
+        text += len;
+    }
+    return true;
+}
+
+static docker_excess_error_t ignore_rules_load(ignore_rules_t *rules, const char *context_path) {
+    memset(rules, 0, sizeof(*rules));
+    
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/.dockerignore", context_path);
+    FILE *file = fopen(path, "r");
+    if (!file) return errno == ENOENT ? DOCKER_EXCESS_OK : map_errno(errno);
+    
+    docker_excess_error_t err = DOCKER_EXCESS_OK;
+    size_t capacity = 0;
+    char line[PATH_MAX];
+    
+    while (err == DOCKER_EXCESS_OK && fgets(line, sizeof(line), file)) {
+        char *text = line;
+        while (isspace((unsigned char)*text)) text++;
+        size_t len = strlen(text);
+        while (len > 0 && isspace((unsigned char)text[len - 1])) text[--len] = '\0';
+        if (len == 0 || text[0] == '#') continue;
+        
+        bool negate = text[0] == '!';
+        if (negate) {
+            text++;
+            while (isspace((unsigned char)*text)) text++;
+        }
+        
+        if (rules->count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            ignore_pattern_t *patterns = realloc(rules->patterns, capacity * sizeof(ignore_pattern_t));
+            if (!patterns) {
+                err = DOCKER_EXCESS_ERR_MEMORY;
+                break;
+            }
+            rules->patterns = patterns;
+        }
+        ignore_pattern_t *pattern = &rules->patterns[rules->count++];
+        memset(pattern, 0, sizeof(*pattern));
+        pattern->negate = negate;
+        if (!ignore_compile_pattern(pattern, text)) err = DOCKER_EXCESS_ERR_MEMORY;
+        if (negate) rules->has_negation = true;
+    }
+    
+    fclose(file);
+    if (err != DOCKER_EXCESS_OK) ignore_rules_free(rules);
+    return err;
+}
+
+/*
+ * A pattern excludes a path if it matches the path or any parent, as in
+ * moby's patternmatcher; `matched` carries the per-pattern parent results
+ * down the walk. The last matching pattern decides.
+ */
+static bool ignore_rules_excluded(const ignore_rules_t *rules, const char *rel_path,
+                                  const bool *parent_matched, bool *matched) {
+    if (rules->count == 0) return false;
+    
+    char buffer[PATH_MAX];
+    char *components[PATH_MAX / 2];
+    size_t ncomponents = 0;
+    snprintf(buffer, sizeof(buffer), "%s", rel_path);
+    for (char *save = NULL, *part = strtok_r(buffer, "/", &save); part; part = strtok_r(NULL, "/", &save)) {
+        components[ncomponents++] = part;
+    }
+    
+    bool excluded = false;
+    for (size_t i = 0; i < rules->count; i++) {
+        const ignore_pattern_t *pattern = &rules->patterns[i];
+        matched[i] = (parent_matched && parent_matched[i]) ||
+                     ignore_match_segments(pattern->segments, pattern->count, components, ncomponents);
+        if (matched[i]) excluded = !pattern->negate;
+    }
+    return excluded;
+}
+
+/* --- Manifest --- */
+
+typedef struct {
+    char *path;
+    ino_t ino;
+    off_t size;
+    mode_t mode;
+    struct timespec mtime;
+    struct timespec ctime;
+    uint32_t crc;                   /* CRC-32 of the payload */
+    unsigned char *member;          /* Compressed entry, NULL if not kept */
+    size_t member_len;
+} manifest_entry_t;
+
+struct docker_excess_build_context {
+    size_t cache_bytes;             /* Budget for kept members */
+    manifest_entry_t *entries;      /* Sorted by path */
+    size_t count;
+    char digest[17];
+    pthread_mutex_t mutex;          /* One build per context at a time */
+};
+
+static void manifest_entries_free(manifest_entry_t *entries, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(entries[i].path);
+        free(entries[i].member);
+    }
+    free(entries);
+}
+
+docker_excess_build_context_t* docker_excess_build_context_new(size_t cache_bytes) {
+    docker_excess_build_context_t *ctx = calloc(1, sizeof(docker_excess_build_context_t));
+    if (!ctx) return NULL;
+    
+    if (pthread_mutex_init(&ctx->mutex, NULL) != 0) {
+        free(ctx);
+        return NULL;
+    }
+    ctx->cache_bytes = cache_bytes;
+    return ctx;
+}
+
+void docker_excess_build_context_free(docker_excess_build_context_t *ctx) {
+    if (!ctx) return;
+    manifest_entries_free(ctx->entries, ctx->count);
+    pthread_mutex_destroy(&ctx->mutex);
+    free(ctx);
+}
+
+const char* docker_excess_build_context_digest(const docker_excess_build_context_t *ctx) {
+    return ctx && ctx->digest[0] ? ctx->digest : NULL;
+}
+
+static manifest_entry_t* manifest_find(docker_excess_build_context_t *ctx, const char *path) {
+    size_t lo = 0, hi = ctx ? ctx->count : 0;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(ctx->entries[mid].path, path);
+        if (cmp == 0) return &ctx->entries[mid];
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return NULL;
+}
+
+static bool manifest_unchanged(const manifest_entry_t *entry, const struct stat *st) {
+    return entry->member && entry->ino == st->st_ino && entry->size == st->st_size &&
+           entry->mode == st->st_mode &&
+           entry->mtime.tv_sec == st->st_mtim.tv_sec && entry->mtime.tv_nsec == st->st_mtim.tv_nsec &&
+           entry->ctime.tv_sec == st->st_ctim.tv_sec && entry->ctime.tv_nsec == st->st_ctim.tv_nsec;
+}
+
+/* --- Walk --- */
+
+typedef struct {
+    char *path;                     /* Relative to the context root */
+    struct stat st;
+    char *link_target;
+    uint32_t crc;
+    unsigned char *member;          /* NULL with `streamed` = compressed during upload */
+    size_t member_len;
+    manifest_entry_t *previous;     /* Owner of `member` when it was reused */
+    bool streamed;
+    bool ready;
+} pack_entry_t;
+
+typedef struct pack_dir {
+    struct pack_dir *next;
+    bool *matched;                  /* Parent results per ignore pattern */
+    char path[];
+} pack_dir_t;
+
+typedef struct {
+    const char *root;
+    const char *dockerfile;         /* Always included, relative to root */
+    ignore_rules_t rules;
+    docker_excess_build_context_t *ctx;
+    
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    
+    /* Walk */
+    pack_dir_t *dirs;
+    size_t busy;                    /* Workers inside a directory */
+    pack_entry_t *entries;
+    size_t count;
+    size_t capacity;
+    
+    /* Compression pipeline */
+    size_t next_job;
+    size_t consumed;
+    atomic_bool abort;              /* Also polled by the walk without the lock */
+    int error;
+    char error_path[PATH_MAX];
+    
+    /* Upload side */
+    size_t current;
+    size_t member_offset;
+    struct entry_deflater *streaming;
+    bool streaming_entry;           /* `streaming` holds the current entry */
+    unsigned char trailer[64];      /* Two zero blocks as a gzip member */
+    size_t trailer_len;
+    size_t trailer_off;
+} packer_t;
+
+static void packer_fail(packer_t *packer, int err, const char *path) {
+    pthread_mutex_lock(&packer->mutex);
+    if (!packer->error) {
+        packer->error = err ? err : EIO;
+        snprintf(packer->error_path, sizeof(packer->error_path), "%s", path ? path : "");
+    }
+    packer->abort = true;
+    pthread_cond_broadcast(&packer->cond);
+    pthread_mutex_unlock(&packer->mutex);
+}
+
+static bool packer_push_dir(packer_t *packer, const char *path, const bool *matched) {
+    size_t len = strlen(path);
+    pack_dir_t *dir = malloc(sizeof(pack_dir_t) + len + 1);
+    if (!dir) return false;
+    
+    dir->matched = NULL;
+    if (packer->rules.count > 0) {
+        dir->matched = malloc(packer->rules.count * sizeof(bool));
+        if (!dir->matched) {
+            free(dir);
+            return false;
+        }
+        if (matched) memcpy(dir->matched, matched, packer->rules.count * sizeof(bool));
+        else memset(dir->matched, 0, packer->rules.count * sizeof(bool));
+    }
+    memcpy(dir->path, path, len + 1);
+    
+    pthread_mutex_lock(&packer->mutex);
+    dir->next = packer->dirs;
+    packer->dirs = dir;
+    pthread_cond_signal(&packer->cond);
+    pthread_mutex_unlock(&packer->mutex);
+    return true;
+}
+
+static bool packer_add_entry(packer_t *packer, const char *path, const struct stat *st, const char *link_target) {
+    pack_entry_t entry = { .st = *st };
+    entry.st.st_uid = 0;            /* Owned by root in the image, as with docker build */
+    entry.st.st_gid = 0;
+    entry.path = strdup(path);
+    if (link_target) entry.link_target = strdup(link_target);
+    if (!entry.path || (link_target && !entry.link_target)) {
+        free(entry.path);
+        free(entry.link_target);
+        return false;
+    }
+    
+    pthread_mutex_lock(&packer->mutex);
+    if (packer->count == packer->capacity) {
+        size_t capacity = packer->capacity ? packer->capacity * 2 : 1024;
+        pack_entry_t *entries = realloc(packer->entries, capacity * sizeof(pack_entry_t));
+        if (!entries) {
+            pthread_mutex_unlock(&packer->mutex);
+            free(entry.path);
+            free(entry.link_target);
+            return false;
+        }
+        packer->entries = entries;
+        packer->capacity = capacity;
+    }
+    packer->entries[packer->count++] = entry;
+    pthread_mutex_unlock(&packer->mutex);
+    return true;
+}
+
+/* True if the Dockerfile lives below this directory, which then must not be pruned */
+static bool packer_dir_holds_dockerfile(const packer_t *packer, const char *rel_path) {
+    size_t len = strlen(rel_path);
+    return packer->dockerfile && strncmp(packer->dockerfile, rel_path, len) == 0 && packer->dockerfile[len] == '/';
+}
+
+static void packer_walk_dir(packer_t *packer, pack_dir_t *dir, bool *matched) {
+    char host_path[PATH_MAX];
+    int n = snprintf(host_path, sizeof(host_path), "%s%s%s", packer->root, dir->path[0] ? "/" : "", dir->path);
+    if (n < 0 || (size_t)n >= sizeof(host_path)) {
+        packer_fail(packer, ENAMETOOLONG, dir->path);
+        return;
+    }
+    
+    DIR *handle = opendir(host_path);
+    if (!handle) {
+        packer_fail(packer, errno, host_path);
+        return;
+    }
+    
+    struct dirent *dent;
+    while ((dent = readdir(handle)) && !packer->abort) {
+        if (strcmp(dent->d_name, ".") == 0 || strcmp(dent->d_name, "..") == 0) continue;
+        
+        char rel_path[PATH_MAX];
+        char full_path[PATH_MAX];
+        n = snprintf(rel_path, sizeof(rel_path), "%s%s%s", dir->path, dir->path[0] ? "/" : "", dent->d_name);
+        int m = snprintf(full_path, sizeof(full_path), "%s/%s", host_path, dent->d_name);
+        if (n < 0 || (size_t)n >= sizeof(rel_path) || m < 0 || (size_t)m >= sizeof(full_path)) {
+            packer_fail(packer, ENAMETOOLONG, rel_path);
+            break;
+        }
+        
+        struct stat st;
+        if (lstat(full_path, &st) != 0) {
+            packer_fail(packer, errno, full_path);
+            break;
+        }
+        
+        bool excluded = ignore_rules_excluded(&packer->rules, rel_path, dir->matched, matched);
+        if (excluded && (strcmp(rel_path, ".dockerignore") == 0 ||
+                         (packer->dockerfile && strcmp(rel_path, packer->dockerfile) == 0))) {
+            excluded = false;
+        }
+        
+        bool ok = true;
+        if (S_ISDIR(st.st_mode)) {
+            /* Negated patterns may re-include something below an excluded directory */
+            if (!excluded) ok = packer_add_entry(packer, rel_path, &st, NULL);
+            if (ok && (!excluded || packer->rules.has_negation || packer_dir_holds_dockerfile(packer, rel_path))) {
+                ok = packer_push_dir(packer, rel_path, matched);
+            }
+        } else if (!excluded && S_ISREG(st.st_mode)) {
+            ok = packer_add_entry(packer, rel_path, &st, NULL);
+        } else if (!excluded && S_ISLNK(st.st_mode)) {
+            char target[PATH_MAX];
+            ssize_t len = readlink(full_path, target, sizeof(target) - 1);
+            if (len < 0) {
+                packer_fail(packer, errno, full_path);
+                break;
+            }
+            target[len] = '\0';
+            ok = packer_add_entry(packer, rel_path, &st, target);
+        }
+        if (!ok) {
+            packer_fail(packer, ENOMEM, rel_path);
+            break;
+        }
+    }
+    closedir(handle);
+}
+
+static void* packer_walk_worker(void *arg) {
+    packer_t *packer = arg;
+    bool *matched = packer->rules.count ? malloc(packer->rules.count * sizeof(bool)) : NULL;
+    if (packer->rules.count && !matched) {
+        packer_fail(packer, ENOMEM, NULL);
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&packer->mutex);
+    for (;;) {
+        while (!packer->dirs && packer->busy > 0 && !packer->abort) {
+            pthread_cond_wait(&packer->cond, &packer->mutex);
+        }
+        if (!packer->dirs || packer->abort) break;
+        
+        pack_dir_t *dir = packer->dirs;
+        packer->dirs = dir->next;
+        packer->busy++;
+        pthread_mutex_unlock(&packer->mutex);
+        
+        packer_walk_dir(packer, dir, matched);
+        free(dir->matched);
+        free(dir);
+        
+        pthread_mutex_lock(&packer->mutex);
+        packer->busy--;
+        if (packer->busy == 0 && !packer->dirs) pthread_cond_broadcast(&packer->cond);
+    }
+    pthread_mutex_unlock(&packer->mutex);
+    
+    free(matched);
+    return NULL;
+}
+
+/* --- Compression --- */
+
+/* Deflates one tar entry (header, payload, padding) into a gzip member */
+typedef struct entry_deflater {
+    z_stream zs;
+    bool zs_ready;
+    tar_writer_t header;            /* Only its stage buffer is used */
+    size_t header_off;
+    int fd;
+    uint64_t file_left;
+    size_t pad_left;
+    uint32_t crc;
+    bool input_done;
+    const char *path;
+    unsigned char in[PACK_CHUNK];
+} entry_deflater_t;
+
+static entry_deflater_t* entry_deflater_new(void) {
+    entry_deflater_t *d = calloc(1, sizeof(entry_deflater_t));
+    if (d) {
+        d->fd = -1;
+        d->header.fd = -1;
+    }
+    return d;
+}
+
+static void entry_deflater_end(entry_deflater_t *d) {
+    if (d->zs_ready) deflateEnd(&d->zs);
+    d->zs_ready = false;
+    if (d->fd >= 0) close(d->fd);
+    d->fd = -1;
+}
+
+static void entry_deflater_free(entry_deflater_t *d) {
+    if (!d) return;
+    entry_deflater_end(d);
+    tar_writer_cleanup(&d->header);
+    free(d);
+}
+
+static int entry_deflater_start(entry_deflater_t *d, const packer_t *packer, const pack_entry_t *entry) {
+    entry_deflater_end(d);
+    d->header.stage_len = 0;
+    d->header_off = 0;
+    d->file_left = 0;
+    d->pad_left = 0;
+    d->crc = (uint32_t)crc32(0L, Z_NULL, 0);
+    d->input_done = false;
+    d->path = entry->path;
+    
+    char name[PATH_MAX + 2];
+    bool is_dir = S_ISDIR(entry->st.st_mode);
+    snprintf(name, sizeof(name), "%s%s", entry->path, is_dir ? "/" : "");
+    char type = is_dir ? '5' : entry->link_target ? '2' : '0';
+    if (!tar_stage_header(&d->header, name, &entry->st, type, entry->link_target)) return ENOMEM;
+    
+    if (type == '0') {
+        char full_path[PATH_MAX];
+        snprintf(full_path, sizeof(full_path), "%s/%s", packer->root, entry->path);
+        d->fd = open(full_path, O_RDONLY | O_CLOEXEC);
+        if (d->fd < 0) return errno;
+        d->file_left = (uint64_t)entry->st.st_size;
+        d->pad_left = tar_padding((uint64_t)entry->st.st_size);
+    }
+    
+    if (deflateInit2(&d->zs, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return ENOMEM;
+    d->zs_ready = true;
+    return 0;
+}
+
+/* Deflate into out; returns 1 when the member is complete, 0 if out filled up, or -errno */
+static int entry_deflater_run(entry_deflater_t *d, unsigned char *out, size_t out_len, size_t *produced) {
+    d->zs.next_out = out;
+    d->zs.avail_out = (uInt)out_len;
+    
+    while (d->zs.avail_out > 0) {
+        if (d->zs.avail_in == 0 && !d->input_done) {
+            if (d->header_off < d->header.stage_len) {
+                d->zs.next_in = d->header.stage + d->header_off;
+                d->zs.avail_in = (uInt)(d->header.stage_len - d->header_off);
+                d->header_off = d->header.stage_len;
+            } else if (d->file_left > 0) {
+                size_t want = d->file_left < PACK_CHUNK ? (size_t)d->file_left : PACK_CHUNK;
+                ssize_t got = read(d->fd, d->in, want);
+                if (got < 0) {
+                    if (errno == EINTR) continue;
+                    return -errno;
+                }
+                if (got == 0) {
+                    /* Shrunk since it was stat'ed: keep the announced size */
+                    memset(d->in, 0, want);
+                    got = (ssize_t)want;
+                }
+                d->crc = (uint32_t)crc32(d->crc, d->in, (uInt)got);
+                d->file_left -= (uint64_t)got;
+                d->zs.next_in = d->in;
+                d->zs.avail_in = (uInt)got;
+            } else if (d->pad_left > 0) {
+                memset(d->in, 0, d->pad_left);
+                d->zs.next_in = d->in;
+                d->zs.avail_in = (uInt)d->pad_left;
+                d->pad_left = 0;
+            } else {
+                d->input_done = true;
+            }
+        }
+        
+        int rc = deflate(&d->zs, d->input_done ? Z_FINISH : Z_NO_FLUSH);
+        if (rc == Z_STREAM_END) {
+            *produced = out_len - d->zs.avail_out;
+            entry_deflater_end(d);
+            return 1;
+        }
+        if (rc != Z_OK && rc != Z_BUF_ERROR) return -EIO;
+    }
+    
+    *produced = out_len;
+    return 0;
+}
+
+static int packer_compress_entry(packer_t *packer, entry_deflater_t *d, pack_entry_t *entry) {
+    manifest_entry_t *previous = manifest_find(packer->ctx, entry->path);
+    if (previous && manifest_unchanged(previous, &entry->st)) {
+        entry->member = previous->member;
+        entry->member_len = previous->member_len;
+        entry->previous = previous;
+        entry->crc = previous->crc;
+        return 0;
+    }
+    
+    if (S_ISREG(entry->st.st_mode) && entry->st.st_size > PACK_INLINE_MAX) {
+        entry->streamed = true;
+        return 0;
+    }
+    
+    int err = entry_deflater_start(d, packer, entry);
+    if (err) return err;
+    
+    size_t capacity = deflateBound(&d->zs, (uLong)(d->header.stage_len + (size_t)entry->st.st_size + TAR_BLOCK)) + 32;
+    unsigned char *member = malloc(capacity);
+    if (!member) return ENOMEM;
+    
+    size_t len = 0;
+    for (;;) {
+        size_t produced = 0;
+        int rc = entry_deflater_run(d, member + len, capacity - len, &produced);
+        len += produced;
+        if (rc == 1) break;
+        if (rc < 0) {
+            free(member);
+            return -rc;
+        }
+        unsigned char *grown = realloc(member, capacity * 2);
+        if (!grown) {
+            free(member);
+            return ENOMEM;
+        }
+        member = grown;
+        capacity *= 2;
+    }
+    
+    entry->member = member;
+    entry->member_len = len;
+    entry->crc = d->crc;
+    return 0;
+}
+
+static void* packer_compress_worker(void *arg) {
+    packer_t *packer = arg;
+    entry_deflater_t *d = entry_deflater_new();
+    if (!d) {
+        packer_fail(packer, ENOMEM, NULL);
+        return NULL;
+    }
+    
+    for (;;) {
+        pthread_mutex_lock(&packer->mutex);
+        while (!packer->abort && packer->next_job < packer->count &&
+               packer->next_job >= packer->consumed + PACK_WINDOW) {
+            pthread_cond_wait(&packer->cond, &packer->mutex);
+        }
+        if (packer->abort || packer->next_job >= packer->count) {
+            pthread_mutex_unlock(&packer->mutex);
+            break;
+        }
+        pack_entry_t *entry = &packer->entries[packer->next_job++];
+        pthread_mutex_unlock(&packer->mutex);
+        
+        int err = packer_compress_entry(packer, d, entry);
+        if (err) {
+            packer_fail(packer, err, entry->path);
+            break;
+        }
+        
+        pthread_mutex_lock(&packer->mutex);
+        entry->ready = true;
+        pthread_cond_broadcast(&packer->cond);
+        pthread_mutex_unlock(&packer->mutex);
+    }
+    
+    entry_deflater_free(d);
+    return NULL;
+}
+
+/* --- Upload --- */
+
+static void packer_advance(packer_t *packer) {
+    pthread_mutex_lock(&packer->mutex);
+    packer->current++;
+    packer->consumed = packer->current;
+    pthread_cond_broadcast(&packer->cond);
+    pthread_mutex_unlock(&packer->mutex);
+    packer->member_offset = 0;
+}
+
+/* CURLOPT_READFUNCTION: hand out the members in path order, then the trailer */
+static size_t packer_read_callback(char *buffer, size_t size, size_t nitems, void *userdata) {
+    packer_t *packer = userdata;
+    size_t capacity = size * nitems;
+    size_t out = 0;
+    
+    while (out < capacity && packer->current < packer->count) {
+        pack_entry_t *entry = &packer->entries[packer->current];
+        
+        pthread_mutex_lock(&packer->mutex);
+        while (!entry->ready && !packer->abort) {
+            pthread_cond_wait(&packer->cond, &packer->mutex);
+        }
+        bool aborted = !entry->ready;
+        pthread_mutex_unlock(&packer->mutex);
+        if (aborted) return CURL_READFUNC_ABORT;
+        
+        if (entry->streamed) {
+            if (!packer->streaming) {
+                packer->streaming = entry_deflater_new();
+                if (!packer->streaming) {
+                    packer_fail(packer, ENOMEM, entry->path);
+                    return CURL_READFUNC_ABORT;
+                }
+            }
+            if (!packer->streaming_entry) {
+                int err = entry_deflater_start(packer->streaming, packer, entry);
+                if (err) {
+                    packer_fail(packer, err, entry->path);
+                    return CURL_READFUNC_ABORT;
+                }
+                packer->streaming_entry = true;
+            }
+            
+            size_t produced = 0;
+            int rc = entry_deflater_run(packer->streaming, (unsigned char *)buffer + out, capacity - out, &produced);
+            out += produced;
+            if (rc < 0) {
+                packer_fail(packer, -rc, entry->path);
+                return CURL_READFUNC_ABORT;
+            }
+            if (rc == 1) {
+                entry->crc = packer->streaming->crc;
+                packer->streaming_entry = false;
+                packer_advance(packer);
+            }
+            continue;
+        }
+        
+        size_t n = entry->member_len - packer->member_offset;
+        if (n > capacity - out) n = capacity - out;
+        memcpy(buffer + out, entry->member + packer->member_offset, n);
+        packer->member_offset += n;
+        out += n;
+        if (packer->member_offset == entry->member_len) packer_advance(packer);
+    }
+    
+    if (out < capacity && packer->current == packer->count) {
+        size_t n = packer->trailer_len - packer->trailer_off;
+        if (n > capacity - out) n = capacity - out;
+        memcpy(buffer + out, packer->trailer + packer->trailer_off, n);
+        packer->trailer_off += n;
+        out += n;
     }
     
-    char **result = calloc(len, sizeof(char*));
-    if (!result) {
-        *count = 0;
-        return NULL;
+    return out;
+}
+
+static int pack_entry_compare(const void *a, const void *b) {
+    return strcmp(((const pack_entry_t *)a)->path, ((const pack_entry_t *)b)->path);
+}
+
+static size_t packer_thread_count(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) return 1;
+    return cpus > PACK_MAX_THREADS ? PACK_MAX_THREADS : (size_t)cpus;
+}
+
+/* Runs fn on up to PACK_MAX_THREADS threads and waits for all of them */
+static void packer_run_threads(packer_t *packer, void *(*fn)(void *)) {
+    pthread_t threads[PACK_MAX_THREADS];
+    size_t started = 0;
+    size_t wanted = packer_thread_count();
+    
+    for (size_t i = 0; i < wanted; i++) {
+        if (pthread_create(&threads[started], NULL, fn, packer) == 0) started++;
     }
+    if (started == 0) {
+        fn(packer);
+        return;
+    }
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+static bool packer_init(packer_t *packer, const char *root, const char *dockerfile,
+                        docker_excess_build_context_t *ctx) {
+    memset(packer, 0, sizeof(*packer));
+    packer->root = root;
+    packer->dockerfile = dockerfile;
+    packer->ctx = ctx;
+    atomic_init(&packer->abort, false);
     
-    for (size_t i = 0; i < len; i++) {
-        json_object *item = json_object_array_get_idx(array, i);
-        const char *str = json_object_get_string(item);
-        result[i] = safe_strdup(str);
+    if (pthread_mutex_init(&packer->mutex, NULL) != 0) return false;
+    if (pthread_cond_init(&packer->cond, NULL) != 0) {
+        pthread_mutex_destroy(&packer->mutex);
+        return false;
     }
     
-    *count = len;
-    return result;
+    /* The end-of-archive marker is a member of its own */
+    static const unsigned char zeros[2 * TAR_BLOCK];
+    z_stream zs = {0};
+    if (deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+    zs.next_in = (Bytef *)zeros;
+    zs.avail_in = sizeof(zeros);
+    zs.next_out = packer->trailer;
+    zs.avail_out = sizeof(packer->trailer);
+    int rc = deflate(&zs, Z_FINISH);
+    packer->trailer_len = sizeof(packer->trailer) - zs.avail_out;
+    deflateEnd(&zs);
+    return rc == Z_STREAM_END;
 }
 
-static docker_excess_container_state_t parse_container_state(const char *state_str) {
-    if (!state_str) return DOCKER_EXCESS_STATE_CREATED;
+/* Frees the entries; members are kept in ctx (replacing its manifest) when `commit` is set */
+static void packer_cleanup(packer_t *packer, bool commit) {
+    ignore_rules_free(&packer->rules);
+    while (packer->dirs) {
+        pack_dir_t *dir = packer->dirs;
+        packer->dirs = dir->next;
+        free(dir->matched);
+        free(dir);
+    }
+    entry_deflater_free(packer->streaming);
     
-    static const struct {
-        const char *name;
-        docker_excess_container_state_t state;
-    } state_map[] = {
-        {"created", DOCKER_EXCESS_STATE_CREATED},
-        {"restarting", DOCKER_EXCESS_STATE_RESTARTING},
-        {"running", DOCKER_EXCESS_STATE_RUNNING},
-        {"removing", DOCKER_EXCESS_STATE_REMOVING},
-        {"paused", DOCKER_EXCESS_STATE_PAUSED},
-        {"exited", DOCKER_EXCESS_STATE_EXITED},
-        {"dead", DOCKER_EXCESS_STATE_DEAD}
+    docker_excess_build_context_t *ctx = packer->ctx;
+    manifest_entry_t *manifest = NULL;
+    if (commit && ctx && packer->count > 0) {
+        manifest = malloc(packer->count * sizeof(manifest_entry_t));
+    }
+    
+    uint64_t digest = 14695981039346656037ull; /* FNV-1a over path, mode, size and payload CRC */
+    size_t kept = 0;
+    for (size_t i = 0; i < packer->count; i++) {
+        pack_entry_t *entry = &packer->entries[i];
+        
+        if (manifest) {
+            const unsigned char *fields[] = {
+                (const unsigned char *)entry->path, (const unsigned char *)&entry->st.st_mode,
+                (const unsigned char *)&entry->st.st_size, (const unsigned char *)&entry->crc,
+            };
+            const size_t lengths[] = {
+                strlen(entry->path) + 1, sizeof(entry->st.st_mode), sizeof(entry->st.st_size), sizeof(entry->crc),
+            };
+            for (size_t f = 0; f < 4; f++) {
+                for (size_t b = 0; b < lengths[f]; b++) {
+                    digest ^= fields[f][b];
+                    digest *= 1099511628211ull;
+                }
+            }
+            
+            manifest_entry_t *record = &manifest[i];
+            record->path = entry->path;
+            record->ino = entry->st.st_ino;
+            record->size = entry->st.st_size;
+            record->mode = entry->st.st_mode;
+            record->mtime = entry->st.st_mtim;
+            record->ctime = entry->st.st_ctim;
+            record->crc = entry->crc;
+            record->member = NULL;
+            record->member_len = 0;
+            entry->path = NULL;
+            
+            if (entry->member && kept + entry->member_len <= ctx->cache_bytes) {
+                record->member = entry->member;
+                record->member_len = entry->member_len;
+                kept += entry->member_len;
+                if (entry->previous) entry->previous->member = NULL;
+                entry->member = NULL;
+            }
+        }
+        
+        free(entry->path);
+        free(entry->link_target);
+        if (!entry->previous) free(entry->member);
+    }
+    free(packer->entries);
+    
+    if (manifest) {
+        manifest_entries_free(ctx->entries, ctx->count);
+        ctx->entries = manifest;
+        ctx->count = packer->count;
+        snprintf(ctx->digest, sizeof(ctx->digest), "%016llx", (unsigned long long)digest);
+    }
+    
+    pthread_cond_destroy(&packer->cond);
+    pthread_mutex_destroy(&packer->mutex);
+}
+
+/* --- Build --- */
+
+/* "key=value" pairs to a JSON object string, as /build expects for buildargs and labels */
+static char* key_values_to_json(char **pairs, size_t count) {
+    json_object *obj = json_object_new_object();
+    if (!obj) return NULL;
+    
+    for (size_t i = 0; i < count; i++) {
+        const char *eq = strchr(pairs[i], '=');
+        if (!eq) continue;
+        char *key = strndup(pairs[i], (size_t)(eq - pairs[i]));
+        if (!key) break;
+        json_object_object_add(obj, key, json_object_new_string(eq + 1));
+        free(key);
+    }
+    
+    char *json = strdup(json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PLAIN));
+    json_object_put(obj);
+    return json;
+}
+
+static bool build_build_endpoint(char *endpoint, size_t size, const docker_excess_image_build_t *params,
+                                 const char *dockerfile) {
+    int n = snprintf(endpoint, size, "/build?nocache=%d&pull=%d&forcerm=%d",
+                     params->no_cache ? 1 : 0, params->pull ? 1 : 0, params->force_rm ? 1 : 0);
+    if (n < 0 || (size_t)n >= size) return false;
+    size_t len = (size_t)n;
+    
+    if (params->tag && !query_append(endpoint, size, &len, "t", params->tag)) return false;
+    if (dockerfile && !query_append(endpoint, size, &len, "dockerfile", dockerfile)) return false;
+    if (params->target && !query_append(endpoint, size, &len, "target", params->target)) return false;
+    if (params->network_mode && !query_append(endpoint, size, &len, "networkmode", params->network_mode)) return false;
+    if (params->memory_limit > 0) {
+        n = snprintf(endpoint + len, size - len, "&memory=%lld", (long long)params->memory_limit);
+        if (n < 0 || (size_t)n >= size - len) return false;
+        len += (size_t)n;
+    }
+    
+    const struct { const char *key; char **pairs; size_t count; } maps[] = {
+        { "buildargs", params->build_args, params->build_args_count },
+        { "labels", params->labels, params->labels_count },
     };
+    for (size_t i = 0; i < sizeof(maps) / sizeof(maps[0]); i++) {
+        if (maps[i].count == 0) continue;
+        char *json = key_values_to_json(maps[i].pairs, maps[i].count);
+        bool ok = json && query_append(endpoint, size, &len, maps[i].key, json);
+        free(json);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+typedef struct {
+    docker_excess_t *client;
+    docker_excess_progress_callback_t callback;
+    void *userdata;
+    bool failed;
+} build_progress_t;
+
+static bool build_on_value(json_object *value, void *ctx) {
+    build_progress_t *progress = ctx;
     
-    for (size_t i = 0; i < sizeof(state_map) / sizeof(state_map[0]); i++) {
-        if (strcmp(state_str, state_map[i].name) == 0) {
-            return state_map[i].state;
+    const char *error = get_json_string(value, "error");
+    if (error) {
+        set_error(progress->client, "Build failed: %s", error);
+        progress->failed = true;
+        return true;
+    }
+    
+    if (progress->callback) {
+        const char *stream = get_json_string(value, "stream");
+        const char *status = get_json_string(value, "status");
+        if (stream) progress->callback(stream, NULL, progress->userdata);
+        else if (status) progress->callback(status, get_json_string(value, "progress"), progress->userdata);
+    }
+    return true;
+}
+
+/* Dockerfile path as the daemon wants it: relative to the context */
+static const char* build_dockerfile_name(const char *context, const char *dockerfile) {
+    if (!dockerfile || !dockerfile[0]) return NULL;
+    
+    size_t len = strlen(context);
+    while (len > 1 && context[len - 1] == '/') len--;
+    if (strncmp(dockerfile, context, len) == 0 && dockerfile[len] == '/') dockerfile += len + 1;
+    while (dockerfile[0] == '.' && dockerfile[1] == '/') dockerfile += 2;
+    return dockerfile;
+}
+
+docker_excess_error_t docker_excess_build_image_ctx(docker_excess_t *client,
+                                                   const docker_excess_image_build_t *params,
+                                                   docker_excess_build_context_t *ctx,
+                                                   docker_excess_progress_callback_t callback, void *userdata) {
+    if (!client || !params || !params->context_path) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    const char *dockerfile = build_dockerfile_name(params->context_path, params->dockerfile_path);
+    char endpoint[DOCKER_EXCESS_MAX_URL_LEN];
+    if (!build_build_endpoint(endpoint, sizeof(endpoint), params, dockerfile)) {
+        set_error(client, "Build parameters do not fit in a request URL");
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    char root[PATH_MAX];
+    snprintf(root, sizeof(root), "%s", params->context_path);
+    size_t root_len = strlen(root);
+    while (root_len > 1 && root[root_len - 1] == '/') root[--root_len] = '\0';
+    
+    struct stat st;
+    if (stat(root, &st) != 0) {
+        set_error(client, "Cannot access build context %s: %s", root, strerror(errno));
+        return map_errno(errno);
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        set_error(client, "Build context %s is not a directory", root);
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    if (ctx) pthread_mutex_lock(&ctx->mutex);
+    
+    packer_t *packer = malloc(sizeof(packer_t));
+    if (!packer || !packer_init(packer, root, dockerfile, ctx)) {
+        free(packer);
+        if (ctx) pthread_mutex_unlock(&ctx->mutex);
+        return DOCKER_EXCESS_ERR_MEMORY;
+    }
+    
+    docker_excess_error_t err = ignore_rules_load(&packer->rules, root);
+    if (err != DOCKER_EXCESS_OK) {
+        set_error(client, "Failed to read %s/.dockerignore", root);
+    } else if (!packer_push_dir(packer, "", NULL)) {
+        err = DOCKER_EXCESS_ERR_MEMORY;
+    } else {
+        packer_run_threads(packer, packer_walk_worker);
+        if (!packer->error) {
+            qsort(packer->entries, packer->count, sizeof(pack_entry_t), pack_entry_compare);
         }
     }
     
-    return DOCKER_EXCESS_STATE_CREATED;
+    build_progress_t progress = { client, callback, userdata, false };
+    pthread_t compressors[PACK_MAX_THREADS];
+    size_t started = 0;
+    
+    if (err == DOCKER_EXCESS_OK && !packer->error) {
+        /* Compression overlaps the upload; the callback waits for members in order */
+        size_t wanted = packer_thread_count();
+        for (size_t i = 0; i < wanted; i++) {
+            if (pthread_create(&compressors[started], NULL, packer_compress_worker, packer) == 0) started++;
+        }
+        
+        json_stream_t stream;
+        if (started == 0) {
+            err = DOCKER_EXCESS_ERR_INTERNAL;
+        } else if (!json_stream_init(&stream, build_on_value, &progress)) {
+            err = DOCKER_EXCESS_ERR_MEMORY;
+        } else {
+            request_opts_t opts = {
+                .method = "POST",
+                .endpoint = endpoint,
+                .read_fn = packer_read_callback,
+                .read_data = packer,
+                .upload_size = -1,
+                .headers = client->tar_headers,
+                .write_fn = write_json_stream_callback,
+                .write_data = &stream,
+                .timeout_ms = -1,
+                .stopped = &stream.stopped,
+                .fail_on_error = true,
+            };
+            err = perform_request(client, &opts, NULL, NULL);
+            json_stream_cleanup(&stream);
+        }
+        
+        pthread_mutex_lock(&packer->mutex);
+        packer->abort = true;
+        pthread_cond_broadcast(&packer->cond);
+        pthread_mutex_unlock(&packer->mutex);
+        for (size_t i = 0; i < started; i++) {
+            pthread_join(compressors[i], NULL);
+        }
+    }
+    
+    if (packer->error) {
+        set_error(client, "Failed to pack build context %s: %s", packer->error_path, strerror(packer->error));
+        err = map_errno(packer->error);
+    } else if (err == DOCKER_EXCESS_OK && progress.failed) {
+        err = DOCKER_EXCESS_ERR_HTTP;
+    }
+    
+    packer_cleanup(packer, err == DOCKER_EXCESS_OK && !packer->error);
+    free(packer);
+    if (ctx) pthread_mutex_unlock(&ctx->mutex);
+    return err;
+}
+
+docker_excess_error_t docker_excess_build_image(docker_excess_t *client,
+                                               const docker_excess_image_build_t *params,
+                                               docker_excess_progress_callback_t callback, void *userdata) {
+    return docker_excess_build_image_ctx(client, params, NULL, callback, userdata);
+}
+
+/* ----------------- Image Management Implementation ----------------- */
+
+static void parse_image(json_object *json, docker_excess_image_t *image) {
+    const char *id = get_json_string(json, "Id");
+    if (id) {
+        image->id = strdup(id);
+        image->short_id = docker_excess_short_id(id);
+    }
+    image->repo_tags = parse_json_string_array(get_json_object(json, "RepoTags"), &image->repo_tags_count);
+    image->repo_digests = parse_json_string_array(get_json_object(json, "RepoDigests"), &image->repo_digests_count);
+    image->created = parse_json_time(json, "Created");
+    image->size = get_json_int(json, "Size");
+    image->virtual_size = get_json_int(json, "VirtualSize");
+    
+    json_object *config = get_json_object(json, "Config");
+    json_object *labels = get_json_object(config ? config : json, "Labels");
+    parse_json_labels(labels, NULL, NULL, 0, &image->labels, &image->labels_count);
+}
+
+static void image_clear(docker_excess_image_t *image) {
+    safe_free(image->id);
+    safe_free(image->short_id);
+    for (size_t i = 0; i < image->repo_tags_count; i++) free(image->repo_tags[i]);
+    safe_free(image->repo_tags);
+    for (size_t i = 0; i < image->repo_digests_count; i++) free(image->repo_digests[i]);
+    safe_free(image->repo_digests);
+    for (size_t i = 0; i < image->labels_count; i++) free(image->labels[i]);
+    safe_free(image->labels);
+    memset(image, 0, sizeof(*image));
+}
+
+void docker_excess_free_images(docker_excess_image_t **images, size_t count) {
+    if (!images) return;
+    
+    for (size_t i = 0; i < count; i++) {
+        if (!images[i]) continue;
+        image_clear(images[i]);
+        free(images[i]);
+    }
+    free(images);
+}
+
+docker_excess_error_t docker_excess_inspect_image(docker_excess_t *client, const char *image_name,
+                                                 docker_excess_image_t **image) {
+    if (!client || !image_name || !image) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char endpoint[512];
+    if (!build_resource_endpoint(endpoint, sizeof(endpoint), "/images/", image_name, "/json")) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    json_object *json = NULL;
+    docker_excess_error_t err = make_request_json(client, "GET", endpoint, NULL, &json, NULL);
+    if (err != DOCKER_EXCESS_OK) return err;
+    
+    *image = calloc(1, sizeof(docker_excess_image_t));
+    if (*image) {
+        parse_image(json, *image);
+    } else {
+        err = DOCKER_EXCESS_ERR_MEMORY;
+    }
+    
+    json_object_put(json);
+    return err;
+}
+
+docker_excess_error_t docker_excess_remove_image(docker_excess_t *client, const char *image_name, bool force,
+                                                bool no_prune) {
+    if (!client || !image_name) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char endpoint[512];
+    if (!build_resource_endpoint(endpoint, sizeof(endpoint), "/images/", image_name, NULL)) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    size_t len = strlen(endpoint);
+    int n = snprintf(endpoint + len, sizeof(endpoint) - len, "?force=%d&noprune=%d", force ? 1 : 0, no_prune ? 1 : 0);
+    if (n < 0 || (size_t)n >= sizeof(endpoint) - len) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char *response = NULL;
+    docker_excess_error_t err = make_request(client, "DELETE", endpoint, NULL, &response, NULL);
+    safe_free(response);
+    
+    if (err == DOCKER_EXCESS_OK) resolve_cache_invalidate_kind(&client->resolver, RESOLVE_IMAGE);
+    return err;
+}
+
+/* target_image is "repo[:tag]"; the tag is what follows the last ':' after the last '/' */
+docker_excess_error_t docker_excess_tag_image(docker_excess_t *client, const char *source_image,
+                                             const char *target_image) {
+    if (!client || !source_image || !target_image || !target_image[0]) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char repo[512];
+    int n = snprintf(repo, sizeof(repo), "%s", target_image);
+    if (n < 0 || (size_t)n >= sizeof(repo)) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    const char *tag = NULL;
+    char *colon = strrchr(repo, ':');
+    if (colon && !strchr(colon, '/')) {
+        *colon = '\0';
+        tag = colon + 1;
+    }
+    
+    char endpoint[DOCKER_EXCESS_MAX_URL_LEN];
+    if (!build_resource_endpoint(endpoint, sizeof(endpoint), "/images/", source_image, "/tag")) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    size_t len = strlen(endpoint);
+    if (!query_append(endpoint, sizeof(endpoint), &len, "repo", repo) ||
+        (tag && !query_append(endpoint, sizeof(endpoint), &len, "tag", tag))) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    
+    char *response = NULL;
+    docker_excess_error_t err = make_request(client, "POST", endpoint, NULL, &response, NULL);
+    safe_free(response);
+    
+    /* The target may have named another image until now */
+    if (err == DOCKER_EXCESS_OK) resolve_cache_invalidate_kind(&client->resolver, RESOLVE_IMAGE);
+    return err;
+}
+
+/* ----------------- Image Transfers ----------------- */
+
+/*
+ * Pull and push reply with one JSON message per layer event. They are
+ * folded into a layer table as they arrive; the callback only ever sees
+ * the aggregate, at most once per interval.
+ */
+
+typedef struct {
+    docker_excess_layer_progress_t *layers;
+    size_t count;
+    size_t capacity;
+    size_t done;
+    int64_t current;                /* Running sums over `layers` */
+    int64_t total;
+    char status[256];               /* Last message not about a layer */
+    bool has_status;
+    size_t images_count;            /* Images in this transfer (pull_images) */
+    size_t images_done;
+} layer_table_t;
+
+static const struct {
+    const char *prefix;
+    docker_excess_layer_state_t state;
+} layer_statuses[] = {
+    { "Pulling fs layer", DOCKER_EXCESS_LAYER_WAITING },
+    { "Waiting", DOCKER_EXCESS_LAYER_WAITING },
+    { "Preparing", DOCKER_EXCESS_LAYER_WAITING },
+    { "Downloading", DOCKER_EXCESS_LAYER_TRANSFERRING },
+    { "Pushing", DOCKER_EXCESS_LAYER_TRANSFERRING },
+    { "Verifying Checksum", DOCKER_EXCESS_LAYER_EXTRACTING },
+    { "Download complete", DOCKER_EXCESS_LAYER_EXTRACTING },
+    { "Extracting", DOCKER_EXCESS_LAYER_EXTRACTING },
+    { "Pull complete", DOCKER_EXCESS_LAYER_DONE },
+    { "Already exists", DOCKER_EXCESS_LAYER_DONE },
+    { "Pushed", DOCKER_EXCESS_LAYER_DONE },
+    { "Layer already exists", DOCKER_EXCESS_LAYER_DONE },
+    { "Mounted from", DOCKER_EXCESS_LAYER_DONE },
+};
+
+/* Returns -1 for messages that do not describe a layer (or carry no news, e.g. "Retrying") */
+static int layer_status_state(const char *status) {
+    for (size_t i = 0; i < sizeof(layer_statuses) / sizeof(layer_statuses[0]); i++) {
+        if (strncmp(status, layer_statuses[i].prefix, strlen(layer_statuses[i].prefix)) == 0) {
+            return (int)layer_statuses[i].state;
+        }
+    }
+    return -1;
+}
+
+static void layer_table_cleanup(layer_table_t *table) {
+    safe_free(table->layers);
+    memset(table, 0, sizeof(*table));
+}
+
+static docker_excess_layer_progress_t* layer_table_find(layer_table_t *table, const char *id, bool create) {
+    /* Few dozen layers at most: a scan beats hashing */
+    for (size_t i = 0; i < table->count; i++) {
+        if (strcmp(table->layers[i].id, id) == 0) return &table->layers[i];
+    }
+    if (!create) return NULL;
+    
+    if (table->count == table->capacity) {
+        size_t capacity = table->capacity ? table->capacity * 2 : 16;
+        docker_excess_layer_progress_t *layers = realloc(table->layers, capacity * sizeof(*layers));
+        if (!layers) return NULL;
+        table->layers = layers;
+        table->capacity = capacity;
+    }
+    docker_excess_layer_progress_t *layer = &table->layers[table->count++];
+    memset(layer, 0, sizeof(*layer));
+    snprintf(layer->id, sizeof(layer->id), "%s", id);
+    return layer;
+}
+
+/* Fold one daemon message into the table; returns true if anything changed */
+static bool layer_table_apply(layer_table_t *table, json_object *message) {
+    const char *status = get_json_string(message, "status");
+    if (!status) return false;
+    
+    const char *id = get_json_string(message, "id");
+    int state = layer_status_state(status);
+    docker_excess_layer_progress_t *layer = id ? layer_table_find(table, id, state >= 0) : NULL;
+    
+    if (!layer) {
+        /* "Pulling from library/alpine" comes with the tag as id */
+        if (state >= 0 && id) return false;
+        snprintf(table->status, sizeof(table->status), "%s", status);
+        table->has_status = true;
+        return true;
+    }
+    if (state < 0) return false;
+    
+    int64_t current = layer->current;
+    int64_t total = layer->total;
+    
+    if (state == DOCKER_EXCESS_LAYER_TRANSFERRING) {
+        json_object *detail;
+        if (json_object_object_get_ex(message, "progressDetail", &detail)) {
+            json_object *value;
+            if (json_object_object_get_ex(detail, "current", &value)) current = json_object_get_int64(value);
+            if (json_object_object_get_ex(detail, "total", &value)) total = json_object_get_int64(value);
+        }
+    } else if (state >= DOCKER_EXCESS_LAYER_EXTRACTING && total > 0) {
+        current = total;
+    }
+    
+    /* Messages may arrive out of order; a layer never moves back */
+    if ((int)layer->state > state) return false;
+    if ((int)layer->state == state && layer->current == current && layer->total == total) return false;
+    if (layer->state != DOCKER_EXCESS_LAYER_DONE && state == DOCKER_EXCESS_LAYER_DONE) table->done++;
+    
+    table->current += current - layer->current;
+    table->total += total - layer->total;
+    layer->current = current;
+    layer->total = total;
+    layer->state = (docker_excess_layer_state_t)state;
+    return true;
+}
+
+static void layer_table_snapshot(const layer_table_t *table, docker_excess_transfer_progress_t *progress) {
+    progress->layers = table->layers;
+    progress->layers_count = table->count;
+    progress->layers_done = table->done;
+    progress->current = table->current;
+    progress->total = table->total;
+    progress->status = table->has_status ? table->status : NULL;
+    progress->images_count = table->images_count;
+    progress->images_done = table->images_done;
+    progress->finished = false;
+}
+
+typedef struct {
+    docker_excess_t *client;
+    layer_table_t table;
+    docker_excess_transfer_callback_t callback;
+    docker_excess_progress_callback_t legacy;   /* Per-message callback of pull_image/push_image */
+    void *userdata;
+    int interval_ms;
+    int64_t last_emit_ms;
+    bool pending;                   /* Changes not reported yet */
+    bool cancelled;
+    bool failed;
+} image_transfer_t;
+
+static bool image_transfer_emit(image_transfer_t *transfer, bool finished) {
+    docker_excess_transfer_progress_t progress;
+    layer_table_snapshot(&transfer->table, &progress);
+    progress.finished = finished;
+    transfer->pending = false;
+    
+    if (!transfer->callback(&progress, transfer->userdata)) {
+        transfer->cancelled = true;
+        return false;
+    }
+    return true;
+}
+
+static bool image_transfer_feed(image_transfer_t *transfer, json_object *value);
+
+static bool image_transfer_on_value(json_object *value, void *ctx) {
+    image_transfer_t *transfer = ctx;
+    
+    const char *error = get_json_string(value, "error");
+    if (error) {
+        set_error(transfer->client, "%s", error);
+        transfer->failed = true;
+        return true;
+    }
+    
+    if (transfer->legacy) {
+        const char *status = get_json_string(value, "status");
+        if (status) transfer->legacy(status, get_json_string(value, "progress"), transfer->userdata);
+        return true;
+    }
+    return image_transfer_feed(transfer, value);
+}
+
+/* Apply a progress message and report if the interval has passed; false = cancelled */
+static bool image_transfer_feed(image_transfer_t *transfer, json_object *value) {
+    if (!transfer->callback) return true;
+    if (!layer_table_apply(&transfer->table, value)) return true;
+    transfer->pending = true;
+    
+    if (transfer->interval_ms >= 0) {
+        int64_t now = monotonic_ms();
+        if (now - transfer->last_emit_ms < transfer->interval_ms) return true;
+        transfer->last_emit_ms = now;
+    }
+    return image_transfer_emit(transfer, false);
+}
+
+/* Default headers plus X-Registry-Auth; NULL on allocation failure */
+static struct curl_slist* registry_auth_headers(const char *registry_auth) {
+    size_t header_len = strlen(registry_auth) + sizeof("X-Registry-Auth: ");
+    char *header = malloc(header_len);
+    if (!header) return NULL;
+    snprintf(header, header_len, "X-Registry-Auth: %s", registry_auth);
+    
+    struct curl_slist *headers = build_headers("application/json");
+    if (headers && !curl_slist_append(headers, header)) {
+        curl_slist_free_all(headers);
+        headers = NULL;
+    }
+    free(header);
+    return headers;
+}
+
+static docker_excess_error_t image_transfer_run(docker_excess_t *client, const char *endpoint,
+                                                const char *registry_auth, image_transfer_t *transfer) {
+    struct curl_slist *headers = NULL;
+    if (registry_auth) {
+        headers = registry_auth_headers(registry_auth);
+        if (!headers) return DOCKER_EXCESS_ERR_MEMORY;
+    }
+    
+    json_stream_t stream;
+    if (!json_stream_init(&stream, image_transfer_on_value, transfer)) {
+        curl_slist_free_all(headers);
+        return DOCKER_EXCESS_ERR_MEMORY;
+    }
+    
+    request_opts_t opts = {
+        .method = "POST",
+        .endpoint = endpoint,
+        .headers = headers,
+        .write_fn = write_json_stream_callback,
+        .write_data = &stream,
+        .timeout_ms = -1,
+        .stopped = &stream.stopped,
+        .fail_on_error = true,
+    };
+    docker_excess_error_t err = perform_request(client, &opts, NULL, NULL);
+    json_stream_cleanup(&stream);
+    curl_slist_free_all(headers);
+    
+    /* The daemon reports registry failures in the stream, after a 200 */
+    if (err == DOCKER_EXCESS_OK && transfer->failed) err = DOCKER_EXCESS_ERR_HTTP;
+    if (err == DOCKER_EXCESS_OK && transfer->callback && !transfer->cancelled) {
+        transfer->table.images_done = 1;
+        image_transfer_emit(transfer, true);
+    }
+    return err;
+}
+
+/* True for "name:tag" and "name@digest"; a port in "host:5000/name" is not a tag */
+static bool image_ref_has_tag(const char *ref) {
+    if (strchr(ref, '@')) return true;
+    const char *slash = strrchr(ref, '/');
+    return strchr(slash ? slash : ref, ':') != NULL;
+}
+
+static bool build_pull_endpoint(char *endpoint, size_t size, const char *image_name, const char *tag) {
+    int n = snprintf(endpoint, size, "/images/create");
+    if (n < 0 || (size_t)n >= size) return false;
+    size_t len = (size_t)n;
+    
+    /* Without a tag the daemon would pull every tag of the repository */
+    if (!tag && !image_ref_has_tag(image_name)) tag = "latest";
+    
+    if (!query_append(endpoint, size, &len, "fromImage", image_name)) return false;
+    return !tag || query_append(endpoint, size, &len, "tag", tag);
+}
+
+static bool build_push_endpoint(char *endpoint, size_t size, const char *image_name, const char *tag) {
+    if (!build_resource_endpoint(endpoint, size, "/images/", image_name, "/push")) return false;
+    size_t len = strlen(endpoint);
+    return !tag || query_append(endpoint, size, &len, "tag", tag);
+}
+
+static docker_excess_error_t image_transfer(docker_excess_t *client, bool push, const char *image_name,
+                                            const char *tag, const docker_excess_transfer_options_t *options,
+                                            docker_excess_transfer_callback_t callback,
+                                            docker_excess_progress_callback_t legacy, void *userdata) {
+    if (!client || !image_name || !image_name[0]) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    char endpoint[DOCKER_EXCESS_MAX_URL_LEN];
+    bool ok = push ? build_push_endpoint(endpoint, sizeof(endpoint), image_name, tag)
+                   : build_pull_endpoint(endpoint, sizeof(endpoint), image_name, tag);
+    if (!ok) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    
+    image_transfer_t transfer = {
+        .client = client,
+        .table = { .images_count = 1 },
+        .callback = callback,
+        .legacy = legacy,
+        .userdata = userdata,
+        .interval_ms = options && options->interval_ms != 0 ?
+                       options->interval_ms : DOCKER_EXCESS_DEFAULT_PROGRESS_INTERVAL_MS,
+    };
+    
+    /* Push insists on an auth header; "{}" is the anonymous one */
+    const char *registry_auth = options ? options->registry_auth : NULL;
+    if (push && !registry_auth) registry_auth = "e30=";
+    
+    docker_excess_error_t err = image_transfer_run(client, endpoint, registry_auth, &transfer);
+    layer_table_cleanup(&transfer.table);
+    return err;
+}
+
+docker_excess_error_t docker_excess_pull_image(docker_excess_t *client, const char *image_name, const char *tag,
+                                              docker_excess_progress_callback_t callback, void *userdata) {
+    return image_transfer(client, false, image_name, tag, NULL, NULL, callback, userdata);
+}
+
+docker_excess_error_t docker_excess_push_image(docker_excess_t *client, const char *image_name, const char *tag,
+                                              docker_excess_progress_callback_t callback, void *userdata) {
+    return image_transfer(client, true, image_name, tag, NULL, NULL, callback, userdata);
+}
+
+docker_excess_error_t docker_excess_pull_image_ex(docker_excess_t *client, const char *image_name, const char *tag,
+                                                 const docker_excess_transfer_options_t *options,
+                                                 docker_excess_transfer_callback_t callback, void *userdata) {
+    return image_transfer(client, false, image_name, tag, options, callback, NULL, userdata);
+}
+
+docker_excess_error_t docker_excess_push_image_ex(docker_excess_t *client, const char *image_name, const char *tag,
+                                                 const docker_excess_transfer_options_t *options,
+                                                 docker_excess_transfer_callback_t callback, void *userdata) {
+    return image_transfer(client, true, image_name, tag, options, callback, NULL, userdata);
 }
 
-/* ----------------- Core API Implementation ----------------- */
+/*
+ * docker_excess_pull_images(): every image is first inspected (in parallel)
+ * so references already present can be skipped, then pulled with bounded
+ * concurrency over the async engine. All pulls feed one layer table, so a
+ * base layer shared by several images is only counted once.
+ */
 
-const char* docker_excess_get_version(void) {
-    return DOCKER_EXCESS_VERSION;
-}
+typedef struct pull_batch pull_batch_t;
 
-docker_excess_error_t docker_excess_new(docker_excess_t **client) {
-    docker_excess_config_t config = docker_excess_default_config();
-    docker_excess_error_t err = docker_excess_new_with_config(&config, client);
-    docker_excess_free_config(&config);
-    return err;
+typedef struct {
+    pull_batch_t *batch;
+    json_stream_t stream;
+    bool present;                   /* Found by the inspect pass */
+    bool failed;                    /* Error message in the pull stream */
+} pull_item_t;
+
+struct pull_batch {
+    docker_excess_t *client;
+    const char **images;
+    size_t count;
+    pull_item_t *items;
+    docker_excess_error_t *errors;
+    struct curl_slist *headers;     /* With X-Registry-Auth, or NULL */
+    bool skip_present;
+    bool pulling;                   /* Second pass */
+    size_t *order;                  /* Image index of each item of the current pass */
+    docker_excess_error_t *results; /* Per item of the current pass */
+    async_batch_t run;
+    image_transfer_t transfer;      /* Shared by all pulls, under mutex */
+    pthread_mutex_t mutex;
+};
+
+static bool pull_item_on_value(json_object *value, void *ctx) {
+    pull_item_t *item = ctx;
+    pull_batch_t *batch = item->batch;
+    
+    pthread_mutex_lock(&batch->mutex);
+    bool keep_going = !batch->transfer.cancelled;
+    if (keep_going) {
+        const char *error = get_json_string(value, "error");
+        if (error) {
+            set_error(batch->client, "%s", error);
+            item->failed = true;
+        } else {
+            keep_going = image_transfer_feed(&batch->transfer, value);
+        }
+    }
+    pthread_mutex_unlock(&batch->mutex);
+    return keep_going;
 }
 
-docker_excess_error_t docker_excess_new_with_config(const docker_excess_config_t *config, docker_excess_t **client) {
-    if (!config || !client) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+static bool pull_item_needed(const pull_batch_t *batch, size_t index) {
+    const pull_item_t *item = &batch->items[index];
+    if (batch->errors[index] != DOCKER_EXCESS_OK) return false;
     
-    docker_excess_t *c = calloc(1, sizeof(docker_excess_t));
-    if (!c) return DOCKER_EXCESS_ERR_MEMORY;
+    /* A digest names immutable content; a tag may have moved since */
+    return !item->present || !(batch->skip_present || strchr(batch->images[index], '@'));
+}
+
+static void pull_batch_done(async_request_t *req, docker_excess_error_t err, int http_code) {
+    pull_batch_t *batch = req->done_data;
+    size_t index = batch->order[req->tag];
+    pull_item_t *item = &batch->items[index];
     
-    /* Initialize config with deep copy */
-    memset(&c->config, 0, sizeof(docker_excess_config_t));
-    c->config.socket_path = safe_strdup(config->socket_path);
-    c->config.host = safe_strdup(config->host);
-    c->config.port = config->port;
-    c->config.use_tls = config->use_tls;
-    c->config.cert_path = safe_strdup(config->cert_path);
-    c->config.key_path = safe_strdup(config->key_path);
-    c->config.ca_path = safe_strdup(config->ca_path);
-    c->config.timeout_s = config->timeout_s;
-    c->config.debug = config->debug;
-    c->config.log_callback = config->log_callback;
-    c->config.log_userdata = config->log_userdata;
+    if (!batch->pulling) {
+        /* 404 just means the image has to be pulled */
+        item->present = err == DOCKER_EXCESS_OK;
+        if (http_code == 404) err = DOCKER_EXCESS_OK;
+    } else {
+        json_stream_cleanup(&item->stream);
+        if (err == DOCKER_EXCESS_OK && item->failed) err = DOCKER_EXCESS_ERR_HTTP;
     
-    if (pthread_mutex_init(&c->mutex, NULL) != 0) {
-        docker_excess_free(c);
-        return DOCKER_EXCESS_ERR_INTERNAL;
+        pthread_mutex_lock(&batch->mutex);
+        batch->transfer.table.images_done++;
+        pthread_mutex_unlock(&batch->mutex);
     }
+    async_batch_done(&batch->run, req->tag, err);
+}
+
+static docker_excess_error_t pull_batch_submit(async_batch_t *run, size_t slot) {
+    pull_batch_t *batch = run->data;
+    size_t index = batch->order[slot];
+    const char *image = batch->images[index];
+    char endpoint[DOCKER_EXCESS_MAX_URL_LEN];
+    async_request_t *req = NULL;
     
-    /* Initialize cURL (thread-safe) */
-    pthread_mutex_lock(&g_curl_init_mutex);
-    if (g_curl_init_count == 0) {
-        if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
-            pthread_mutex_unlock(&g_curl_init_mutex);
-            docker_excess_free(c);
-            return DOCKER_EXCESS_ERR_INTERNAL;
+    if (!batch->pulling) {
+        if (!build_resource_endpoint(endpoint, sizeof(endpoint), "/images/", image, "/json")) {
+            return DOCKER_EXCESS_ERR_INVALID_PARAM;
         }
-    }
-    g_curl_init_count++;
-    pthread_mutex_unlock(&g_curl_init_mutex);
+        req = async_request_new(batch->client, run->engine, "GET", endpoint, NULL);
+        if (!req) return DOCKER_EXCESS_ERR_MEMORY;
+    } else {
+        pthread_mutex_lock(&batch->mutex);
+        bool cancelled = batch->transfer.cancelled;
+        pthread_mutex_unlock(&batch->mutex);
+        if (cancelled) return DOCKER_EXCESS_ERR_INTERNAL;   /* Never started */
     
-    c->curl = curl_easy_init();
-    if (!c->curl) {
-        docker_excess_free(c);
-        return DOCKER_EXCESS_ERR_INTERNAL;
+        pull_item_t *item = &batch->items[index];
+        docker_excess_error_t err = DOCKER_EXCESS_ERR_INVALID_PARAM;
+        if (build_pull_endpoint(endpoint, sizeof(endpoint), image, NULL)) {
+            err = DOCKER_EXCESS_ERR_MEMORY;
+            if (json_stream_init(&item->stream, pull_item_on_value, item)) {
+                req = async_request_new(batch->client, run->engine, "POST", endpoint, NULL);
+                if (!req) json_stream_cleanup(&item->stream);
+            }
+        }
+        if (!req) {
+            pthread_mutex_lock(&batch->mutex);
+            batch->transfer.table.images_done++;
+            pthread_mutex_unlock(&batch->mutex);
+            return err;
+        }
+        req->write_fn = write_json_stream_callback;
+        req->write_data = &item->stream;
+        req->headers = batch->headers;
+        req->timeout_ms = -1;
+        req->stopped = &item->stream.stopped;
+        req->fail_on_error = true;
     }
     
-    c->curl_initialized = true;
-    c->is_connected = false;
-    c->last_ping = 0;
+    req->done = pull_batch_done;
+    req->done_data = batch;
+    req->tag = slot;
+    async_request_enqueue(run->engine, req);
+    return DOCKER_EXCESS_OK;
+}
+
+/* Run one pass over the images selected by needed(), then copy its results back */
+static docker_excess_error_t pull_batch_pass(pull_batch_t *batch, size_t max_parallel,
+                                             bool (*needed)(const pull_batch_t *batch, size_t index)) {
+    size_t count = 0;
+    for (size_t i = 0; i < batch->count; i++) {
+        if (needed(batch, i)) batch->order[count++] = i;
+    }
     
-    docker_excess_log(c, DOCKER_EXCESS_LOG_INFO, "Docker client created successfully");
+    batch->run.count = count;
+    batch->run.max_parallel = max_parallel;
+    docker_excess_error_t err = async_batch_run(batch->client, &batch->run);
     
-    *client = c;
-    return DOCKER_EXCESS_OK;
+    for (size_t i = 0; i < count; i++) {
+        batch->errors[batch->order[i]] = batch->results[i];
+    }
+    return err;
 }
 
-void docker_excess_free(docker_excess_t *client) {
-    if (!client) return;
+static bool pull_item_valid(const pull_batch_t *batch, size_t index) {
+    return batch->errors[index] == DOCKER_EXCESS_OK;
+}
+
+docker_excess_error_t docker_excess_pull_images(docker_excess_t *client, const char **images, size_t count,
+                                               const docker_excess_pull_options_t *options,
+                                               docker_excess_transfer_callback_t callback, void *userdata,
+                                               docker_excess_error_t *errors) {
+    if (!client || (!images && count > 0) || !errors) return DOCKER_EXCESS_ERR_INVALID_PARAM;
     
-    docker_excess_log(client, DOCKER_EXCESS_LOG_DEBUG, "Freeing Docker client");
+    for (size_t i = 0; i < count; i++) {
+        errors[i] = images[i] && images[i][0] ? DOCKER_EXCESS_OK : DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
+    if (count == 0) return DOCKER_EXCESS_OK;
     
-    /* Free configuration */
-    safe_free(client->config.socket_path);
-    safe_free(client->config.host);
-    safe_free(client->config.cert_path);
-    safe_free(client->config.key_path);
-    safe_free(client->config.ca_path);
+    async_engine_t *engine = async_engine_get(client);
+    if (!engine) return DOCKER_EXCESS_ERR_INTERNAL;
+    
+    pull_batch_t batch = {
+        .client = client,
+        .images = images,
+        .count = count,
+        .errors = errors,
+        .skip_present = options && options->skip_present,
+        .transfer = {
+            .client = client,
+            .table = { .images_count = count },
+            .callback = callback,
+            .userdata = userdata,
+            .interval_ms = options && options->interval_ms != 0 ?
+                           options->interval_ms : DOCKER_EXCESS_DEFAULT_PROGRESS_INTERVAL_MS,
+        },
+    };
+    batch.run = (async_batch_t){
+        .engine = engine,
+        .submit = pull_batch_submit,
+        .data = &batch,
+    };
     
-    /* Cleanup cURL */
-    if (client->curl) {
-        curl_easy_cleanup(client->curl);
+    batch.items = calloc(count, sizeof(pull_item_t));
+    batch.order = malloc(count * sizeof(size_t));
+    batch.results = malloc(count * sizeof(docker_excess_error_t));
+    if (!batch.items || !batch.order || !batch.results) {
+        free(batch.items);
+        free(batch.order);
+        free(batch.results);
+        return DOCKER_EXCESS_ERR_MEMORY;
+    }
+    batch.run.errors = batch.results;
+    for (size_t i = 0; i < count; i++) {
+        batch.items[i].batch = &batch;
     }
+    if (options && options->registry_auth) {
+        batch.headers = registry_auth_headers(options->registry_auth);
+        if (!batch.headers) {
+            free(batch.items);
+            free(batch.order);
+            free(batch.results);
+            return DOCKER_EXCESS_ERR_MEMORY;
+        }
+    }
+    pthread_mutex_init(&batch.mutex, NULL);
     
-    if (client->curl_initialized) {
-        pthread_mutex_lock(&g_curl_init_mutex);
-        g_curl_init_count--;
-        if (g_curl_init_count == 0) {
-            curl_global_cleanup();
+    docker_excess_error_t err = pull_batch_pass(&batch, (size_t)client->config.max_connections, pull_item_valid);
+    for (size_t i = 0; i < count; i++) {
+        if (!pull_item_needed(&batch, i)) batch.transfer.table.images_done++;
+    }
+    
+    if (err != DOCKER_EXCESS_OK) {
+        /* The engine failed during the inspect pass: nothing gets pulled */
+        for (size_t i = 0; i < count; i++) {
+            if (pull_item_needed(&batch, i)) errors[i] = err;
+        }
+    } else {
+        batch.pulling = true;
+        err = pull_batch_pass(&batch, options && options->max_parallel > 0 ?
+                              options->max_parallel : DOCKER_EXCESS_DEFAULT_PULL_PARALLEL, pull_item_needed);
+        if (err == DOCKER_EXCESS_OK && !batch.transfer.cancelled && callback) {
+            image_transfer_emit(&batch.transfer, true);
         }
-        pthread_mutex_unlock(&g_curl_init_mutex);
     }
     
-    pthread_mutex_destroy(&client->mutex);
-    free(client);
+    pthread_mutex_destroy(&batch.mutex);
+    curl_slist_free_all(batch.headers);
+    layer_table_cleanup(&batch.transfer.table);
+    free(batch.items);
+    free(batch.order);
+    free(batch.results);
+    return err;
 }
 
-const char* docker_excess_get_error(docker_excess_t *client) {
-    if (!client) return "Invalid client";
+/* ----------------- Host Groups ----------------- */
+
+docker_excess_error_t docker_excess_group_new(docker_excess_group_t **group) {
+    if (!group) return DOCKER_EXCESS_ERR_INVALID_PARAM;
     
-    pthread_mutex_lock(&client->mutex);
-    const char *msg = client->error_msg[0] ? client->error_msg : "No error";
-    pthread_mutex_unlock(&client->mutex);
+    docker_excess_group_t *g = calloc(1, sizeof(docker_excess_group_t));
+    if (!g) return DOCKER_EXCESS_ERR_MEMORY;
+    
+    pthread_mutex_init(&g->mutex, NULL);
+    docker_excess_error_t err = share_init(&g->share);
+    if (err == DOCKER_EXCESS_OK) {
+        /* Idle handles are added per member, see docker_excess_group_add() */
+        g->engine = async_engine_create(0);
+        if (!g->engine) err = DOCKER_EXCESS_ERR_INTERNAL;
+    }
+    if (err != DOCKER_EXCESS_OK) {
+        docker_excess_group_free(g);
+        return err;
+    }
     
-    return msg;
+    *group = g;
+    return DOCKER_EXCESS_OK;
 }
 
-void docker_excess_clear_error(docker_excess_t *client) {
-    if (!client) return;
+void docker_excess_group_free(docker_excess_group_t *group) {
+    if (!group) return;
+    
+    /* Fail outstanding requests while every member is still alive */
+    if (group->engine) async_engine_shutdown(group->engine);
     
-    pthread_mutex_lock(&client->mutex);
-    client->error_msg[0] = '\0';
-    pthread_mutex_unlock(&client->mutex);
+    /* Easy handles must be gone before the share they use */
+    if (group->engine) async_engine_destroy(group->engine);
+    for (size_t i = 0; i < group->count; i++) {
+        client_destroy(group->clients[i]);
+    }
+    free(group->clients);
+    share_cleanup(&group->share);
+    pthread_mutex_destroy(&group->mutex);
+    free(group);
 }
 
-docker_excess_error_t docker_excess_ping(docker_excess_t *client) {
-    if (!client) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+docker_excess_error_t docker_excess_group_add(docker_excess_group_t *group, const docker_excess_config_t *config,
+                                             docker_excess_t **client) {
+    if (!group || !config) return DOCKER_EXCESS_ERR_INVALID_PARAM;
     
-    char *response = NULL;
-    int http_code;
-    docker_excess_error_t err = make_request(client, "GET", "/_ping", NULL, &response, &http_code);
+    async_engine_t *engine = group->engine;
+    pthread_mutex_lock(&engine->mutex);
+    void *idle = realloc(engine->idle, (engine->idle_max + ASYNC_MAX_IDLE_HANDLES) * sizeof(*engine->idle));
+    if (idle) {
+        engine->idle = idle;
+        engine->idle_max += ASYNC_MAX_IDLE_HANDLES;
+    }
+    pthread_mutex_unlock(&engine->mutex);
+    if (!idle) return DOCKER_EXCESS_ERR_MEMORY;
     
-    if (err == DOCKER_EXCESS_OK) {
-        client->is_connected = true;
-        client->last_ping = time(NULL);
-        docker_excess_log(client, DOCKER_EXCESS_LOG_DEBUG, "Ping successful");
-    } else {
-        client->is_connected = false;
-        docker_excess_log(client, DOCKER_EXCESS_LOG_WARN, "Ping failed");
+    docker_excess_t *c = NULL;
+    docker_excess_error_t err = client_create(config, group, &c);
+    if (err != DOCKER_EXCESS_OK) return err;
+    
+    pthread_mutex_lock(&group->mutex);
+    if (group->count == group->capacity) {
+        size_t capacity = group->capacity ? group->capacity * 2 : 4;
+        docker_excess_t **clients = realloc(group->clients, capacity * sizeof(docker_excess_t*));
+        if (!clients) {
+            pthread_mutex_unlock(&group->mutex);
+            client_destroy(c);
+            return DOCKER_EXCESS_ERR_MEMORY;
+        }
+        group->clients = clients;
+        group->capacity = capacity;
     }
+    group->clients[group->count++] = c;
+    pthread_mutex_unlock(&group->mutex);
     
-    safe_free(response);
-    return err;
+    if (client) *client = c;
+    return DOCKER_EXCESS_OK;
 }
 
-docker_excess_error_t docker_excess_version(docker_excess_t *client, char **version_json) {
-    return make_request(client, "GET", "/version", NULL, version_json, NULL);
+size_t docker_excess_group_size(docker_excess_group_t *group) {
+    if (!group) return 0;
+    
+    pthread_mutex_lock(&group->mutex);
+    size_t count = group->count;
+    pthread_mutex_unlock(&group->mutex);
+    return count;
 }
 
-docker_excess_error_t docker_excess_system_info(docker_excess_t *client, char **info_json) {
-    return make_request(client, "GET", "/info", NULL, info_json, NULL);
+docker_excess_t* docker_excess_group_client(docker_excess_group_t *group, size_t index) {
+    if (!group) return NULL;
+    
+    pthread_mutex_lock(&group->mutex);
+    docker_excess_t *client = index < group->count ? group->clients[index] : NULL;
+    pthread_mutex_unlock(&group->mutex);
+    return client;
 }
 
-/* ----------------- Container Management Implementation ----------------- */
+/* Shared state of one fan-out across every member of a group */
+typedef struct {
+    docker_excess_group_callback_t callback;
+    docker_excess_group_list_callback_t list_callback;
+    container_projection_t projection;
+    void *userdata;
+    size_t remaining;
+    pthread_mutex_t mutex;
+} group_fanout_t;
 
-docker_excess_error_t docker_excess_list_containers(docker_excess_t *client, bool all,
-                                                   const char *filters,
-                                                   docker_excess_container_t ***containers, size_t *count) {
-    if (!client || !containers || !count) return DOCKER_EXCESS_ERR_INVALID_PARAM;
-    
-    char endpoint[512];
-    if (filters) {
-        char *encoded_filters = url_encode(filters);
-        snprintf(endpoint, sizeof(endpoint), "/containers/json?all=%s&filters=%s", 
-                all ? "true" : "false", encoded_filters);
-        safe_free(encoded_filters);
-    } else {
-        snprintf(endpoint, sizeof(endpoint), "/containers/json?all=%s", all ? "true" : "false");
+static void group_fanout_finish(group_fanout_t *fanout) {
+    pthread_mutex_lock(&fanout->mutex);
+    fanout->remaining--;
+    pthread_mutex_unlock(&fanout->mutex);
+}
+
+static void group_request_done(async_request_t *req, docker_excess_error_t err, int http_code) {
+    group_fanout_t *fanout = req->done_data;
+    if (fanout->callback) {
+        fanout->callback(req->tag, err, http_code, req->buffer.data, req->buffer.size, fanout->userdata);
     }
+    group_fanout_finish(fanout);
+}
+
+static void group_list_done(async_request_t *req, docker_excess_error_t err, int http_code) {
+    (void)http_code;
+    group_fanout_t *fanout = req->done_data;
+    docker_excess_container_t **containers = NULL;
+    size_t count = 0;
     
-    char *response = NULL;
-    docker_excess_error_t err = make_request(client, "GET", endpoint, NULL, &response, NULL);
-    if (err != DOCKER_EXCESS_OK) return err;
-    
-    json_object *json = json_tokener_parse(response);
-    safe_free(response);
+    if (err == DOCKER_EXCESS_OK) {
+        json_object *json = json_sink_finish(&req->json);
+        if (json && json_object_get_type(json) == json_type_array) {
+            err = build_container_list(json, &fanout->projection, NULL, &containers, &count);
+        } else {
+            set_error(req->client, "Invalid JSON response for container list");
+            err = DOCKER_EXCESS_ERR_JSON;
+        }
+        json_object_put(json);
+    }
     
-    if (!json || json_object_get_type(json) != json_type_array) {
-        if (json) json_object_put(json);
-        set_error(client, "Invalid JSON response for container list");
-        return DOCKER_EXCESS_ERR_JSON;
+    if (fanout->list_callback) {
+        fanout->list_callback(req->tag, err, containers, count, fanout->userdata);
+    } else {
+        docker_excess_free_containers(containers, count);
     }
+    group_fanout_finish(fanout);
+}
+
+/* Submit one request per member, then run the shared engine until every host answered */
+static docker_excess_error_t group_fanout_run(docker_excess_group_t *group, group_fanout_t *fanout,
+                                              const char *method, const char *endpoint, const char *body,
+                                              bool parse_json) {
+    pthread_mutex_lock(&group->mutex);
+    size_t count = group->count;
+    docker_excess_t **clients = count > 0 ? malloc(count * sizeof(docker_excess_t*)) : NULL;
+    if (clients) memcpy(clients, group->clients, count * sizeof(docker_excess_t*));
+    pthread_mutex_unlock(&group->mutex);
     
-    size_t array_len = json_object_array_length(json);
-    docker_excess_container_t **result = NULL;
+    if (count == 0) return DOCKER_EXCESS_OK;
+    if (!clients) return DOCKER_EXCESS_ERR_MEMORY;
     
-    if (array_len > 0) {
-        result = calloc(array_len, sizeof(docker_excess_container_t*));
-        if (!result) {
-            json_object_put(json);
-            return DOCKER_EXCESS_ERR_MEMORY;
+    async_engine_t *engine = group->engine;
+    pthread_mutex_init(&fanout->mutex, NULL);
+    fanout->remaining = count;
+    
+    for (size_t i = 0; i < count; i++) {
+        async_request_t *req = async_request_new(clients[i], engine, method, endpoint, body);
+        if (req && parse_json && !async_request_parse_json(req)) {
+            async_request_free(engine, req);
+            req = NULL;
         }
-        
-        for (size_t i = 0; i < array_len; i++) {
-            json_object *container_obj = json_object_array_get_idx(json, i);
-            if (!container_obj) continue;
-            
-            docker_excess_container_t *container = calloc(1, sizeof(docker_excess_container_t));
-            if (!container) continue;
-            
-            const char *id = get_json_string(container_obj, "Id");
-            if (id) {
-                container->id = safe_strdup(id);
-                container->short_id = docker_excess_short_id(id);
+        if (!req) {
+            /* Report the host like any other failure so callers see every index once */
+            if (fanout->callback) {
+                fanout->callback(i, DOCKER_EXCESS_ERR_MEMORY, 0, NULL, 0, fanout->userdata);
             }
-            
-            const char *image = get_json_string(container_obj, "Image");
-            container->image = safe_strdup(image);
-            
-            const char *image_id = get_json_string(container_obj, "ImageID");
-            container->image_id = safe_strdup(image_id);
-            
-            const char *status = get_json_string(container_obj, "Status");
-            container->status = safe_strdup(status);
-            
-            const char *state = get_json_string(container_obj, "State");
-            container->state = parse_container_state(state);
-            
-            container->created = get_json_int(container_obj, "Created");
-            
-            /* Parse names array */
-            json_object *names_obj = get_json_object(container_obj, "Names");
-            if (names_obj && json_object_get_type(names_obj) == json_type_array) {
-                if (json_object_array_length(names_obj) > 0) {
-                    json_object *name_obj = json_object_array_get_idx(names_obj, 0);
-                    const char *name = json_object_get_string(name_obj);
-                    if (name && name[0] == '/') {
-                        container->name = safe_strdup(name + 1); /* Skip leading '/' */
-                    }
-                }
+            if (fanout->list_callback) {
+                fanout->list_callback(i, DOCKER_EXCESS_ERR_MEMORY, NULL, 0, fanout->userdata);
             }
-            
-            /* Parse labels */
-            json_object *labels_obj = get_json_object(container_obj, "Labels");
-            if (labels_obj) {
-                docker_excess_parse_labels(json_object_to_json_string(labels_obj), 
-                                         &container->labels, &container->labels_count);
-            }
-            
-            result[i] = container;
+            group_fanout_finish(fanout);
+            continue;
         }
+        
+        req->done = parse_json ? group_list_done : group_request_done;
+        req->done_data = fanout;
+        req->tag = i;
+        async_request_enqueue(engine, req);
     }
+    free(clients);
     
-    json_object_put(json);
+    /* If the engine fails, the hosts still outstanding get its error */
+    docker_excess_error_t result = DOCKER_EXCESS_OK;
+    for (;;) {
+        pthread_mutex_lock(&fanout->mutex);
+        bool done = fanout->remaining == 0;
+        pthread_mutex_unlock(&fanout->mutex);
+        if (done) break;
     
-    *containers = result;
-    *count = array_len;
-    return DOCKER_EXCESS_OK;
+        if (result != DOCKER_EXCESS_OK) {
+            if (async_engine_fail_owned(engine, fanout, result) == 0) sched_yield();
+            continue;
+        }
+    
+        /* Short waits: another thread may be running the same engine */
+        result = async_engine_run(engine, 100);
+    }
+    
+    pthread_mutex_destroy(&fanout->mutex);
+    return result;
 }
 
-docker_excess_error_t docker_excess_inspect_container(docker_excess_t *client, const char *container_id,
-                                                     docker_excess_container_t **container) {
-    if (!client || !container_id || !container) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+docker_excess_error_t docker_excess_group_request(docker_excess_group_t *group, const char *method,
+                                                 const char *endpoint, const char *body,
+                                                 docker_excess_group_callback_t callback, void *userdata) {
+    if (!group || !method || !endpoint) return DOCKER_EXCESS_ERR_INVALID_PARAM;
     
-    char *encoded_id = url_encode(container_id);
-    if (!encoded_id) return DOCKER_EXCESS_ERR_MEMORY;
+    group_fanout_t fanout = {
+        .callback = callback,
+        .userdata = userdata,
+    };
+    return group_fanout_run(group, &fanout, method, endpoint, body, false);
+}
+
+docker_excess_error_t docker_excess_group_list_containers(docker_excess_group_t *group,
+                                                         const docker_excess_list_options_t *options,
+                                                         docker_excess_group_list_callback_t callback,
+                                                         void *userdata) {
+    if (!group) return DOCKER_EXCESS_ERR_INVALID_PARAM;
     
-    char endpoint[512];
-    snprintf(endpoint, sizeof(endpoint), "/containers/%s/json", encoded_id);
-    safe_free(encoded_id);
+    /* The endpoint does not depend on the host, only the filters */
+    char endpoint[DOCKER_EXCESS_MAX_URL_LEN];
+    if (!build_container_list_endpoint(NULL, options ? options->all : false, options ? options->filters : NULL,
+                                       endpoint, sizeof(endpoint))) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    }
     
-    char *response = NULL;
-    docker_excess_error_t err = make_request(client, "GET", endpoint, NULL, &response, NULL);
-    if (err != DOCKER_EXCESS_OK) return err;
+    group_fanout_t fanout = {
+        .list_callback = callback,
+        .projection = make_projection(options),
+        .userdata = userdata,
+    };
+    return group_fanout_run(group, &fanout, "GET", endpoint, NULL, true);
+}
+
+/* ----------------- Raw API Access ----------------- */
+
+docker_excess_error_t docker_excess_raw_request(docker_excess_t *client, const char *method,
+                                               const char *endpoint, const char *body,
+                                               char **response, int *http_code) {
+    return make_request(client, method, endpoint, body, response, http_code);
+}
+
+docker_excess_error_t docker_excess_raw_request_body(docker_excess_t *client, const char *method,
+                                                    const char *endpoint, const docker_excess_body_t *body,
+                                                    char **response, size_t *response_size, int *http_code) {
+    if (!client || !method || !endpoint) return DOCKER_EXCESS_ERR_INVALID_PARAM;
     
-    json_object *json = json_tokener_parse(response);
-    safe_free(response);
+    response_buffer_t buffer = {0};
+    docker_excess_error_t err = make_request_body(client, method, endpoint, body, 0,
+                                                  (curl_write_callback)write_response_callback, &buffer,
+                                                  http_code, NULL);
     
-    if (!json) {
-        return DOCKER_EXCESS_ERR_JSON;
+    if (response) {
+        *response = buffer.data;
+        if (response_size) *response_size = buffer.size;
+    } else {
+        safe_free(buffer.data);
     }
-    
-    docker_excess_container_t *result = calloc(1, sizeof(docker_excess_container_t));
-    if (!result) {
-        json_object_put(json);
-        return DOCKER_EXCESS_ERR_MEMORY;
+    return err;
+}
+
+docker_excess_error_t docker_excess_raw_request_sink(docker_excess_t *client, const char *method,
+                                                    const char *endpoint, const docker_excess_body_t *body,
+                                                    docker_excess_sink_t *sink, int *http_code) {
+    if (!client || !method || !endpoint || !sink) return DOCKER_EXCESS_ERR_INVALID_PARAM;
+    if (sink->type == DOCKER_EXCESS_SINK_BUFFER && !sink->buffer && sink->capacity > 0) {
+        return DOCKER_EXCESS_ERR_INVALID_PARAM;
     }
+    if (sink->type == DOCKER_EXCESS_SINK_FD && sink->fd < 0) return DOCKER_EXCESS_ERR_INVALID_PARAM;
     
-    /* Parse detailed container information */
-    const char *id = get_json_string(json, "Id");
-    if (id) {
-        result->id = safe_strdup(id);
-        result->short_id = docker_excess_short_id(id);
-    }
+    sink->data = NULL;
+    sink->size = 0;
+    sink->mapped = false;
     
-    const char *name = get_json_string(json, "Name");
-    if (name && name[0] == '/') {
-        result->name = safe_strdup(name + 1);
-    }
+    sink_writer_t writer = { .sink = sink, .spill_fd = -1 };
+    CURLcode res = CURLE_OK;
+    docker_excess_error_t err = make_request_body(client, method, endpoint, body, 0, write_sink_callback, &writer,
+                                                  http_code, &res);
     
-    /* Parse Config section */
-    json_object *config_obj = get_json_object(json, "Config");
-    if (config_obj) {
-        const char *image = get_json_string(config_obj, "Image");
-        result->image = safe_strdup(image);
-        
-        json_object *labels_obj = get_json_object(config_obj, "Labels");
-        if (labels_obj) {
-            docker_excess_parse_labels(json_object_to_json_string(labels_obj),
-                                     &result->labels, &result->labels_count);
+    /* The body of an HTTP error is still handed over; a failed transfer leaves the sink empty */
+    if (writer.over_limit) {
+        set_error(client, "Response from %s exceeds %lld bytes", endpoint, (long long)sink_limit(sink));
+        err = DOCKER_EXCESS_ERR_MEMORY;
+    } else if (writer.error) {
+        set_error(client, "Failed to store response from %s: %s", endpoint, strerror(writer.error));
+        err = map_errno(writer.error);
+    } else if (res == CURLE_OK) {
+        docker_excess_error_t finish = sink_writer_finish(&writer);
+        if (finish != DOCKER_EXCESS_OK) {
+            set_error(client, "Failed to map spilled response: %s", strerror(errno));
+            err = finish;
         }
     }
     
-    /* Parse State section */
-    json_object *state_obj = get_json_object(json, "State");
-    if (state_obj) {
-        const char *status = get_json_string(state_obj, "Status");
-        result->state = parse_container_state(status);
-        
-        result->exit_code = (int)get_json_int(state_obj, "ExitCode");
-        
-        const char *started_at = get_json_string(state_obj, "StartedAt");
-        const char *finished_at = get_json_string(state_obj, "FinishedAt");
-        /* TODO: Parse ISO 8601 timestamps */
-    }
-    
-    result->created = get_json_int(json, "Created");
-    
-    json_object_put(json);
-    *container = result;
-    return DOCKER_EXCESS_OK;
+    sink_writer_cleanup(&writer);
+    return err;
 }
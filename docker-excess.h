@@ -9,6 +9,7 @@ extern "C" {
 #include <stdbool.h>
 #include <stddef.h>
 #include <time.h>
+#include <sys/types.h>
 
 /* ----------------- Version Information ----------------- */
 #define DOCKER_EXCESS_VERSION_MAJOR 2
@@ -19,11 +20,30 @@ extern "C" {
 /* ----------------- Core Types & Constants ----------------- */
 #define DOCKER_EXCESS_DEFAULT_SOCKET "/var/run/docker.sock"
 #define DOCKER_EXCESS_DEFAULT_TIMEOUT_S 30
+#define DOCKER_EXCESS_DEFAULT_MAX_CONNECTIONS 8
+#define DOCKER_EXCESS_DEFAULT_RESOLVE_CACHE_SIZE 1024
+#define DOCKER_EXCESS_DEFAULT_RESOLVE_CACHE_TTL 60
+#define DOCKER_EXCESS_DEFAULT_PROGRESS_INTERVAL_MS 250
+#define DOCKER_EXCESS_DEFAULT_PULL_PARALLEL 4
+#define DOCKER_EXCESS_DEFAULT_BULK_PARALLEL 64
+#define DOCKER_EXCESS_DEFAULT_SPILL_THRESHOLD (8 * 1024 * 1024)
+#define DOCKER_EXCESS_DEFAULT_CONNECT_TIMEOUT 10
+#define DOCKER_EXCESS_DEFAULT_MAX_RETRIES 2
+#define DOCKER_EXCESS_DEFAULT_RETRY_BACKOFF_MS 50
+#define DOCKER_EXCESS_DEFAULT_BREAKER_THRESHOLD 5
+#define DOCKER_EXCESS_DEFAULT_BREAKER_COOLDOWN_MS 5000
 #define DOCKER_EXCESS_API_VERSION "1.41"
 #define DOCKER_EXCESS_MAX_ERROR_MSG 512
 #define DOCKER_EXCESS_MAX_URL_LEN 2048
 
 typedef struct docker_excess_t docker_excess_t;
+typedef struct docker_excess_group docker_excess_group_t;
+typedef struct docker_excess_arena_t docker_excess_arena_t;
+struct docker_excess_label_index;
+typedef struct docker_excess_cache docker_excess_cache_t;
+typedef struct docker_excess_cache_snapshot docker_excess_cache_snapshot_t;
+typedef struct docker_excess_build_context docker_excess_build_context_t;
+typedef struct docker_excess_create_template docker_excess_create_template_t;
 
 /* Enhanced error codes */
 typedef enum {
@@ -54,14 +74,49 @@ typedef enum {
     DOCKER_EXCESS_STATE_DEAD
 } docker_excess_container_state_t;
 
-/* Log levels */
+/* Log levels; DEFAULT is only for config.log_level, where it means INFO */
 typedef enum {
+    DOCKER_EXCESS_LOG_DEFAULT,
     DOCKER_EXCESS_LOG_ERROR,
     DOCKER_EXCESS_LOG_WARN,
     DOCKER_EXCESS_LOG_INFO,
     DOCKER_EXCESS_LOG_DEBUG
 } docker_excess_log_level_t;
 
+/* Log2 latency histogram: buckets[i] counts values below 2^i microseconds, the last one is open */
+#define DOCKER_EXCESS_HIST_BUCKETS 26
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t max_us;
+    uint64_t buckets[DOCKER_EXCESS_HIST_BUCKETS];
+} docker_excess_histogram_t;
+
+/* One finished request; timings in microseconds, 0 for phases that did not happen (reused connection) */
+typedef struct {
+    const char *method;
+    const char *endpoint;           /* As requested, query included */
+    const char *route;              /* Endpoint with IDs and query replaced, e.g. "/containers/{id}/json" */
+    int http_code;                  /* 0 = no response */
+    docker_excess_error_t error;
+    bool async;
+    bool new_connection;            /* false = reused a keep-alive connection */
+    int64_t pool_wait_us;           /* Waiting for a pooled handle, or queued in the async engine */
+    int64_t dns_us;
+    int64_t connect_us;
+    int64_t tls_us;
+    int64_t first_byte_us;          /* Request sent to first response byte: time spent in the daemon */
+    int64_t total_us;               /* Whole transfer, pool wait excluded */
+    int64_t json_parse_us;          /* Incremental parse of a JSON response, 0 = none */
+    int64_t bytes_in;
+    int64_t bytes_out;
+} docker_excess_span_t;
+
+/* begin returns a token handed back to end; end runs exactly once per begin, on the completing thread */
+typedef void* (*docker_excess_span_begin_t)(const char *method, const char *endpoint, void *userdata);
+typedef void (*docker_excess_span_end_t)(void *span, const docker_excess_span_t *info, void *userdata);
+
 /* ----------------- Configuration Structure ----------------- */
 typedef struct {
     char *socket_path;              /* Docker socket path (default: /var/run/docker.sock) */
@@ -72,13 +127,36 @@ typedef struct {
     char *key_path;                 /* TLS key path */
     char *ca_path;                  /* TLS CA path */
     int timeout_s;                  /* Request timeout in seconds */
+    int connect_timeout_s;          /* Connection setup timeout (0 = default) */
+    int max_retries;                /* Retries of idempotent requests (0 = off, e.g. DOCKER_EXCESS_DEFAULT_MAX_RETRIES) */
+    int retry_backoff_ms;           /* Upper bound of the first jittered retry delay (0 = default) */
+    bool hedge_reads;               /* Send a second GET when the first is slow to answer */
+    int hedge_delay_ms;             /* When to hedge (0 = the route's p95, needs metrics) */
+    int breaker_threshold;          /* Consecutive unreachable-daemon failures that open the breaker (0 = off) */
+    int breaker_cooldown_ms;        /* Fail fast this long before probing again (0 = default) */
+    int max_connections;            /* Max parallel requests per client (0 = default) */
+    int resolve_cache_size;         /* Cached name -> ID lookups (0 = default, < 0 = off) */
+    int resolve_cache_ttl_s;        /* Lifetime of a cached lookup (0 = default) */
     bool debug;                     /* Enable debug logging */
+    bool compression;               /* Compressed responses and gzip archive uploads (remote daemons) */
     void (*log_callback)(docker_excess_log_level_t level, const char *message, void *userdata);
     void *log_userdata;             /* User data for log callback */
+    docker_excess_log_level_t log_level;    /* Most verbose level passed to log_callback (0 = INFO, debug = DEBUG) */
+    bool metrics;                   /* Per-route counters and histograms, see docker_excess_metrics_snapshot() */
+    docker_excess_span_begin_t span_begin;  /* Optional */
+    docker_excess_span_end_t span_end;      /* Tracing is off while NULL */
+    void *span_userdata;
 } docker_excess_config_t;
 
 /* ----------------- Data Structures ----------------- */
 
+/* Last failure of a thread on a client, see docker_excess_last_result() */
+typedef struct {
+    docker_excess_error_t code;     /* Status of a failed request, OK if the error did not come from one */
+    int http_code;                  /* 0 = no response */
+    char message[DOCKER_EXCESS_MAX_ERROR_MSG];
+} docker_excess_result_t;
+
 /* Port mapping structure */
 typedef struct {
     uint16_t host_port;
@@ -111,8 +189,8 @@ typedef struct {
     char *status;                   /* Status string */
     docker_excess_container_state_t state;
     int64_t created;                /* Creation timestamp */
-    int64_t started_at;             /* Start timestamp */
-    int64_t finished_at;            /* Finish timestamp */
+    int64_t started_at;             /* Last start, Unix seconds (inspect only; 0 = never) */
+    int64_t finished_at;            /* Last exit, Unix seconds (inspect only; 0 = never) */
     int exit_code;                  /* Exit code (if exited) */
     docker_excess_port_mapping_t *ports;
     size_t ports_count;
@@ -120,8 +198,45 @@ typedef struct {
     size_t mounts_count;
     char **labels;                  /* Array of "key=value" strings */
     size_t labels_count;
+    struct docker_excess_label_index *label_index; /* Lookup table for docker_excess_get_label() (internal) */
 } docker_excess_container_t;
 
+/* Container fields for projection; 0 in a field mask means all fields */
+#define DOCKER_EXCESS_FIELD_ID          (1u << 0)   /* id and short_id */
+#define DOCKER_EXCESS_FIELD_NAME        (1u << 1)
+#define DOCKER_EXCESS_FIELD_IMAGE       (1u << 2)
+#define DOCKER_EXCESS_FIELD_IMAGE_ID    (1u << 3)
+#define DOCKER_EXCESS_FIELD_STATUS      (1u << 4)
+#define DOCKER_EXCESS_FIELD_STATE       (1u << 5)   /* state, and started_at/finished_at on inspect */
+#define DOCKER_EXCESS_FIELD_CREATED     (1u << 6)
+#define DOCKER_EXCESS_FIELD_EXIT_CODE   (1u << 7)
+#define DOCKER_EXCESS_FIELD_LABELS      (1u << 8)
+#define DOCKER_EXCESS_FIELD_ALL         0xffffffffu
+
+/* Options for docker_excess_list_containers_ex() */
+typedef struct {
+    bool all;                       /* Include stopped containers */
+    const char *filters;            /* JSON filters (optional) */
+    uint32_t fields;                /* DOCKER_EXCESS_FIELD_* mask (0 = all) */
+    const char **label_keys;        /* Only keep these labels (NULL = all) */
+    size_t label_keys_count;
+    docker_excess_arena_t **arena;  /* Allocate the result in a new arena (optional) */
+} docker_excess_list_options_t;
+
+/* Changes since the last docker_excess_list_containers_delta() call; containers are shared, read-only */
+typedef struct {
+    docker_excess_container_t **containers;  /* The whole current list, in daemon order */
+    size_t count;
+    docker_excess_container_t **added;       /* Subsets of containers */
+    size_t added_count;
+    docker_excess_container_t **changed;
+    size_t changed_count;
+    char **removed;                 /* IDs of containers gone since the token */
+    size_t removed_count;
+    uint64_t token;                 /* Pass to the next call */
+    bool full;                      /* Token unknown or stale: every container is in added, none removed */
+} docker_excess_container_delta_t;
+
 /* Image information */
 typedef struct {
     char *id;                       /* Full image ID */
@@ -236,6 +351,15 @@ typedef struct {
     int health_start_period_s;      /* Health check start period */
 } docker_excess_container_create_t;
 
+/* Per-container values rendered into a compiled create template */
+typedef struct {
+    const char *name;                       /* Container name (NULL = generated) */
+    const docker_excess_env_var_t *env;     /* Added to the template's, same name replaces */
+    size_t env_count;
+    const char **labels;                    /* "key=value", added to the template's, same key replaces */
+    size_t labels_count;
+} docker_excess_create_instance_t;
+
 /* Image build parameters */
 typedef struct {
     char *dockerfile_path;          /* Path to Dockerfile */
@@ -266,6 +390,39 @@ typedef struct {
     bool detach;                    /* Run detached */
 } docker_excess_exec_params_t;
 
+/* Lifecycle operations for docker_excess_bulk_op() */
+typedef enum {
+    DOCKER_EXCESS_OP_START,
+    DOCKER_EXCESS_OP_STOP,
+    DOCKER_EXCESS_OP_KILL,
+    DOCKER_EXCESS_OP_RESTART,
+    DOCKER_EXCESS_OP_REMOVE,
+    DOCKER_EXCESS_OP_PAUSE,
+    DOCKER_EXCESS_OP_UNPAUSE
+} docker_excess_bulk_op_t;
+
+typedef struct {
+    size_t max_parallel;            /* Operations in flight (0 = default) */
+    int deadline_ms;                /* For the whole call (0 = none) */
+    int timeout_s;                  /* Stop/restart grace period (0 = daemon default) */
+    const char *signal;             /* Kill signal (NULL = SIGKILL) */
+    bool force;                     /* Remove: kill running containers first */
+    bool remove_volumes;            /* Remove: also anonymous volumes */
+} docker_excess_bulk_options_t;
+
+/* Exec output in caller-owned buffers; either buffer may be NULL to discard that stream */
+typedef struct {
+    char *stdout_buf;
+    size_t stdout_size;
+    size_t stdout_len;              /* Bytes stored (the buffer is always NUL-terminated) */
+    bool stdout_truncated;          /* Output did not fit */
+    char *stderr_buf;
+    size_t stderr_size;
+    size_t stderr_len;
+    bool stderr_truncated;
+    int exit_code;                  /* -1 if unknown (detached) */
+} docker_excess_exec_result_t;
+
 /* Log parameters */
 typedef struct {
     bool follow;                    /* Follow log output */
@@ -276,10 +433,165 @@ typedef struct {
     time_t until;                   /* Show logs until timestamp (0 = all) */
 } docker_excess_log_params_t;
 
+/* Stream ids of multiplexed log and attach frames */
+#define DOCKER_EXCESS_STREAM_STDIN  0
+#define DOCKER_EXCESS_STREAM_STDOUT 1
+#define DOCKER_EXCESS_STREAM_STDERR 2
+
+/* One pre-parsed stats frame */
+typedef struct {
+    time_t read_time;               /* When the frame was received */
+    uint64_t cpu_total_ns;          /* Container CPU time */
+    uint64_t system_cpu_ns;         /* Host CPU time */
+    uint64_t cpu_delta_ns;          /* Container CPU time since the previous frame */
+    uint64_t system_cpu_delta_ns;   /* Host CPU time since the previous frame */
+    uint32_t online_cpus;
+    double cpu_percent;             /* Same formula as `docker stats` */
+    uint64_t memory_usage;          /* Bytes, including page cache */
+    uint64_t memory_limit;          /* Bytes */
+    uint64_t memory_cache;          /* Inactive file cache in bytes */
+    double memory_percent;          /* (usage - cache) / limit */
+    uint64_t net_rx_bytes;          /* Summed over all interfaces */
+    uint64_t net_tx_bytes;
+    uint64_t net_rx_packets;
+    uint64_t net_tx_packets;
+    uint64_t blk_read_bytes;        /* Summed over all devices */
+    uint64_t blk_write_bytes;
+    uint64_t pids;
+} docker_excess_stats_sample_t;
+
+/* Request body sources */
+typedef enum {
+    DOCKER_EXCESS_BODY_NONE = 0,
+    DOCKER_EXCESS_BODY_MEMORY,      /* data/size, sent without copying */
+    DOCKER_EXCESS_BODY_FD,          /* fd from offset, length bytes (-1 = until EOF) */
+    DOCKER_EXCESS_BODY_CALLBACK     /* read() pulled until it returns 0 */
+} docker_excess_body_type_t;
+
+/* Fill up to size bytes; return the count, 0 at the end or DOCKER_EXCESS_BODY_ABORT */
+#define DOCKER_EXCESS_BODY_ABORT ((size_t)-1)
+typedef size_t (*docker_excess_body_read_t)(void *buffer, size_t size, void *userdata);
+
+/* Binary-safe request body */
+typedef struct {
+    docker_excess_body_type_t type;
+    const void *data;               /* MEMORY */
+    size_t size;
+    int fd;                         /* FD, read with pread(): the file offset is left alone */
+    off_t offset;
+    int64_t length;                 /* FD and CALLBACK: total bytes, -1 = unknown (chunked) */
+    docker_excess_body_read_t read; /* CALLBACK */
+    void *userdata;
+    const char *content_type;       /* NULL = application/json */
+} docker_excess_body_t;
+
+/* Layer states during pull and push, in order */
+typedef enum {
+    DOCKER_EXCESS_LAYER_WAITING = 0,    /* Queued, or waiting for another transfer */
+    DOCKER_EXCESS_LAYER_TRANSFERRING,   /* Downloading or pushing */
+    DOCKER_EXCESS_LAYER_EXTRACTING,     /* Verifying and extracting (pull only) */
+    DOCKER_EXCESS_LAYER_DONE            /* Complete, already present or mounted */
+} docker_excess_layer_state_t;
+
+typedef struct {
+    char id[72];                    /* Layer ID as reported by the daemon */
+    docker_excess_layer_state_t state;
+    int64_t current;                /* Bytes transferred */
+    int64_t total;                  /* Layer size, 0 = unknown */
+} docker_excess_layer_progress_t;
+
+/* Aggregated pull/push progress; valid only during the callback */
+typedef struct {
+    const docker_excess_layer_progress_t *layers;  /* In order of appearance */
+    size_t layers_count;
+    size_t layers_done;
+    int64_t current;                /* Bytes transferred over all layers */
+    int64_t total;                  /* Sum of the known layer sizes */
+    const char *status;             /* Last message not about a layer, or NULL */
+    size_t images_count;            /* Images in this transfer (1 except for pull_images) */
+    size_t images_done;             /* Pulled, skipped or failed */
+    bool finished;                  /* Last call for this transfer */
+} docker_excess_transfer_progress_t;
+
+typedef struct {
+    int interval_ms;                /* Minimum time between callbacks (0 = default, < 0 = every message) */
+    const char *registry_auth;      /* X-Registry-Auth value (base64 JSON), NULL = none */
+} docker_excess_transfer_options_t;
+
+typedef struct {
+    size_t max_parallel;            /* Concurrent pulls (0 = default) */
+    bool skip_present;              /* Also skip tags already present (digests always are) */
+    int interval_ms;                /* As in docker_excess_transfer_options_t */
+    const char *registry_auth;
+} docker_excess_pull_options_t;
+
+/* Counters of one method and route */
+typedef struct {
+    char method[16];
+    char route[96];                 /* "*" collects routes past the table size */
+    uint64_t requests;
+    uint64_t errors;                /* Transport errors and HTTP statuses >= 400 */
+    uint64_t retries;
+    int64_t bytes_in;
+    int64_t bytes_out;
+    docker_excess_histogram_t dns;
+    docker_excess_histogram_t connect;
+    docker_excess_histogram_t tls;
+    docker_excess_histogram_t first_byte;
+    docker_excess_histogram_t total;
+} docker_excess_route_metrics_t;
+
+typedef struct {
+    docker_excess_route_metrics_t *routes;  /* In order of first use */
+    size_t routes_count;
+    docker_excess_histogram_t pool_wait;
+    docker_excess_histogram_t json_parse;
+    uint64_t retries;
+} docker_excess_metrics_t;
+
+/* Response body destinations */
+typedef enum {
+    DOCKER_EXCESS_SINK_MEMORY = 0,  /* Heap buffer, NUL-terminated, freed by docker_excess_sink_release() */
+    DOCKER_EXCESS_SINK_BUFFER,      /* Caller's buffer; a longer body fails the request */
+    DOCKER_EXCESS_SINK_FD,          /* Written to fd as it arrives */
+    DOCKER_EXCESS_SINK_SPILL        /* Heap up to spill_threshold, then an unlinked temp file mapped read-only */
+} docker_excess_sink_type_t;
+
+typedef struct {
+    docker_excess_sink_type_t type;
+    void *buffer;                   /* BUFFER */
+    size_t capacity;
+    int fd;                         /* FD */
+    size_t spill_threshold;         /* SPILL: 0 = default */
+    const char *spill_dir;          /* SPILL: NULL = $TMPDIR, then /tmp */
+    int64_t limit;                  /* Most body bytes accepted, 0 = no limit */
+    
+    /* Filled in by the request; valid until docker_excess_sink_release() */
+    const void *data;               /* NULL for FD */
+    size_t size;                    /* Body bytes received */
+    bool mapped;                    /* SPILL went to disk: data maps spill_fd */
+    int spill_fd;                   /* Valid while mapped */
+} docker_excess_sink_t;
+
 /* ----------------- Callback Types ----------------- */
 typedef void (*docker_excess_log_callback_t)(const char *line, bool is_stderr, time_t timestamp, void *userdata);
+typedef bool (*docker_excess_log_frame_callback_t)(const void *data, size_t len, int stream_id, void *userdata);
 typedef void (*docker_excess_exec_callback_t)(const char *stdout_data, const char *stderr_data, void *userdata);
+typedef void (*docker_excess_exec_done_t)(docker_excess_error_t err, docker_excess_exec_result_t *result,
+                                          void *userdata);
 typedef void (*docker_excess_progress_callback_t)(const char *status, const char *progress, void *userdata);
+typedef bool (*docker_excess_stats_callback_t)(const char *container_id, const docker_excess_stats_sample_t *sample,
+                                               void *userdata);
+typedef bool (*docker_excess_transfer_callback_t)(const docker_excess_transfer_progress_t *progress,
+                                                  void *userdata);
+typedef void (*docker_excess_completion_callback_t)(docker_excess_error_t err, int http_code,
+                                                    const char *response, size_t size, void *userdata);
+typedef void (*docker_excess_group_callback_t)(size_t host, docker_excess_error_t err, int http_code,
+                                               const char *response, size_t size, void *userdata);
+/* containers belong to the callback: free with docker_excess_free_containers() */
+typedef void (*docker_excess_group_list_callback_t)(size_t host, docker_excess_error_t err,
+                                                    docker_excess_container_t **containers, size_t count,
+                                                    void *userdata);
 
 /* ----------------- Core Functions ----------------- */
 
@@ -295,15 +607,21 @@ docker_excess_error_t docker_excess_new_with_config(const docker_excess_config_t
 /* Free Docker client */
 void docker_excess_free(docker_excess_t *client);
 
-/* Get last error message (thread-safe) */
+/* Last error message of the calling thread on this client; valid until that thread's next error */
 const char* docker_excess_get_error(docker_excess_t *client);
 
-/* Clear last error */
+/* Copy the calling thread's last failure on this client and return its code */
+docker_excess_error_t docker_excess_last_result(docker_excess_t *client, docker_excess_result_t *result);
+
+/* Clear the calling thread's last error */
 void docker_excess_clear_error(docker_excess_t *client);
 
-/* Test connection to Docker daemon */
+/* Test connection to Docker daemon; bypasses the circuit breaker and closes it on success */
 docker_excess_error_t docker_excess_ping(docker_excess_t *client);
 
+/* True while requests fail fast because the daemon looked unhealthy */
+bool docker_excess_circuit_open(docker_excess_t *client);
+
 /* Get Docker version information */
 docker_excess_error_t docker_excess_version(docker_excess_t *client, char **version_json);
 
@@ -314,6 +632,63 @@ docker_excess_error_t docker_excess_system_info(docker_excess_t *client, char **
 docker_excess_error_t docker_excess_events(docker_excess_t *client,
                                           docker_excess_log_callback_t callback, void *userdata);
 
+/* ----------------- Asynchronous Requests ----------------- */
+
+/* Queue a request without blocking; callback runs from docker_excess_async_run() */
+docker_excess_error_t docker_excess_submit(docker_excess_t *client, const char *method,
+                                          const char *endpoint, const char *body,
+                                          docker_excess_completion_callback_t callback, void *userdata);
+
+/* Pollable fd for the async engine (readable when docker_excess_async_run() has work) */
+int docker_excess_async_fd(docker_excess_t *client);
+
+/* Process ready I/O and run completion callbacks (timeout_ms: -1 = block, 0 = poll) */
+docker_excess_error_t docker_excess_async_run(docker_excess_t *client, int timeout_ms);
+
+/* Number of submitted requests that have not completed yet */
+size_t docker_excess_async_pending(docker_excess_t *client);
+
+/* ----------------- Host Groups ----------------- */
+
+/* Empty group; members share one DNS/TLS cache and one async engine */
+docker_excess_error_t docker_excess_group_new(docker_excess_group_t **group);
+
+/* Free the group and every member client */
+void docker_excess_group_free(docker_excess_group_t *group);
+
+/* Add a client for another daemon; the group owns it (docker_excess_free() on it is a no-op) */
+docker_excess_error_t docker_excess_group_add(docker_excess_group_t *group, const docker_excess_config_t *config,
+                                             docker_excess_t **client);
+
+size_t docker_excess_group_size(docker_excess_group_t *group);
+
+/* Member in insertion order, NULL past the end */
+docker_excess_t* docker_excess_group_client(docker_excess_group_t *group, size_t index);
+
+/* Send the same request to every member concurrently; returns once each host's callback has run */
+docker_excess_error_t docker_excess_group_request(docker_excess_group_t *group, const char *method,
+                                                 const char *endpoint, const char *body,
+                                                 docker_excess_group_callback_t callback, void *userdata);
+
+/* List containers on every member concurrently (options->arena is ignored) */
+docker_excess_error_t docker_excess_group_list_containers(docker_excess_group_t *group,
+                                                         const docker_excess_list_options_t *options,
+                                                         docker_excess_group_list_callback_t callback,
+                                                         void *userdata);
+
+/* ----------------- Metrics ----------------- */
+
+/* Copy the counters of a client created with config.metrics; free with docker_excess_metrics_free() */
+docker_excess_error_t docker_excess_metrics_snapshot(docker_excess_t *client, docker_excess_metrics_t *metrics);
+
+void docker_excess_metrics_free(docker_excess_metrics_t *metrics);
+
+/* Zero every counter */
+void docker_excess_metrics_reset(docker_excess_t *client);
+
+/* Upper bound of the bucket holding the given quantile (0..1) in microseconds, 0 if empty */
+int64_t docker_excess_histogram_quantile(const docker_excess_histogram_t *hist, double quantile);
+
 /* ----------------- Container Management ----------------- */
 
 /* List containers with filtering options */
@@ -321,15 +696,65 @@ docker_excess_error_t docker_excess_list_containers(docker_excess_t *client, boo
                                                    const char *filters, /* JSON filters */
                                                    docker_excess_container_t ***containers, size_t *count);
 
+/* List containers into an arena: the whole result is freed by docker_excess_arena_free() */
+docker_excess_error_t docker_excess_list_containers_arena(docker_excess_t *client, bool all,
+                                                         const char *filters, docker_excess_arena_t **arena,
+                                                         docker_excess_container_t ***containers, size_t *count);
+
+/* List containers, filling only the fields selected in options */
+docker_excess_error_t docker_excess_list_containers_ex(docker_excess_t *client,
+                                                      const docker_excess_list_options_t *options,
+                                                      docker_excess_container_t ***containers, size_t *count);
+
+/* List containers, reporting what changed since `token` (0 = first call); options->arena is ignored
+ * and DOCKER_EXCESS_FIELD_ID is always filled in */
+docker_excess_error_t docker_excess_list_containers_delta(docker_excess_t *client,
+                                                         const docker_excess_list_options_t *options,
+                                                         uint64_t token, docker_excess_container_delta_t *delta);
+
+void docker_excess_container_delta_free(docker_excess_container_delta_t *delta);
+
 /* Get detailed container information */
 docker_excess_error_t docker_excess_inspect_container(docker_excess_t *client, const char *container_id,
                                                      docker_excess_container_t **container);
 
+/* Inspect a container, filling only DOCKER_EXCESS_FIELD_* members (0 = all) */
+docker_excess_error_t docker_excess_inspect_container_ex(docker_excess_t *client, const char *container_id,
+                                                        uint32_t fields, docker_excess_container_t **container);
+
+/* Inspect many containers concurrently (max_parallel 0 = max_connections).
+ * Results land in one contiguous array, errors[i] holds the per-item result. */
+docker_excess_error_t docker_excess_inspect_containers(docker_excess_t *client, const char **container_ids,
+                                                      size_t count, size_t max_parallel,
+                                                      docker_excess_container_t **containers,
+                                                      docker_excess_error_t *errors);
+
 /* Create container from parameters */
 docker_excess_error_t docker_excess_create_container(docker_excess_t *client,
                                                     const docker_excess_container_create_t *params,
                                                     char **container_id);
 
+/* Serialize create parameters once for many near-identical containers (params->name is not used) */
+docker_excess_error_t docker_excess_create_template_compile(const docker_excess_container_create_t *params,
+                                                           docker_excess_create_template_t **template_out);
+
+void docker_excess_create_template_free(docker_excess_create_template_t *tmpl);
+
+/* Create one container from a template; instance may be NULL */
+docker_excess_error_t docker_excess_create_from_template(docker_excess_t *client,
+                                                        const docker_excess_create_template_t *tmpl,
+                                                        const docker_excess_create_instance_t *instance,
+                                                        char **container_id);
+
+/* Create and start count containers, each start sent as soon as its create returns.
+ * container_ids[i] is set whenever the container was created, even if its start failed;
+ * only max_parallel and deadline_ms of options apply */
+docker_excess_error_t docker_excess_create_start_containers(docker_excess_t *client,
+                                                           const docker_excess_create_template_t *tmpl,
+                                                           const docker_excess_create_instance_t *instances,
+                                                           size_t count, const docker_excess_bulk_options_t *options,
+                                                           char **container_ids, docker_excess_error_t *errors);
+
 /* Start container by ID or name */
 docker_excess_error_t docker_excess_start_container(docker_excess_t *client, const char *container_id);
 
@@ -349,6 +774,17 @@ docker_excess_error_t docker_excess_remove_container(docker_excess_t *client, co
 docker_excess_error_t docker_excess_pause_container(docker_excess_t *client, const char *container_id);
 docker_excess_error_t docker_excess_unpause_container(docker_excess_t *client, const char *container_id);
 
+/*
+ * Apply one lifecycle operation to many containers concurrently. errors[i]
+ * receives the result for container_ids[i]; operations that could not be
+ * started before the deadline get DOCKER_EXCESS_ERR_TIMEOUT. Starting a
+ * running or stopping a stopped container counts as success.
+ */
+docker_excess_error_t docker_excess_bulk_op(docker_excess_t *client, docker_excess_bulk_op_t op,
+                                           const char **container_ids, size_t count,
+                                           const docker_excess_bulk_options_t *options,
+                                           docker_excess_error_t *errors);
+
 /* Wait for container to stop */
 docker_excess_error_t docker_excess_wait_container(docker_excess_t *client, const char *container_id, int *exit_code);
 
@@ -356,6 +792,14 @@ docker_excess_error_t docker_excess_wait_container(docker_excess_t *client, cons
 docker_excess_error_t docker_excess_stats_container(docker_excess_t *client, const char *container_id, bool stream,
                                                    char **stats_json);
 
+/* Stream stats frames until the callback returns false or the container stops */
+docker_excess_error_t docker_excess_stats_stream(docker_excess_t *client, const char *container_id,
+                                                docker_excess_stats_callback_t callback, void *userdata);
+
+/* Same, on the async engine; the callback gets sample == NULL once if the stream ends by itself */
+docker_excess_error_t docker_excess_async_stats(docker_excess_t *client, const char *container_id,
+                                               docker_excess_stats_callback_t callback, void *userdata);
+
 /* Get container processes */
 docker_excess_error_t docker_excess_top_container(docker_excess_t *client, const char *container_id,
                                                  const char *ps_args, char **processes_json);
@@ -367,13 +811,70 @@ docker_excess_error_t docker_excess_rename_container(docker_excess_t *client, co
 docker_excess_error_t docker_excess_update_container(docker_excess_t *client, const char *container_id,
                                                     int64_t memory_limit, double cpu_shares);
 
+/* ----------------- Container State Cache ----------------- */
+#define DOCKER_EXCESS_STATE_ANY (-1)
+
+/* Seed a cache from one list call and keep it current from /events (needs docker_excess_async_run) */
+docker_excess_error_t docker_excess_cache_start(docker_excess_t *client, docker_excess_cache_t **cache);
+
+/* Stop following events and free the cache; snapshots still held stay valid */
+void docker_excess_cache_stop(docker_excess_cache_t *cache);
+
+/* False once the events stream has ended; the cache no longer updates */
+bool docker_excess_cache_live(const docker_excess_cache_t *cache);
+
+/* Pin the current snapshot without locking; pair with docker_excess_cache_release() */
+const docker_excess_cache_snapshot_t* docker_excess_cache_acquire(docker_excess_cache_t *cache);
+void docker_excess_cache_release(const docker_excess_cache_snapshot_t *snapshot);
+
+/* Snapshot contents, sorted by container id */
+uint64_t docker_excess_cache_version(const docker_excess_cache_snapshot_t *snapshot);
+size_t docker_excess_cache_count(const docker_excess_cache_snapshot_t *snapshot);
+const docker_excess_container_t* docker_excess_cache_at(const docker_excess_cache_snapshot_t *snapshot,
+                                                        size_t index);
+
+/* Find by unique id prefix or by name */
+const docker_excess_container_t* docker_excess_cache_find(const docker_excess_cache_snapshot_t *snapshot,
+                                                          const char *id_or_name);
+
+/* Containers in `state` (or DOCKER_EXCESS_STATE_ANY) with a label (any value if label_value is NULL).
+   Stores up to max matches in out and returns the total number of matches. */
+size_t docker_excess_cache_select(const docker_excess_cache_snapshot_t *snapshot, int state,
+                                  const char *label_key, const char *label_value,
+                                  const docker_excess_container_t **out, size_t max);
+
 /* ----------------- Container Logs and Execution ----------------- */
 
-/* Get container logs with parameters */
+/* Get container logs line by line, per stream; with params->timestamps the time is parsed off each line */
 docker_excess_error_t docker_excess_get_logs(docker_excess_t *client, const char *container_id,
                                             const docker_excess_log_params_t *params,
                                             docker_excess_log_callback_t callback, void *userdata);
 
+/* Get container logs as raw demultiplexed slices, without copying or line splitting */
+docker_excess_error_t docker_excess_get_logs_raw(docker_excess_t *client, const char *container_id,
+                                                const docker_excess_log_params_t *params,
+                                                docker_excess_log_frame_callback_t callback, void *userdata);
+
+/* Same, on the async engine; the callback gets data == NULL once if the stream ends by itself */
+docker_excess_error_t docker_excess_async_logs_raw(docker_excess_t *client, const char *container_id,
+                                                  const docker_excess_log_params_t *params,
+                                                  docker_excess_log_frame_callback_t callback, void *userdata);
+
+/*
+ * Exec sessions: create, start and inspect are chained on the async engine
+ * using pooled connections, and output is demultiplexed into the caller's
+ * buffers. Any number of sessions can run concurrently.
+ */
+docker_excess_error_t docker_excess_exec_run(docker_excess_t *client, const char *container_id,
+                                            const docker_excess_exec_params_t *params,
+                                            docker_excess_exec_result_t *result);
+
+/* Same without blocking; done runs from docker_excess_async_run() once the exit code is known */
+docker_excess_error_t docker_excess_async_exec(docker_excess_t *client, const char *container_id,
+                                              const docker_excess_exec_params_t *params,
+                                              docker_excess_exec_result_t *result,
+                                              docker_excess_exec_done_t done, void *userdata);
+
 /* Execute command in container */
 docker_excess_error_t docker_excess_exec(docker_excess_t *client, const char *container_id,
                                         const docker_excess_exec_params_t *params,
@@ -410,6 +911,10 @@ docker_excess_error_t docker_excess_read_file(docker_excess_t *client, const cha
 docker_excess_error_t docker_excess_write_file(docker_excess_t *client, const char *container_id,
                                               const char *file_path, const char *content, size_t size, uint32_t mode);
 
+/* Extract a tar archive from any body source into a container directory */
+docker_excess_error_t docker_excess_put_archive(docker_excess_t *client, const char *container_id,
+                                               const char *container_path, const docker_excess_body_t *archive);
+
 /* Create directory in container */
 docker_excess_error_t docker_excess_mkdir(docker_excess_t *client, const char *container_id,
                                          const char *dir_path, uint32_t mode, bool parents);
@@ -437,6 +942,28 @@ docker_excess_error_t docker_excess_pull_image(docker_excess_t *client, const ch
 docker_excess_error_t docker_excess_push_image(docker_excess_t *client, const char *image_name, const char *tag,
                                               docker_excess_progress_callback_t callback, void *userdata);
 
+/*
+ * Pull/push with progress aggregated per layer. The callback gets running
+ * totals at most every interval_ms (plus a final call) instead of one call
+ * per daemon message; return false to cancel.
+ */
+docker_excess_error_t docker_excess_pull_image_ex(docker_excess_t *client, const char *image_name, const char *tag,
+                                                 const docker_excess_transfer_options_t *options,
+                                                 docker_excess_transfer_callback_t callback, void *userdata);
+docker_excess_error_t docker_excess_push_image_ex(docker_excess_t *client, const char *image_name, const char *tag,
+                                                 const docker_excess_transfer_options_t *options,
+                                                 docker_excess_transfer_callback_t callback, void *userdata);
+
+/*
+ * Pull several images ("name:tag" or "name@digest") concurrently. Images
+ * already present are skipped, progress is combined over all of them, and
+ * errors[i] receives the result for images[i].
+ */
+docker_excess_error_t docker_excess_pull_images(docker_excess_t *client, const char **images, size_t count,
+                                               const docker_excess_pull_options_t *options,
+                                               docker_excess_transfer_callback_t callback, void *userdata,
+                                               docker_excess_error_t *errors);
+
 /* Remove image */
 docker_excess_error_t docker_excess_remove_image(docker_excess_t *client, const char *image_name, bool force, bool no_prune);
 
@@ -445,6 +972,23 @@ docker_excess_error_t docker_excess_build_image(docker_excess_t *client,
                                                const docker_excess_image_build_t *params,
                                                docker_excess_progress_callback_t callback, void *userdata);
 
+/*
+ * Build context kept between builds of the same directory. Compressed
+ * entries of unchanged files (same size, inode, mtime and ctime) are reused
+ * up to cache_bytes; one build at a time per context.
+ */
+docker_excess_build_context_t* docker_excess_build_context_new(size_t cache_bytes);
+void docker_excess_build_context_free(docker_excess_build_context_t *ctx);
+
+/* Digest of the last successfully sent context (paths, modes, sizes, contents), or NULL */
+const char* docker_excess_build_context_digest(const docker_excess_build_context_t *ctx);
+
+/* Build image, reusing ctx from a previous build (NULL = build_image) */
+docker_excess_error_t docker_excess_build_image_ctx(docker_excess_t *client,
+                                                   const docker_excess_image_build_t *params,
+                                                   docker_excess_build_context_t *ctx,
+                                                   docker_excess_progress_callback_t callback, void *userdata);
+
 /* Tag image */
 docker_excess_error_t docker_excess_tag_image(docker_excess_t *client, const char *source_image, const char *target_image);
 
@@ -514,6 +1058,19 @@ docker_excess_error_t docker_excess_raw_request(docker_excess_t *client, const c
                                                const char *endpoint, const char *body,
                                                char **response, int *http_code);
 
+/* Make raw HTTP request with a binary-safe body; the response may be binary too */
+docker_excess_error_t docker_excess_raw_request_body(docker_excess_t *client, const char *method,
+                                                    const char *endpoint, const docker_excess_body_t *body,
+                                                    char **response, size_t *response_size, int *http_code);
+
+/* Make raw HTTP request, the response going to a sink (buffer, fd, or spilled to a temp file) */
+docker_excess_error_t docker_excess_raw_request_sink(docker_excess_t *client, const char *method,
+                                                    const char *endpoint, const docker_excess_body_t *body,
+                                                    docker_excess_sink_t *sink, int *http_code);
+
+/* Free what a MEMORY or SPILL sink holds, unmap a spilled body */
+void docker_excess_sink_release(docker_excess_sink_t *sink);
+
 /* Stream raw API response */
 docker_excess_error_t docker_excess_raw_stream(docker_excess_t *client, const char *method,
                                               const char *endpoint, const char *body,
@@ -523,10 +1080,12 @@ docker_excess_error_t docker_excess_raw_stream(docker_excess_t *client, const ch
 
 /* Memory management */
 void docker_excess_free_containers(docker_excess_container_t **containers, size_t count);
+void docker_excess_free_container_array(docker_excess_container_t *containers, size_t count);
 void docker_excess_free_images(docker_excess_image_t **images, size_t count);
 void docker_excess_free_networks(docker_excess_network_t **networks, size_t count);
 void docker_excess_free_volumes(docker_excess_volume_t **volumes, size_t count);
 void docker_excess_free_files(docker_excess_file_t **files, size_t count);
+void docker_excess_arena_free(docker_excess_arena_t *arena);
 
 /* Configuration helpers */
 docker_excess_config_t docker_excess_default_config(void);
@@ -554,11 +1113,17 @@ docker_excess_error_t docker_excess_resolve_image_id(docker_excess_t *client, co
 docker_excess_error_t docker_excess_resolve_network_id(docker_excess_t *client, const char *name_or_id,
                                                       char **full_id);
 
+/* Forget cached lookups for a name or ID (NULL = all) */
+void docker_excess_resolve_invalidate(docker_excess_t *client, const char *name_or_id);
+
 /* Validation helpers */
 bool docker_excess_validate_name(const char *name);
 bool docker_excess_validate_tag(const char *tag);
 bool docker_excess_validate_image_name(const char *name);
 
+/* Label lookup: value for key, or NULL (points into container->labels) */
+const char* docker_excess_get_label(const docker_excess_container_t *container, const char *key);
+
 /* JSON utilities */
 char* docker_excess_create_filters_json(const char **keys, const char **values, size_t count);
 docker_excess_error_t docker_excess_parse_labels(const char *labels_json, char ***labels, size_t *count);
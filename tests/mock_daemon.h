@@ -0,0 +1,193 @@
+/*
+ * Minimal HTTP/1.1 daemon on a unix socket for the tests.
+ *
+ * Every request is handed to the test's handler, which writes the response
+ * itself with mock_reply() or raw mock_write() calls. Connections are
+ * kept alive unless the handler returns false.
+ */
+
+#ifndef MOCK_DAEMON_H
+#define MOCK_DAEMON_H
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+typedef struct {
+    char method[16];
+    char path[1024];
+    char *body;
+    size_t body_len;
+} mock_request_t;
+
+/* Return false to close the connection after the response */
+typedef bool (*mock_handler_t)(int fd, const mock_request_t *req, void *userdata);
+
+typedef struct {
+    char socket_path[108];
+    int listen_fd;
+    mock_handler_t handler;
+    void *userdata;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    int requests;                   /* Requests seen so far */
+    int connections;                /* Connections accepted so far */
+} mock_daemon_t;
+
+typedef struct {
+    mock_daemon_t *daemon;
+    int fd;
+} mock_conn_t;
+
+static inline void mock_write(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return;
+        p += n;
+        len -= (size_t)n;
+    }
+}
+
+static inline void mock_reply(int fd, int code, const char *content_type, const char *body) {
+    char head[256];
+    size_t len = body ? strlen(body) : 0;
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n\r\n",
+                     code, code < 300 ? "OK" : "Error", content_type ? content_type : "application/json", len);
+    mock_write(fd, head, (size_t)n);
+    if (len) mock_write(fd, body, len);
+}
+
+/* Read one request; false on EOF or a malformed head */
+static inline bool mock_read_request(int fd, char **buf, size_t *buf_len, mock_request_t *req) {
+    size_t cap = 8192;
+    if (!*buf) *buf = malloc(cap);
+    
+    char *end;
+    while (!(end = *buf_len ? memmem(*buf, *buf_len, "\r\n\r\n", 4) : NULL)) {
+        if (*buf_len == cap) return false;
+        ssize_t n = recv(fd, *buf + *buf_len, cap - *buf_len, 0);
+        if (n <= 0) return false;
+        *buf_len += (size_t)n;
+    }
+    
+    size_t head_len = (size_t)(end - *buf) + 4;
+    *end = '\0';
+    if (sscanf(*buf, "%15s %1023s", req->method, req->path) != 2) return false;
+    
+    size_t content_length = 0;
+    for (char *line = strstr(*buf, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, "Content-Length:", 15) == 0) content_length = strtoul(line + 17, NULL, 10);
+    }
+    if (head_len + content_length > cap) return false;
+    
+    while (*buf_len < head_len + content_length) {
+        ssize_t n = recv(fd, *buf + *buf_len, cap - *buf_len, 0);
+        if (n <= 0) return false;
+        *buf_len += (size_t)n;
+    }
+    
+    req->body = *buf + head_len;
+    req->body_len = content_length;
+    return true;
+}
+
+static void* mock_conn_thread(void *arg) {
+    mock_conn_t *conn = arg;
+    char *buf = NULL;
+    size_t buf_len = 0;
+    mock_request_t req;
+    
+    while (mock_read_request(conn->fd, &buf, &buf_len, &req)) {
+        pthread_mutex_lock(&conn->daemon->mutex);
+        conn->daemon->requests++;
+        pthread_mutex_unlock(&conn->daemon->mutex);
+    
+        /* Copy the body out so the handler may keep it NUL-terminated */
+        char *body = malloc(req.body_len + 1);
+        memcpy(body, req.body, req.body_len);
+        body[req.body_len] = '\0';
+        size_t consumed = (size_t)(req.body - buf) + req.body_len;
+        req.body = body;
+    
+        bool keep = conn->daemon->handler(conn->fd, &req, conn->daemon->userdata);
+        free(body);
+        if (!keep) break;
+    
+        memmove(buf, buf + consumed, buf_len - consumed);
+        buf_len -= consumed;
+    }
+    
+    free(buf);
+    close(conn->fd);
+    free(conn);
+    return NULL;
+}
+
+static void* mock_accept_thread(void *arg) {
+    mock_daemon_t *daemon = arg;
+    for (;;) {
+        int fd = accept(daemon->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return NULL;            /* Listening socket shut down */
+        }
+    
+        pthread_mutex_lock(&daemon->mutex);
+        daemon->connections++;
+        pthread_mutex_unlock(&daemon->mutex);
+    
+        mock_conn_t *conn = malloc(sizeof(*conn));
+        conn->daemon = daemon;
+        conn->fd = fd;
+        pthread_t thread;
+        pthread_create(&thread, NULL, mock_conn_thread, conn);
+        pthread_detach(thread);
+    }
+}
+
+static inline bool mock_daemon_start(mock_daemon_t *daemon, mock_handler_t handler, void *userdata) {
+    memset(daemon, 0, sizeof(*daemon));
+    snprintf(daemon->socket_path, sizeof(daemon->socket_path), "/tmp/docker-excess-mock-%d.sock", (int)getpid());
+    unlink(daemon->socket_path);
+    daemon->handler = handler;
+    daemon->userdata = userdata;
+    pthread_mutex_init(&daemon->mutex, NULL);
+    
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, daemon->socket_path, sizeof(addr.sun_path) - 1);
+    
+    daemon->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (daemon->listen_fd < 0) return false;
+    if (bind(daemon->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(daemon->listen_fd, 64) < 0) {
+        close(daemon->listen_fd);
+        return false;
+    }
+    return pthread_create(&daemon->thread, NULL, mock_accept_thread, daemon) == 0;
+}
+
+static inline int mock_daemon_requests(mock_daemon_t *daemon) {
+    pthread_mutex_lock(&daemon->mutex);
+    int requests = daemon->requests;
+    pthread_mutex_unlock(&daemon->mutex);
+    return requests;
+}
+
+static inline void mock_daemon_stop(mock_daemon_t *daemon) {
+    shutdown(daemon->listen_fd, SHUT_RDWR);
+    pthread_join(daemon->thread, NULL);
+    close(daemon->listen_fd);
+    unlink(daemon->socket_path);
+    pthread_mutex_destroy(&daemon->mutex);
+}
+
+#endif /* MOCK_DAEMON_H */
@@ -0,0 +1,22 @@
+/*
+ * Assertions shared by the tests. Each test program includes the library
+ * source directly so internal helpers can be checked too.
+ */
+
+#ifndef DOCKER_EXCESS_TEST_H
+#define DOCKER_EXCESS_TEST_H
+
+#include <stdio.h>
+
+static int test_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        test_failures++; \
+    } \
+} while (0)
+
+#define TEST_RESULT() (test_failures ? (fprintf(stderr, "%d check(s) failed\n", test_failures), 1) : 0)
+
+#endif /* DOCKER_EXCESS_TEST_H */
@@ -0,0 +1,225 @@
+/*
+ * copy_from_container: the archive comes from the container and is not
+ * trusted. Entries that walk through a symlink or hard-link to a path
+ * through one must not touch anything outside the destination.
+ */
+
+#include "../docker-excess.c"
+#include "mock_daemon.h"
+#include "test.h"
+
+typedef struct {
+    unsigned char data[16 * TAR_BLOCK];
+    size_t len;
+} archive_t;
+
+static void archive_add(archive_t *a, const char *name, char type, const char *link, const char *data) {
+    unsigned char *h = a->data + a->len;
+    size_t len = data ? strlen(data) : 0;
+    
+    memset(h, 0, TAR_BLOCK);
+    snprintf((char *)h, 100, "%s", name);
+    tar_put_number(h + 100, 8, type == '5' ? 0755 : 0644);
+    tar_put_number(h + 108, 8, 0);
+    tar_put_number(h + 116, 8, 0);
+    tar_put_number(h + 124, 12, len);
+    tar_put_number(h + 136, 12, 1714979289);
+    h[156] = (unsigned char)type;
+    if (link) snprintf((char *)h + 157, 100, "%s", link);
+    tar_finish_header(h);
+    a->len += TAR_BLOCK;
+    
+    if (len) {
+        memcpy(a->data + a->len, data, len);
+        a->len += len + tar_padding(len);
+    }
+}
+
+static void archive_end(archive_t *a) {
+    memset(a->data + a->len, 0, 2 * TAR_BLOCK);
+    a->len += 2 * TAR_BLOCK;
+}
+
+static pthread_mutex_t archive_mutex = PTHREAD_MUTEX_INITIALIZER;
+static archive_t served;
+
+static void serve(const archive_t *a) {
+    pthread_mutex_lock(&archive_mutex);
+    served = *a;
+    pthread_mutex_unlock(&archive_mutex);
+}
+
+static bool handle(int fd, const mock_request_t *req, void *userdata) {
+    (void)userdata;
+    if (!strstr(req->path, "/archive?")) {
+        mock_reply(fd, 404, NULL, "{\"message\":\"no such route\"}");
+        return true;
+    }
+    
+    pthread_mutex_lock(&archive_mutex);
+    char head[160];
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: application/x-tar\r\n"
+                     "Content-Length: %zu\r\n\r\n", served.len);
+    mock_write(fd, head, (size_t)n);
+    mock_write(fd, served.data, served.len);
+    pthread_mutex_unlock(&archive_mutex);
+    return true;
+}
+
+static char base[64];
+static char outside[96];
+static char victim[128];
+
+static bool file_is(const char *path, const char *expected) {
+    char buf[64] = {0};
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    return n == strlen(expected) && memcmp(buf, expected, n) == 0;
+}
+
+static void reset_victim(void) {
+    unlink(victim);
+    FILE *f = fopen(victim, "w");
+    if (f) {
+        fputs("original", f);
+        fclose(f);
+    }
+}
+
+static bool victim_untouched(void) {
+    struct stat st;
+    return file_is(victim, "original") && stat(victim, &st) == 0 && st.st_nlink == 1;
+}
+
+static void make_dest(char *dest, size_t size, const char *name) {
+    snprintf(dest, size, "%s/%s", base, name);
+    mkdir(dest, 0755);
+}
+
+/* root/evil -> outside, then root/evil/victim */
+static void test_write_through_symlink(docker_excess_t *client) {
+    char dest[128];
+    make_dest(dest, sizeof(dest), "dest-symlink");
+    reset_victim();
+    
+    archive_t a = {0};
+    archive_add(&a, "root/", '5', NULL, NULL);
+    archive_add(&a, "root/evil", '2', outside, NULL);
+    archive_add(&a, "root/evil/victim", '0', NULL, "pwned");
+    archive_end(&a);
+    serve(&a);
+    
+    CHECK(docker_excess_copy_from_container(client, "box", "/root", dest) == DOCKER_EXCESS_ERR_PERMISSION);
+    CHECK(victim_untouched());
+    
+    char link_path[192];
+    struct stat st;
+    snprintf(link_path, sizeof(link_path), "%s/root/evil", dest);
+    CHECK(lstat(link_path, &st) == 0 && S_ISLNK(st.st_mode));
+}
+
+/* A hard link whose target is reached through a symlink */
+static void test_hardlink_through_symlink(docker_excess_t *client) {
+    char dest[128];
+    make_dest(dest, sizeof(dest), "dest-hardlink");
+    reset_victim();
+    
+    archive_t a = {0};
+    archive_add(&a, "root/", '5', NULL, NULL);
+    archive_add(&a, "root/evil", '2', outside, NULL);
+    archive_add(&a, "root/grab", '1', "root/evil/victim", NULL);
+    archive_end(&a);
+    serve(&a);
+    
+    CHECK(docker_excess_copy_from_container(client, "box", "/root", dest) == DOCKER_EXCESS_ERR_PERMISSION);
+    CHECK(victim_untouched());
+    
+    char grab[192];
+    struct stat st;
+    snprintf(grab, sizeof(grab), "%s/root/grab", dest);
+    CHECK(lstat(grab, &st) != 0);
+}
+
+/* A later regular file replaces a symlink of the same name instead of writing through it */
+static void test_replace_symlink(docker_excess_t *client) {
+    char dest[128];
+    make_dest(dest, sizeof(dest), "dest-replace");
+    reset_victim();
+    
+    archive_t a = {0};
+    archive_add(&a, "root/", '5', NULL, NULL);
+    archive_add(&a, "root/file", '2', victim, NULL);
+    archive_add(&a, "root/file", '0', NULL, "payload");
+    archive_end(&a);
+    serve(&a);
+    
+    CHECK(docker_excess_copy_from_container(client, "box", "/root", dest) == DOCKER_EXCESS_OK);
+    CHECK(victim_untouched());
+    
+    char file[192];
+    snprintf(file, sizeof(file), "%s/root/file", dest);
+    CHECK(file_is(file, "payload"));
+}
+
+/* Plain archives still extract, also onto a new path that renames the root */
+static void test_ordinary_archive(docker_excess_t *client) {
+    archive_t a = {0};
+    archive_add(&a, "root/", '5', NULL, NULL);
+    archive_add(&a, "root/sub/", '5', NULL, NULL);
+    archive_add(&a, "root/sub/a", '0', NULL, "hello");
+    archive_add(&a, "root/b", '1', "root/sub/a", NULL);
+    archive_add(&a, "root/c", '2', "sub/a", NULL);
+    archive_end(&a);
+    serve(&a);
+    
+    char dest[128];
+    char path[192];
+    snprintf(dest, sizeof(dest), "%s/renamed", base);
+    CHECK(docker_excess_copy_from_container(client, "box", "/root", dest) == DOCKER_EXCESS_OK);
+    
+    snprintf(path, sizeof(path), "%s/sub/a", dest);
+    CHECK(file_is(path, "hello"));
+    snprintf(path, sizeof(path), "%s/b", dest);
+    CHECK(file_is(path, "hello"));
+    snprintf(path, sizeof(path), "%s/c", dest);
+    CHECK(file_is(path, "hello"));
+}
+
+int main(void) {
+    snprintf(base, sizeof(base), "/tmp/dx-archive-XXXXXX");
+    if (!mkdtemp(base)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(outside, sizeof(outside), "%s/outside", base);
+    snprintf(victim, sizeof(victim), "%s/victim", outside);
+    mkdir(outside, 0755);
+    
+    mock_daemon_t daemon;
+    if (!mock_daemon_start(&daemon, handle, NULL)) {
+        perror("mock daemon");
+        return 1;
+    }
+    
+    docker_excess_config_t config = {0};
+    config.socket_path = daemon.socket_path;
+    config.timeout_s = 5;
+    docker_excess_t *client = NULL;
+    CHECK(docker_excess_new_with_config(&config, &client) == DOCKER_EXCESS_OK);
+    if (client) {
+        test_write_through_symlink(client);
+        test_hardlink_through_symlink(client);
+        test_replace_symlink(client);
+        test_ordinary_archive(client);
+        docker_excess_free(client);
+    }
+    
+    mock_daemon_stop(&daemon);
+    
+    char cmd[96];
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", base);
+    if (system(cmd) != 0) fprintf(stderr, "could not remove %s\n", base);
+    return TEST_RESULT();
+}
@@ -0,0 +1,40 @@
+/*
+ * Arena allocator: every allocation is ARENA_ALIGN-aligned, across block
+ * growth and oversized requests.
+ */
+
+#include "../docker-excess.c"
+#include "test.h"
+
+_Static_assert(offsetof(arena_block_t, data) % ARENA_ALIGN == 0, "arena data is not aligned");
+
+static void test_alignment(size_t size_hint) {
+    docker_excess_arena_t *arena = arena_create(size_hint);
+    CHECK(arena != NULL);
+    if (!arena) return;
+    
+    static const size_t sizes[] = { 1, 3, 7, 8, 15, 16, 17, 24, 33, 100, 4095, ARENA_MIN_BLOCK * 3 };
+    for (int round = 0; round < 200; round++) {
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            char *ptr = arena_alloc(arena, sizes[i]);
+            CHECK(ptr != NULL);
+            if (!ptr) continue;
+            CHECK((uintptr_t)ptr % ARENA_ALIGN == 0);
+            memset(ptr, 0xab, sizes[i]);
+        }
+    }
+    
+    char *copy = arena_strndup(arena, "arena", SIZE_MAX);
+    CHECK(copy && strcmp(copy, "arena") == 0 && (uintptr_t)copy % ARENA_ALIGN == 0);
+    long double *values = arena_calloc(arena, 5, sizeof(long double));
+    CHECK(values && (uintptr_t)values % _Alignof(long double) == 0 && values[4] == 0);
+    
+    docker_excess_arena_free(arena);
+}
+
+int main(void) {
+    test_alignment(0);
+    test_alignment(1000);           /* Below the minimum block size */
+    test_alignment(ARENA_MIN_BLOCK + 5);
+    return TEST_RESULT();
+}
@@ -0,0 +1,470 @@
+/*
+ * Batches on the async engine: every item finishes before the call
+ * returns, also while another thread runs the same engine, and a failing
+ * engine ends the wait instead of spinning, failing only the batch's own
+ * requests. Exec sessions and group fan-outs wait on the same engine and
+ * must give up the same way; a fan-out still reports every host once.
+ */
+
+#include "../docker-excess.c"
+#include "mock_daemon.h"
+#include "test.h"
+
+#define BATCH_SIZE 40
+
+static pthread_mutex_t create_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char last_create_body[1024];
+
+static bool handle(int fd, const mock_request_t *req, void *userdata) {
+    (void)userdata;
+    char id[128];
+    char body[512];
+    
+    usleep(1000);                   /* Let completions interleave with submissions */
+    if (strcmp(req->method, "POST") == 0 && strstr(req->path, "/containers/create")) {
+        const char *name = strstr(req->path, "name=");
+        snprintf(body, sizeof(body), "{\"Id\":\"id-%s\",\"Warnings\":[]}", name ? name + 5 : "anonymous");
+        pthread_mutex_lock(&create_mutex);
+        snprintf(last_create_body, sizeof(last_create_body), "%s", req->body);
+        pthread_mutex_unlock(&create_mutex);
+        mock_reply(fd, 201, NULL, body);
+        return true;
+    }
+    if (strcmp(req->method, "POST") == 0 && strstr(req->path, "/images/create")) {
+        const char *progress = "{\"status\":\"Pulling fs layer\",\"id\":\"base\"}\n"
+                               "{\"status\":\"Pull complete\",\"id\":\"base\"}\n";
+        mock_reply(fd, 200, NULL, progress);
+        return true;
+    }
+    if (sscanf(req->path, "/v%*[0-9.]/images/%127[^/]/json", id) == 1) {
+        /* Only the digest references are present */
+        if (strstr(id, "%40")) {
+            mock_reply(fd, 200, NULL, "{\"Id\":\"sha256:present\"}");
+        } else {
+            mock_reply(fd, 404, NULL, "{\"message\":\"No such image\"}");
+        }
+        return true;
+    }
+    if (sscanf(req->path, "/v%*[0-9.]/containers/%127[^/]/json", id) == 1) {
+        /* Unset times come as Go's zero time */
+        bool exited = strncmp(id, "exited", 6) == 0;
+        snprintf(body, sizeof(body), "{\"Id\":\"%s\",\"Name\":\"/%s\",\"Image\":\"alpine\","
+                 "\"State\":{\"Status\":\"%s\",\"Running\":%s,\"StartedAt\":\"2024-05-06T07:08:09.123456789Z\","
+                 "\"FinishedAt\":\"%s\"}}", id, id, exited ? "exited" : "running", exited ? "false" : "true",
+                 exited ? "2024-05-06T08:08:09.5Z" : "0001-01-01T00:00:00Z");
+        mock_reply(fd, 200, NULL, body);
+        return true;
+    }
+    if (strcmp(req->method, "POST") == 0 && strstr(req->path, "/containers/")) {
+        mock_write(fd, "HTTP/1.1 204 No Content\r\n\r\n", 27);
+        return true;
+    }
+    
+    mock_reply(fd, 404, NULL, "{\"message\":\"no such route\"}");
+    return true;
+}
+
+typedef struct {
+    docker_excess_t *client;
+    atomic_bool stop;
+} runner_t;
+
+/* A second thread driving the engine, as an application event loop would */
+static void* run_engine(void *arg) {
+    runner_t *runner = arg;
+    while (!atomic_load(&runner->stop)) docker_excess_async_run(runner->client, 10);
+    return NULL;
+}
+
+static docker_excess_t* new_client(const mock_daemon_t *daemon) {
+    docker_excess_config_t config = {0};
+    config.socket_path = (char*)daemon->socket_path;
+    config.timeout_s = 5;
+    
+    docker_excess_t *client = NULL;
+    if (docker_excess_new_with_config(&config, &client) != DOCKER_EXCESS_OK) return NULL;
+    return client;
+}
+
+static void make_ids(char names[][32], const char **ids, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        snprintf(names[i], 32, "c%zu", i);
+        ids[i] = names[i];
+    }
+}
+
+static void test_inspect_shared_engine(docker_excess_t *client) {
+    char names[BATCH_SIZE][32];
+    const char *ids[BATCH_SIZE];
+    make_ids(names, ids, BATCH_SIZE);
+    
+    runner_t runner = { .client = client };
+    pthread_t thread;
+    pthread_create(&thread, NULL, run_engine, &runner);
+    
+    for (int round = 0; round < 5; round++) {
+        docker_excess_container_t *containers = NULL;
+        docker_excess_error_t errors[BATCH_SIZE];
+        docker_excess_error_t err = docker_excess_inspect_containers(client, ids, BATCH_SIZE, 3, &containers, errors);
+    
+        CHECK(err == DOCKER_EXCESS_OK);
+        if (!containers) continue;
+        for (size_t i = 0; i < BATCH_SIZE; i++) {
+            CHECK(errors[i] == DOCKER_EXCESS_OK);
+            CHECK(containers[i].id && strcmp(containers[i].id, ids[i]) == 0);
+            CHECK(containers[i].started_at == 1714979289 && containers[i].finished_at == 0);
+        }
+        docker_excess_free_container_array(containers, BATCH_SIZE);
+    }
+    
+    atomic_store(&runner.stop, true);
+    pthread_join(thread, NULL);
+}
+
+static void test_inspect_times(docker_excess_t *client) {
+    docker_excess_container_t *container = NULL;
+    CHECK(docker_excess_inspect_container(client, "exited-1", &container) == DOCKER_EXCESS_OK);
+    CHECK(container && container->state == DOCKER_EXCESS_STATE_EXITED);
+    CHECK(container && container->started_at == 1714979289 && container->finished_at == 1714982889);
+    docker_excess_free_container_array(container, 1);
+    
+    container = NULL;
+    CHECK(docker_excess_inspect_container_ex(client, "exited-1", DOCKER_EXCESS_FIELD_ID, &container) ==
+          DOCKER_EXCESS_OK);
+    CHECK(container && container->started_at == 0 && container->finished_at == 0);
+    docker_excess_free_container_array(container, 1);
+}
+
+/* epoll on a closed fd fails every time: the batch must give up and fail its items */
+static void test_inspect_engine_failure(docker_excess_t *client) {
+    char names[BATCH_SIZE][32];
+    const char *ids[BATCH_SIZE];
+    make_ids(names, ids, BATCH_SIZE);
+    
+    async_engine_t *engine = async_engine_get(client);
+    CHECK(engine != NULL);
+    if (!engine) return;
+    int epoll_fd = engine->epoll_fd;
+    engine->epoll_fd = -1;
+    
+    docker_excess_container_t *containers = NULL;
+    docker_excess_error_t errors[BATCH_SIZE];
+    docker_excess_error_t err = docker_excess_inspect_containers(client, ids, BATCH_SIZE, 3, &containers, errors);
+    
+    engine->epoll_fd = epoll_fd;
+    CHECK(err != DOCKER_EXCESS_OK);
+    CHECK(containers == NULL);
+    for (size_t i = 0; i < BATCH_SIZE; i++) CHECK(errors[i] != DOCKER_EXCESS_OK);
+}
+
+typedef struct {
+    atomic_int calls;
+    docker_excess_error_t err;
+} submitted_t;
+
+static void on_submitted(docker_excess_error_t err, int http_code, const char *response, size_t size,
+                         void *userdata) {
+    (void)http_code;
+    (void)response;
+    (void)size;
+    submitted_t *submitted = userdata;
+    submitted->err = err;
+    atomic_fetch_add(&submitted->calls, 1);
+}
+
+/* A failing batch fails only its own requests, not other work on the engine */
+static void test_engine_failure_spares_other_requests(docker_excess_t *client) {
+    char names[BATCH_SIZE][32];
+    const char *ids[BATCH_SIZE];
+    make_ids(names, ids, BATCH_SIZE);
+    
+    async_engine_t *engine = async_engine_get(client);
+    CHECK(engine != NULL);
+    if (!engine) return;
+    int epoll_fd = engine->epoll_fd;
+    engine->epoll_fd = -1;
+    
+    submitted_t submitted = { .err = DOCKER_EXCESS_ERR_INTERNAL };
+    CHECK(docker_excess_submit(client, "GET", "/containers/other/json", NULL, on_submitted, &submitted) ==
+          DOCKER_EXCESS_OK);
+    
+    docker_excess_error_t errors[BATCH_SIZE];
+    CHECK(docker_excess_bulk_op(client, DOCKER_EXCESS_OP_START, ids, BATCH_SIZE, NULL, errors) != DOCKER_EXCESS_OK);
+    CHECK(atomic_load(&submitted.calls) == 0);
+    
+    engine->epoll_fd = epoll_fd;
+    for (int i = 0; i < 100 && atomic_load(&submitted.calls) == 0; i++) docker_excess_async_run(client, 50);
+    CHECK(atomic_load(&submitted.calls) == 1);
+    CHECK(submitted.err == DOCKER_EXCESS_OK);
+}
+
+static void test_bulk_shared_engine(docker_excess_t *client) {
+    char names[BATCH_SIZE][32];
+    const char *ids[BATCH_SIZE];
+    make_ids(names, ids, BATCH_SIZE);
+    
+    runner_t runner = { .client = client };
+    pthread_t thread;
+    pthread_create(&thread, NULL, run_engine, &runner);
+    
+    docker_excess_bulk_options_t options = { .max_parallel = 4 };
+    for (int round = 0; round < 5; round++) {
+        docker_excess_error_t errors[BATCH_SIZE];
+        for (size_t i = 0; i < BATCH_SIZE; i++) errors[i] = DOCKER_EXCESS_ERR_INTERNAL;
+    
+        CHECK(docker_excess_bulk_op(client, DOCKER_EXCESS_OP_STOP, ids, BATCH_SIZE, &options, errors) ==
+              DOCKER_EXCESS_OK);
+        for (size_t i = 0; i < BATCH_SIZE; i++) CHECK(errors[i] == DOCKER_EXCESS_OK);
+    }
+    
+    atomic_store(&runner.stop, true);
+    pthread_join(thread, NULL);
+}
+
+static void test_bulk_engine_failure(docker_excess_t *client) {
+    char names[BATCH_SIZE][32];
+    const char *ids[BATCH_SIZE];
+    make_ids(names, ids, BATCH_SIZE);
+    
+    async_engine_t *engine = async_engine_get(client);
+    CHECK(engine != NULL);
+    if (!engine) return;
+    int epoll_fd = engine->epoll_fd;
+    engine->epoll_fd = -1;
+    
+    docker_excess_error_t errors[BATCH_SIZE];
+    docker_excess_error_t err = docker_excess_bulk_op(client, DOCKER_EXCESS_OP_START, ids, BATCH_SIZE, NULL, errors);
+    
+    engine->epoll_fd = epoll_fd;
+    CHECK(err != DOCKER_EXCESS_OK);
+    for (size_t i = 0; i < BATCH_SIZE; i++) CHECK(errors[i] != DOCKER_EXCESS_OK);
+}
+
+static void test_create_start_shared_engine(docker_excess_t *client) {
+    char names[BATCH_SIZE][32];
+    const char *ids[BATCH_SIZE];
+    make_ids(names, ids, BATCH_SIZE);
+    
+    docker_excess_container_create_t params = { .image = "alpine" };
+    docker_excess_create_template_t *tmpl = NULL;
+    CHECK(docker_excess_create_template_compile(&params, &tmpl) == DOCKER_EXCESS_OK);
+    if (!tmpl) return;
+    
+    docker_excess_create_instance_t instances[BATCH_SIZE];
+    for (size_t i = 0; i < BATCH_SIZE; i++) instances[i] = (docker_excess_create_instance_t){ .name = ids[i] };
+    
+    runner_t runner = { .client = client };
+    pthread_t thread;
+    pthread_create(&thread, NULL, run_engine, &runner);
+    
+    docker_excess_bulk_options_t options = { .max_parallel = 4 };
+    for (int round = 0; round < 5; round++) {
+        char *created[BATCH_SIZE];
+        docker_excess_error_t errors[BATCH_SIZE];
+        CHECK(docker_excess_create_start_containers(client, tmpl, instances, BATCH_SIZE, &options, created, errors) ==
+              DOCKER_EXCESS_OK);
+        for (size_t i = 0; i < BATCH_SIZE; i++) {
+            char expected[40];
+            snprintf(expected, sizeof(expected), "id-%s", ids[i]);
+            CHECK(errors[i] == DOCKER_EXCESS_OK);
+            CHECK(created[i] && strcmp(created[i], expected) == 0);
+            free(created[i]);
+        }
+    }
+    
+    atomic_store(&runner.stop, true);
+    pthread_join(thread, NULL);
+    docker_excess_create_template_free(tmpl);
+}
+
+static void make_images(char names[][32], const char **images, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (i % 4 == 0) {
+            snprintf(names[i], 32, "app@sha256:%zu", i);
+        } else {
+            snprintf(names[i], 32, "app%zu:1.0", i);
+        }
+        images[i] = names[i];
+    }
+}
+
+typedef struct {
+    size_t images_done;
+    size_t images_count;
+} pull_progress_t;
+
+static bool record_progress(const docker_excess_transfer_progress_t *progress, void *userdata) {
+    pull_progress_t *last = userdata;
+    last->images_done = progress->images_done;
+    last->images_count = progress->images_count;
+    return true;
+}
+
+static void test_pull_shared_engine(docker_excess_t *client) {
+    char names[BATCH_SIZE][32];
+    const char *images[BATCH_SIZE];
+    make_images(names, images, BATCH_SIZE);
+    
+    runner_t runner = { .client = client };
+    pthread_t thread;
+    pthread_create(&thread, NULL, run_engine, &runner);
+    
+    docker_excess_pull_options_t options = { .max_parallel = 4, .interval_ms = -1 };
+    for (int round = 0; round < 5; round++) {
+        docker_excess_error_t errors[BATCH_SIZE];
+        pull_progress_t progress = {0};
+        CHECK(docker_excess_pull_images(client, images, BATCH_SIZE, &options, record_progress, &progress, errors) ==
+              DOCKER_EXCESS_OK);
+        for (size_t i = 0; i < BATCH_SIZE; i++) CHECK(errors[i] == DOCKER_EXCESS_OK);
+        CHECK(progress.images_count == BATCH_SIZE && progress.images_done == BATCH_SIZE);
+    }
+    
+    atomic_store(&runner.stop, true);
+    pthread_join(thread, NULL);
+}
+
+static void test_pull_engine_failure(docker_excess_t *client) {
+    char names[BATCH_SIZE][32];
+    const char *images[BATCH_SIZE];
+    make_images(names, images, BATCH_SIZE);
+    
+    async_engine_t *engine = async_engine_get(client);
+    CHECK(engine != NULL);
+    if (!engine) return;
+    int epoll_fd = engine->epoll_fd;
+    engine->epoll_fd = -1;
+    
+    docker_excess_error_t errors[BATCH_SIZE];
+    docker_excess_error_t err = docker_excess_pull_images(client, images, BATCH_SIZE, NULL, NULL, NULL, errors);
+    
+    engine->epoll_fd = epoll_fd;
+    CHECK(err != DOCKER_EXCESS_OK);
+    for (size_t i = 0; i < BATCH_SIZE; i++) CHECK(errors[i] != DOCKER_EXCESS_OK);
+}
+
+static void test_exec_engine_failure(docker_excess_t *client) {
+    async_engine_t *engine = async_engine_get(client);
+    CHECK(engine != NULL);
+    if (!engine) return;
+    int epoll_fd = engine->epoll_fd;
+    engine->epoll_fd = -1;
+    
+    char *argv[] = { "true" };
+    docker_excess_exec_params_t params = { .cmd = argv, .cmd_count = 1 };
+    docker_excess_exec_result_t result = {0};
+    docker_excess_error_t err = docker_excess_exec_run(client, "c0", &params, &result);
+    
+    engine->epoll_fd = epoll_fd;
+    CHECK(err != DOCKER_EXCESS_OK);
+}
+
+#define GROUP_SIZE 3
+
+typedef struct {
+    int calls[GROUP_SIZE];
+    int failed[GROUP_SIZE];
+} group_seen_t;
+
+static void group_seen(size_t host, docker_excess_error_t err, int http_code, const char *response, size_t size,
+                       void *userdata) {
+    (void)http_code;
+    (void)response;
+    (void)size;
+    group_seen_t *seen = userdata;
+    if (host >= GROUP_SIZE) return;
+    seen->calls[host]++;
+    if (err != DOCKER_EXCESS_OK) seen->failed[host]++;
+}
+
+static void group_list_seen(size_t host, docker_excess_error_t err, docker_excess_container_t **containers,
+                            size_t count, void *userdata) {
+    group_seen(host, err, 0, NULL, 0, userdata);
+    docker_excess_free_containers(containers, count);
+}
+
+static void test_group_engine_failure(const mock_daemon_t *daemon) {
+    docker_excess_group_t *group = NULL;
+    CHECK(docker_excess_group_new(&group) == DOCKER_EXCESS_OK);
+    if (!group) return;
+    
+    docker_excess_config_t config = {0};
+    config.socket_path = (char*)daemon->socket_path;
+    config.timeout_s = 5;
+    for (int i = 0; i < GROUP_SIZE; i++) CHECK(docker_excess_group_add(group, &config, NULL) == DOCKER_EXCESS_OK);
+    
+    async_engine_t *engine = group->engine;
+    int epoll_fd = engine->epoll_fd;
+    engine->epoll_fd = -1;
+    
+    group_seen_t seen = {0};
+    CHECK(docker_excess_group_request(group, "GET", "/containers/c0/json", NULL, group_seen, &seen) !=
+          DOCKER_EXCESS_OK);
+    group_seen_t listed = {0};
+    CHECK(docker_excess_group_list_containers(group, NULL, group_list_seen, &listed) != DOCKER_EXCESS_OK);
+    
+    engine->epoll_fd = epoll_fd;
+    for (int i = 0; i < GROUP_SIZE; i++) {
+        CHECK(seen.calls[i] == 1 && seen.failed[i] == 1);
+        CHECK(listed.calls[i] == 1 && listed.failed[i] == 1);
+    }
+    docker_excess_group_free(group);
+}
+
+static void test_create_container(docker_excess_t *client) {
+    docker_excess_env_var_t env[] = { { .name = "MODE", .value = "test" } };
+    char *labels[] = { "tier=web" };
+    docker_excess_container_create_t params = {
+        .name = "web-1",
+        .image = "nginx:alpine",
+        .env = env,
+        .env_count = 1,
+        .labels = labels,
+        .labels_count = 1,
+    };
+    
+    char *id = NULL;
+    CHECK(docker_excess_create_container(client, &params, &id) == DOCKER_EXCESS_OK);
+    CHECK(id && strcmp(id, "id-web-1") == 0);
+    free(id);
+    
+    pthread_mutex_lock(&create_mutex);
+    json_object *body = json_tokener_parse(last_create_body);
+    pthread_mutex_unlock(&create_mutex);
+    CHECK(body != NULL);
+    CHECK(strcmp(get_json_string(body, "Image"), "nginx:alpine") == 0);
+    CHECK(strstr(json_object_to_json_string(body), "MODE=test") != NULL);
+    CHECK(strcmp(get_json_string(get_json_object(body, "Labels"), "tier"), "web") == 0);
+    json_object_put(body);
+    
+    params.image = NULL;
+    CHECK(docker_excess_create_container(client, &params, &id) == DOCKER_EXCESS_ERR_INVALID_PARAM);
+}
+
+int main(void) {
+    mock_daemon_t daemon;
+    if (!mock_daemon_start(&daemon, handle, NULL)) {
+        perror("mock daemon");
+        return 1;
+    }
+    
+    docker_excess_t *client = new_client(&daemon);
+    CHECK(client != NULL);
+    if (client) {
+        test_inspect_shared_engine(client);
+        test_inspect_times(client);
+        test_inspect_engine_failure(client);
+        test_bulk_shared_engine(client);
+        test_bulk_engine_failure(client);
+        test_engine_failure_spares_other_requests(client);
+        test_create_start_shared_engine(client);
+        test_create_container(client);
+        test_pull_shared_engine(client);
+        test_pull_engine_failure(client);
+        test_exec_engine_failure(client);
+        docker_excess_free(client);
+    }
+    test_group_engine_failure(&daemon);
+    
+    mock_daemon_stop(&daemon);
+    return TEST_RESULT();
+}
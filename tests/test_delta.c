@@ -0,0 +1,92 @@
+/*
+ * Incremental container listing: deltas are keyed by container id, also
+ * when the caller's projection leaves the id out.
+ */
+
+#include "../docker-excess.c"
+#include "mock_daemon.h"
+#include "test.h"
+
+static pthread_mutex_t list_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const char *list_body = "[]";
+
+static void set_listing(const char *body) {
+    pthread_mutex_lock(&list_mutex);
+    list_body = body;
+    pthread_mutex_unlock(&list_mutex);
+}
+
+static bool handle(int fd, const mock_request_t *req, void *userdata) {
+    (void)userdata;
+    if (strstr(req->path, "/containers/json")) {
+        pthread_mutex_lock(&list_mutex);
+        mock_reply(fd, 200, NULL, list_body);
+        pthread_mutex_unlock(&list_mutex);
+        return true;
+    }
+    
+    mock_reply(fd, 404, NULL, "{\"message\":\"no such route\"}");
+    return true;
+}
+
+static const char *listing_1 =
+    "[{\"Id\":\"aaaa\",\"Names\":[\"/web\"],\"State\":\"running\",\"Status\":\"Up 1 minute\"},"
+    "{\"Id\":\"bbbb\",\"Names\":[\"/db\"],\"State\":\"running\",\"Status\":\"Up 1 minute\"}]";
+
+static const char *listing_2 =
+    "[{\"Id\":\"aaaa\",\"Names\":[\"/web\"],\"State\":\"exited\",\"Status\":\"Exited (0)\"},"
+    "{\"Id\":\"cccc\",\"Names\":[\"/cache\"],\"State\":\"running\",\"Status\":\"Up 1 second\"}]";
+
+static void test_projection_without_id(docker_excess_t *client) {
+    docker_excess_list_options_t options = {
+        .all = true,
+        .fields = DOCKER_EXCESS_FIELD_NAME | DOCKER_EXCESS_FIELD_STATE,
+    };
+    docker_excess_container_delta_t delta;
+    
+    set_listing(listing_1);
+    CHECK(docker_excess_list_containers_delta(client, &options, 0, &delta) == DOCKER_EXCESS_OK);
+    CHECK(delta.full);
+    CHECK(delta.count == 2);
+    CHECK(delta.added_count == 2);
+    for (size_t i = 0; i < delta.count; i++) CHECK(delta.containers[i]->id != NULL);
+    uint64_t token = delta.token;
+    docker_excess_container_delta_free(&delta);
+    
+    set_listing(listing_2);
+    CHECK(docker_excess_list_containers_delta(client, &options, token, &delta) == DOCKER_EXCESS_OK);
+    CHECK(!delta.full);
+    CHECK(delta.count == 2);
+    CHECK(delta.added_count == 1 && strcmp(delta.added[0]->id, "cccc") == 0);
+    CHECK(delta.changed_count == 1 && strcmp(delta.changed[0]->name, "web") == 0);
+    CHECK(delta.changed_count == 1 && delta.changed[0]->state == DOCKER_EXCESS_STATE_EXITED);
+    CHECK(delta.removed_count == 1 && strcmp(delta.removed[0], "bbbb") == 0);
+    token = delta.token;
+    docker_excess_container_delta_free(&delta);
+    
+    /* Nothing changed: the records of the last call are handed out again */
+    CHECK(docker_excess_list_containers_delta(client, &options, token, &delta) == DOCKER_EXCESS_OK);
+    CHECK(delta.count == 2 && delta.added_count == 0 && delta.changed_count == 0 && delta.removed_count == 0);
+    docker_excess_container_delta_free(&delta);
+}
+
+int main(void) {
+    mock_daemon_t daemon;
+    if (!mock_daemon_start(&daemon, handle, NULL)) {
+        perror("mock daemon");
+        return 1;
+    }
+    
+    docker_excess_config_t config = {0};
+    config.socket_path = daemon.socket_path;
+    config.timeout_s = 5;
+    docker_excess_t *client = NULL;
+    CHECK(docker_excess_new_with_config(&config, &client) == DOCKER_EXCESS_OK);
+    if (client) {
+        test_projection_without_id(client);
+        docker_excess_free(client);
+    }
+    
+    mock_daemon_stop(&daemon);
+    return TEST_RESULT();
+}
@@ -0,0 +1,99 @@
+/*
+ * Log streaming: multiplexed frames are split into lines per stream, also
+ * when a line spans several frames, and timestamps are parsed off.
+ */
+
+#include "../docker-excess.c"
+#include "mock_daemon.h"
+#include "test.h"
+
+static void write_frame(int fd, int stream, const char *payload) {
+    size_t len = strlen(payload);
+    unsigned char header[8] = { (unsigned char)stream, 0, 0, 0,
+                                (unsigned char)(len >> 24), (unsigned char)(len >> 16),
+                                (unsigned char)(len >> 8), (unsigned char)len };
+    mock_write(fd, header, sizeof(header));
+    mock_write(fd, payload, len);
+}
+
+static bool handle(int fd, const mock_request_t *req, void *userdata) {
+    (void)userdata;
+    if (!strstr(req->path, "/logs?")) {
+        mock_reply(fd, 404, NULL, "{\"message\":\"no such route\"}");
+        return true;
+    }
+    
+    /* No length: the body ends when the connection closes */
+    const char *head = "HTTP/1.1 200 OK\r\nContent-Type: application/vnd.docker.raw-stream\r\n\r\n";
+    mock_write(fd, head, strlen(head));
+    if (strstr(req->path, "timestamps=1")) {
+        write_frame(fd, DOCKER_EXCESS_STREAM_STDOUT, "2024-05-06T07:08:09.123456789Z hello\n");
+        write_frame(fd, DOCKER_EXCESS_STREAM_STDERR, "2024-05-06T07:08:10.5Z oops\n");
+    } else {
+        write_frame(fd, DOCKER_EXCESS_STREAM_STDOUT, "first li");
+        write_frame(fd, DOCKER_EXCESS_STREAM_STDERR, "warn\r\n");
+        write_frame(fd, DOCKER_EXCESS_STREAM_STDOUT, "ne\nsecond\n\nlast");
+    }
+    return false;
+}
+
+typedef struct {
+    char text[8][64];
+    bool is_stderr[8];
+    time_t timestamp[8];
+    size_t count;
+} captured_t;
+
+static void capture(const char *line, bool is_stderr, time_t timestamp, void *userdata) {
+    captured_t *captured = userdata;
+    if (captured->count >= 8) return;
+    snprintf(captured->text[captured->count], sizeof(captured->text[0]), "%s", line);
+    captured->is_stderr[captured->count] = is_stderr;
+    captured->timestamp[captured->count] = timestamp;
+    captured->count++;
+}
+
+static void test_lines(docker_excess_t *client) {
+    captured_t captured = {0};
+    CHECK(docker_excess_get_logs(client, "web", NULL, capture, &captured) == DOCKER_EXCESS_OK);
+    
+    CHECK(captured.count == 5);
+    CHECK(strcmp(captured.text[0], "warn") == 0 && captured.is_stderr[0]);
+    CHECK(strcmp(captured.text[1], "first line") == 0 && !captured.is_stderr[1]);
+    CHECK(strcmp(captured.text[2], "second") == 0);
+    CHECK(strcmp(captured.text[3], "") == 0);
+    CHECK(strcmp(captured.text[4], "last") == 0 && !captured.is_stderr[4]);
+    CHECK(captured.timestamp[1] == 0);
+}
+
+static void test_timestamps(docker_excess_t *client) {
+    captured_t captured = {0};
+    docker_excess_log_params_t params = { .timestamps = true };
+    CHECK(docker_excess_get_logs(client, "web", &params, capture, &captured) == DOCKER_EXCESS_OK);
+    
+    CHECK(captured.count == 2);
+    CHECK(strcmp(captured.text[0], "hello") == 0 && captured.timestamp[0] == 1714979289);
+    CHECK(strcmp(captured.text[1], "oops") == 0 && captured.is_stderr[1] && captured.timestamp[1] == 1714979290);
+}
+
+int main(void) {
+    mock_daemon_t daemon;
+    if (!mock_daemon_start(&daemon, handle, NULL)) {
+        perror("mock daemon");
+        return 1;
+    }
+    
+    docker_excess_config_t config = {0};
+    config.socket_path = daemon.socket_path;
+    config.timeout_s = 5;
+    docker_excess_t *client = NULL;
+    CHECK(docker_excess_new_with_config(&config, &client) == DOCKER_EXCESS_OK);
+    if (client) {
+        test_lines(client);
+        test_timestamps(client);
+        docker_excess_free(client);
+    }
+    
+    mock_daemon_stop(&daemon);
+    return TEST_RESULT();
+}
@@ -0,0 +1,226 @@
+/*
+ * Name resolution cache: the client's own remove, rename and tag calls
+ * evict what they made stale, so a recreated name resolves to the new ID.
+ */
+
+#include "../docker-excess.c"
+#include "mock_daemon.h"
+#include "test.h"
+
+#define MAX_OBJECTS 16
+
+typedef struct {
+    char name[64];
+    char id[64];
+} object_t;
+
+/* Containers and image references the mock daemon knows, by name */
+static pthread_mutex_t state_mutex = PTHREAD_MUTEX_INITIALIZER;
+static object_t containers[MAX_OBJECTS];
+static object_t images[MAX_OBJECTS];
+static int next_id = 1;
+
+/* By name or, like the daemon, by ID */
+static object_t* find(object_t *table, const char *name) {
+    for (int i = 0; i < MAX_OBJECTS; i++) {
+        if (table[i].name[0] && (strcmp(table[i].name, name) == 0 || strcmp(table[i].id, name) == 0)) {
+            return &table[i];
+        }
+    }
+    return NULL;
+}
+
+static void put(object_t *table, const char *name, const char *id) {
+    object_t *slot = find(table, name);
+    for (int i = 0; !slot && i < MAX_OBJECTS; i++) {
+        if (!table[i].name[0]) slot = &table[i];
+    }
+    if (!slot) return;
+    snprintf(slot->name, sizeof(slot->name), "%s", name);
+    snprintf(slot->id, sizeof(slot->id), "%s", id);
+}
+
+static void decode(char *s) {
+    char *out = s;
+    for (char *in = s; *in; in++) {
+        if (in[0] == '%' && in[1] && in[2]) {
+            char hex[3] = { in[1], in[2], 0 };
+            *out++ = (char)strtol(hex, NULL, 16);
+            in += 2;
+        } else {
+            *out++ = *in;
+        }
+    }
+    *out = '\0';
+}
+
+static bool handle(int fd, const mock_request_t *req, void *userdata) {
+    (void)userdata;
+    char name[128] = {0};
+    char arg[128] = {0};
+    char arg2[128] = {0};
+    char body[256];
+    
+    pthread_mutex_lock(&state_mutex);
+    if (strcmp(req->method, "POST") == 0 && sscanf(req->path, "/v%*[0-9.]/containers/create?name=%127s", name) == 1) {
+        snprintf(arg, sizeof(arg), "container-%d", next_id++);
+        put(containers, name, arg);
+        snprintf(body, sizeof(body), "{\"Id\":\"%s\",\"Warnings\":[]}", arg);
+        mock_reply(fd, 201, NULL, body);
+    } else if (sscanf(req->path, "/v%*[0-9.]/containers/%127[^/?]/rename?name=%127s", name, arg) == 2) {
+        object_t *c = find(containers, name);
+        if (c) snprintf(c->name, sizeof(c->name), "%s", arg);
+        mock_reply(fd, c ? 204 : 404, NULL, c ? NULL : "{\"message\":\"No such container\"}");
+    } else if (strcmp(req->method, "DELETE") == 0 && sscanf(req->path, "/v%*[0-9.]/containers/%127[^/?]", name) == 1) {
+        object_t *c = find(containers, name);
+        if (c) c->name[0] = '\0';
+        mock_reply(fd, c ? 204 : 404, NULL, c ? NULL : "{\"message\":\"No such container\"}");
+    } else if (sscanf(req->path, "/v%*[0-9.]/containers/%127[^/]/json", name) == 1) {
+        object_t *c = find(containers, name);
+        snprintf(body, sizeof(body), "{\"Id\":\"%s\"}", c ? c->id : "");
+        mock_reply(fd, c ? 200 : 404, NULL, c ? body : "{\"message\":\"No such container\"}");
+    } else if (sscanf(req->path, "/v%*[0-9.]/images/%127[^/]/tag?repo=%127[^&]&tag=%127s", name, arg, arg2) == 3) {
+        decode(name);
+        snprintf(body, sizeof(body), "%s:%s", arg, arg2);
+        decode(body);
+        object_t *image = find(images, name);
+        if (image) put(images, body, image->id);
+        mock_reply(fd, image ? 201 : 404, NULL, image ? NULL : "{\"message\":\"No such image\"}");
+    } else if (strcmp(req->method, "DELETE") == 0 && sscanf(req->path, "/v%*[0-9.]/images/%127[^/?]", name) == 1) {
+        decode(name);
+        object_t *image = find(images, name);
+        if (image) image->name[0] = '\0';
+        mock_reply(fd, image ? 200 : 404, NULL, image ? "[]" : "{\"message\":\"No such image\"}");
+    } else if (sscanf(req->path, "/v%*[0-9.]/images/%127[^/]/json", name) == 1) {
+        decode(name);
+        object_t *image = find(images, name);
+        snprintf(body, sizeof(body), "{\"Id\":\"%s\"}", image ? image->id : "");
+        mock_reply(fd, image ? 200 : 404, NULL, image ? body : "{\"message\":\"No such image\"}");
+    } else {
+        mock_reply(fd, 404, NULL, "{\"message\":\"no such route\"}");
+    }
+    pthread_mutex_unlock(&state_mutex);
+    return true;
+}
+
+static bool resolves_to(docker_excess_t *client, const char *name, const char *expected) {
+    char *id = NULL;
+    docker_excess_error_t err = docker_excess_resolve_container_id(client, name, &id);
+    bool ok = expected ? err == DOCKER_EXCESS_OK && id && strcmp(id, expected) == 0 : err != DOCKER_EXCESS_OK;
+    free(id);
+    return ok;
+}
+
+static char* create(docker_excess_t *client, const char *name) {
+    docker_excess_container_create_t params = { .name = (char*)name, .image = "alpine" };
+    char *id = NULL;
+    CHECK(docker_excess_create_container(client, &params, &id) == DOCKER_EXCESS_OK);
+    return id;
+}
+
+static void test_remove_and_recreate(docker_excess_t *client) {
+    char *first = create(client, "web");
+    CHECK(resolves_to(client, "web", first));
+    CHECK(docker_excess_remove_container(client, "web", true, false) == DOCKER_EXCESS_OK);
+    
+    char *second = create(client, "web");
+    CHECK(first && second && strcmp(first, second) != 0);
+    CHECK(resolves_to(client, "web", second));
+    free(first);
+    free(second);
+}
+
+/* Removing by ID evicts the names cached for it too */
+static void test_remove_by_id(docker_excess_t *client) {
+    char *first = create(client, "api");
+    CHECK(resolves_to(client, "api", first));
+    CHECK(first && docker_excess_remove_container(client, first, true, false) == DOCKER_EXCESS_OK);
+    CHECK(resolves_to(client, "api", NULL));
+    free(first);
+}
+
+static void test_bulk_remove(docker_excess_t *client) {
+    char *a = create(client, "job-a");
+    char *b = create(client, "job-b");
+    CHECK(resolves_to(client, "job-a", a) && resolves_to(client, "job-b", b));
+    
+    const char *names[] = { "job-a", "job-b" };
+    docker_excess_error_t errors[2];
+    docker_excess_bulk_options_t options = { .force = true };
+    CHECK(docker_excess_bulk_op(client, DOCKER_EXCESS_OP_REMOVE, names, 2, &options, errors) == DOCKER_EXCESS_OK);
+    CHECK(errors[0] == DOCKER_EXCESS_OK && errors[1] == DOCKER_EXCESS_OK);
+    
+    char *c = create(client, "job-a");
+    CHECK(resolves_to(client, "job-a", c));
+    CHECK(resolves_to(client, "job-b", NULL));
+    free(a);
+    free(b);
+    free(c);
+}
+
+static void test_rename(docker_excess_t *client) {
+    char *old_db = create(client, "db");
+    char *cache = create(client, "cache");
+    CHECK(resolves_to(client, "db", old_db) && resolves_to(client, "cache", cache));
+    
+    /* Another client removes db, and cache takes its name */
+    pthread_mutex_lock(&state_mutex);
+    find(containers, "db")->name[0] = '\0';
+    pthread_mutex_unlock(&state_mutex);
+    CHECK(docker_excess_rename_container(client, "cache", "db") == DOCKER_EXCESS_OK);
+    CHECK(resolves_to(client, "db", cache));
+    CHECK(resolves_to(client, "cache", NULL));
+    free(old_db);
+    free(cache);
+}
+
+static void test_image_tags(docker_excess_t *client) {
+    pthread_mutex_lock(&state_mutex);
+    put(images, "app:1", "sha256:one");
+    put(images, "app:2", "sha256:two");
+    put(images, "app:latest", "sha256:one");
+    pthread_mutex_unlock(&state_mutex);
+    
+    char *id = NULL;
+    CHECK(docker_excess_resolve_image_id(client, "app:latest", &id) == DOCKER_EXCESS_OK);
+    CHECK(id && strcmp(id, "sha256:one") == 0);
+    free(id);
+    
+    /* Moving the tag */
+    CHECK(docker_excess_tag_image(client, "app:2", "app:latest") == DOCKER_EXCESS_OK);
+    id = NULL;
+    CHECK(docker_excess_resolve_image_id(client, "app:latest", &id) == DOCKER_EXCESS_OK);
+    CHECK(id && strcmp(id, "sha256:two") == 0);
+    free(id);
+    
+    /* Untagging it */
+    CHECK(docker_excess_remove_image(client, "app:latest", false, false) == DOCKER_EXCESS_OK);
+    id = NULL;
+    CHECK(docker_excess_resolve_image_id(client, "app:latest", &id) != DOCKER_EXCESS_OK);
+    free(id);
+}
+
+int main(void) {
+    mock_daemon_t daemon;
+    if (!mock_daemon_start(&daemon, handle, NULL)) {
+        perror("mock daemon");
+        return 1;
+    }
+    
+    docker_excess_config_t config = {0};
+    config.socket_path = daemon.socket_path;
+    config.timeout_s = 5;
+    docker_excess_t *client = NULL;
+    CHECK(docker_excess_new_with_config(&config, &client) == DOCKER_EXCESS_OK);
+    if (client) {
+        test_remove_and_recreate(client);
+        test_remove_by_id(client);
+        test_bulk_remove(client);
+        test_rename(client);
+        test_image_tags(client);
+        docker_excess_free(client);
+    }
+    
+    mock_daemon_stop(&daemon);
+    return TEST_RESULT();
+}
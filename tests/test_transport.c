@@ -0,0 +1,257 @@
+/*
+ * Retries and hedged reads must never replay a request once part of the
+ * body reached the caller. Retries and the breaker are off by default, and
+ * only an unreachable daemon counts toward the breaker. A zero log level
+ * means the INFO default.
+ */
+
+#include "../docker-excess.c"
+#include "mock_daemon.h"
+#include "test.h"
+
+#define PARTIAL_BYTES 100
+
+/* Requests arrive as /v1.xx/<path> */
+static bool is_route(const mock_request_t *req, const char *route) {
+    const char *path = strchr(req->path + 1, '/');
+    return path && strcmp(path, route) == 0;
+}
+
+static bool handle(int fd, const mock_request_t *req, void *userdata) {
+    (void)userdata;
+    
+    if (is_route(req, "/partial") || is_route(req, "/partial-slow")) {
+        /* Promise 1000 bytes, send a tenth of them, hang up */
+        const char *head = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 1000\r\n\r\n";
+        char body[PARTIAL_BYTES];
+        memset(body, 'x', sizeof(body));
+        mock_write(fd, head, strlen(head));
+        mock_write(fd, body, sizeof(body));
+        if (is_route(req, "/partial-slow")) usleep(300 * 1000);
+        return false;
+    }
+    if (is_route(req, "/garbled")) {
+        /* One good chunk, then a broken chunk header: a receive error after delivery */
+        const char *head = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nTransfer-Encoding: chunked\r\n\r\n64\r\n";
+        char body[PARTIAL_BYTES];
+        memset(body, 'x', sizeof(body));
+        mock_write(fd, head, strlen(head));
+        mock_write(fd, body, sizeof(body));
+        mock_write(fd, "\r\nzz\r\n", 6);
+        return false;
+    }
+    if (is_route(req, "/unavailable")) {
+        mock_reply(fd, 503, NULL, "{\"message\":\"busy\"}");
+        return true;
+    }
+    
+    mock_reply(fd, 200, NULL, "{\"ok\":true}");
+    return true;
+}
+
+static docker_excess_t* new_client(const mock_daemon_t *daemon, bool hedge) {
+    docker_excess_config_t config = {0};
+    config.socket_path = (char*)daemon->socket_path;
+    config.timeout_s = 5;
+    config.max_retries = 3;
+    config.retry_backoff_ms = 1;
+    config.hedge_reads = hedge;
+    config.hedge_delay_ms = 50;
+    config.metrics = true;
+    
+    docker_excess_t *client = NULL;
+    if (docker_excess_new_with_config(&config, &client) != DOCKER_EXCESS_OK) return NULL;
+    return client;
+}
+
+static uint64_t client_retries(docker_excess_t *client) {
+    docker_excess_metrics_t metrics;
+    if (docker_excess_metrics_snapshot(client, &metrics) != DOCKER_EXCESS_OK) return 0;
+    uint64_t retries = metrics.retries;
+    docker_excess_metrics_free(&metrics);
+    return retries;
+}
+
+static void test_partial_body(mock_daemon_t *daemon, bool hedge, const char *path) {
+    docker_excess_t *client = new_client(daemon, hedge);
+    CHECK(client != NULL);
+    if (!client) return;
+    
+    int before = mock_daemon_requests(daemon);
+    docker_excess_sink_t sink = { .type = DOCKER_EXCESS_SINK_MEMORY };
+    int http_code = 0;
+    docker_excess_error_t err = docker_excess_raw_request_sink(client, "GET", path, NULL, &sink, &http_code);
+    
+    CHECK(err != DOCKER_EXCESS_OK);
+    CHECK(mock_daemon_requests(daemon) - before == 1);
+    CHECK(client_retries(client) == 0);
+    CHECK(sink.size <= PARTIAL_BYTES);
+    
+    docker_excess_sink_release(&sink);
+    docker_excess_free(client);
+}
+
+/* A failure that delivered nothing is still retried */
+static void test_retry_before_body(mock_daemon_t *daemon) {
+    docker_excess_t *client = new_client(daemon, false);
+    CHECK(client != NULL);
+    if (!client) return;
+    
+    int before = mock_daemon_requests(daemon);
+    char *response = NULL;
+    int http_code = 0;
+    docker_excess_raw_request(client, "GET", "/unavailable", NULL, &response, &http_code);
+    
+    CHECK(http_code == 503);
+    CHECK(mock_daemon_requests(daemon) - before == 4);
+    CHECK(client_retries(client) == 3);
+    CHECK(response != NULL && strstr(response, "busy") != NULL);
+    
+    free(response);
+    docker_excess_free(client);
+}
+
+/* No retry after all, because the budget is spent or the request is the breaker's probe: the body still arrives */
+static void test_refused_retry_keeps_body(mock_daemon_t *daemon, bool probe) {
+    docker_excess_t *client = new_client(daemon, false);
+    CHECK(client != NULL);
+    if (!client) return;
+    
+    pthread_mutex_lock(&client->policy.mutex);
+    if (probe) {
+        client->config.breaker_threshold = 5;
+        client->policy.open_until = 1;      /* Cooldown long over */
+    } else {
+        client->policy.retry_tokens = 0;
+    }
+    pthread_mutex_unlock(&client->policy.mutex);
+    
+    int before = mock_daemon_requests(daemon);
+    char *response = NULL;
+    int http_code = 0;
+    docker_excess_raw_request(client, "GET", "/unavailable", NULL, &response, &http_code);
+    
+    CHECK(http_code == 503);
+    CHECK(mock_daemon_requests(daemon) - before == 1);
+    CHECK(client_retries(client) == 0);
+    CHECK(response != NULL && strstr(response, "busy") != NULL);
+    
+    free(response);
+    docker_excess_free(client);
+}
+
+/* A zero-filled config neither retries nor opens the breaker */
+static void test_policy_off_by_default(mock_daemon_t *daemon) {
+    docker_excess_config_t config = {0};
+    config.socket_path = daemon->socket_path;
+    config.timeout_s = 5;
+    docker_excess_t *client = NULL;
+    CHECK(docker_excess_new_with_config(&config, &client) == DOCKER_EXCESS_OK);
+    if (!client) return;
+    
+    int before = mock_daemon_requests(daemon);
+    for (int i = 0; i < 10; i++) {
+        char *response = NULL;
+        int http_code = 0;
+        docker_excess_raw_request(client, "GET", "/unavailable", NULL, &response, &http_code);
+        CHECK(http_code == 503);
+        free(response);
+    }
+    CHECK(mock_daemon_requests(daemon) - before == 10);
+    CHECK(!docker_excess_circuit_open(client));
+    docker_excess_free(client);
+}
+
+/* 503s are answers; only failing to reach the daemon opens the breaker */
+static void test_breaker_counts_unreachable(mock_daemon_t *daemon) {
+    docker_excess_config_t config = {0};
+    config.socket_path = daemon->socket_path;
+    config.timeout_s = 5;
+    config.breaker_threshold = 2;
+    docker_excess_t *client = NULL;
+    CHECK(docker_excess_new_with_config(&config, &client) == DOCKER_EXCESS_OK);
+    if (!client) return;
+    
+    for (int i = 0; i < 5; i++) {
+        char *response = NULL;
+        int http_code = 0;
+        docker_excess_raw_request(client, "GET", "/unavailable", NULL, &response, &http_code);
+        free(response);
+    }
+    CHECK(!docker_excess_circuit_open(client));
+    docker_excess_free(client);
+    
+    config.socket_path = "/nonexistent/docker-excess-test.sock";
+    CHECK(docker_excess_new_with_config(&config, &client) == DOCKER_EXCESS_OK);
+    if (!client) return;
+    for (int i = 0; i < 2; i++) {
+        char *response = NULL;
+        int http_code = 0;
+        CHECK(docker_excess_raw_request(client, "GET", "/anything", NULL, &response, &http_code) != DOCKER_EXCESS_OK);
+        free(response);
+    }
+    CHECK(docker_excess_circuit_open(client));
+    docker_excess_free(client);
+}
+
+static void count_level(docker_excess_log_level_t level, const char *message, void *userdata) {
+    (void)message;
+    int *seen = userdata;
+    if (level >= DOCKER_EXCESS_LOG_ERROR && level <= DOCKER_EXCESS_LOG_DEBUG) seen[level]++;
+}
+
+/* Logs the client's INFO line on creation and a DEBUG line per request */
+static void count_log_levels(mock_daemon_t *daemon, docker_excess_log_level_t log_level, int *seen) {
+    docker_excess_config_t config = {0};
+    config.socket_path = daemon->socket_path;
+    config.timeout_s = 5;
+    config.log_callback = count_level;
+    config.log_userdata = seen;
+    config.log_level = log_level;
+    docker_excess_t *client = NULL;
+    CHECK(docker_excess_new_with_config(&config, &client) == DOCKER_EXCESS_OK);
+    if (!client) return;
+    
+    char *response = NULL;
+    int http_code = 0;
+    docker_excess_raw_request(client, "GET", "/unavailable", NULL, &response, &http_code);
+    free(response);
+    docker_excess_free(client);
+}
+
+static void test_log_level_default(mock_daemon_t *daemon) {
+    int seen[DOCKER_EXCESS_LOG_DEBUG + 1] = {0};
+    count_log_levels(daemon, DOCKER_EXCESS_LOG_DEFAULT, seen);
+    CHECK(seen[DOCKER_EXCESS_LOG_INFO] > 0);
+    CHECK(seen[DOCKER_EXCESS_LOG_DEBUG] == 0);
+    
+    memset(seen, 0, sizeof(seen));
+    count_log_levels(daemon, DOCKER_EXCESS_LOG_ERROR, seen);
+    CHECK(seen[DOCKER_EXCESS_LOG_INFO] == 0 && seen[DOCKER_EXCESS_LOG_DEBUG] == 0);
+    
+    memset(seen, 0, sizeof(seen));
+    count_log_levels(daemon, DOCKER_EXCESS_LOG_DEBUG, seen);
+    CHECK(seen[DOCKER_EXCESS_LOG_INFO] > 0 && seen[DOCKER_EXCESS_LOG_DEBUG] > 0);
+}
+
+int main(void) {
+    mock_daemon_t daemon;
+    if (!mock_daemon_start(&daemon, handle, NULL)) {
+        perror("mock daemon");
+        return 1;
+    }
+    
+    test_partial_body(&daemon, false, "/partial");
+    test_partial_body(&daemon, true, "/partial-slow");
+    test_partial_body(&daemon, false, "/garbled");
+    test_partial_body(&daemon, true, "/garbled");
+    test_retry_before_body(&daemon);
+    test_refused_retry_keeps_body(&daemon, false);
+    test_refused_retry_keeps_body(&daemon, true);
+    test_policy_off_by_default(&daemon);
+    test_breaker_counts_unreachable(&daemon);
+    test_log_level_default(&daemon);
+    
+    mock_daemon_stop(&daemon);
+    return TEST_RESULT();
+}